@@ -28,6 +28,7 @@
 #include "cpp/sat_cnf_reader.h"
 #include "sat/boolean_problem.h"
 #include "sat/sat_solver.h"
+#include "sat/simplification.h"
 #include "util/time_limit.h"
 #include "algorithms/sparse_permutation.h"
 
@@ -70,6 +71,12 @@ DEFINE_bool(use_symmetry, false,
             "of the problem.");
 
 
+DEFINE_bool(presolve, false,
+            "If true, simplify the problem before solving it with subsumption, "
+            "self-subsuming resolution, bounded variable elimination and "
+            "failed literal probing. This is not compatible with the "
+            "unsat_proof parameter.");
+
 DEFINE_bool(refine_core, false,
             "If true, turn on the unsat_proof parameters and if the problem is "
             "UNSAT, refine as much as possible its UNSAT core in order to get "
@@ -123,9 +130,30 @@ int Run() {
     if (!reader.Load(FLAGS_input, &problem)) {
       LOG(FATAL) << "Cannot load file '" << FLAGS_input << "'.";
     }
+  } else {
     file::ReadFileToProtoOrDie(FLAGS_input, &problem);
   }
 
+  // Presolve the problem. The original problem is kept to check and store the
+  // final solution.
+  LinearBooleanProblem original_problem;
+  SatPostsolver postsolver(problem.num_variables());
+  if (FLAGS_presolve) {
+    CHECK(!parameters.unsat_proof())
+        << "--presolve is not compatible with unsat_proof.";
+    SatPresolver presolver(&postsolver);
+    presolver.SetParameters(parameters);
+    presolver.Load(problem);
+    if (!presolver.Presolve()) {
+      LOG(INFO) << "UNSAT when presolving.";
+      CHECK(FLAGS_expected_result == "undefined" ||
+            FLAGS_expected_result == "unsat");
+      return EXIT_SUCCESS;
+    }
+    original_problem.Swap(&problem);
+    presolver.ExtractPresolvedProblem(&problem);
+  }
+
 
   // Load the problem into the solver.
   if (!LoadBooleanProblem(problem, &solver)) {
@@ -204,6 +232,18 @@ int Run() {
     CHECK(IsAssignmentValid(problem, solver.Assignment()));
   }
 
+  // Extend the solution of the presolved problem to the original one.
+  VariablesAssignment postsolved_assignment;
+  if (FLAGS_presolve) {
+    problem.Swap(&original_problem);
+    if (result == SatSolver::MODEL_SAT) {
+      postsolver.PostsolveSolution(solver.Assignment(), &postsolved_assignment);
+      CHECK(IsAssignmentValid(problem, postsolved_assignment));
+    }
+  }
+  const VariablesAssignment& assignment =
+      FLAGS_presolve ? postsolved_assignment : solver.Assignment();
+
   // Unsat with verification.
   // Note(user): For now we just compute an UNSAT core and check it.
   if (result == SatSolver::MODEL_UNSAT && parameters.unsat_proof()) {
@@ -237,7 +277,7 @@ int Run() {
 
   if (!FLAGS_output.empty()) {
     if (result == SatSolver::MODEL_SAT) {
-      StoreAssignment(solver.Assignment(), problem.mutable_assignment());
+      StoreAssignment(assignment, problem.mutable_assignment());
     }
     if (HasSuffixString(FLAGS_output, ".txt")) {
       file::WriteProtoToASCIIFileOrDie(problem, FLAGS_output);
@@ -0,0 +1,223 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the domain consistent AllDifferent against an oracle which removes
+// all the values without support, under random removals and backtracks, and
+// checks the solution counts of all the consistency levels against brute
+// force.
+
+#include <set>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 6, "Number of variables");
+DEFINE_int32(max_value, 8, "The values are in [0, max_value]");
+DEFINE_int32(num_problems, 50, "Number of random problems");
+DEFINE_int32(depth, 3, "Depth of the nested searches");
+DEFINE_int32(operations, 3, "Number of removals per search node");
+
+namespace operations_research {
+
+typedef std::vector<std::set<int64> > Domains;
+
+// Returns true if the variables from 'index' on can be assigned distinct
+// values of their domains, different from the values in 'used'.
+bool CanComplete(const Domains& domains, int index, std::set<int64>* used) {
+  if (index == domains.size()) return true;
+  for (std::set<int64>::const_iterator it = domains[index].begin();
+       it != domains[index].end(); ++it) {
+    if (used->insert(*it).second) {
+      const bool found = CanComplete(domains, index + 1, used);
+      used->erase(*it);
+      if (found) return true;
+    }
+  }
+  return false;
+}
+
+// Returns the values of the domains which belong to a solution.
+Domains SupportedValues(const Domains& domains) {
+  Domains supported(domains.size());
+  for (int i = 0; i < domains.size(); ++i) {
+    for (std::set<int64>::const_iterator it = domains[i].begin();
+         it != domains[i].end(); ++it) {
+      Domains restricted = domains;
+      restricted[i].clear();
+      restricted[i].insert(*it);
+      std::set<int64> used;
+      if (CanComplete(restricted, 0, &used)) {
+        supported[i].insert(*it);
+      }
+    }
+  }
+  return supported;
+}
+
+bool IsFeasible(const Domains& domains) {
+  std::set<int64> used;
+  return CanComplete(domains, 0, &used);
+}
+
+Domains RandomDomains(ACMRandom* const rgen) {
+  Domains domains(FLAGS_size);
+  for (int i = 0; i < FLAGS_size; ++i) {
+    const int size = 2 + rgen->Uniform(4);
+    while (domains[i].size() < size) {
+      domains[i].insert(rgen->Uniform(FLAGS_max_value + 1));
+    }
+  }
+  return domains;
+}
+
+void CheckDomains(const std::vector<IntVar*>& vars, const Domains& domains) {
+  for (int i = 0; i < vars.size(); ++i) {
+    CHECK_EQ(domains[i].size(), vars[i]->Size()) << i;
+    for (std::set<int64>::const_iterator it = domains[i].begin();
+         it != domains[i].end(); ++it) {
+      CHECK(vars[i]->Contains(*it)) << i << " " << *it;
+    }
+  }
+}
+
+// Removes random values which keep the problem feasible, then checks that
+// nested searches restore the domains when they backtrack.
+class RandomRemovals : public DecisionBuilder {
+ public:
+  RandomRemovals(const std::vector<IntVar*>& vars, const Domains& domains,
+                 int depth, ACMRandom* const rgen)
+      : vars_(vars), domains_(domains), depth_(depth), rgen_(rgen) {}
+  virtual ~RandomRemovals() {}
+
+  virtual Decision* Next(Solver* const s) {
+    CheckDomains(vars_, domains_);
+    for (int i = 0; i < FLAGS_operations; ++i) {
+      const int index = rgen_->Uniform(vars_.size());
+      if (domains_[index].size() == 1) continue;
+      std::set<int64>::const_iterator it = domains_[index].begin();
+      for (int skip = rgen_->Uniform(domains_[index].size()); skip > 0;
+           --skip) {
+        ++it;
+      }
+      const int64 value = *it;
+      Domains reduced = domains_;
+      reduced[index].erase(value);
+      if (!IsFeasible(reduced)) continue;
+      vars_[index]->RemoveValue(value);
+      domains_ = SupportedValues(reduced);
+      CheckDomains(vars_, domains_);
+    }
+    if (depth_ < FLAGS_depth) {
+      for (int i = 0; i < 2; ++i) {
+        s->Solve(s->RevAlloc(
+            new RandomRemovals(vars_, domains_, depth_ + 1, rgen_)));
+        CheckDomains(vars_, domains_);
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  const std::vector<IntVar*> vars_;
+  Domains domains_;
+  const int depth_;
+  ACMRandom* const rgen_;
+};
+
+void MakeVars(Solver* const solver, const Domains& domains,
+              std::vector<IntVar*>* const vars) {
+  for (int i = 0; i < domains.size(); ++i) {
+    const std::vector<int64> values(domains[i].begin(), domains[i].end());
+    vars->push_back(solver->MakeIntVar(values));
+  }
+}
+
+void TestDomainConsistency() {
+  LOG(INFO) << "TestDomainConsistency";
+  ACMRandom rgen(FLAGS_seed);
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    Domains domains = RandomDomains(&rgen);
+    if (!IsFeasible(domains)) continue;
+    Solver solver("TestDomainConsistency");
+    std::vector<IntVar*> vars;
+    MakeVars(&solver, domains, &vars);
+    solver.AddConstraint(
+        solver.MakeAllDifferent(vars, Solver::DOMAIN_CONSISTENCY));
+    domains = SupportedValues(domains);
+    CHECK(solver.Solve(
+        solver.RevAlloc(new RandomRemovals(vars, domains, 0, &rgen))));
+  }
+}
+
+int64 CountSolutions(const Domains& domains,
+                     Solver::AllDifferentConsistency consistency) {
+  Solver solver("CountSolutions");
+  std::vector<IntVar*> vars;
+  MakeVars(&solver, domains, &vars);
+  solver.AddConstraint(solver.MakeAllDifferent(vars, consistency));
+  solver.NewSearch(solver.MakePhase(vars, Solver::CHOOSE_FIRST_UNBOUND,
+                                    Solver::ASSIGN_MIN_VALUE));
+  int64 count = 0;
+  while (solver.NextSolution()) {
+    for (int i = 0; i < vars.size(); ++i) {
+      for (int j = i + 1; j < vars.size(); ++j) {
+        CHECK_NE(vars[i]->Value(), vars[j]->Value());
+      }
+    }
+    ++count;
+  }
+  solver.EndSearch();
+  return count;
+}
+
+// Counts the assignments of the variables from 'index' on with distinct
+// values.
+int64 BruteForceCount(const Domains& domains, int index,
+                      std::set<int64>* used) {
+  if (index == domains.size()) return 1;
+  int64 count = 0;
+  for (std::set<int64>::const_iterator it = domains[index].begin();
+       it != domains[index].end(); ++it) {
+    if (used->insert(*it).second) {
+      count += BruteForceCount(domains, index + 1, used);
+      used->erase(*it);
+    }
+  }
+  return count;
+}
+
+void TestSolutionCounts() {
+  LOG(INFO) << "TestSolutionCounts";
+  ACMRandom rgen(FLAGS_seed);
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    const Domains domains = RandomDomains(&rgen);
+    std::set<int64> used;
+    const int64 count = BruteForceCount(domains, 0, &used);
+    CHECK_EQ(count, CountSolutions(domains, Solver::VALUE_CONSISTENCY));
+    CHECK_EQ(count, CountSolutions(domains, Solver::BOUNDS_CONSISTENCY));
+    CHECK_EQ(count, CountSolutions(domains, Solver::DOMAIN_CONSISTENCY));
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestDomainConsistency();
+  operations_research::TestSolutionCounts();
+  return 0;
+}
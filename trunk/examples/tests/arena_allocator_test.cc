@@ -0,0 +1,164 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Solves an assignment problem by large neighborhood search, with nested
+// searches and decisions whose constructors create other objects with
+// 'new (solver)', and checks that the search is the same with and without
+// the arena allocator and that all the objects are destroyed.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 12, "Number of tasks of the assignment problem");
+DEFINE_int64(failures, 2000, "Failure limit of the search");
+
+namespace operations_research {
+
+// Number of objects of the classes below which have not been destroyed yet.
+int num_live_objects = 0;
+
+class Value : public BaseObject {
+ public:
+  explicit Value(int64 value) : value_(value) { ++num_live_objects; }
+  virtual ~Value() { --num_live_objects; }
+
+  int64 value() const { return value_; }
+
+ private:
+  const int64 value_;
+};
+
+// Assigns a value to a variable; the value is stored in an object created by
+// the constructor.
+class NestedAssign : public Decision {
+ public:
+  NestedAssign(Solver* const solver, IntVar* const var, int64 value)
+      : var_(var), value_(solver->RevAlloc(new (solver) Value(value))) {
+    ++num_live_objects;
+  }
+  virtual ~NestedAssign() { --num_live_objects; }
+
+  virtual void Apply(Solver* const solver) { var_->SetValue(value_->value()); }
+  virtual void Refute(Solver* const solver) {
+    var_->RemoveValue(value_->value());
+  }
+
+ private:
+  IntVar* const var_;
+  const Value* const value_;
+};
+
+// Assigns the variables in order to their minimum value.
+class NestedAssignBuilder : public DecisionBuilder {
+ public:
+  explicit NestedAssignBuilder(const std::vector<IntVar*>& vars)
+      : vars_(vars) {}
+  virtual ~NestedAssignBuilder() {}
+
+  virtual Decision* Next(Solver* const solver) {
+    for (int i = 0; i < vars_.size(); ++i) {
+      if (!vars_[i]->Bound()) {
+        return solver->RevAlloc(
+            new (solver) NestedAssign(solver, vars_[i], vars_[i]->Min()));
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  const std::vector<IntVar*> vars_;
+};
+
+struct SearchResult {
+  std::vector<int64> values;
+  int64 objective;
+  int64 solutions;
+  int64 branches;
+  int64 failures;
+};
+
+// Solves the problem from a first solution found by a nested search, and
+// improves it by random LNS, whose fragments are completed by nested
+// searches.
+void Solve(bool use_arena_allocator, SearchResult* const result) {
+  SolverParameters parameters;
+  parameters.use_arena_allocator = use_arena_allocator;
+  Solver solver("AssignmentProblem", parameters);
+  const int size = FLAGS_size;
+  ACMRandom rgen(FLAGS_seed);
+  std::vector<IntVar*> vars;
+  solver.MakeIntVarArray(size, 0, size - 1, "task_", &vars);
+  solver.AddConstraint(solver.MakeAllDifferent(vars));
+  std::vector<IntVar*> costs;
+  for (int task = 0; task < size; ++task) {
+    std::vector<int64> task_costs;
+    for (int worker = 0; worker < size; ++worker) {
+      task_costs.push_back(rgen.Uniform(1000));
+    }
+    costs.push_back(solver.MakeElement(task_costs, vars[task])->Var());
+  }
+  IntVar* const objective = solver.MakeSum(costs)->Var();
+  DecisionBuilder* const builder =
+      solver.RevAlloc(new NestedAssignBuilder(vars));
+  LocalSearchPhaseParameters* const ls_parameters =
+      solver.MakeLocalSearchPhaseParameters(
+          solver.MakeRandomLNSOperator(vars, size / 3, FLAGS_seed), builder);
+  SolutionCollector* const collector = solver.MakeLastSolutionCollector();
+  collector->Add(vars);
+  collector->AddObjective(objective);
+  solver.Solve(
+      solver.MakeLocalSearchPhase(vars, solver.MakeSolveOnce(builder),
+                                  ls_parameters),
+      solver.MakeMinimize(objective, 1), collector,
+      solver.MakeFailuresLimit(FLAGS_failures));
+  CHECK_EQ(0, num_live_objects);
+  CHECK_EQ(1, collector->solution_count());
+  result->values.clear();
+  for (int task = 0; task < size; ++task) {
+    result->values.push_back(collector->Value(0, vars[task]));
+  }
+  result->objective = collector->objective_value(0);
+  result->solutions = solver.solutions();
+  result->branches = solver.branches();
+  result->failures = solver.failures();
+}
+
+void TestSameSearch() {
+  LOG(INFO) << "TestSameSearch";
+  SearchResult heap_result;
+  Solve(false, &heap_result);
+  SearchResult arena_result;
+  Solve(true, &arena_result);
+  LOG(INFO) << "Objective " << heap_result.objective << ", "
+            << heap_result.solutions << " solutions";
+  // LNS improved the first solution.
+  CHECK_GT(heap_result.solutions, 1);
+  CHECK(heap_result.values == arena_result.values);
+  CHECK_EQ(heap_result.objective, arena_result.objective);
+  CHECK_EQ(heap_result.solutions, arena_result.solutions);
+  CHECK_EQ(heap_result.branches, arena_result.branches);
+  CHECK_EQ(heap_result.failures, arena_result.failures);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestSameSearch();
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the lookups, Clear(), Copy() and operator== of the assignment
+// containers, whose elements are indexed either by the dense index of their
+// variable or by a hash map.
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_vars, 1000, "Number of variables of the solver");
+
+namespace operations_research {
+
+typedef Assignment::IntContainer IntContainer;
+
+// Returns 'size' distinct variables of 'vars' in random order.
+std::vector<IntVar*> RandomVars(const std::vector<IntVar*>& vars, int size,
+                                ACMRandom* const rgen) {
+  std::vector<IntVar*> shuffled = vars;
+  std::random_shuffle(shuffled.begin(), shuffled.end(), *rgen);
+  shuffled.resize(size);
+  return shuffled;
+}
+
+// Adds 'vars' to 'container', with values depending on 'offset'.
+void AddVars(const std::vector<IntVar*>& vars, int64 offset,
+             IntContainer* const container) {
+  for (int i = 0; i < vars.size(); ++i) {
+    container->Add(vars[i])->SetValue(vars[i]->index() + offset);
+  }
+}
+
+// Checks that 'container' holds exactly 'vars' among 'all_vars', with the
+// values set by AddVars().
+void CheckContainer(const std::vector<IntVar*>& all_vars,
+                    const std::vector<IntVar*>& vars, int64 offset,
+                    const IntContainer& container) {
+  CHECK_EQ(vars.size(), container.Size());
+  const std::set<IntVar*> var_set(vars.begin(), vars.end());
+  for (int i = 0; i < all_vars.size(); ++i) {
+    IntVar* const var = all_vars[i];
+    const bool contained = var_set.count(var) > 0;
+    CHECK_EQ(contained, container.Contains(var)) << var->DebugString();
+    if (contained) {
+      CHECK_EQ(var->index() + offset, container.Element(var).Value());
+    } else {
+      CHECK(container.ElementPtrOrNull(var) == nullptr);
+    }
+  }
+}
+
+// Large containers index the variables whose index is below a few times
+// their size by dense positions, and the other ones by a hash map; the small
+// ones only use the hash map. Clearing a container and adding other
+// variables must forget all the previous positions.
+void TestLookups(int size) {
+  LOG(INFO) << "TestLookups(" << size << ")";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestLookups");
+  std::vector<IntVar*> all_vars;
+  solver.MakeIntVarArray(FLAGS_num_vars, 0, 10 * FLAGS_num_vars, "x",
+                         &all_vars);
+  IntContainer container;
+  for (int round = 0; round < 5; ++round) {
+    const std::vector<IntVar*> vars = RandomVars(all_vars, size, &rgen);
+    if (size >= 64) {
+      int num_high_indices = 0;
+      for (int i = 0; i < vars.size(); ++i) {
+        if (vars[i]->index() >= 4 * size) ++num_high_indices;
+      }
+      CHECK_GT(num_high_indices, 0);
+      CHECK_LT(num_high_indices, size);
+    }
+    // Adding the variables again does not create new elements.
+    AddVars(vars, round, &container);
+    AddVars(vars, round, &container);
+    CheckContainer(all_vars, vars, round, container);
+    container.Clear();
+    CHECK(container.Empty());
+    CheckContainer(all_vars, std::vector<IntVar*>(), round, container);
+  }
+}
+
+// Copy() copies the values and the activation of the variables of the
+// source container that are in the target container, whatever their order.
+void TestCopy(int size) {
+  LOG(INFO) << "TestCopy(" << size << ")";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestCopy");
+  std::vector<IntVar*> all_vars;
+  solver.MakeIntVarArray(FLAGS_num_vars, 0, 10 * FLAGS_num_vars, "x",
+                         &all_vars);
+  std::vector<IntVar*> vars = RandomVars(all_vars, size, &rgen);
+  IntContainer source;
+  AddVars(vars, 1, &source);
+  for (int i = 0; i < size; i += 3) {
+    source.MutableElement(vars[i])->Deactivate();
+  }
+  // The target has the first half of the variables of the source in another
+  // order, and other variables.
+  std::vector<IntVar*> target_vars(vars.begin(), vars.begin() + size / 2);
+  for (int i = 0; i < all_vars.size() && target_vars.size() < size; ++i) {
+    if (!source.Contains(all_vars[i])) target_vars.push_back(all_vars[i]);
+  }
+  std::random_shuffle(target_vars.begin(), target_vars.end(), rgen);
+  IntContainer target;
+  AddVars(target_vars, 2, &target);
+  target.Copy(source);
+  for (int i = 0; i < target_vars.size(); ++i) {
+    IntVar* const var = target_vars[i];
+    const IntVarElement& element = target.Element(var);
+    if (source.Contains(var)) {
+      CHECK_EQ(var->index() + 1, element.Value());
+      CHECK_EQ(source.Element(var).Activated(), element.Activated());
+    } else {
+      CHECK_EQ(var->index() + 2, element.Value());
+      CHECK(element.Activated());
+    }
+  }
+}
+
+// Two containers are equal when they map the same variables to the same
+// elements, whatever the order of the elements.
+void TestEquality(int size) {
+  LOG(INFO) << "TestEquality(" << size << ")";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestEquality");
+  std::vector<IntVar*> all_vars;
+  solver.MakeIntVarArray(FLAGS_num_vars, 0, 10 * FLAGS_num_vars, "x",
+                         &all_vars);
+  std::vector<IntVar*> vars = RandomVars(all_vars, size, &rgen);
+  IntContainer container;
+  AddVars(vars, 0, &container);
+  std::random_shuffle(vars.begin(), vars.end(), rgen);
+  IntContainer shuffled;
+  AddVars(vars, 0, &shuffled);
+  CHECK(container == shuffled);
+  CHECK(shuffled == container);
+  // Different values.
+  shuffled.MutableElement(vars[size / 2])->SetValue(-1);
+  CHECK(container != shuffled);
+  CHECK(shuffled != container);
+  // Different variables, with the same size.
+  IntContainer other;
+  AddVars(std::vector<IntVar*>(vars.begin() + 1, vars.end()), 0, &other);
+  for (int i = 0; other.Size() < size; ++i) {
+    if (!container.Contains(all_vars[i])) {
+      other.Add(all_vars[i])->SetValue(all_vars[i]->index());
+    }
+  }
+  CHECK(container != other);
+  CHECK(other != container);
+  // Different sizes.
+  IntContainer smaller;
+  AddVars(std::vector<IntVar*>(vars.begin(), vars.end() - 1), 0, &smaller);
+  CHECK(container != smaller);
+  CHECK(smaller != container);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  // Linear search, hash map only, and dense positions with a hash map.
+  for (int size = 8; size <= 300; size *= 3) {
+    operations_research::TestLookups(size);
+    operations_research::TestCopy(size);
+    operations_research::TestEquality(size);
+  }
+  return 0;
+}
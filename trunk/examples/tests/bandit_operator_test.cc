@@ -0,0 +1,241 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks that the multi-armed bandit compound operator explores first the
+// operator which keeps improving the objective, and that it still enumerates
+// all the neighbors of all its operators whatever their order.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(size, 10, "Number of variables");
+
+namespace operations_research {
+
+// Adds 'shift' to the value of one variable.
+class ShiftValue : public IntVarLocalSearchOperator {
+ public:
+  ShiftValue(const std::vector<IntVar*>& vars, int64 shift)
+      : IntVarLocalSearchOperator(vars), shift_(shift), index_(0) {}
+  virtual ~ShiftValue() {}
+
+  virtual std::string DebugString() const { return "ShiftValue"; }
+
+ protected:
+  virtual bool MakeOneNeighbor() {
+    if (index_ >= Size()) {
+      return false;
+    }
+    SetValue(index_, OldValue(index_) + shift_);
+    ++index_;
+    return true;
+  }
+
+ private:
+  virtual void OnStart() { index_ = 0; }
+
+  const int64 shift_;
+  int index_;
+};
+
+// What the compound operator asked its operators since it was started.
+struct Episode {
+  // The operator which was asked for a neighbor first, or -1.
+  int first_operator;
+  // The operators which have no more neighbors.
+  std::vector<bool> exhausted;
+  // The number of neighbors produced by each operator.
+  std::vector<int> num_neighbors;
+};
+
+// Records in 'episode' the calls to 'ls_operator', the operator 'id' of a
+// compound operator.
+class RecordingOperator : public LocalSearchOperator {
+ public:
+  RecordingOperator(LocalSearchOperator* const ls_operator, int id,
+                    Episode* const episode)
+      : ls_operator_(ls_operator), id_(id), episode_(episode) {}
+  virtual ~RecordingOperator() {}
+
+  virtual void Start(const Assignment* assignment) {
+    episode_->first_operator = -1;
+    episode_->exhausted[id_] = false;
+    episode_->num_neighbors[id_] = 0;
+    ls_operator_->Start(assignment);
+  }
+
+  virtual bool MakeNextNeighbor(Assignment* delta, Assignment* deltadelta) {
+    if (episode_->first_operator == -1) {
+      episode_->first_operator = id_;
+    }
+    CHECK(!episode_->exhausted[id_]);
+    if (ls_operator_->MakeNextNeighbor(delta, deltadelta)) {
+      ++episode_->num_neighbors[id_];
+      return true;
+    }
+    episode_->exhausted[id_] = true;
+    return false;
+  }
+
+  virtual std::string DebugString() const { return "RecordingOperator"; }
+
+ private:
+  LocalSearchOperator* const ls_operator_;
+  const int id_;
+  Episode* const episode_;
+};
+
+// Returns a compound operator of operators adding 1, 2 and -1 to a variable,
+// recorded in 'episode'.
+LocalSearchOperator* MakeBanditOperator(Solver* const solver,
+                                        const std::vector<IntVar*>& vars,
+                                        Episode* const episode) {
+  const int64 kShifts[] = {1, 2, -1};
+  const int num_operators = sizeof(kShifts) / sizeof(kShifts[0]);
+  episode->first_operator = -1;
+  episode->exhausted.assign(num_operators, false);
+  episode->num_neighbors.assign(num_operators, 0);
+  std::vector<LocalSearchOperator*> operators;
+  for (int i = 0; i < num_operators; ++i) {
+    operators.push_back(solver->RevAlloc(new RecordingOperator(
+        solver->RevAlloc(new ShiftValue(vars, kShifts[i])), i, episode)));
+  }
+  return solver->MultiArmedBanditConcatenateOperators(operators, 0.5, 1e-3,
+                                                      false);
+}
+
+// Records the first operator of each local search episode.
+class EpisodeMonitor : public SearchMonitor {
+ public:
+  EpisodeMonitor(Solver* const solver, const Episode* const episode)
+      : SearchMonitor(solver), episode_(episode) {}
+  virtual ~EpisodeMonitor() {}
+
+  virtual bool AtSolution() {
+    first_operators_.push_back(episode_->first_operator);
+    return false;
+  }
+
+  const std::vector<int>& first_operators() const { return first_operators_; }
+
+ private:
+  const Episode* const episode_;
+  std::vector<int> first_operators_;
+};
+
+// When minimizing the sum of the variables, only the operator adding -1,
+// which is given last, finds improving neighbors; the compound operator
+// moves it first after a few improvements, and keeps it first.
+void TestRanking() {
+  LOG(INFO) << "TestRanking";
+  Solver solver("TestRanking");
+  std::vector<IntVar*> vars;
+  solver.MakeIntVarArray(FLAGS_size, 0, 100, "x", &vars);
+  IntVar* const objective = solver.MakeSum(vars)->Var();
+  Assignment* const assignment = solver.MakeAssignment();
+  assignment->Add(vars);
+  for (int i = 0; i < vars.size(); ++i) {
+    assignment->SetValue(vars[i], 50);
+  }
+  Episode episode;
+  LocalSearchOperator* const bandit =
+      MakeBanditOperator(&solver, vars, &episode);
+  EpisodeMonitor* const monitor =
+      solver.RevAlloc(new EpisodeMonitor(&solver, &episode));
+  const int kNumSolutions = 30;
+  CHECK(solver.Solve(
+      solver.MakeLocalSearchPhase(
+          assignment, solver.MakeLocalSearchPhaseParameters(bandit, nullptr)),
+      solver.MakeMinimize(objective, 1), monitor,
+      solver.MakeSolutionsLimit(kNumSolutions)));
+  const std::vector<int>& first_operators = monitor->first_operators();
+  CHECK_EQ(kNumSolutions, first_operators.size());
+  // The first solution is the initial assignment; the second one was found
+  // by exploring the operators in their given order.
+  CHECK_EQ(0, first_operators[1]);
+  for (int i = kNumSolutions / 2; i < kNumSolutions; ++i) {
+    CHECK_EQ(2, first_operators[i]) << i;
+  }
+}
+
+// Starting the compound operator from assignments with decreasing
+// objectives changes the order of its operators; each neighborhood still
+// contains all the neighbors of all the operators, and the compound
+// operator only fails once all of them have failed.
+void TestEnumeration() {
+  LOG(INFO) << "TestEnumeration";
+  Solver solver("TestEnumeration");
+  std::vector<IntVar*> vars;
+  solver.MakeIntVarArray(FLAGS_size, 0, 100, "x", &vars);
+  IntVar* const objective = solver.MakeSum(vars)->Var();
+  Assignment* const assignment = solver.MakeAssignment();
+  assignment->Add(vars);
+  assignment->AddObjective(objective);
+  for (int i = 0; i < vars.size(); ++i) {
+    assignment->SetValue(vars[i], 50);
+  }
+  Episode episode;
+  LocalSearchOperator* const bandit =
+      MakeBanditOperator(&solver, vars, &episode);
+  Assignment* const delta = solver.MakeAssignment();
+  Assignment* const deltadelta = solver.MakeAssignment();
+  int64 objective_value = 1000;
+  std::vector<bool> was_first(episode.exhausted.size(), false);
+  for (int round = 0; round < 20; ++round) {
+    assignment->SetObjectiveValue(objective_value);
+    bandit->Start(assignment);
+    if (round % 2 == 0) {
+      // Rewards the operator ranked second, which produces the last
+      // neighbor of this round, and not the first one.
+      for (int i = 0; i <= FLAGS_size; ++i) {
+        delta->Clear();
+        deltadelta->Clear();
+        CHECK(bandit->MakeNextNeighbor(delta, deltadelta));
+      }
+      was_first[episode.first_operator] = true;
+      objective_value -= 10;
+    } else {
+      int num_neighbors = 0;
+      for (;;) {
+        delta->Clear();
+        deltadelta->Clear();
+        if (!bandit->MakeNextNeighbor(delta, deltadelta)) break;
+        ++num_neighbors;
+      }
+      for (int i = 0; i < episode.exhausted.size(); ++i) {
+        CHECK(episode.exhausted[i]) << i;
+        CHECK_EQ(FLAGS_size, episode.num_neighbors[i]) << i;
+      }
+      CHECK_EQ(FLAGS_size * episode.exhausted.size(), num_neighbors);
+    }
+  }
+  // The order did change.
+  int num_first_operators = 0;
+  for (int i = 0; i < was_first.size(); ++i) {
+    if (was_first[i]) ++num_first_operators;
+  }
+  CHECK_GT(num_first_operators, 1);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestRanking();
+  operations_research::TestEnumeration();
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the solution counts of small random cumulative problems against
+// brute force, with the combinations of the cumulative propagators.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_problems, 100, "Number of random problems");
+DEFINE_int32(num_tasks, 6, "Number of tasks of the problems");
+DEFINE_int32(horizon, 7, "The tasks end before the horizon");
+DECLARE_bool(cp_use_cumulative_edge_finder);
+DECLARE_bool(cp_use_cumulative_time_table);
+DECLARE_bool(cp_use_cumulative_time_table_edge_finder);
+DECLARE_bool(cp_use_sequence_high_demand_tasks);
+DECLARE_bool(cp_use_all_possible_disjunctions);
+
+namespace operations_research {
+
+struct Problem {
+  std::vector<int64> durations;
+  std::vector<int64> demands;
+  int64 capacity;
+};
+
+// Returns true if the usage of the tasks never exceeds the capacity.
+bool IsFeasible(const Problem& problem, const std::vector<int64>& starts) {
+  for (int64 time = 0; time < FLAGS_horizon; ++time) {
+    int64 usage = 0;
+    for (int i = 0; i < starts.size(); ++i) {
+      if (starts[i] <= time && time < starts[i] + problem.durations[i]) {
+        usage += problem.demands[i];
+      }
+    }
+    if (usage > problem.capacity) return false;
+  }
+  return true;
+}
+
+// Counts the feasible start times of the tasks from 'index' on.
+int64 BruteForceCount(const Problem& problem, int index,
+                      std::vector<int64>* const starts) {
+  if (index == starts->size()) return IsFeasible(problem, *starts) ? 1 : 0;
+  int64 count = 0;
+  for ((*starts)[index] = 0;
+       (*starts)[index] <= FLAGS_horizon - problem.durations[index];
+       ++(*starts)[index]) {
+    count += BruteForceCount(problem, index + 1, starts);
+  }
+  return count;
+}
+
+// The propagators posted by the cumulative constraint.
+struct Propagators {
+  bool time_table;
+  bool edge_finder;
+  bool time_table_edge_finder;
+  bool decompositions;
+};
+
+int64 CountSolutions(const Problem& problem, const Propagators& propagators) {
+  FLAGS_cp_use_cumulative_time_table = propagators.time_table;
+  FLAGS_cp_use_cumulative_edge_finder = propagators.edge_finder;
+  FLAGS_cp_use_cumulative_time_table_edge_finder =
+      propagators.time_table_edge_finder;
+  FLAGS_cp_use_sequence_high_demand_tasks = propagators.decompositions;
+  FLAGS_cp_use_all_possible_disjunctions = propagators.decompositions;
+  const int num_tasks = problem.durations.size();
+  Solver solver("CountSolutions");
+  std::vector<IntVar*> starts;
+  std::vector<IntervalVar*> tasks;
+  for (int i = 0; i < num_tasks; ++i) {
+    starts.push_back(
+        solver.MakeIntVar(0, FLAGS_horizon - problem.durations[i]));
+    tasks.push_back(solver.MakeFixedDurationIntervalVar(
+        starts[i], problem.durations[i], "task"));
+  }
+  solver.AddConstraint(solver.MakeCumulative(tasks, problem.demands,
+                                             problem.capacity, "cumulative"));
+  solver.NewSearch(solver.MakePhase(starts, Solver::CHOOSE_FIRST_UNBOUND,
+                                    Solver::ASSIGN_MIN_VALUE));
+  int64 count = 0;
+  while (solver.NextSolution()) {
+    std::vector<int64> values(num_tasks);
+    for (int i = 0; i < num_tasks; ++i) {
+      values[i] = starts[i]->Value();
+    }
+    CHECK(IsFeasible(problem, values));
+    ++count;
+  }
+  solver.EndSearch();
+  return count;
+}
+
+// The search backtracks over every node, so this also checks that the
+// propagators restore their state.
+void TestSolutionCounts(const Propagators& propagators) {
+  LOG(INFO) << "TestSolutionCounts(" << propagators.time_table << ", "
+            << propagators.edge_finder << ", "
+            << propagators.time_table_edge_finder << ", "
+            << propagators.decompositions << ")";
+  ACMRandom rgen(FLAGS_seed);
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    Problem problem;
+    problem.capacity = 2 + rgen.Uniform(3);
+    for (int i = 0; i < FLAGS_num_tasks; ++i) {
+      problem.durations.push_back(1 + rgen.Uniform(3));
+      problem.demands.push_back(1 + rgen.Uniform(problem.capacity));
+    }
+    std::vector<int64> starts(FLAGS_num_tasks);
+    CHECK_EQ(BruteForceCount(problem, 0, &starts),
+             CountSolutions(problem, propagators)) << p;
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  // Only the time table checks the usage at each time against the capacity,
+  // so it is always posted.
+  const operations_research::Propagators kPropagators[] = {
+    {true, false, false, false}, {true, true, false, false},
+    {true, false, true, false}, {true, true, true, false},
+    {true, true, true, true}
+  };
+  for (int i = 0; i < sizeof(kPropagators) / sizeof(kPropagators[0]); ++i) {
+    operations_research::TestSolutionCounts(kPropagators[i]);
+  }
+  return 0;
+}
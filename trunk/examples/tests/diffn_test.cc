@@ -0,0 +1,196 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the non overlapping boxes constraint: the solution counts of small
+// random problems against brute force, and the solutions of a larger one.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_problems, 20, "Number of random problems per test");
+
+namespace operations_research {
+
+struct Box {
+  int64 x;
+  int64 y;
+  int64 dx;
+  int64 dy;
+};
+
+bool Overlap(const Box& a, const Box& b) {
+  return a.x < b.x + b.dx && b.x < a.x + a.dx && a.y < b.y + b.dy &&
+         b.y < a.y + a.dy;
+}
+
+bool NoOverlap(const std::vector<Box>& boxes) {
+  for (int i = 0; i < boxes.size(); ++i) {
+    for (int j = i + 1; j < boxes.size(); ++j) {
+      if (Overlap(boxes[i], boxes[j])) return false;
+    }
+  }
+  return true;
+}
+
+// The boxes have their origins in [min, max]^2, and their sizes in
+// [1, max_size[i]].
+struct Problem {
+  int64 min;
+  int64 max;
+  std::vector<int64> min_sizes;
+  std::vector<int64> max_sizes;
+};
+
+// Counts the placements of the boxes from 'index' on which do not overlap
+// the boxes before 'index'.
+int64 BruteForceCount(const Problem& problem, int index,
+                      std::vector<Box>* const boxes) {
+  if (index == boxes->size()) return 1;
+  int64 count = 0;
+  Box& box = (*boxes)[index];
+  for (box.x = problem.min; box.x <= problem.max; ++box.x) {
+    for (box.y = problem.min; box.y <= problem.max; ++box.y) {
+      for (box.dx = problem.min_sizes[index];
+           box.dx <= problem.max_sizes[index]; ++box.dx) {
+        for (box.dy = problem.min_sizes[index];
+             box.dy <= problem.max_sizes[index]; ++box.dy) {
+          bool overlap = false;
+          for (int i = 0; i < index && !overlap; ++i) {
+            overlap = Overlap((*boxes)[i], box);
+          }
+          if (!overlap) {
+            count += BruteForceCount(problem, index + 1, boxes);
+          }
+        }
+      }
+    }
+  }
+  return count;
+}
+
+int64 CountSolutions(const Problem& problem) {
+  const int num_boxes = problem.min_sizes.size();
+  Solver solver("CountSolutions");
+  std::vector<IntVar*> x;
+  std::vector<IntVar*> y;
+  std::vector<IntVar*> dx;
+  std::vector<IntVar*> dy;
+  solver.MakeIntVarArray(num_boxes, problem.min, problem.max, &x);
+  solver.MakeIntVarArray(num_boxes, problem.min, problem.max, &y);
+  for (int i = 0; i < num_boxes; ++i) {
+    dx.push_back(
+        solver.MakeIntVar(problem.min_sizes[i], problem.max_sizes[i]));
+    dy.push_back(
+        solver.MakeIntVar(problem.min_sizes[i], problem.max_sizes[i]));
+  }
+  solver.AddConstraint(solver.MakeNonOverlappingBoxesConstraint(x, y, dx, dy));
+  std::vector<IntVar*> all_vars;
+  for (int i = 0; i < num_boxes; ++i) {
+    all_vars.push_back(x[i]);
+    all_vars.push_back(y[i]);
+    all_vars.push_back(dx[i]);
+    all_vars.push_back(dy[i]);
+  }
+  solver.NewSearch(solver.MakePhase(all_vars, Solver::CHOOSE_FIRST_UNBOUND,
+                                    Solver::ASSIGN_MIN_VALUE));
+  int64 count = 0;
+  while (solver.NextSolution()) {
+    std::vector<Box> boxes(num_boxes);
+    for (int i = 0; i < num_boxes; ++i) {
+      boxes[i].x = x[i]->Value();
+      boxes[i].y = y[i]->Value();
+      boxes[i].dx = dx[i]->Value();
+      boxes[i].dy = dy[i]->Value();
+    }
+    CHECK(NoOverlap(boxes));
+    ++count;
+  }
+  solver.EndSearch();
+  return count;
+}
+
+// With fixed sizes and nonnegative origins, redundant cumulative constraints
+// are added to the boxes, which is not the case with negative origins or
+// variable sizes.
+void TestSolutionCounts(int num_boxes, int64 min, int64 max,
+                        bool variable_sizes) {
+  LOG(INFO) << "TestSolutionCounts(" << num_boxes << ", " << min << ", "
+            << max << ", " << variable_sizes << ")";
+  ACMRandom rgen(FLAGS_seed);
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    Problem problem;
+    problem.min = min;
+    problem.max = max;
+    for (int i = 0; i < num_boxes; ++i) {
+      const int64 size = 1 + rgen.Uniform(variable_sizes ? 2 : 3);
+      problem.min_sizes.push_back(variable_sizes ? 1 : size);
+      problem.max_sizes.push_back(size);
+    }
+    std::vector<Box> boxes(num_boxes);
+    CHECK_EQ(BruteForceCount(problem, 0, &boxes), CountSolutions(problem));
+  }
+}
+
+// Places many boxes in a square, box by box at the lowest coordinates, and
+// checks the first solution.
+void TestPacking() {
+  LOG(INFO) << "TestPacking";
+  ACMRandom rgen(FLAGS_seed);
+  const int kNumBoxes = 40;
+  const int64 kSide = 20;
+  Solver solver("TestPacking");
+  std::vector<IntVar*> x;
+  std::vector<IntVar*> y;
+  std::vector<int64> dx;
+  std::vector<int64> dy;
+  for (int i = 0; i < kNumBoxes; ++i) {
+    dx.push_back(1 + rgen.Uniform(3));
+    dy.push_back(1 + rgen.Uniform(3));
+    x.push_back(solver.MakeIntVar(0, kSide - dx[i]));
+    y.push_back(solver.MakeIntVar(0, kSide - dy[i]));
+  }
+  solver.AddConstraint(solver.MakeNonOverlappingBoxesConstraint(x, y, dx, dy));
+  std::vector<IntVar*> all_vars;
+  for (int i = 0; i < kNumBoxes; ++i) {
+    all_vars.push_back(x[i]);
+    all_vars.push_back(y[i]);
+  }
+  solver.NewSearch(solver.MakePhase(all_vars, Solver::CHOOSE_FIRST_UNBOUND,
+                                    Solver::ASSIGN_MIN_VALUE));
+  CHECK(solver.NextSolution());
+  std::vector<Box> boxes(kNumBoxes);
+  for (int i = 0; i < kNumBoxes; ++i) {
+    boxes[i].x = x[i]->Value();
+    boxes[i].y = y[i]->Value();
+    boxes[i].dx = dx[i];
+    boxes[i].dy = dy[i];
+  }
+  CHECK(NoOverlap(boxes));
+  solver.EndSearch();
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestSolutionCounts(4, 0, 3, false);
+  operations_research::TestSolutionCounts(4, -2, 1, false);
+  operations_research::TestSolutionCounts(3, -1, 2, true);
+  operations_research::TestPacking();
+  return 0;
+}
@@ -0,0 +1,184 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the round trip of the fast LZ codec on compressible and
+// incompressible inputs, its detection of truncated inputs, and the
+// restoration of a trail compressed with it under nested backtracks.
+
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+#include "util/fast_compression.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(depth, 5, "Depth of the nested searches");
+DEFINE_int32(operations, 500, "Number of operations per search node");
+
+namespace operations_research {
+
+void CheckRoundTrip(const std::string& input) {
+  std::vector<char> compressed(FastCompressBound(input.size()));
+  const size_t compressed_size =
+      FastCompress(input.data(), input.size(), &compressed[0]);
+  CHECK_LE(compressed_size, compressed.size());
+  std::string output(input.size() + 1, 'x');
+  CHECK(FastUncompress(&compressed[0], compressed_size, &output[0],
+                       input.size()));
+  CHECK_EQ('x', output[input.size()]);
+  output.resize(input.size());
+  CHECK(input == output);
+  // A wrong output size or a truncated input is detected.
+  std::string too_large(input.size() + 1, 'x');
+  CHECK(!FastUncompress(&compressed[0], compressed_size, &too_large[0],
+                        input.size() + 1));
+  if (!input.empty()) {
+    CHECK(!FastUncompress(&compressed[0], compressed_size, &output[0],
+                          input.size() - 1));
+    CHECK(!FastUncompress(&compressed[0], compressed_size - 1, &output[0],
+                          input.size()));
+  }
+}
+
+std::string RandomBytes(int size, ACMRandom* const rgen) {
+  std::string bytes(size, 0);
+  for (int i = 0; i < size; ++i) {
+    bytes[i] = rgen->Uniform(256);
+  }
+  return bytes;
+}
+
+// Repeats a random pattern of the given period.
+std::string Periodic(int size, int period, ACMRandom* const rgen) {
+  const std::string pattern = RandomBytes(period, rgen);
+  std::string bytes(size, 0);
+  for (int i = 0; i < size; ++i) {
+    bytes[i] = pattern[i % period];
+  }
+  return bytes;
+}
+
+// Random bytes with copies of previous substrings at random distances,
+// including distances beyond the maximum offset of a match.
+std::string WithCopies(int size, ACMRandom* const rgen) {
+  std::string bytes;
+  while (bytes.size() < size) {
+    const int length = 1 + rgen->Uniform(300);
+    if (bytes.size() > length && rgen->Uniform(2) == 0) {
+      const int start = rgen->Uniform(bytes.size() - length);
+      bytes.append(bytes, start, length);
+    } else {
+      bytes.append(RandomBytes(length, rgen));
+    }
+  }
+  bytes.resize(size);
+  return bytes;
+}
+
+void TestRoundTrip() {
+  LOG(INFO) << "TestRoundTrip";
+  ACMRandom rgen(FLAGS_seed);
+  const int kSizes[] = {0, 1, 4, 5, 12, 13, 17, 100, 1000, 70000, 300000};
+  const int kPeriods[] = {1, 3, 4, 7, 100, 65535, 65536, 70000};
+  for (int s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    const int size = kSizes[s];
+    CheckRoundTrip(RandomBytes(size, &rgen));
+    CheckRoundTrip(WithCopies(size, &rgen));
+    for (int p = 0; p < sizeof(kPeriods) / sizeof(kPeriods[0]); ++p) {
+      CheckRoundTrip(Periodic(size, kPeriods[p], &rgen));
+    }
+  }
+  // Long runs compress well.
+  const std::string zeros(100000, 0);
+  std::vector<char> compressed(FastCompressBound(zeros.size()));
+  CHECK_LT(FastCompress(zeros.data(), zeros.size(), &compressed[0]), 1000);
+}
+
+// Applies random bound reductions to the variables, then checks that nested
+// searches restore them when they backtrack. There are many more changes per
+// node than entries in a trail block, so the trail is packed and unpacked.
+class RandomBoundOperations : public DecisionBuilder {
+ public:
+  RandomBoundOperations(const std::vector<IntVar*>& vars, int depth,
+                        ACMRandom* const rgen)
+      : vars_(vars), depth_(depth), rgen_(rgen) {}
+  virtual ~RandomBoundOperations() {}
+
+  virtual Decision* Next(Solver* const s) {
+    for (int i = 0; i < FLAGS_operations; ++i) {
+      IntVar* const var = vars_[rgen_->Uniform(vars_.size())];
+      const int64 span = var->Max() - var->Min();
+      if (rgen_->Uniform(2) == 0) {
+        var->SetMin(var->Min() + rgen_->Uniform(span / 4 + 1));
+      } else {
+        var->SetMax(var->Max() - rgen_->Uniform(span / 4 + 1));
+      }
+    }
+    std::vector<int64> mins(vars_.size());
+    std::vector<int64> maxes(vars_.size());
+    for (int i = 0; i < vars_.size(); ++i) {
+      mins[i] = vars_[i]->Min();
+      maxes[i] = vars_[i]->Max();
+    }
+    if (depth_ < FLAGS_depth) {
+      for (int i = 0; i < 2; ++i) {
+        s->Solve(s->RevAlloc(
+            new RandomBoundOperations(vars_, depth_ + 1, rgen_)));
+        for (int j = 0; j < vars_.size(); ++j) {
+          CHECK_EQ(mins[j], vars_[j]->Min());
+          CHECK_EQ(maxes[j], vars_[j]->Max());
+        }
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  const std::vector<IntVar*> vars_;
+  const int depth_;
+  ACMRandom* const rgen_;
+};
+
+void TestTrail(SolverParameters::TrailCompression compression) {
+  LOG(INFO) << "TestTrail(" << compression << ")";
+  ACMRandom rgen(FLAGS_seed);
+  SolverParameters parameters;
+  parameters.compress_trail = compression;
+  parameters.trail_block_size = 64;
+  Solver solver("TestTrail", parameters);
+  std::vector<IntVar*> vars;
+  solver.MakeIntVarArray(1000, 0, 1000000, &vars);
+  CHECK(solver.Solve(
+      solver.RevAlloc(new RandomBoundOperations(vars, 0, &rgen))));
+  for (int i = 0; i < vars.size(); ++i) {
+    CHECK_EQ(0, vars[i]->Min());
+    CHECK_EQ(1000000, vars[i]->Max());
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestRoundTrip();
+  operations_research::TestTrail(
+      operations_research::SolverParameters::NO_COMPRESSION);
+  operations_research::TestTrail(
+      operations_research::SolverParameters::COMPRESS_WITH_ZLIB);
+  operations_research::TestTrail(
+      operations_research::SolverParameters::COMPRESS_WITH_FAST_LZ);
+  return 0;
+}
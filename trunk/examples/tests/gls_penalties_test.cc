@@ -0,0 +1,259 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the map storing the sparse penalties of guided local search, and
+// that guided local search follows the same trajectory with dense and sparse
+// penalties, whatever the values of the penalized arcs, and when the search
+// is restarted.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 30, "Number of tasks of the assignment problem");
+DEFINE_int32(num_solutions, 300, "Number of solutions of each search");
+DECLARE_bool(cp_use_sparse_gls_penalties);
+
+namespace operations_research {
+
+// Swaps the values of two variables.
+class SwapValues : public IntVarLocalSearchOperator {
+ public:
+  explicit SwapValues(const std::vector<IntVar*>& vars)
+      : IntVarLocalSearchOperator(vars), first_(0), second_(0) {}
+  virtual ~SwapValues() {}
+
+  virtual std::string DebugString() const { return "SwapValues"; }
+
+ protected:
+  virtual bool MakeOneNeighbor() {
+    if (++second_ >= Size()) {
+      ++first_;
+      second_ = first_ + 1;
+    }
+    if (second_ >= Size()) {
+      return false;
+    }
+    SetValue(first_, OldValue(second_));
+    SetValue(second_, OldValue(first_));
+    return true;
+  }
+
+ private:
+  virtual void OnStart() {
+    first_ = 0;
+    second_ = 0;
+  }
+
+  int first_;
+  int second_;
+};
+
+// Records the objective of each solution.
+class ObjectiveRecorder : public SearchMonitor {
+ public:
+  ObjectiveRecorder(Solver* const solver, IntVar* const objective)
+      : SearchMonitor(solver), objective_(objective) {}
+  virtual ~ObjectiveRecorder() {}
+
+  virtual bool AtSolution() {
+    objectives_.push_back(objective_->Value());
+    return false;
+  }
+
+  std::vector<int64>* mutable_objectives() { return &objectives_; }
+
+ private:
+  IntVar* const objective_;
+  std::vector<int64> objectives_;
+};
+
+// An assignment problem whose workers are represented by arbitrary values,
+// none of which is a task index: guided local search does not penalize the
+// arcs from a variable to its own index.
+class AssignmentProblem {
+ public:
+  AssignmentProblem(int size, int seed, const std::vector<int64>& workers)
+      : size_(size), workers_(workers) {
+    CHECK_EQ(size, workers.size());
+    ACMRandom rgen(seed);
+    for (int i = 0; i < size * size; ++i) {
+      costs_.push_back(rgen.Uniform(1000));
+    }
+  }
+
+  int64 Cost(int64 task, int64 worker_value) {
+    const int worker =
+        std::find(workers_.begin(), workers_.end(), worker_value) -
+        workers_.begin();
+    CHECK_LT(worker, size_);
+    return costs_[task * size_ + worker];
+  }
+
+  // Solves the problem with guided local search from the identity, twice
+  // with the same metaheuristic, and returns the objectives of the solutions
+  // of each search.
+  void Solve(bool sparse_penalties,
+             std::vector<std::vector<int64> >* const objectives) {
+    FLAGS_cp_use_sparse_gls_penalties = sparse_penalties;
+    Solver solver("AssignmentProblem");
+    std::vector<IntVar*> vars;
+    for (int task = 0; task < size_; ++task) {
+      vars.push_back(solver.MakeIntVar(workers_));
+    }
+    solver.AddConstraint(solver.MakeAllDifferent(vars));
+    std::vector<IntVar*> costs;
+    for (int task = 0; task < size_; ++task) {
+      costs.push_back(solver.MakeElement(
+          NewPermanentCallback(this, &AssignmentProblem::Cost,
+                               static_cast<int64>(task)),
+          vars[task])->Var());
+    }
+    IntVar* const objective = solver.MakeSum(costs)->Var();
+    Assignment* const assignment = solver.MakeAssignment();
+    assignment->Add(vars);
+    ObjectiveRecorder* const recorder =
+        solver.RevAlloc(new ObjectiveRecorder(&solver, objective));
+    std::vector<SearchMonitor*> monitors;
+    monitors.push_back(solver.MakeGuidedLocalSearch(
+        false, objective,
+        NewPermanentCallback(this, &AssignmentProblem::Cost), 1, vars, 0.3));
+    monitors.push_back(recorder);
+    monitors.push_back(solver.MakeSolutionsLimit(FLAGS_num_solutions));
+    objectives->clear();
+    for (int run = 0; run < 2; ++run) {
+      // The local search stores its solutions in 'assignment'.
+      for (int task = 0; task < size_; ++task) {
+        assignment->SetValue(vars[task], workers_[task]);
+      }
+      DecisionBuilder* const local_search = solver.MakeLocalSearchPhase(
+          assignment, solver.MakeLocalSearchPhaseParameters(
+                          solver.RevAlloc(new SwapValues(vars)), nullptr));
+      solver.Solve(local_search, monitors);
+      objectives->push_back(*recorder->mutable_objectives());
+      recorder->mutable_objectives()->clear();
+    }
+  }
+
+ private:
+  const int size_;
+  const std::vector<int64> workers_;
+  std::vector<int64> costs_;
+};
+
+// Returns 'size' consecutive worker values starting at 'first'.
+std::vector<int64> Workers(int64 first, int size) {
+  std::vector<int64> workers;
+  for (int worker = 0; worker < size; ++worker) {
+    workers.push_back(first + worker);
+  }
+  return workers;
+}
+
+// The cached penalized values of the sparse penalties are the ones computed
+// from the dense penalties, for arcs whose values are small, negative, or
+// close to the largest int32; element expressions take int indices, so the
+// values of the variables of the model cannot go beyond. The searches
+// penalize many more arcs than the initial capacity of the sparse penalty
+// map, and the penalties are cleared when the search is restarted.
+// Arcs whose values fit in 32 bits, negative ones included, are stored in the
+// flat array, which grows several times; the other ones are stored in the
+// overflow map. Clear() forgets both, and the map can be filled again.
+void TestArcMap() {
+  LOG(INFO) << "TestArcMap";
+  typedef ArcInt64FlatMap::Arc Arc;
+  const int64 kValues[] = {0, 1, -1, kint32max, kint32min, kint32max + 1LL,
+                           kint32min - 1LL, kint64max, kint64min / 2};
+  const int num_values = sizeof(kValues) / sizeof(kValues[0]);
+  const int kNumVars = 100;
+  ArcInt64FlatMap map;
+  for (int round = 0; round < 2; ++round) {
+    CHECK(map.Empty());
+    for (int var = 0; var < kNumVars; ++var) {
+      for (int i = 0; i < num_values; ++i) {
+        const Arc arc(var, kValues[i]);
+        CHECK_EQ(0, map.Value(arc));
+        int64* const value = map.MutableValue(arc);
+        CHECK_EQ(0, *value);
+        *value = var * num_values + i + round;
+        CHECK(!map.Empty());
+      }
+    }
+    // The values inserted before the growths are still there, and distinct
+    // arcs with the same low 32 bits do not collide.
+    for (int var = 0; var < kNumVars; ++var) {
+      for (int i = 0; i < num_values; ++i) {
+        const Arc arc(var, kValues[i]);
+        CHECK_EQ(var * num_values + i + round, map.Value(arc))
+            << var << " " << kValues[i];
+        ++*map.MutableValue(arc);
+        CHECK_EQ(var * num_values + i + round + 1, map.Value(arc));
+      }
+      CHECK_EQ(0, map.Value(Arc(var, 2)));
+    }
+    CHECK_EQ(0, map.Value(Arc(kNumVars, 0)));
+    CHECK_EQ(0, map.Value(Arc(kNumVars, kint64max)));
+    map.Clear();
+    CHECK(map.Empty());
+    for (int var = 0; var < kNumVars; ++var) {
+      for (int i = 0; i < num_values; ++i) {
+        CHECK_EQ(0, map.Value(Arc(var, kValues[i])));
+      }
+    }
+  }
+  // Only overflowing arcs.
+  map.MutableValue(Arc(0, kint64max));
+  CHECK(!map.Empty());
+  map.Clear();
+  CHECK(map.Empty());
+}
+
+void TestSameTrajectory() {
+  LOG(INFO) << "TestSameTrajectory";
+  const int size = FLAGS_size;
+  std::vector<std::vector<int64> > dense_objectives;
+  AssignmentProblem(size, FLAGS_seed, Workers(size, size))
+      .Solve(false, &dense_objectives);
+  CHECK_EQ(FLAGS_num_solutions, dense_objectives[0].size());
+  // The search goes through local optima.
+  bool has_worse_solution = false;
+  for (int i = 1; i < dense_objectives[0].size(); ++i) {
+    has_worse_solution |= dense_objectives[0][i] > dense_objectives[0][i - 1];
+  }
+  CHECK(has_worse_solution);
+  CHECK(dense_objectives[0] == dense_objectives[1]);
+  const int64 kFirstWorkers[] = {size, -10 * size, kint32max - 3 * size};
+  for (int i = 0; i < sizeof(kFirstWorkers) / sizeof(kFirstWorkers[0]);
+       ++i) {
+    std::vector<std::vector<int64> > sparse_objectives;
+    AssignmentProblem(size, FLAGS_seed, Workers(kFirstWorkers[i], size))
+        .Solve(true, &sparse_objectives);
+    CHECK(dense_objectives == sparse_objectives) << kFirstWorkers[i];
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestArcMap();
+  operations_research::TestSameTrajectory();
+  return 0;
+}
@@ -0,0 +1,174 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Counts the neighbors generated by the path operators restricted to
+// neighbor lists, and checks that all of them create an arc to a neighbor.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/unique_ptr.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 200, "Number of nodes of the paths");
+DEFINE_int32(paths, 4, "Number of paths");
+DEFINE_int32(num_neighbors, 5, "Number of neighbors of each node");
+
+namespace operations_research {
+
+// Random sorted neighbor lists of the nodes which are not path starts.
+class NeighborLists {
+ public:
+  NeighborLists(int size, int paths, int num_neighbors, int seed)
+      : neighbors_(size) {
+    ACMRandom rgen(seed);
+    for (int node = 0; node < size; ++node) {
+      std::vector<int>* const neighbors = &neighbors_[node];
+      while (neighbors->size() < num_neighbors) {
+        const int neighbor = paths + rgen.Uniform(size - paths);
+        if (neighbor != node &&
+            std::find(neighbors->begin(), neighbors->end(), neighbor) ==
+                neighbors->end()) {
+          neighbors->push_back(neighbor);
+        }
+      }
+      std::sort(neighbors->begin(), neighbors->end());
+    }
+  }
+
+  const std::vector<int>* Neighbors(int64 node, int64 path) {
+    return &neighbors_[node];
+  }
+
+  bool IsNeighbor(int64 from, int64 to) const {
+    return std::binary_search(neighbors_[from].begin(), neighbors_[from].end(),
+                              to);
+  }
+
+ private:
+  std::vector<std::vector<int> > neighbors_;
+};
+
+// Counts and rejects all the neighbors; if 'lists' is not nullptr, checks
+// that they create an arc to a neighbor.
+class NeighborCounter : public IntVarLocalSearchFilter {
+ public:
+  NeighborCounter(const std::vector<IntVar*>& nexts,
+                  const NeighborLists* const lists)
+      : IntVarLocalSearchFilter(nexts), lists_(lists), num_neighbors_(0) {}
+  virtual ~NeighborCounter() {}
+
+  virtual bool Accept(const Assignment* delta, const Assignment* deltadelta) {
+    ++num_neighbors_;
+    if (lists_ != nullptr) {
+      bool creates_neighbor_arc = false;
+      const Assignment::IntContainer& container = delta->IntVarContainer();
+      for (int i = 0; i < container.Size(); ++i) {
+        const IntVarElement& element = container.Element(i);
+        int64 index = -1;
+        if (FindIndex(element.Var(), &index) &&
+            element.Value() != Value(index) &&
+            lists_->IsNeighbor(index, element.Value())) {
+          creates_neighbor_arc = true;
+        }
+      }
+      CHECK(creates_neighbor_arc);
+    }
+    return false;
+  }
+
+  int64 num_neighbors() const { return num_neighbors_; }
+
+ private:
+  const NeighborLists* const lists_;
+  int64 num_neighbors_;
+};
+
+// Returns the number of neighbors of 'Operator' on paths visiting all the
+// nodes, with the neighbor lists if 'lists' is not nullptr.
+template <class Operator>
+int64 CountNeighbors(NeighborLists* const lists) {
+  Solver solver("CountNeighbors");
+  const int size = FLAGS_size;
+  std::vector<IntVar*> nexts;
+  solver.MakeIntVarArray(size, 0, size + FLAGS_paths - 1, "next_", &nexts);
+  // Path p starts at node p, visits the nodes n such that n % paths == p and
+  // ends at node size + p.
+  Assignment* const assignment = solver.MakeAssignment();
+  assignment->Add(nexts);
+  for (int node = 0; node < size; ++node) {
+    const int next = node + FLAGS_paths;
+    assignment->SetValue(nexts[node],
+                         next < size ? next : size + node % FLAGS_paths);
+  }
+  std::unique_ptr<ResultCallback2<const std::vector<int>*, int64, int64> >
+      neighbors(lists == nullptr ? nullptr : NewPermanentCallback(
+                                                 lists,
+                                                 &NeighborLists::Neighbors));
+  LocalSearchOperator* const path_operator =
+      lists == nullptr
+          ? MakeLocalSearchOperator<Operator>(&solver, nexts,
+                                              std::vector<IntVar*>(), nullptr)
+          : MakeGranularLocalSearchOperator<Operator>(
+                &solver, nexts, std::vector<IntVar*>(), nullptr,
+                neighbors.get());
+  NeighborCounter* const counter =
+      solver.RevAlloc(new NeighborCounter(nexts, lists));
+  std::vector<LocalSearchFilter*> filters(1, counter);
+  // The first solution is the initial assignment; the neighborhood is then
+  // explored once without finding any other solution.
+  solver.NewSearch(solver.MakeLocalSearchPhase(
+      assignment, solver.MakeLocalSearchPhaseParameters(
+                      path_operator, nullptr, nullptr, filters)));
+  CHECK(solver.NextSolution());
+  CHECK(!solver.NextSolution());
+  solver.EndSearch();
+  return counter->num_neighbors();
+}
+
+// The operators exploring neighbor lists generate at most one neighbor per
+// neighbor of each node, instead of one per pair of nodes; the other
+// operators are filtered.
+template <class Operator>
+void TestNeighborCount(bool explores_neighbors) {
+  LOG(INFO) << "TestNeighborCount(" << explores_neighbors << ")";
+  NeighborLists lists(FLAGS_size, FLAGS_paths, FLAGS_num_neighbors,
+                      FLAGS_seed);
+  const int64 num_neighbors = CountNeighbors<Operator>(nullptr);
+  const int64 num_granular_neighbors = CountNeighbors<Operator>(&lists);
+  LOG(INFO) << num_neighbors << " neighbors, " << num_granular_neighbors
+            << " granular neighbors";
+  CHECK_GT(num_granular_neighbors, 0);
+  CHECK_LT(num_granular_neighbors, num_neighbors);
+  if (explores_neighbors) {
+    CHECK_LE(num_granular_neighbors, FLAGS_size * FLAGS_num_neighbors);
+    CHECK_GT(num_neighbors, FLAGS_size * FLAGS_size / (4 * FLAGS_paths));
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestNeighborCount<operations_research::TwoOpt>(true);
+  operations_research::TestNeighborCount<operations_research::Relocate>(true);
+  operations_research::TestNeighborCount<operations_research::Exchange>(true);
+  operations_research::TestNeighborCount<operations_research::Cross>(false);
+  return 0;
+}
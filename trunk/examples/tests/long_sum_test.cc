@@ -0,0 +1,177 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the bounds of the terms of a sum with more than
+// --cp_long_sum_size terms against an oracle under random bound changes and
+// backtracks, with and without the long sum propagator.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 1500, "Number of terms of the sum");
+DEFINE_int32(depth, 4, "Depth of the nested searches");
+DEFINE_int32(operations, 20, "Number of operations per search node");
+DECLARE_int32(cp_long_sum_size);
+
+namespace operations_research {
+
+// The bounds of the terms and of the sum, and their bound consistent
+// propagation.
+struct SumOracle {
+  std::vector<int64> mins;
+  std::vector<int64> maxes;
+  int64 sum_min;
+  int64 sum_max;
+
+  void Propagate() {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      int64 min_of_sum = 0;
+      int64 max_of_sum = 0;
+      for (int i = 0; i < mins.size(); ++i) {
+        min_of_sum += mins[i];
+        max_of_sum += maxes[i];
+      }
+      sum_min = std::max(sum_min, min_of_sum);
+      sum_max = std::min(sum_max, max_of_sum);
+      CHECK_LE(sum_min, sum_max);
+      for (int i = 0; i < mins.size(); ++i) {
+        const int64 new_min = sum_min - (max_of_sum - maxes[i]);
+        const int64 new_max = sum_max - (min_of_sum - mins[i]);
+        if (new_min > mins[i]) {
+          mins[i] = new_min;
+          changed = true;
+        }
+        if (new_max < maxes[i]) {
+          maxes[i] = new_max;
+          changed = true;
+        }
+      }
+    }
+  }
+};
+
+void CheckBounds(const std::vector<IntVar*>& vars, IntVar* const sum,
+                 const SumOracle& oracle) {
+  CHECK_EQ(oracle.sum_min, sum->Min());
+  CHECK_EQ(oracle.sum_max, sum->Max());
+  for (int i = 0; i < vars.size(); ++i) {
+    CHECK_EQ(oracle.mins[i], vars[i]->Min()) << i;
+    CHECK_EQ(oracle.maxes[i], vars[i]->Max()) << i;
+  }
+}
+
+// Reduces the bounds of random terms or of the sum, and of the oracle, then
+// checks that nested searches leave the bounds unchanged when they backtrack.
+// A bound consistent sum supports all the values in the bounds of its terms,
+// so the reductions never fail.
+class RandomSumOperations : public DecisionBuilder {
+ public:
+  RandomSumOperations(const std::vector<IntVar*>& vars, IntVar* const sum,
+                      const SumOracle& oracle, int depth,
+                      ACMRandom* const rgen)
+      : vars_(vars), sum_(sum), oracle_(oracle), depth_(depth), rgen_(rgen) {}
+  virtual ~RandomSumOperations() {}
+
+  virtual Decision* Next(Solver* const s) {
+    for (int i = 0; i < FLAGS_operations; ++i) {
+      ApplyRandomOperation();
+      oracle_.Propagate();
+      CheckBounds(vars_, sum_, oracle_);
+    }
+    if (depth_ < FLAGS_depth) {
+      for (int i = 0; i < 2; ++i) {
+        s->Solve(s->RevAlloc(new RandomSumOperations(vars_, sum_, oracle_,
+                                                     depth_ + 1, rgen_)));
+        CheckBounds(vars_, sum_, oracle_);
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  void ApplyRandomOperation() {
+    if (rgen_->Uniform(10) == 0) {
+      // Moves a bound of the sum close to the other one, so that the slack of
+      // the sum is smaller than the spans of the terms.
+      const int64 span = oracle_.sum_max - oracle_.sum_min;
+      if (rgen_->Uniform(2) == 0) {
+        oracle_.sum_max = oracle_.sum_min + rgen_->Uniform(span / 16 + 1);
+      } else {
+        oracle_.sum_min = oracle_.sum_max - rgen_->Uniform(span / 16 + 1);
+      }
+      sum_->SetRange(oracle_.sum_min, oracle_.sum_max);
+    } else {
+      const int index = rgen_->Uniform(vars_.size());
+      const int64 span = oracle_.maxes[index] - oracle_.mins[index];
+      oracle_.mins[index] += rgen_->Uniform(span / 2 + 1);
+      oracle_.maxes[index] -= rgen_->Uniform(span / 2 + 1);
+      vars_[index]->SetRange(oracle_.mins[index], oracle_.maxes[index]);
+    }
+  }
+
+  const std::vector<IntVar*> vars_;
+  IntVar* const sum_;
+  SumOracle oracle_;
+  const int depth_;
+  ACMRandom* const rgen_;
+};
+
+void TestBoundsConsistency(bool long_sum) {
+  LOG(INFO) << "TestBoundsConsistency(" << long_sum << ")";
+  CHECK_GE(FLAGS_size, FLAGS_cp_long_sum_size);
+  const int long_sum_size = FLAGS_cp_long_sum_size;
+  if (!long_sum) {
+    FLAGS_cp_long_sum_size = 0;
+  }
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestBoundsConsistency");
+  SumOracle oracle;
+  std::vector<IntVar*> vars;
+  for (int i = 0; i < FLAGS_size; ++i) {
+    // Spans of all magnitudes, so that the terms are in many span classes.
+    const int64 min = rgen.Uniform(201) - 100;
+    const int64 max = min + rgen.Uniform(1 << rgen.Uniform(20));
+    vars.push_back(solver.MakeIntVar(min, max));
+    oracle.mins.push_back(min);
+    oracle.maxes.push_back(max);
+  }
+  oracle.sum_min = kint64min;
+  oracle.sum_max = kint64max;
+  oracle.Propagate();
+  IntVar* const sum = solver.MakeIntVar(oracle.sum_min, oracle.sum_max, "sum");
+  Constraint* const constraint = solver.MakeSumEquality(vars, sum);
+  CHECK_EQ(long_sum, constraint->DebugString().find("LongSum(") == 0);
+  solver.AddConstraint(constraint);
+  CHECK(solver.Solve(solver.RevAlloc(
+      new RandomSumOperations(vars, sum, oracle, 0, &rgen))));
+  CheckBounds(vars, sum, oracle);
+  FLAGS_cp_long_sum_size = long_sum_size;
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestBoundsConsistency(true);
+  operations_research::TestBoundsConsistency(false);
+  return 0;
+}
@@ -0,0 +1,179 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Solves an assignment problem by local search with replicas of the operator
+// and of the filters screening the neighbors in parallel, and checks the
+// search against the one without replicas.
+
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 30, "Number of tasks of the assignment problem");
+
+namespace operations_research {
+
+// Swaps the values of two variables.
+class SwapValues : public IntVarLocalSearchOperator {
+ public:
+  explicit SwapValues(const std::vector<IntVar*>& vars)
+      : IntVarLocalSearchOperator(vars), first_(0), second_(0) {}
+  virtual ~SwapValues() {}
+
+  virtual std::string DebugString() const { return "SwapValues"; }
+
+ protected:
+  virtual bool MakeOneNeighbor() {
+    if (++second_ >= Size()) {
+      ++first_;
+      second_ = first_ + 1;
+    }
+    if (second_ >= Size()) {
+      return false;
+    }
+    SetValue(first_, OldValue(second_));
+    SetValue(second_, OldValue(first_));
+    return true;
+  }
+
+ private:
+  virtual void OnStart() {
+    first_ = 0;
+    second_ = 0;
+  }
+
+  int first_;
+  int second_;
+};
+
+class AssignmentProblem {
+ public:
+  AssignmentProblem(int size, int seed) : size_(size) {
+    ACMRandom rgen(seed);
+    for (int i = 0; i < size * size; ++i) {
+      costs_.push_back(rgen.Uniform(1000));
+    }
+  }
+
+  int64 Cost(int64 task, int64 worker) { return costs_[task * size_ + worker]; }
+
+  // Solves the problem by local search from the identity, with
+  // 'num_replicas' replicas, and with guided local search for
+  // 'num_solutions' solutions if 'guided_local_search' is true. Returns the
+  // objective of the last solution.
+  int64 Solve(int num_replicas, bool guided_local_search, int num_solutions,
+              int64* const accepted_neighbors) {
+    Solver solver("AssignmentProblem");
+    std::vector<IntVar*> vars;
+    solver.MakeIntVarArray(size_, 0, size_ - 1, "task_", &vars);
+    solver.AddConstraint(solver.MakeAllDifferent(vars));
+    std::vector<IntVar*> costs;
+    for (int task = 0; task < size_; ++task) {
+      std::vector<int64> task_costs(costs_.begin() + task * size_,
+                                    costs_.begin() + (task + 1) * size_);
+      costs.push_back(solver.MakeElement(task_costs, vars[task])->Var());
+    }
+    IntVar* const objective = solver.MakeSum(costs)->Var();
+    std::vector<SearchMonitor*> monitors;
+    if (guided_local_search) {
+      monitors.push_back(solver.MakeGuidedLocalSearch(
+          false, objective,
+          NewPermanentCallback(this, &AssignmentProblem::Cost), 1, vars, 0.1));
+      monitors.push_back(solver.MakeSolutionsLimit(num_solutions));
+    } else {
+      monitors.push_back(solver.MakeMinimize(objective, 1));
+    }
+    SolutionCollector* const collector = solver.MakeLastSolutionCollector();
+    collector->Add(vars);
+    collector->AddObjective(objective);
+    monitors.push_back(collector);
+
+    std::vector<LocalSearchFilter*> filters;
+    std::vector<LocalSearchOperator*> operator_replicas;
+    std::vector<std::vector<LocalSearchFilter*> > filter_replicas(num_replicas);
+    for (int i = 0; i <= num_replicas; ++i) {
+      std::vector<LocalSearchFilter*>* const replica_filters =
+          i == 0 ? &filters : &filter_replicas[i - 1];
+      replica_filters->push_back(solver.MakeLocalSearchObjectiveFilter(
+          vars, NewPermanentCallback(this, &AssignmentProblem::Cost),
+          objective, Solver::LE, Solver::SUM));
+      if (i > 0) {
+        operator_replicas.push_back(solver.RevAlloc(new SwapValues(vars)));
+      }
+    }
+    DecisionBuilder* const first_solution = solver.MakePhase(
+        vars, Solver::CHOOSE_FIRST_UNBOUND, Solver::ASSIGN_MIN_VALUE);
+    LocalSearchPhaseParameters* const parameters =
+        solver.MakeLocalSearchPhaseParameters(
+            solver.RevAlloc(new SwapValues(vars)), nullptr, nullptr, filters,
+            operator_replicas, filter_replicas);
+    solver.Solve(solver.MakeLocalSearchPhase(vars, first_solution, parameters),
+                 monitors);
+    CHECK_EQ(1, collector->solution_count());
+    int64 cost = 0;
+    for (int task = 0; task < size_; ++task) {
+      cost += Cost(task, collector->Value(0, vars[task]));
+    }
+    CHECK_EQ(cost, collector->objective_value(0));
+    *accepted_neighbors = solver.accepted_neighbors();
+    return cost;
+  }
+
+ private:
+  const int size_;
+  std::vector<int64> costs_;
+};
+
+// With a metaheuristic which does not bound the objective of the deltas, the
+// same neighbors are accepted with and without replicas.
+void TestSameLocalOptimum() {
+  LOG(INFO) << "TestSameLocalOptimum";
+  AssignmentProblem problem(FLAGS_size, FLAGS_seed);
+  int64 accepted_neighbors = 0;
+  const int64 cost = problem.Solve(0, false, 0, &accepted_neighbors);
+  for (int num_replicas = 1; num_replicas <= 7; num_replicas += 2) {
+    int64 replica_accepted_neighbors = 0;
+    CHECK_EQ(cost,
+             problem.Solve(num_replicas, false, 0, &replica_accepted_neighbors));
+    CHECK_EQ(accepted_neighbors, replica_accepted_neighbors);
+  }
+}
+
+// Guided local search bounds the objective of each delta depending on its
+// penalties, and the filters of the replicas get the bound of an empty delta:
+// the search differs from the one without replicas, but finds valid
+// solutions.
+void TestGuidedLocalSearch() {
+  LOG(INFO) << "TestGuidedLocalSearch";
+  AssignmentProblem problem(FLAGS_size, FLAGS_seed);
+  int64 accepted_neighbors = 0;
+  problem.Solve(0, true, 100, &accepted_neighbors);
+  for (int num_replicas = 1; num_replicas <= 7; num_replicas += 2) {
+    problem.Solve(num_replicas, true, 100, &accepted_neighbors);
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestSameLocalOptimum();
+  operations_research::TestGuidedLocalSearch();
+  return 0;
+}
@@ -0,0 +1,262 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the propagation of the nogoods added before the search and below
+// the root, with the watched and the naive nogood managers, and the nogoods
+// kept when there are too many of them.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "constraint_solver/constraint_solver.h"
+
+DECLARE_bool(cp_use_naive_nogood_manager);
+DECLARE_int32(cp_max_nogoods);
+
+namespace operations_research {
+
+// Scripted search on a, x, d and e, where b == (x <= 1), with the nogood
+// (a == 1 && b == 1 && d == 1):
+//  - a == 1, then x == 0 makes b true, and the nogood refutes d == 1.
+//  - The search fails back to x != 0, where b is undecided and d is free.
+//  - x == 1 makes b true again, and the nogood must refute d == 1 again.
+// When the nogood is added below the root, after x == 0, its only term not
+// known to be true is d == 1, and a == 1 stays true upon the backtrack while
+// b == 1 is undone.
+class NoGoodScript : public DecisionBuilder {
+ public:
+  NoGoodScript(NoGoodManager* const manager, IntVar* const a, IntVar* const b,
+               IntVar* const d, IntVar* const e, IntVar* const x,
+               bool add_below_root)
+      : manager_(manager),
+        a_(a),
+        b_(b),
+        d_(d),
+        e_(e),
+        x_(x),
+        add_below_root_(add_below_root),
+        step_(0) {}
+  virtual ~NoGoodScript() {}
+
+  virtual Decision* Next(Solver* const s) {
+    switch (step_++) {
+      case 0: { return s->MakeAssignVariableValue(a_, 1); }
+      case 1: { return s->MakeAssignVariableValue(x_, 0); }
+      case 2: {
+        CHECK(b_->Bound());
+        CHECK_EQ(1, b_->Min());
+        if (add_below_root_) {
+          CHECK_EQ(1, d_->Max());
+          manager_->AddNoGood(MakeNoGood());
+        }
+        return s->MakeAssignVariableValue(e_, 1);
+      }
+      case 3: {
+        CHECK_EQ(0, d_->Max());
+        return s->MakeFailDecision();
+      }
+      case 4: {
+        // After e != 1.
+        CHECK_EQ(0, d_->Max());
+        return s->MakeFailDecision();
+      }
+      case 5: {
+        // After x != 0.
+        CHECK(!b_->Bound());
+        CHECK_EQ(1, d_->Max());
+        return s->MakeAssignVariableValue(x_, 1);
+      }
+      case 6: {
+        CHECK(b_->Bound());
+        CHECK_EQ(1, b_->Min());
+        CHECK_EQ(0, d_->Max());
+        return nullptr;
+      }
+    }
+    LOG(FATAL) << "Unexpected step " << step_;
+    return nullptr;
+  }
+
+  NoGood* MakeNoGood() {
+    NoGood* const nogood = manager_->MakeNoGood();
+    nogood->AddIntegerVariableEqualValueTerm(a_, 1);
+    nogood->AddIntegerVariableEqualValueTerm(b_, 1);
+    nogood->AddIntegerVariableEqualValueTerm(d_, 1);
+    return nogood;
+  }
+
+  int step() const { return step_; }
+
+ private:
+  NoGoodManager* const manager_;
+  IntVar* const a_;
+  IntVar* const b_;
+  IntVar* const d_;
+  IntVar* const e_;
+  IntVar* const x_;
+  const bool add_below_root_;
+  int step_;
+};
+
+void TestPropagation(bool naive, bool add_below_root) {
+  LOG(INFO) << "TestPropagation(" << naive << ", " << add_below_root << ")";
+  FLAGS_cp_use_naive_nogood_manager = naive;
+  Solver solver("TestPropagation");
+  IntVar* const a = solver.MakeIntVar(0, 1, "a");
+  IntVar* const d = solver.MakeIntVar(0, 1, "d");
+  IntVar* const e = solver.MakeIntVar(0, 1, "e");
+  IntVar* const x = solver.MakeIntVar(0, 2, "x");
+  IntVar* const b = solver.MakeIsLessOrEqualCstVar(x, 1);
+  NoGoodManager* const manager = solver.MakeNoGoodManager();
+  NoGoodScript* const script = solver.RevAlloc(
+      new NoGoodScript(manager, a, b, d, e, x, add_below_root));
+  if (add_below_root) {
+    // A nogood which is never violated, so that a is listened to from the
+    // root, and its watchers are not visited again after the backtrack.
+    NoGood* const nogood = manager->MakeNoGood();
+    nogood->AddIntegerVariableEqualValueTerm(a, 2);
+    manager->AddNoGood(nogood);
+  } else {
+    manager->AddNoGood(script->MakeNoGood());
+  }
+  CHECK(solver.Solve(script, manager));
+  CHECK_EQ(7, script->step());
+  CHECK_EQ(add_below_root ? 2 : 1, manager->NoGoodCount());
+}
+
+// A nogood violated when it is added below the root fails the next decision.
+class ViolatedNoGood : public DecisionBuilder {
+ public:
+  ViolatedNoGood(NoGoodManager* const manager, IntVar* const a,
+                 IntVar* const b)
+      : manager_(manager), a_(a), b_(b), step_(0) {}
+  virtual ~ViolatedNoGood() {}
+
+  virtual Decision* Next(Solver* const s) {
+    switch (step_++) {
+      case 0: { return s->MakeAssignVariableValue(a_, 1); }
+      case 1: { return s->MakeAssignVariableValue(b_, 1); }
+      case 2: {
+        NoGood* const nogood = manager_->MakeNoGood();
+        nogood->AddIntegerVariableEqualValueTerm(a_, 1);
+        nogood->AddIntegerVariableEqualValueTerm(b_, 1);
+        manager_->AddNoGood(nogood);
+        return s->MakeAssignVariableValue(a_, 1);
+      }
+      case 3: {
+        // After b != 1.
+        CHECK_EQ(0, b_->Max());
+        return nullptr;
+      }
+    }
+    LOG(FATAL) << "Unexpected step " << step_;
+    return nullptr;
+  }
+
+  int step() const { return step_; }
+
+ private:
+  NoGoodManager* const manager_;
+  IntVar* const a_;
+  IntVar* const b_;
+  int step_;
+};
+
+void TestViolated(bool naive) {
+  LOG(INFO) << "TestViolated(" << naive << ")";
+  FLAGS_cp_use_naive_nogood_manager = naive;
+  Solver solver("TestViolated");
+  IntVar* const a = solver.MakeIntVar(0, 1, "a");
+  IntVar* const b = solver.MakeIntVar(0, 1, "b");
+  NoGoodManager* const manager = solver.MakeNoGoodManager();
+  ViolatedNoGood* const script =
+      solver.RevAlloc(new ViolatedNoGood(manager, a, b));
+  CHECK(solver.Solve(script, manager));
+  CHECK_EQ(4, script->step());
+}
+
+// Assigns a and b to 1, and checks that d is 0.
+class CheckRecentNoGood : public DecisionBuilder {
+ public:
+  CheckRecentNoGood(IntVar* const a, IntVar* const b, IntVar* const d)
+      : a_(a), b_(b), d_(d), step_(0) {}
+  virtual ~CheckRecentNoGood() {}
+
+  virtual Decision* Next(Solver* const s) {
+    switch (step_++) {
+      case 0: { return s->MakeAssignVariableValue(a_, 1); }
+      case 1: { return s->MakeAssignVariableValue(b_, 1); }
+      case 2: {
+        CHECK_EQ(0, d_->Max());
+        return nullptr;
+      }
+    }
+    LOG(FATAL) << "Unexpected step " << step_;
+    return nullptr;
+  }
+
+  int step() const { return step_; }
+
+ private:
+  IntVar* const a_;
+  IntVar* const b_;
+  IntVar* const d_;
+  int step_;
+};
+
+// The nogood added last, which is larger than the others and never
+// propagated, is kept when the least active nogoods are removed.
+void TestKeepRecent() {
+  LOG(INFO) << "TestKeepRecent";
+  FLAGS_cp_use_naive_nogood_manager = false;
+  const int max_nogoods = FLAGS_cp_max_nogoods;
+  FLAGS_cp_max_nogoods = 10;
+  Solver solver("TestKeepRecent");
+  IntVar* const a = solver.MakeIntVar(0, 1, "a");
+  IntVar* const b = solver.MakeIntVar(0, 1, "b");
+  IntVar* const d = solver.MakeIntVar(0, 1, "d");
+  std::vector<IntVar*> vars;
+  solver.MakeIntVarArray(FLAGS_cp_max_nogoods, 0, 1, "v_", &vars);
+  NoGoodManager* const manager = solver.MakeNoGoodManager();
+  for (int i = 0; i < vars.size(); ++i) {
+    NoGood* const nogood = manager->MakeNoGood();
+    nogood->AddIntegerVariableEqualValueTerm(vars[i], 1);
+    nogood->AddIntegerVariableEqualValueTerm(a, 0);
+    manager->AddNoGood(nogood);
+  }
+  NoGood* const nogood = manager->MakeNoGood();
+  nogood->AddIntegerVariableEqualValueTerm(a, 1);
+  nogood->AddIntegerVariableEqualValueTerm(b, 1);
+  nogood->AddIntegerVariableEqualValueTerm(d, 1);
+  manager->AddNoGood(nogood);
+  CHECK_EQ((FLAGS_cp_max_nogoods + 1) / 2, manager->NoGoodCount());
+  CheckRecentNoGood* const script =
+      solver.RevAlloc(new CheckRecentNoGood(a, b, d));
+  CHECK(solver.Solve(script, manager));
+  CHECK_EQ(3, script->step());
+  FLAGS_cp_max_nogoods = max_nogoods;
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  for (int naive = 0; naive <= 1; ++naive) {
+    operations_research::TestPropagation(naive, false);
+    operations_research::TestPropagation(naive, true);
+    operations_research::TestViolated(naive);
+  }
+  operations_research::TestKeepRecent();
+  return 0;
+}
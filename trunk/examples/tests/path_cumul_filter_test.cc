@@ -0,0 +1,365 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the path cumul filter using node summaries against the filter
+// propagating cumuls along the whole delta paths, and against a propagation
+// of the cumuls of the routes, on random deltas of random routes with time
+// windows, slacks, soft upper bounds and span costs.
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/unique_ptr.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/routing.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_instances, 100, "Number of random instances");
+DEFINE_int32(num_deltas, 500, "Number of random deltas of each instance");
+DECLARE_bool(routing_use_cumul_node_summaries);
+
+namespace operations_research {
+
+typedef std::vector<std::vector<int64> > Routes;
+
+// Records the last objective value propagated by a filter.
+class ObjectiveRecorder {
+ public:
+  ObjectiveRecorder() : value_(0) {}
+  void Set(int64 value) { value_ = value; }
+  int64 value() const { return value_; }
+
+ private:
+  int64 value_;
+};
+
+struct Options {
+  bool slacks;
+  bool soft_bounds;
+  bool vehicle_span_costs;
+  bool global_span_cost;
+};
+
+// A random vehicle routing problem with a "time" dimension, and random
+// routes visiting all the nodes which are feasible for the cumul bounds and
+// the vehicle capacities.
+class RandomInstance {
+ public:
+  RandomInstance(const Options& options, ACMRandom* const rgen) {
+    const int size = 5 + rgen->Uniform(25);
+    const int vehicles = 1 + rgen->Uniform(4);
+    for (int i = 0; i < size; ++i) {
+      x_.push_back(rgen->Uniform(30));
+      y_.push_back(rgen->Uniform(30));
+    }
+    capacities_.resize(vehicles, 0);
+    model_.reset(new RoutingModel(size, vehicles));
+    model_->SetDepot(RoutingModel::NodeIndex(0));
+    model_->AddDimensionWithVehicleCapacity(
+        NewPermanentCallback(this, &RandomInstance::Distance), 1000,
+        NewPermanentCallback(this, &RandomInstance::Capacity), false, "time");
+    RoutingDimension* const dimension = model_->GetMutableDimension("time");
+    routes_.resize(vehicles);
+    for (int64 index = 0; index < model_->Size(); ++index) {
+      if (!model_->IsStart(index)) {
+        routes_[rgen->Uniform(vehicles)].push_back(index);
+      }
+      if (options.slacks) {
+        dimension->SlackVar(index)->SetMin(rgen->Uniform(3));
+      }
+    }
+    for (int vehicle = 0; vehicle < vehicles; ++vehicle) {
+      std::random_shuffle(routes_[vehicle].begin(), routes_[vehicle].end(),
+                          *rgen);
+    }
+    // Cumul minima, then maxima above the cumuls of the routes.
+    const int64 num_indices = model_->Size() + vehicles;
+    for (int64 index = 0; index < num_indices; ++index) {
+      if (rgen->Uniform(2) == 0) {
+        dimension->CumulVar(index)->SetMin(rgen->Uniform(300));
+      }
+    }
+    for (int vehicle = 0; vehicle < vehicles; ++vehicle) {
+      const std::vector<int64> nodes = RouteNodes(vehicle, routes_[vehicle]);
+      std::vector<int64> cumuls;
+      int64 cumul = dimension->CumulVar(nodes[0])->Min();
+      for (int i = 0; i < nodes.size(); ++i) {
+        if (i > 0) {
+          cumul = std::max(dimension->CumulVar(nodes[i])->Min(),
+                           cumul + Transit(vehicle, nodes[i - 1], nodes[i]));
+        }
+        cumuls.push_back(cumul);
+      }
+      for (int i = 0; i < nodes.size(); ++i) {
+        if (rgen->Uniform(2) == 0) {
+          dimension->CumulVar(nodes[i])->SetMax(cumuls[i] + rgen->Uniform(60));
+        }
+        if (options.soft_bounds && rgen->Uniform(2) == 0) {
+          const int64 bound = cumuls[i] - 30 + rgen->Uniform(60);
+          dimension->SetCumulVarSoftUpperBoundFromIndex(
+              nodes[i], std::max<int64>(0, bound), 1 + rgen->Uniform(5));
+        }
+      }
+      capacities_[vehicle] = cumuls.back() + rgen->Uniform(60);
+      if (options.vehicle_span_costs) {
+        dimension->SetSpanCostCoefficientForVehicle(rgen->Uniform(3), vehicle);
+      }
+    }
+    if (options.global_span_cost) {
+      dimension->SetGlobalSpanCostCoefficient(1 + rgen->Uniform(3));
+    }
+    model_->CloseModel();
+  }
+
+  RoutingModel* model() const { return model_.get(); }
+  const Routes& routes() const { return routes_; }
+
+  // Returns the nodes of the route of 'vehicle' visiting 'route'.
+  std::vector<int64> RouteNodes(int vehicle,
+                                const std::vector<int64>& route) const {
+    std::vector<int64> nodes(1, model_->Start(vehicle));
+    nodes.insert(nodes.end(), route.begin(), route.end());
+    nodes.push_back(model_->End(vehicle));
+    return nodes;
+  }
+
+  int64 Transit(int vehicle, int64 from, int64 to) const {
+    const RoutingDimension& dimension = model_->GetDimensionOrDie("time");
+    return dimension.transit_evaluator(vehicle)->Run(from, to) +
+           dimension.SlackVar(from)->Min();
+  }
+
+  // Propagates the cumuls along 'routes'; returns false if a cumul bound or
+  // a capacity is violated, otherwise sets 'cost' to the soft upper bound
+  // cost of the routes.
+  bool Evaluate(const Routes& routes, int64* const cost) const {
+    const RoutingDimension& dimension = model_->GetDimensionOrDie("time");
+    *cost = 0;
+    for (int vehicle = 0; vehicle < routes.size(); ++vehicle) {
+      const std::vector<int64> nodes = RouteNodes(vehicle, routes[vehicle]);
+      int64 cumul = dimension.CumulVar(nodes[0])->Min();
+      for (int i = 0; i < nodes.size(); ++i) {
+        const int64 node = nodes[i];
+        if (i > 0) {
+          cumul += Transit(vehicle, nodes[i - 1], node);
+          if (cumul > std::min(capacities_[vehicle],
+                               dimension.CumulVar(node)->Max())) {
+            return false;
+          }
+          cumul = std::max(dimension.CumulVar(node)->Min(), cumul);
+        }
+        if (dimension.HasCumulVarSoftUpperBoundFromIndex(node)) {
+          const int64 bound =
+              dimension.GetCumulVarSoftUpperBoundFromIndex(node);
+          if (cumul > bound) {
+            *cost += (cumul - bound) *
+                     dimension.GetCumulVarSoftUpperBoundCoefficientFromIndex(
+                         node);
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // Sets the next variables of 'routes' in 'assignment'; if 'current' is not
+  // nullptr, only the ones which differ from 'current'.
+  void FillAssignment(const Routes& routes, const Routes* const current,
+                      Assignment* const assignment) const {
+    std::vector<int64> current_nexts;
+    if (current != nullptr) {
+      current_nexts = Nexts(*current);
+    }
+    const std::vector<int64> nexts = Nexts(routes);
+    for (int64 index = 0; index < nexts.size(); ++index) {
+      if (current == nullptr || nexts[index] != current_nexts[index]) {
+        IntVar* const next = model_->NextVar(index);
+        assignment->Add(next);
+        assignment->SetValue(next, nexts[index]);
+      }
+    }
+  }
+
+ private:
+  int64 Distance(RoutingModel::NodeIndex from, RoutingModel::NodeIndex to) {
+    return std::abs(x_[from.value()] - x_[to.value()]) +
+           std::abs(y_[from.value()] - y_[to.value()]);
+  }
+
+  int64 Capacity(int64 vehicle) { return capacities_[vehicle]; }
+
+  std::vector<int64> Nexts(const Routes& routes) const {
+    std::vector<int64> nexts(model_->Size());
+    for (int vehicle = 0; vehicle < routes.size(); ++vehicle) {
+      const std::vector<int64> nodes = RouteNodes(vehicle, routes[vehicle]);
+      for (int i = 0; i + 1 < nodes.size(); ++i) {
+        nexts[nodes[i]] = nodes[i + 1];
+      }
+    }
+    return nexts;
+  }
+
+  std::vector<int64> x_;
+  std::vector<int64> y_;
+  std::vector<int64> capacities_;
+  std::unique_ptr<RoutingModel> model_;
+  Routes routes_;
+};
+
+// Picks a random route which has at least 'min_size' nodes, or returns -1.
+int RandomRoute(const Routes& routes, int min_size, ACMRandom* const rgen) {
+  std::vector<int> candidates;
+  for (int i = 0; i < routes.size(); ++i) {
+    if (routes[i].size() >= min_size) {
+      candidates.push_back(i);
+    }
+  }
+  return candidates.empty() ? -1 : candidates[rgen->Uniform(candidates.size())];
+}
+
+// Applies one to three random moves relocating, exchanging or reversing
+// chains of nodes.
+void RandomMoves(ACMRandom* const rgen, Routes* const routes) {
+  for (int moves = 1 + rgen->Uniform(3); moves > 0; --moves) {
+    const int from = RandomRoute(*routes, 1, rgen);
+    if (from < 0) return;
+    std::vector<int64>* const from_route = &(*routes)[from];
+    switch (rgen->Uniform(3)) {
+      case 0: {
+        // Relocates a chain, possibly reversed.
+        const int begin = rgen->Uniform(from_route->size());
+        const int end = std::min<int>(from_route->size(),
+                                      begin + 1 + rgen->Uniform(3));
+        std::vector<int64> chain(from_route->begin() + begin,
+                                 from_route->begin() + end);
+        from_route->erase(from_route->begin() + begin,
+                          from_route->begin() + end);
+        if (rgen->Uniform(4) == 0) {
+          std::reverse(chain.begin(), chain.end());
+        }
+        std::vector<int64>* const to_route =
+            &(*routes)[rgen->Uniform(routes->size())];
+        const int position = rgen->Uniform(to_route->size() + 1);
+        to_route->insert(to_route->begin() + position, chain.begin(),
+                         chain.end());
+        break;
+      }
+      case 1: {
+        // Exchanges two nodes.
+        const int to = RandomRoute(*routes, 1, rgen);
+        std::swap((*from_route)[rgen->Uniform(from_route->size())],
+                  (*routes)[to][rgen->Uniform((*routes)[to].size())]);
+        break;
+      }
+      default: {
+        // Reverses a chain.
+        const int begin = rgen->Uniform(from_route->size());
+        const int end = begin + 1 + rgen->Uniform(from_route->size() - begin);
+        std::reverse(from_route->begin() + begin, from_route->begin() + end);
+        break;
+      }
+    }
+  }
+}
+
+// Both filters accept the same deltas, which are the feasible ones, with the
+// same objective values; the current solution is sometimes replaced by an
+// accepted delta.
+void TestRandomDeltas(const Options& options) {
+  LOG(INFO) << "TestRandomDeltas(" << options.slacks << ", "
+            << options.soft_bounds << ", " << options.vehicle_span_costs
+            << ", " << options.global_span_cost << ")";
+  const bool has_span_costs =
+      options.vehicle_span_costs || options.global_span_cost;
+  ACMRandom rgen(FLAGS_seed);
+  int64 num_accepted = 0;
+  int64 num_rejected = 0;
+  for (int instance_index = 0; instance_index < FLAGS_num_instances;
+       ++instance_index) {
+    RandomInstance instance(options, &rgen);
+    RoutingModel* const model = instance.model();
+    const RoutingDimension& dimension = model->GetDimensionOrDie("time");
+    ObjectiveRecorder objectives[2];
+    RoutingLocalSearchFilter* filters[2];
+    for (int i = 0; i < 2; ++i) {
+      FLAGS_routing_use_cumul_node_summaries = i == 0;
+      filters[i] = MakePathCumulFilter(
+          *model, dimension,
+          NewPermanentCallback(&objectives[i], &ObjectiveRecorder::Set));
+    }
+    FLAGS_routing_use_cumul_node_summaries = true;
+    Solver* const solver = model->solver();
+    Routes current = instance.routes();
+    int64 cost = 0;
+    CHECK(instance.Evaluate(current, &cost));
+    Assignment* const solution = solver->MakeAssignment();
+    instance.FillAssignment(current, nullptr, solution);
+    for (int i = 0; i < 2; ++i) {
+      filters[i]->Synchronize(solution);
+    }
+    Assignment* const delta = solver->MakeAssignment();
+    Assignment* const empty = solver->MakeAssignment();
+    for (int d = 0; d < FLAGS_num_deltas; ++d) {
+      Routes routes = current;
+      RandomMoves(&rgen, &routes);
+      delta->Clear();
+      instance.FillAssignment(routes, &current, delta);
+      const bool accepted = filters[0]->Accept(delta, empty);
+      CHECK_EQ(accepted, filters[1]->Accept(delta, empty))
+          << instance_index << " " << d;
+      CHECK_EQ(instance.Evaluate(routes, &cost), accepted)
+          << instance_index << " " << d;
+      if (!accepted) {
+        ++num_rejected;
+        continue;
+      }
+      ++num_accepted;
+      CHECK_EQ(objectives[0].value(), objectives[1].value())
+          << instance_index << " " << d;
+      if (!has_span_costs) {
+        CHECK_EQ(cost, objectives[0].value()) << instance_index << " " << d;
+      }
+      if (rgen.Uniform(4) == 0) {
+        current = routes;
+        solution->Clear();
+        instance.FillAssignment(current, nullptr, solution);
+        for (int i = 0; i < 2; ++i) {
+          filters[i]->Synchronize(solution);
+        }
+      }
+    }
+  }
+  LOG(INFO) << num_accepted << " accepted, " << num_rejected << " rejected";
+  CHECK_GT(num_accepted, 0);
+  CHECK_GT(num_rejected, 0);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  const operations_research::Options kOptions[] = {
+    {false, false, false, false}, {true, false, false, false},
+    {false, true, false, false}, {true, true, false, false},
+    {true, true, true, false}, {true, true, false, true}
+  };
+  for (int i = 0; i < sizeof(kOptions) / sizeof(kOptions[0]); ++i) {
+    operations_research::TestRandomDeltas(kOptions[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,355 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "base/unique_ptr.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/routing.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(size, 60, "Number of nodes of the vehicle routing problems");
+DEFINE_int32(vehicles, 4, "Number of vehicles of the vehicle routing problems");
+DECLARE_bool(routing_use_dont_look_bits);
+DECLARE_int64(routing_granular_neighbors);
+DECLARE_bool(routing_precompute_callbacks);
+DECLARE_int32(routing_precompute_callbacks_threads);
+
+namespace operations_research {
+
+// A random capacitated vehicle routing problem on a grid.
+class RandomVrp {
+ public:
+  RandomVrp(int size, int vehicles, int seed)
+      : size_(size), vehicles_(vehicles) {
+    ACMRandom rgen(seed);
+    for (int i = 0; i < size; ++i) {
+      x_.push_back(rgen.Uniform(1000));
+      y_.push_back(rgen.Uniform(1000));
+      demands_.push_back(i == 0 ? 0 : 1 + rgen.Uniform(10));
+    }
+  }
+
+  int64 Distance(RoutingModel::NodeIndex from, RoutingModel::NodeIndex to) {
+    return std::abs(x_[from.value()] - x_[to.value()]) +
+           std::abs(y_[from.value()] - y_[to.value()]);
+  }
+
+  int64 ScaledDistance(int64 scale, RoutingModel::NodeIndex from,
+                       RoutingModel::NodeIndex to) {
+    return scale * Distance(from, to);
+  }
+
+  int64 Demand(RoutingModel::NodeIndex from, RoutingModel::NodeIndex to) {
+    return demands_[from.value()];
+  }
+
+  // The model owns the callbacks.
+  RoutingModel* BuildModel() {
+    return BuildModelWithCapacity(10 * size_ / vehicles_);
+  }
+
+  RoutingModel* BuildModelWithCapacity(int64 capacity) {
+    RoutingModel* const model = new RoutingModel(size_, vehicles_);
+    model->SetArcCostEvaluatorOfAllVehicles(
+        NewPermanentCallback(this, &RandomVrp::Distance));
+    model->AddDimension(NewPermanentCallback(this, &RandomVrp::Demand), 0,
+                        capacity, true, "capacity");
+    return model;
+  }
+
+  // A model with several depots and several cost classes: the vehicles have
+  // different arc costs, span costs and fixed costs. The arc costs of half of
+  // the vehicles are multiplied by 'scale'.
+  RoutingModel* BuildCostModel(int64 scale) {
+    std::vector<RoutingModel::NodeIndex> starts;
+    std::vector<RoutingModel::NodeIndex> ends;
+    for (int vehicle = 0; vehicle < vehicles_; ++vehicle) {
+      starts.push_back(RoutingModel::NodeIndex(vehicle % 3));
+      ends.push_back(
+          RoutingModel::NodeIndex(vehicle % 2 == 0 ? 0 : 3 + vehicle));
+    }
+    RoutingModel* const model =
+        new RoutingModel(size_, vehicles_, starts, ends);
+    model->AddDimension(NewPermanentCallback(this, &RandomVrp::Distance), 0,
+                        1LL << 40, true, "distance");
+    RoutingDimension* const dimension = model->GetMutableDimension("distance");
+    for (int vehicle = 0; vehicle < vehicles_; ++vehicle) {
+      if (vehicle % 2 == 0) {
+        model->SetArcCostEvaluatorOfVehicle(
+            NewPermanentCallback(this, &RandomVrp::Distance), vehicle);
+      } else {
+        model->SetArcCostEvaluatorOfVehicle(
+            NewPermanentCallback(this, &RandomVrp::ScaledDistance, scale),
+            vehicle);
+      }
+      dimension->SetSpanCostCoefficientForVehicle(vehicle % 3, vehicle);
+      model->SetFixedCostOfVehicle(1000 * vehicle, vehicle);
+    }
+    return model;
+  }
+
+ private:
+  const int size_;
+  const int vehicles_;
+  std::vector<int64> x_;
+  std::vector<int64> y_;
+  std::vector<int64> demands_;
+};
+
+// Checks that 'solution' is a complete solution of 'model': all the next,
+// vehicle and cumul variables are bound, and the objective is the cost of
+// the routes.
+void CheckCompleteSolution(RandomVrp* const vrp, RoutingModel* const model,
+                           const Assignment* const solution) {
+  CHECK(solution != nullptr);
+  CHECK(solution->HasObjective());
+  int64 cost = 0;
+  for (int vehicle = 0; vehicle < model->vehicles(); ++vehicle) {
+    int64 load = 0;
+    for (int64 index = model->Start(vehicle); !model->IsEnd(index);) {
+      IntVar* const cumul = model->CumulVar(index, "capacity");
+      CHECK(solution->Contains(cumul));
+      CHECK(solution->Bound(cumul));
+      CHECK_EQ(load, solution->Value(cumul));
+      const int64 next = solution->Value(model->NextVar(index));
+      cost += model->GetArcCostForVehicle(index, next, vehicle);
+      load += vrp->Demand(model->IndexToNode(index), model->IndexToNode(next));
+      index = next;
+    }
+  }
+  CHECK_EQ(cost, solution->ObjectiveValue());
+}
+
+// The portfolio returns a complete solution, at least as good as the best
+// first solution of its strategies.
+void TestFirstSolutionPortfolio(int64 time_limit_ms) {
+  LOG(INFO) << "TestFirstSolutionPortfolio(" << time_limit_ms << ")";
+  RandomVrp vrp(FLAGS_size, FLAGS_vehicles, FLAGS_seed);
+  const char* const kStrategies[] = {"PathCheapestArc", "Savings",
+                                     "AllUnperformed", "BestInsertion"};
+  int64 best_cost = kint64max;
+  for (int i = 0; i < sizeof(kStrategies) / sizeof(kStrategies[0]); ++i) {
+    RoutingSearchParameters parameters;
+    parameters.first_solution = kStrategies[i];
+    parameters.solution_limit = 1;
+    std::unique_ptr<RoutingModel> model(vrp.BuildModel());
+    const Assignment* const solution =
+        model->SolveWithParameters(parameters, nullptr);
+    if (solution != nullptr) {
+      best_cost = std::min(best_cost, solution->ObjectiveValue());
+    }
+  }
+  CHECK_LT(best_cost, kint64max);
+  RoutingSearchParameters parameters;
+  parameters.first_solution_portfolio =
+      "PathCheapestArc,Savings,AllUnperformed,BestInsertion";
+  parameters.first_solution_portfolio_threads = 2;
+  parameters.time_limit = time_limit_ms;
+  std::unique_ptr<RoutingModel> model(vrp.BuildModel());
+  std::unique_ptr<RoutingModel::ModelBuilder> builder(
+      NewPermanentCallback(&vrp, &RandomVrp::BuildModel));
+  const Assignment* const solution =
+      model->SolveWithFirstSolutionPortfolio(parameters, builder.get());
+  CheckCompleteSolution(&vrp, model.get(), solution);
+  CHECK_LE(solution->ObjectiveValue(), best_cost);
+}
+
+// Don't look bits skip positions of the path operators, but a complete
+// exploration of the neighborhoods is done before local search stops: the
+// local optimum found with don't look bits cannot be improved by a descent
+// without them.
+void TestDontLookBits() {
+  LOG(INFO) << "TestDontLookBits";
+  RandomVrp vrp(FLAGS_size, FLAGS_vehicles, FLAGS_seed);
+  RoutingSearchParameters parameters;
+  parameters.no_lns = true;
+  parameters.first_solution = "PathCheapestArc";
+  parameters.use_dont_look_bits = true;
+  std::unique_ptr<RoutingModel> model(vrp.BuildModel());
+  const Assignment* const solution =
+      model->SolveWithParameters(parameters, nullptr);
+  CheckCompleteSolution(&vrp, model.get(), solution);
+  const int64 cost = solution->ObjectiveValue();
+
+  // The operators are created when the model is closed.
+  FLAGS_routing_use_dont_look_bits = false;
+  parameters.use_dont_look_bits = false;
+  std::unique_ptr<RoutingModel> other_model(vrp.BuildModel());
+  other_model->CloseModel();
+  std::vector<std::vector<RoutingModel::NodeIndex> > routes;
+  model->AssignmentToRoutes(*solution, &routes);
+  Assignment* const start = other_model->solver()->MakeAssignment();
+  CHECK(other_model->RoutesToAssignment(routes, false, true, start));
+  const Assignment* const improved =
+      other_model->SolveWithParameters(parameters, start);
+  CheckCompleteSolution(&vrp, other_model.get(), improved);
+  CHECK_EQ(cost, improved->ObjectiveValue());
+}
+
+// Relocate, Exchange and 2Opt are built from the neighbor lists of the
+// nodes, and the exploration resumes in the middle of the neighbor lists
+// after each improvement.
+void TestGranularNeighbors(bool use_dont_look_bits) {
+  LOG(INFO) << "TestGranularNeighbors(" << use_dont_look_bits << ")";
+  RandomVrp vrp(FLAGS_size, FLAGS_vehicles, FLAGS_seed);
+  RoutingSearchParameters parameters;
+  parameters.no_lns = true;
+  parameters.first_solution = "PathCheapestArc";
+  parameters.use_dont_look_bits = use_dont_look_bits;
+  parameters.granular_neighbors = 8;
+  std::unique_ptr<RoutingModel> model(vrp.BuildModel());
+  const Assignment* const solution =
+      model->SolveWithParameters(parameters, nullptr);
+  CheckCompleteSolution(&vrp, model.get(), solution);
+  FLAGS_routing_granular_neighbors = 0;
+  FLAGS_routing_use_dont_look_bits = false;
+}
+
+// Global cheapest insertion as it was done before positions were kept in a
+// priority queue: all the insertion positions of all the remaining nodes are
+// sorted by value, then by the node after which to insert and by the node,
+// and the first one which fits in the capacity is committed. Returns the
+// next of each index, or an empty vector if a node could not be inserted.
+std::vector<int64> SortedGlobalCheapestInsertion(RandomVrp* const vrp,
+                                                 RoutingModel* const model,
+                                                 int64 capacity) {
+  std::vector<int64> nexts(model->Size(), -1);
+  std::vector<int> vehicles(model->Size(), -1);
+  std::vector<int64> loads(model->vehicles(), 0);
+  int num_inserted = 0;
+  for (int vehicle = 0; vehicle < model->vehicles(); ++vehicle) {
+    nexts[model->Start(vehicle)] = model->End(vehicle);
+    vehicles[model->Start(vehicle)] = vehicle;
+    ++num_inserted;
+  }
+  while (num_inserted < model->Size()) {
+    std::vector<std::pair<int64, std::pair<int64, int64> > > positions;
+    for (int64 node = 0; node < model->Size(); ++node) {
+      if (vehicles[node] != -1) continue;
+      for (int vehicle = 0; vehicle < model->vehicles(); ++vehicle) {
+        for (int64 after = model->Start(vehicle); !model->IsEnd(after);
+             after = nexts[after]) {
+          const int64 before = nexts[after];
+          const int64 value = model->GetHomogeneousCost(after, node) +
+                              model->GetHomogeneousCost(node, before) -
+                              model->GetHomogeneousCost(after, before);
+          positions.push_back(
+              std::make_pair(value, std::make_pair(after, node)));
+        }
+      }
+    }
+    std::sort(positions.begin(), positions.end());
+    bool found = false;
+    for (int i = 0; i < positions.size() && !found; ++i) {
+      const int64 after = positions[i].second.first;
+      const int64 node = positions[i].second.second;
+      const int vehicle = vehicles[after];
+      const int64 demand = vrp->Demand(model->IndexToNode(node),
+                                       RoutingModel::NodeIndex(0));
+      if (loads[vehicle] + demand <= capacity) {
+        nexts[node] = nexts[after];
+        nexts[after] = node;
+        vehicles[node] = vehicle;
+        loads[vehicle] += demand;
+        ++num_inserted;
+        found = true;
+      }
+    }
+    if (!found) return std::vector<int64>();
+  }
+  return nexts;
+}
+
+// The capacity filter is monotone: a position rejected by it stays rejected
+// until its route changes. Global cheapest insertion then builds the same
+// first solution as when sorting all positions after each insertion.
+void TestGlobalCheapestInsertion(int64 capacity) {
+  LOG(INFO) << "TestGlobalCheapestInsertion(" << capacity << ")";
+  for (int seed = FLAGS_seed; seed < FLAGS_seed + 5; ++seed) {
+    RandomVrp vrp(FLAGS_size, FLAGS_vehicles, seed);
+    RoutingSearchParameters parameters;
+    parameters.no_lns = true;
+    parameters.first_solution = "GlobalCheapestInsertion";
+    parameters.solution_limit = 1;
+    std::unique_ptr<RoutingModel> model(vrp.BuildModelWithCapacity(capacity));
+    const Assignment* const solution =
+        model->SolveWithParameters(parameters, nullptr);
+    const std::vector<int64> expected =
+        SortedGlobalCheapestInsertion(&vrp, model.get(), capacity);
+    if (expected.empty()) {
+      CHECK(solution == nullptr) << seed;
+      continue;
+    }
+    CheckCompleteSolution(&vrp, model.get(), solution);
+    for (int64 index = 0; index < model->Size(); ++index) {
+      CHECK_EQ(expected[index], solution->Value(model->NextVar(index)))
+          << seed << " " << index;
+    }
+  }
+}
+
+// The arc costs of all the cost classes are the same with and without
+// precomputed callbacks, including when they do not fit in an int32.
+void TestPrecomputedArcCosts(int64 scale) {
+  LOG(INFO) << "TestPrecomputedArcCosts(" << scale << ")";
+  RandomVrp vrp(FLAGS_size, FLAGS_vehicles, FLAGS_seed);
+  std::unique_ptr<RoutingModel> model(vrp.BuildCostModel(scale));
+  model->CloseModel();
+  FLAGS_routing_precompute_callbacks = true;
+  FLAGS_routing_precompute_callbacks_threads = 3;
+  std::unique_ptr<RoutingModel> precomputed_model(vrp.BuildCostModel(scale));
+  precomputed_model->CloseModel();
+  FLAGS_routing_precompute_callbacks = false;
+  FLAGS_routing_precompute_callbacks_threads = 1;
+  CHECK_GT(model->GetCostClassesCount(), 2);
+  CHECK_EQ(model->GetCostClassesCount(),
+           precomputed_model->GetCostClassesCount());
+  const int num_indices = model->Size() + model->vehicles();
+  for (int cost_class = 0; cost_class < model->GetCostClassesCount();
+       ++cost_class) {
+    for (int64 i = 0; i < num_indices; ++i) {
+      for (int64 j = 0; j < num_indices; ++j) {
+        CHECK_EQ(model->GetArcCostForClass(i, j, cost_class),
+                 precomputed_model->GetArcCostForClass(i, j, cost_class))
+            << cost_class << " " << i << " " << j;
+      }
+    }
+  }
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestFirstSolutionPortfolio(kint64max);
+  operations_research::TestFirstSolutionPortfolio(100);
+  operations_research::TestDontLookBits();
+  operations_research::TestGranularNeighbors(false);
+  operations_research::TestGranularNeighbors(true);
+  operations_research::TestGlobalCheapestInsertion(10 * FLAGS_size /
+                                                    FLAGS_vehicles);
+  // Tight capacities: many positions are rejected by the capacity filter,
+  // and some instances have no first solution.
+  operations_research::TestGlobalCheapestInsertion(90);
+  operations_research::TestGlobalCheapestInsertion(84);
+  operations_research::TestPrecomputedArcCosts(1);
+  operations_research::TestPrecomputedArcCosts(10000000);
+  return 0;
+}
@@ -0,0 +1,244 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the clauses stored in a ClauseArena through creations, deletions
+// and compactions, and the SAT solver on random 3-SAT problems with and
+// without frequent clause database cleanups, which delete learned clauses
+// and compact the arena.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "sat/clause.h"
+#include "sat/sat_base.h"
+#include "sat/sat_parameters.pb.h"
+#include "sat/sat_solver.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_clauses, 3000, "Number of clauses created in the arena");
+DEFINE_int32(num_problems, 20, "Number of random 3-SAT problems");
+DEFINE_int32(num_variables, 120, "Number of variables of the problems");
+
+namespace operations_research {
+namespace sat {
+
+// The expected content of a clause of the arena. The resolution nodes are
+// never dereferenced by the arena, so any distinct addresses can be used.
+struct ExpectedClause {
+  std::vector<Literal> literals;
+  bool is_learned;
+  ResolutionNode* node;
+  bool is_deleted;
+  ClauseOffset offset;
+};
+
+void CheckClause(ClauseArena* const arena,
+                 const ExpectedClause* const expected) {
+  const SatClause* const clause = arena->Clause(expected->offset);
+  CHECK_EQ(expected->literals.size(), clause->Size());
+  CHECK(std::equal(clause->begin(), clause->end(),
+                   expected->literals.begin()));
+  CHECK_EQ(expected->is_learned, clause->IsLearned());
+  CHECK(clause->ResolutionNodePointer() == expected->node);
+}
+
+// Creates clauses of random sizes, with and without resolution nodes, into
+// 'arena' and appends them to 'clauses'.
+void CreateClauses(int num_clauses, ACMRandom* const rgen,
+                   ClauseArena* const arena,
+                   std::vector<ExpectedClause>* const clauses) {
+  const int first = clauses->size();
+  clauses->resize(first + num_clauses);
+  for (int i = first; i < clauses->size(); ++i) {
+    ExpectedClause* const expected = &(*clauses)[i];
+    const int size = 2 + rgen->Uniform(rgen->Uniform(10) == 0 ? 200 : 10);
+    for (int j = 0; j < size; ++j) {
+      expected->literals.push_back(
+          Literal(VariableIndex(rgen->Uniform(1000)), rgen->Uniform(2) == 0));
+    }
+    expected->is_learned = rgen->Uniform(2) == 0;
+    expected->node = rgen->Uniform(3) == 0
+                         ? reinterpret_cast<ResolutionNode*>(
+                               sizeof(uint64) * (i + 1))
+                         : nullptr;
+    expected->is_deleted = false;
+    const int64 num_words = arena->NumWords();
+    expected->offset = arena->Create(
+        expected->literals, expected->is_learned ? SatClause::LEARNED_CLAUSE
+                                                 : SatClause::PROBLEM_CLAUSE,
+        expected->node != nullptr, expected->node);
+    // Clauses are appended at the end of the arena.
+    CHECK_GE(expected->offset.value(), num_words);
+    CHECK_LT(expected->offset.value(), arena->NumWords());
+  }
+}
+
+void TestArena() {
+  LOG(INFO) << "TestArena";
+  ACMRandom rgen(FLAGS_seed);
+  ClauseArena arena;
+  std::vector<ExpectedClause> clauses;
+  CreateClauses(FLAGS_num_clauses, &rgen, &arena, &clauses);
+  // The offsets are 32-bit indices of 64-bit words.
+  CHECK_EQ(sizeof(int32), sizeof(ClauseOffset));
+  for (int i = 0; i < clauses.size(); ++i) {
+    CheckClause(&arena, &clauses[i]);
+  }
+  for (int round = 0; round < 5; ++round) {
+    // Deletes most of the clauses.
+    CHECK(!arena.NeedsCompaction());
+    for (int i = 0; i < clauses.size(); ++i) {
+      if (!clauses[i].is_deleted && rgen.Uniform(3) != 0) {
+        arena.Delete(clauses[i].offset);
+        clauses[i].is_deleted = true;
+      }
+    }
+    CHECK(arena.NeedsCompaction());
+    // The clauses are relocated in a random order, some of them several
+    // times, and the deleted clauses are dropped.
+    std::vector<int> order;
+    for (int i = 0; i < clauses.size(); ++i) {
+      order.push_back(i);
+      if (rgen.Uniform(4) == 0) order.push_back(i);
+    }
+    std::random_shuffle(order.begin(), order.end(), rgen);
+    const int64 num_words = arena.NumWords();
+    arena.StartCompaction();
+    CHECK_EQ(kNoClauseOffset, arena.Relocate(kNoClauseOffset));
+    std::vector<ClauseOffset> new_offsets(clauses.size(), kNoClauseOffset);
+    ClauseOffset last_offset = kNoClauseOffset;
+    for (int i = 0; i < order.size(); ++i) {
+      ExpectedClause* const expected = &clauses[order[i]];
+      const ClauseOffset new_offset = arena.Relocate(expected->offset);
+      if (expected->is_deleted) {
+        CHECK_EQ(kNoClauseOffset, new_offset);
+      } else if (new_offsets[order[i]] != kNoClauseOffset) {
+        CHECK_EQ(new_offsets[order[i]], new_offset);
+      } else {
+        // Clauses are moved in the order of their first relocation.
+        CHECK_GT(new_offset, last_offset);
+        last_offset = new_offset;
+        new_offsets[order[i]] = new_offset;
+      }
+    }
+    arena.FinishCompaction();
+    CHECK_LT(arena.NumWords(), num_words);
+    CHECK(!arena.NeedsCompaction());
+    for (int i = 0; i < clauses.size(); ++i) {
+      clauses[i].offset = new_offsets[i];
+      if (!clauses[i].is_deleted) {
+        CheckClause(&arena, &clauses[i]);
+      }
+    }
+    // New clauses are appended after the compacted ones.
+    CreateClauses(FLAGS_num_clauses / 2, &rgen, &arena, &clauses);
+    for (int i = 0; i < clauses.size(); ++i) {
+      if (!clauses[i].is_deleted) {
+        CheckClause(&arena, &clauses[i]);
+      }
+    }
+  }
+}
+
+// Random 3-SAT problem at the satisfiability threshold.
+void MakeRandomProblem(int num_variables, ACMRandom* const rgen,
+                       std::vector<std::vector<Literal> >* const clauses) {
+  clauses->resize(num_variables * 426 / 100);
+  for (int i = 0; i < clauses->size(); ++i) {
+    for (int j = 0; j < 3; ++j) {
+      (*clauses)[i].push_back(Literal(
+          VariableIndex(rgen->Uniform(num_variables)), rgen->Uniform(2) == 0));
+    }
+  }
+}
+
+bool IsSolution(const std::vector<std::vector<Literal> >& clauses,
+                const VariablesAssignment& assignment) {
+  for (int i = 0; i < clauses.size(); ++i) {
+    bool is_satisfied = false;
+    for (int j = 0; j < clauses[i].size(); ++j) {
+      is_satisfied |= assignment.IsLiteralTrue(clauses[i][j]);
+    }
+    if (!is_satisfied) return false;
+  }
+  return true;
+}
+
+// Solves the problem and returns its status; checks that the solution, if
+// any, satisfies all the clauses.
+SatSolver::Status Solve(int num_variables,
+                        const std::vector<std::vector<Literal> >& clauses,
+                        const SatParameters& parameters,
+                        int64* const num_failures) {
+  SatSolver solver;
+  solver.SetParameters(parameters);
+  solver.SetNumVariables(num_variables);
+  bool is_unsat = false;
+  for (int i = 0; i < clauses.size(); ++i) {
+    is_unsat |= !solver.AddProblemClause(clauses[i]);
+  }
+  if (is_unsat) return SatSolver::MODEL_UNSAT;
+  const SatSolver::Status status = solver.Solve();
+  if (status == SatSolver::MODEL_SAT) {
+    CHECK(IsSolution(clauses, solver.Assignment()));
+  }
+  *num_failures += solver.num_failures();
+  return status;
+}
+
+// Cleaning the clause database every few conflicts deletes learned clauses
+// and compacts the arena many times; the problems are still solved, with or
+// without unsat proofs.
+void TestCleanup(bool unsat_proof) {
+  LOG(INFO) << "TestCleanup(" << unsat_proof << ")";
+  ACMRandom rgen(FLAGS_seed);
+  SatParameters parameters;
+  parameters.set_unsat_proof(unsat_proof);
+  // The unsat proofs do not support the separate binary clauses; all the
+  // clauses are then stored in the arena.
+  parameters.set_treat_binary_clauses_separately(!unsat_proof);
+  SatParameters cleanup_parameters = parameters;
+  cleanup_parameters.set_clause_cleanup_increment(10);
+  int num_sat = 0;
+  int64 num_failures = 0;
+  int64 num_cleanup_failures = 0;
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    std::vector<std::vector<Literal> > clauses;
+    MakeRandomProblem(FLAGS_num_variables, &rgen, &clauses);
+    const SatSolver::Status status =
+        Solve(FLAGS_num_variables, clauses, parameters, &num_failures);
+    CHECK_EQ(status, Solve(FLAGS_num_variables, clauses, cleanup_parameters,
+                           &num_cleanup_failures)) << p;
+    if (status == SatSolver::MODEL_SAT) ++num_sat;
+  }
+  LOG(INFO) << num_sat << " satisfiable problems, " << num_failures << " / "
+            << num_cleanup_failures << " failures without / with cleanups";
+  CHECK_GT(num_sat, 0);
+  CHECK_LT(num_sat, FLAGS_num_problems);
+  // Enough conflicts for many cleanups.
+  CHECK_GT(num_cleanup_failures, 100 * FLAGS_num_problems);
+}
+}  // namespace sat
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::sat::TestArena();
+  operations_research::sat::TestCleanup(false);
+  operations_research::sat::TestCleanup(true);
+  return 0;
+}
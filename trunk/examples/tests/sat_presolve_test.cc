@@ -0,0 +1,180 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the SAT presolver on small random problems against an enumeration
+// of all their assignments: the presolved problem is satisfiable iff the
+// original one is, and each of its solutions is extended by the postsolver
+// to a solution of the original problem.
+
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "sat/boolean_problem.pb.h"
+#include "sat/sat_base.h"
+#include "sat/simplification.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_problems, 300, "Number of random problems");
+DEFINE_int32(num_variables, 12, "Number of variables of the problems");
+
+namespace operations_research {
+namespace sat {
+
+// Fills 'assignment' with the values of the bits of 'mask'.
+void MaskToAssignment(int num_variables, int mask,
+                      VariablesAssignment* const assignment) {
+  assignment->Resize(num_variables);
+  for (int var = 0; var < num_variables; ++var) {
+    assignment->AssignFromTrueLiteral(
+        Literal(VariableIndex(var), (mask >> var) & 1));
+  }
+}
+
+// Returns the mask of a complete assignment.
+int AssignmentToMask(int num_variables, const VariablesAssignment& assignment) {
+  int mask = 0;
+  for (int var = 0; var < num_variables; ++var) {
+    CHECK(assignment.IsVariableAssigned(VariableIndex(var)));
+    if (assignment.IsLiteralTrue(Literal(VariableIndex(var), true))) {
+      mask |= 1 << var;
+    }
+  }
+  return mask;
+}
+
+// Returns true if the assignment given by the bits of 'mask' satisfies all
+// the constraints of the problem.
+bool IsSolution(const LinearBooleanProblem& problem, int mask) {
+  for (int i = 0; i < problem.constraints_size(); ++i) {
+    const LinearBooleanConstraint& constraint = problem.constraints(i);
+    int64 sum = 0;
+    for (int j = 0; j < constraint.literals_size(); ++j) {
+      const Literal literal(constraint.literals(j));
+      if (((mask >> literal.Variable().value()) & 1) == literal.IsPositive()) {
+        sum += constraint.coefficients(j);
+      }
+    }
+    if ((constraint.has_lower_bound() && sum < constraint.lower_bound()) ||
+        (constraint.has_upper_bound() && sum > constraint.upper_bound())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the masks of all the solutions of the problem.
+std::vector<int> AllSolutions(const LinearBooleanProblem& problem) {
+  std::vector<int> solutions;
+  for (int mask = 0; mask < (1 << problem.num_variables()); ++mask) {
+    if (IsSolution(problem, mask)) {
+      solutions.push_back(mask);
+    }
+  }
+  return solutions;
+}
+
+void AddRandomLiteral(int num_variables, ACMRandom* const rgen,
+                      LinearBooleanConstraint* const constraint) {
+  const int variable = 1 + rgen->Uniform(num_variables);
+  constraint->add_literals(rgen->Uniform(2) == 0 ? variable : -variable);
+  constraint->add_coefficients(1);
+}
+
+// A random problem made of clauses with one to four literals, and sometimes
+// an at most k constraint and an objective, whose variables must not be
+// eliminated.
+void MakeRandomProblem(int num_variables, ACMRandom* const rgen,
+                       LinearBooleanProblem* const problem) {
+  problem->set_num_variables(num_variables);
+  problem->set_type(LinearBooleanProblem::SATISFIABILITY);
+  const int num_clauses = num_variables * (2 + rgen->Uniform(4));
+  for (int i = 0; i < num_clauses; ++i) {
+    LinearBooleanConstraint* const clause = problem->add_constraints();
+    clause->set_lower_bound(1);
+    const int size = rgen->Uniform(10) == 0 ? 1 + rgen->Uniform(2)
+                                            : 2 + rgen->Uniform(3);
+    for (int j = 0; j < size; ++j) {
+      AddRandomLiteral(num_variables, rgen, clause);
+    }
+  }
+  if (rgen->Uniform(2) == 0) {
+    // The literals of the at most k constraint are on distinct variables.
+    LinearBooleanConstraint* const at_most = problem->add_constraints();
+    const int first = rgen->Uniform(num_variables - 4);
+    for (int j = 0; j < 5; ++j) {
+      const int variable = 1 + first + j;
+      at_most->add_literals(rgen->Uniform(2) == 0 ? variable : -variable);
+      at_most->add_coefficients(1);
+    }
+    at_most->set_upper_bound(2);
+  }
+  if (rgen->Uniform(2) == 0) {
+    problem->set_type(LinearBooleanProblem::MINIMIZATION);
+    LinearObjective* const objective = problem->mutable_objective();
+    for (int j = 0; j < 3; ++j) {
+      objective->add_literals(1 + rgen->Uniform(num_variables));
+      objective->add_coefficients(1 + rgen->Uniform(5));
+    }
+  }
+}
+
+void TestRandomProblems() {
+  LOG(INFO) << "TestRandomProblems";
+  ACMRandom rgen(FLAGS_seed);
+  int num_sat = 0;
+  int num_presolved_unsat = 0;
+  for (int p = 0; p < FLAGS_num_problems; ++p) {
+    LinearBooleanProblem problem;
+    MakeRandomProblem(FLAGS_num_variables, &rgen, &problem);
+    const bool is_sat = !AllSolutions(problem).empty();
+    SatPostsolver postsolver(problem.num_variables());
+    SatPresolver presolver(&postsolver);
+    presolver.Load(problem);
+    if (!presolver.Presolve()) {
+      CHECK(!is_sat) << p;
+      ++num_presolved_unsat;
+      continue;
+    }
+    LinearBooleanProblem presolved_problem;
+    presolver.ExtractPresolvedProblem(&presolved_problem);
+    CHECK_EQ(problem.num_variables(), presolved_problem.num_variables());
+    const std::vector<int> solutions = AllSolutions(presolved_problem);
+    CHECK_EQ(is_sat, !solutions.empty()) << p;
+    for (int i = 0; i < solutions.size(); ++i) {
+      VariablesAssignment presolved_assignment;
+      MaskToAssignment(problem.num_variables(), solutions[i],
+                       &presolved_assignment);
+      VariablesAssignment assignment;
+      postsolver.PostsolveSolution(presolved_assignment, &assignment);
+      CHECK(IsSolution(problem, AssignmentToMask(problem.num_variables(),
+                                                 assignment))) << p;
+    }
+    if (is_sat) ++num_sat;
+  }
+  LOG(INFO) << num_sat << " satisfiable problems, " << num_presolved_unsat
+            << " proven unsatisfiable by the presolve";
+  // The random problems are a mix of satisfiable and unsatisfiable ones.
+  CHECK_GT(num_sat, 0);
+  CHECK_LT(num_sat, FLAGS_num_problems);
+}
+}  // namespace sat
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::sat::TestRandomProblems();
+  return 0;
+}
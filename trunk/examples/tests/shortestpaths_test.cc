@@ -0,0 +1,271 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the distances and paths of GenericDijkstra on random graphs against
+// the callback-based Dijkstra and Bellman-Ford, its arc lengths close to
+// kint64max, and the parallel many-to-many distance matrices against one
+// search per source.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "graph/graph.h"
+#include "graph/shortestpaths.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(num_graphs, 200, "Number of random graphs");
+DEFINE_int32(max_nodes, 15, "Maximum number of nodes of the random graphs");
+
+namespace operations_research {
+
+const int64 kDisconnected = kint64max;
+
+// The shortest arc between each pair of nodes.
+class ArcLengthMatrix {
+ public:
+  explicit ArcLengthMatrix(int num_nodes)
+      : num_nodes_(num_nodes), lengths_(num_nodes * num_nodes, kDisconnected) {}
+
+  void AddArc(int tail, int head, int64 length) {
+    int64* const current = &lengths_[tail * num_nodes_ + head];
+    *current = std::min(*current, length);
+  }
+
+  int64 Length(int tail, int head) const {
+    return lengths_[tail * num_nodes_ + head];
+  }
+
+  // Returns the length of 'path', which must be made of arcs of the graph.
+  int64 PathLength(const std::vector<int>& path) const {
+    int64 length = 0;
+    for (int i = 0; i + 1 < path.size(); ++i) {
+      CHECK_NE(kDisconnected, Length(path[i], path[i + 1]));
+      length += Length(path[i], path[i + 1]);
+    }
+    return length;
+  }
+
+  int64 ReversePathLength(const std::vector<int>& reverse_path) const {
+    return PathLength(
+        std::vector<int>(reverse_path.rbegin(), reverse_path.rend()));
+  }
+
+ private:
+  const int num_nodes_;
+  std::vector<int64> lengths_;
+};
+
+// Builds a random graph with parallel arcs, and fills 'arc_lengths' indexed
+// by the arcs of the built graph.
+template <typename Graph>
+void BuildRandomGraph(int num_nodes, ACMRandom* const rgen, Graph* const graph,
+                      std::vector<int64>* const arc_lengths,
+                      ArcLengthMatrix* const matrix) {
+  const int num_arcs = rgen->Uniform(4 * num_nodes);
+  graph->AddNode(num_nodes - 1);
+  for (int i = 0; i < num_arcs; ++i) {
+    const int tail = rgen->Uniform(num_nodes);
+    const int head = rgen->Uniform(num_nodes);
+    if (tail == head) continue;
+    const int64 length = rgen->Uniform(101);
+    graph->AddArc(tail, head);
+    arc_lengths->push_back(length);
+    matrix->AddArc(tail, head, length);
+  }
+  std::vector<typename Graph::ArcIndex> permutation;
+  graph->Build(&permutation);
+  Permute(permutation, arc_lengths);
+}
+
+template <typename Graph>
+void TestRandomGraphs() {
+  LOG(INFO) << "TestRandomGraphs";
+  const int64 kInfinity = GenericDijkstra<Graph>::kInfinity;
+  ACMRandom rgen(FLAGS_seed);
+  for (int g = 0; g < FLAGS_num_graphs; ++g) {
+    const int num_nodes = 2 + rgen.Uniform(FLAGS_max_nodes - 1);
+    Graph graph;
+    std::vector<int64> arc_lengths;
+    ArcLengthMatrix matrix(num_nodes);
+    BuildRandomGraph(num_nodes, &rgen, &graph, &arc_lengths, &matrix);
+    // The same object is used for all the queries on the graph.
+    GenericDijkstra<Graph> dijkstra(&graph, &arc_lengths);
+    for (int source = 0; source < num_nodes; ++source) {
+      CHECK(dijkstra.Run(source, -1));
+      std::vector<int64> distances(num_nodes);
+      for (int node = 0; node < num_nodes; ++node) {
+        distances[node] = dijkstra.Distance(node);
+      }
+      CHECK_EQ(0, distances[source]);
+      const std::vector<int>& settled = dijkstra.settled_nodes();
+      for (int i = 0; i + 1 < settled.size(); ++i) {
+        CHECK_LE(distances[settled[i]], distances[settled[i + 1]]);
+      }
+      for (int target = 0; target < num_nodes; ++target) {
+        std::vector<int> path;
+        CHECK_EQ(distances[target] != kInfinity,
+                 dijkstra.GetPath(target, &path));
+        if (distances[target] != kInfinity) {
+          CHECK_EQ(source, path.front());
+          CHECK_EQ(target, path.back());
+          CHECK_EQ(distances[target], matrix.PathLength(path));
+        }
+        if (target == source) continue;
+        // The callback-based functions append the path from the target back
+        // to the source.
+        path.clear();
+        const bool connected = DijkstraShortestPath(
+            num_nodes, source, target,
+            NewPermanentCallback(&matrix, &ArcLengthMatrix::Length),
+            kDisconnected, &path);
+        CHECK_EQ(distances[target] != kInfinity, connected);
+        if (connected) {
+          CHECK_EQ(source, path.back());
+          CHECK_EQ(distances[target], matrix.ReversePathLength(path));
+        }
+        path.clear();
+        CHECK_EQ(connected,
+                 BellmanFordShortestPath(
+                     num_nodes, source, target,
+                     NewPermanentCallback(&matrix, &ArcLengthMatrix::Length),
+                     kDisconnected, &path));
+        if (connected) {
+          CHECK_EQ(source, path.back());
+          CHECK_EQ(distances[target], matrix.ReversePathLength(path));
+        }
+      }
+      // Early termination at one target, at several targets, and with a
+      // distance limit.
+      const int target = rgen.Uniform(num_nodes);
+      CHECK_EQ(distances[target] != kInfinity, dijkstra.Run(source, target));
+      CHECK_EQ(distances[target], dijkstra.Distance(target));
+      std::vector<int> targets;
+      for (int i = rgen.Uniform(4); i > 0; --i) {
+        targets.push_back(rgen.Uniform(num_nodes));
+      }
+      bool all_reachable = true;
+      for (int i = 0; i < targets.size(); ++i) {
+        all_reachable &= distances[targets[i]] != kInfinity;
+      }
+      CHECK_EQ(all_reachable,
+               dijkstra.RunToTargets(source, targets, kInfinity));
+      for (int i = 0; i < targets.size(); ++i) {
+        CHECK_EQ(distances[targets[i]], dijkstra.Distance(targets[i]));
+      }
+      const int64 limit = rgen.Uniform(200);
+      dijkstra.RunWithLimit(source, -1, limit);
+      for (int node = 0; node < num_nodes; ++node) {
+        CHECK_EQ(distances[node] <= limit ? distances[node] : kInfinity,
+                 dijkstra.Distance(node));
+      }
+    }
+  }
+}
+
+// Compares the distance matrices computed with several numbers of threads
+// with one GenericDijkstra run per source.
+template <typename Graph>
+void TestManyToMany() {
+  LOG(INFO) << "TestManyToMany";
+  const int64 kInfinity = GenericDijkstra<Graph>::kInfinity;
+  const int kNumThreads[] = {1, 2, 3, 8, 100};
+  ACMRandom rgen(FLAGS_seed);
+  for (int g = 0; g < 20; ++g) {
+    const int num_nodes = 2 + rgen.Uniform(300);
+    Graph graph;
+    std::vector<int64> arc_lengths;
+    ArcLengthMatrix matrix(num_nodes);
+    BuildRandomGraph(num_nodes, &rgen, &graph, &arc_lengths, &matrix);
+    // Sources and destinations can be repeated.
+    std::vector<int> sources;
+    for (int i = rgen.Uniform(50); i > 0; --i) {
+      sources.push_back(rgen.Uniform(num_nodes));
+    }
+    std::vector<int> destinations;
+    for (int i = 1 + rgen.Uniform(50); i > 0; --i) {
+      destinations.push_back(rgen.Uniform(num_nodes));
+    }
+    const int64 limit = rgen.Uniform(2) == 0 ? kInfinity : rgen.Uniform(300);
+    const int64 kUnreached = -1;
+    std::vector<int64> expected;
+    GenericDijkstra<Graph> dijkstra(&graph, &arc_lengths);
+    for (int i = 0; i < sources.size(); ++i) {
+      dijkstra.Run(sources[i], -1);
+      for (int j = 0; j < destinations.size(); ++j) {
+        const int64 distance = dijkstra.Distance(destinations[j]);
+        expected.push_back(distance != kInfinity && distance <= limit
+                               ? distance
+                               : kUnreached);
+      }
+    }
+    for (int t = 0; t < sizeof(kNumThreads) / sizeof(kNumThreads[0]); ++t) {
+      std::vector<int64> distances;
+      ComputeManyToManyShortestPaths(graph, arc_lengths, sources,
+                                     destinations, limit, kUnreached,
+                                     kNumThreads[t], &distances);
+      CHECK(expected == distances) << g << " " << kNumThreads[t];
+    }
+  }
+}
+
+// Arcs of length kInfinity or more are never taken, and the distances do not
+// overflow.
+void TestLargeLengths() {
+  LOG(INFO) << "TestLargeLengths";
+  typedef StaticGraph<> Graph;
+  const int64 kInfinity = GenericDijkstra<Graph>::kInfinity;
+  Graph graph(5, 5);
+  std::vector<int64> arc_lengths;
+  graph.AddArc(0, 1);
+  arc_lengths.push_back(5);
+  graph.AddArc(1, 2);
+  arc_lengths.push_back(kint64max);
+  graph.AddArc(1, 3);
+  arc_lengths.push_back(kInfinity - 6);
+  graph.AddArc(3, 4);
+  arc_lengths.push_back(1);
+  graph.AddArc(0, 4);
+  arc_lengths.push_back(kInfinity);
+  std::vector<Graph::ArcIndex> permutation;
+  graph.Build(&permutation);
+  Permute(permutation, &arc_lengths);
+  GenericDijkstra<Graph> dijkstra(&graph, &arc_lengths);
+  CHECK(dijkstra.Run(0, -1));
+  CHECK_EQ(0, dijkstra.Distance(0));
+  CHECK_EQ(5, dijkstra.Distance(1));
+  CHECK_EQ(kInfinity, dijkstra.Distance(2));
+  CHECK_EQ(kInfinity - 1, dijkstra.Distance(3));
+  CHECK_EQ(kInfinity, dijkstra.Distance(4));
+  CHECK(!dijkstra.Run(0, 2));
+  CHECK(!dijkstra.Run(0, 4));
+  CHECK(dijkstra.Run(1, 4));
+  CHECK_EQ(kInfinity - 5, dijkstra.Distance(4));
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestRandomGraphs<operations_research::StaticGraph<> >();
+  operations_research::TestRandomGraphs<
+      operations_research::ReverseArcStaticGraph<> >();
+  operations_research::TestLargeLengths();
+  operations_research::TestManyToMany<operations_research::StaticGraph<> >();
+  operations_research::TestManyToMany<
+      operations_research::ReverseArcStaticGraph<> >();
+  return 0;
+}
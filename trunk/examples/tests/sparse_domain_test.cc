@@ -0,0 +1,360 @@
+// Copyright 2011-2012 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the domains of variables with a huge range, which store their holes
+// as intervals, against an oracle under random removals and backtracks, and
+// the memory used by such a domain.
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "base/commandlineflags.h"
+#include "base/integral_types.h"
+#include "base/logging.h"
+#include "base/random.h"
+#include "constraint_solver/constraint_solver.h"
+#include "constraint_solver/constraint_solveri.h"
+
+DEFINE_int32(seed, 1, "Random seed");
+DEFINE_int32(depth, 4, "Depth of the nested searches");
+DEFINE_int32(operations, 20, "Number of operations per search node");
+
+namespace operations_research {
+
+// The domain of a variable: the values of [min, max] not in removed.
+struct DomainOracle {
+  int64 min;
+  int64 max;
+  std::set<int64> removed;
+
+  bool Contains(int64 value) const {
+    return value >= min && value <= max && removed.count(value) == 0;
+  }
+  int64 Size() const {
+    int64 size = max - min + 1;
+    for (std::set<int64>::const_iterator it = removed.lower_bound(min);
+         it != removed.end() && *it <= max; ++it) {
+      --size;
+    }
+    return size;
+  }
+  int64 NextValue(int64 value) const {
+    while (removed.count(value) != 0) ++value;
+    return value;
+  }
+  int64 PreviousValue(int64 value) const {
+    while (removed.count(value) != 0) --value;
+    return value;
+  }
+};
+
+void CheckDomain(IntVar* const var, const DomainOracle& oracle,
+                 ACMRandom* const rgen) {
+  CHECK_EQ(oracle.min, var->Min());
+  CHECK_EQ(oracle.max, var->Max());
+  CHECK_EQ(oracle.Size(), var->Size());
+  for (std::set<int64>::const_iterator it = oracle.removed.begin();
+       it != oracle.removed.end(); ++it) {
+    for (int64 value = *it - 1; value <= *it + 1; ++value) {
+      CHECK_EQ(oracle.Contains(value), var->Contains(value)) << value;
+    }
+  }
+  for (int i = 0; i < 10; ++i) {
+    const int64 value = oracle.min + rgen->Uniform(1000);
+    CHECK_EQ(oracle.Contains(value), var->Contains(value)) << value;
+  }
+}
+
+// Applies random operations to a variable and to its oracle, then checks
+// that nested searches leave the domain unchanged when they backtrack.
+class RandomDomainOperations : public DecisionBuilder {
+ public:
+  RandomDomainOperations(IntVar* const var, const DomainOracle& oracle,
+                         int depth, ACMRandom* const rgen)
+      : var_(var), oracle_(oracle), depth_(depth), rgen_(rgen) {}
+  virtual ~RandomDomainOperations() {}
+
+  virtual Decision* Next(Solver* const s) {
+    for (int i = 0; i < FLAGS_operations; ++i) {
+      ApplyRandomOperation();
+      CheckDomain(var_, oracle_, rgen_);
+    }
+    if (depth_ < FLAGS_depth) {
+      for (int i = 0; i < 2; ++i) {
+        s->Solve(s->RevAlloc(
+            new RandomDomainOperations(var_, oracle_, depth_ + 1, rgen_)));
+        CheckDomain(var_, oracle_, rgen_);
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  // Values are drawn close to the min so that holes are often adjacent.
+  int64 RandomValue() { return oracle_.min + rgen_->Uniform(200); }
+
+  void ApplyRandomOperation() {
+    if (oracle_.Size() < 50) return;
+    switch (rgen_->Uniform(5)) {
+      case 0: {
+        const int64 value = RandomValue();
+        var_->RemoveValue(value);
+        oracle_.removed.insert(value);
+        break;
+      }
+      case 1: {
+        const int64 start = RandomValue();
+        const int64 end = start + rgen_->Uniform(10);
+        var_->RemoveInterval(start, end);
+        for (int64 value = start; value <= end; ++value) {
+          oracle_.removed.insert(value);
+        }
+        break;
+      }
+      case 2: {
+        const int64 new_min = oracle_.min + rgen_->Uniform(5);
+        var_->SetMin(new_min);
+        oracle_.min = new_min;
+        break;
+      }
+      case 3: {
+        const int64 new_max = oracle_.max - rgen_->Uniform(5);
+        var_->SetMax(new_max);
+        oracle_.max = new_max;
+        break;
+      }
+      case 4: {
+        std::vector<int64> values;
+        for (int i = 0; i < 5; ++i) {
+          values.push_back(RandomValue());
+        }
+        var_->RemoveValues(values);
+        oracle_.removed.insert(values.begin(), values.end());
+        break;
+      }
+    }
+    oracle_.min = oracle_.NextValue(oracle_.min);
+    oracle_.max = oracle_.PreviousValue(oracle_.max);
+  }
+
+  IntVar* const var_;
+  DomainOracle oracle_;
+  const int depth_;
+  ACMRandom* const rgen_;
+};
+
+void TestHugeRange(int64 min, int64 max) {
+  LOG(INFO) << "TestHugeRange(" << min << ", " << max << ")";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestHugeRange");
+  IntVar* const var = solver.MakeIntVar(min, max, "var");
+  DomainOracle oracle;
+  oracle.min = min;
+  oracle.max = max;
+  CHECK(solver.Solve(
+      solver.RevAlloc(new RandomDomainOperations(var, oracle, 0, &rgen))));
+  CheckDomain(var, oracle, &rgen);
+}
+
+// Removes 'num_holes' values, one every 'step' values after 'start', then
+// applies random operations in nested searches if 'rgen' is not nullptr.
+class RemoveEvenlySpacedValues : public DecisionBuilder {
+ public:
+  RemoveEvenlySpacedValues(IntVar* const var, const DomainOracle& oracle,
+                           int64 start, int64 step, int num_holes,
+                           ACMRandom* const rgen)
+      : var_(var),
+        oracle_(oracle),
+        start_(start),
+        step_(step),
+        num_holes_(num_holes),
+        rgen_(rgen),
+        memory_usage_(0) {}
+  virtual ~RemoveEvenlySpacedValues() {}
+
+  virtual Decision* Next(Solver* const s) {
+    for (int i = 0; i < num_holes_; ++i) {
+      const int64 value = start_ + i * step_;
+      var_->RemoveValue(value);
+      oracle_.removed.insert(value);
+    }
+    memory_usage_ = Solver::MemoryUsage();
+    if (rgen_ != nullptr) {
+      CheckDomain(var_, oracle_, rgen_);
+      s->Solve(s->RevAlloc(
+          new RandomDomainOperations(var_, oracle_, 0, rgen_)));
+      CheckDomain(var_, oracle_, rgen_);
+    }
+    return nullptr;
+  }
+
+  // The memory used by the process once the values are removed.
+  int64 memory_usage() const { return memory_usage_; }
+
+ private:
+  IntVar* const var_;
+  DomainOracle oracle_;
+  const int64 start_;
+  const int64 step_;
+  const int num_holes_;
+  ACMRandom* const rgen_;
+  int64 memory_usage_;
+};
+
+// A domain whose holes become dense is stored in a bitset from then on; the
+// domain is the same before and after, and after backtracking.
+void TestDenseHoles() {
+  LOG(INFO) << "TestDenseHoles";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestDenseHoles");
+  DomainOracle oracle;
+  oracle.min = 0;
+  oracle.max = 1 << 20;
+  IntVar* const var = solver.MakeIntVar(oracle.min, oracle.max, "var");
+  // One hole every other value on 20000 values: more than one hole per 128
+  // values of the range.
+  CHECK(solver.Solve(solver.RevAlloc(
+      new RemoveEvenlySpacedValues(var, oracle, 1000, 2, 10000, &rgen))));
+  CheckDomain(var, oracle, &rgen);
+}
+
+// Removing many values from a domain of 10^9 values keeps it sparse: it uses
+// much less memory than a bitset of its range.
+void TestSparseMemory() {
+  LOG(INFO) << "TestSparseMemory";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestSparseMemory");
+  DomainOracle oracle;
+  oracle.min = 0;
+  oracle.max = 1000000000;
+  IntVar* const var = solver.MakeIntVar(oracle.min, oracle.max, "var");
+  const int64 memory = Solver::MemoryUsage();
+  // A bitset of the range would take 250MB.
+  const int64 kMaxMemory = 16 << 20;
+  for (int i = 0; i < 5; ++i) {
+    RemoveEvenlySpacedValues* const remove =
+        solver.RevAlloc(new RemoveEvenlySpacedValues(var, oracle, 1 + i, 5000,
+                                                     100000, nullptr));
+    CHECK(solver.Solve(remove));
+    CHECK_LT(remove->memory_usage() - memory, kMaxMemory);
+    CheckDomain(var, oracle, &rgen);
+  }
+}
+
+// Removes intervals of values from a variable, and counts the values
+// reported by its hole iterator on each domain event.
+class HoleCounter : public Constraint {
+ public:
+  HoleCounter(Solver* const s, IntVar* const var,
+              const std::vector<std::pair<int64, int64> >& intervals)
+      : Constraint(s),
+        var_(var),
+        intervals_(intervals),
+        iterator_(var->MakeHoleIterator(true)),
+        num_holes_(0),
+        memory_usage_(0) {}
+  virtual ~HoleCounter() {}
+
+  virtual void Post() {
+    var_->WhenDomain(
+        MakeConstraintDemon0(solver(), this, &HoleCounter::CountHoles,
+                             "CountHoles"));
+  }
+
+  virtual void InitialPropagate() {
+    for (int i = 0; i < intervals_.size(); ++i) {
+      var_->RemoveInterval(intervals_[i].first, intervals_[i].second);
+    }
+  }
+
+  void CountHoles() {
+    memory_usage_ = std::max(memory_usage_, Solver::MemoryUsage());
+    for (iterator_->Init(); iterator_->Ok(); iterator_->Next()) {
+      CHECK(!var_->Contains(iterator_->Value())) << iterator_->Value();
+      ++num_holes_;
+    }
+  }
+
+  int64 num_holes() const { return num_holes_; }
+  // The maximum memory used by the process on a domain event.
+  int64 memory_usage() const { return memory_usage_; }
+
+ private:
+  IntVar* const var_;
+  const std::vector<std::pair<int64, int64> > intervals_;
+  IntVarIterator* const iterator_;
+  int64 num_holes_;
+  int64 memory_usage_;
+};
+
+// Removing a huge interval of values is recorded as one interval of holes,
+// whose values are still all visited by the hole iterator.
+void TestHoleIntervals() {
+  LOG(INFO) << "TestHoleIntervals";
+  Solver solver("TestHoleIntervals");
+  IntVar* const var = solver.MakeIntVar(0, 1000000000, "var");
+  std::vector<std::pair<int64, int64> > intervals;
+  intervals.push_back(std::make_pair(10, 20));
+  intervals.push_back(std::make_pair(21, 30));
+  intervals.push_back(std::make_pair(50, 50));
+  intervals.push_back(std::make_pair(1000, 100000999));
+  const int64 num_removed = 100000022;
+  HoleCounter* const counter =
+      solver.RevAlloc(new HoleCounter(&solver, var, intervals));
+  const int64 memory = Solver::MemoryUsage();
+  CHECK(solver.Solve(solver.MakeConstraintAdder(counter)));
+  CHECK_EQ(num_removed, counter->num_holes());
+  // One hole per value would take 800MB.
+  const int64 kMaxMemory = 16 << 20;
+  CHECK_LT(counter->memory_usage() - memory, kMaxMemory);
+}
+
+void TestValueList() {
+  LOG(INFO) << "TestValueList";
+  ACMRandom rgen(FLAGS_seed);
+  Solver solver("TestValueList");
+  // A list of values with a large range and a few gaps.
+  std::vector<int64> values;
+  DomainOracle oracle;
+  oracle.min = 0;
+  oracle.max = (1 << 21) - 1;
+  for (int64 value = oracle.min; value <= oracle.max; ++value) {
+    if (value % 100000 == 50) {
+      oracle.removed.insert(value);
+    } else {
+      values.push_back(value);
+    }
+  }
+  IntVar* const var = solver.MakeIntVar(values, "var");
+  CheckDomain(var, oracle, &rgen);
+  CHECK(solver.Solve(
+      solver.RevAlloc(new RandomDomainOperations(var, oracle, 0, &rgen))));
+  CheckDomain(var, oracle, &rgen);
+}
+}  // namespace operations_research
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  operations_research::TestHugeRange(0, 5000000000LL);
+  operations_research::TestHugeRange(-5000000000LL, 5000000000LL);
+  operations_research::TestHugeRange(0, 1 << 21);
+  // Below 2^20 values, the domain is stored in a bitset.
+  operations_research::TestHugeRange(0, 1 << 19);
+  operations_research::TestValueList();
+  operations_research::TestDenseHoles();
+  operations_research::TestSparseMemory();
+  operations_research::TestHoleIntervals();
+  return 0;
+}
@@ -300,6 +300,24 @@ clean_cc:
 	-$(DEL) $(BIN_DIR)$Sfz$E
 	-$(DEL) $(BIN_DIR)$Ssat_runner$E
 	-$(DEL) $(BIN_DIR)$Smtsearch_test$E
+	-$(DEL) $(BIN_DIR)$Sgls_penalties_test$E
+	-$(DEL) $(BIN_DIR)$Sbandit_operator_test$E
+	-$(DEL) $(BIN_DIR)$Sassignment_container_test$E
+	-$(DEL) $(BIN_DIR)$Sarena_allocator_test$E
+	-$(DEL) $(BIN_DIR)$Ssat_clause_arena_test$E
+	-$(DEL) $(BIN_DIR)$Spath_cumul_filter_test$E
+	-$(DEL) $(BIN_DIR)$Sgranular_operators_test$E
+	-$(DEL) $(BIN_DIR)$Sshortestpaths_test$E
+	-$(DEL) $(BIN_DIR)$Scumulative_test$E
+	-$(DEL) $(BIN_DIR)$Sdiffn_test$E
+	-$(DEL) $(BIN_DIR)$Salldiff_test$E
+	-$(DEL) $(BIN_DIR)$Ssat_presolve_test$E
+	-$(DEL) $(BIN_DIR)$Sfast_compression_test$E
+	-$(DEL) $(BIN_DIR)$Slong_sum_test$E
+	-$(DEL) $(BIN_DIR)$Snogoods_test$E
+	-$(DEL) $(BIN_DIR)$Sls_replicas_test$E
+	-$(DEL) $(BIN_DIR)$Srouting_test$E
+	-$(DEL) $(BIN_DIR)$Ssparse_domain_test$E
 	-$(DEL) $(CPBINARIES)
 	-$(DEL) $(LPBINARIES)
 	-$(DEL) $(GEN_DIR)$Sconstraint_solver$S*.pb.*
@@ -604,6 +622,7 @@ endif
 UTIL_LIB_OBJS=\
 	$(OBJ_DIR)/util/bitset.$O \
 	$(OBJ_DIR)/util/cached_log.$O \
+	$(OBJ_DIR)/util/fast_compression.$O \
 	$(OBJ_DIR)/util/graph_export.$O \
 	$(OBJ_DIR)/util/piecewise_linear_function.$O \
 	$(OBJ_DIR)/util/saturated_arithmetic.$O \
@@ -617,6 +636,9 @@ $(OBJ_DIR)/util/bitset.$O:$(SRC_DIR)/util/bitset.cc
 $(OBJ_DIR)/util/cached_log.$O:$(SRC_DIR)/util/cached_log.cc
 	$(CCC) $(CFLAGS) -c $(SRC_DIR)/util/cached_log.cc $(OBJ_OUT)$(OBJ_DIR)$Sutil$Scached_log.$O
 
+$(OBJ_DIR)/util/fast_compression.$O:$(SRC_DIR)/util/fast_compression.cc
+	$(CCC) $(CFLAGS) -c $(SRC_DIR)/util/fast_compression.cc $(OBJ_OUT)$(OBJ_DIR)$Sutil$Sfast_compression.$O
+
 $(OBJ_DIR)/util/graph_export.$O:$(SRC_DIR)/util/graph_export.cc
 	$(CCC) $(CFLAGS) -c $(SRC_DIR)/util/graph_export.cc $(OBJ_OUT)$(OBJ_DIR)$Sutil$Sgraph_export.$O
 
@@ -1160,6 +1182,114 @@ $(OBJ_DIR)/boolean_test.$O:$(EX_DIR)/tests/boolean_test.cc $(SRC_DIR)/constraint
 $(BIN_DIR)/boolean_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/boolean_test.$O
 	$(CCC) $(CFLAGS) $(OBJ_DIR)/boolean_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sboolean_test$E
 
+$(OBJ_DIR)/sparse_domain_test.$O:$(EX_DIR)/tests/sparse_domain_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/sparse_domain_test.cc $(OBJ_OUT)$(OBJ_DIR)$Ssparse_domain_test.$O
+
+$(BIN_DIR)/sparse_domain_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/sparse_domain_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/sparse_domain_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Ssparse_domain_test$E
+
+$(OBJ_DIR)/routing_test.$O:$(EX_DIR)/tests/routing_test.cc $(SRC_DIR)/constraint_solver/routing.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/routing_test.cc $(OBJ_OUT)$(OBJ_DIR)$Srouting_test.$O
+
+$(BIN_DIR)/routing_test$E: $(DYNAMIC_ROUTING_DEPS) $(OBJ_DIR)/routing_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/routing_test.$O $(DYNAMIC_ROUTING_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Srouting_test$E
+
+$(OBJ_DIR)/ls_replicas_test.$O:$(EX_DIR)/tests/ls_replicas_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/ls_replicas_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sls_replicas_test.$O
+
+$(BIN_DIR)/ls_replicas_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/ls_replicas_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/ls_replicas_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sls_replicas_test$E
+
+$(OBJ_DIR)/nogoods_test.$O:$(EX_DIR)/tests/nogoods_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/nogoods_test.cc $(OBJ_OUT)$(OBJ_DIR)$Snogoods_test.$O
+
+$(BIN_DIR)/nogoods_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/nogoods_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/nogoods_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Snogoods_test$E
+
+$(OBJ_DIR)/long_sum_test.$O:$(EX_DIR)/tests/long_sum_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/long_sum_test.cc $(OBJ_OUT)$(OBJ_DIR)$Slong_sum_test.$O
+
+$(BIN_DIR)/long_sum_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/long_sum_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/long_sum_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Slong_sum_test$E
+
+$(OBJ_DIR)/fast_compression_test.$O:$(EX_DIR)/tests/fast_compression_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/fast_compression_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sfast_compression_test.$O
+
+$(BIN_DIR)/fast_compression_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/fast_compression_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/fast_compression_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sfast_compression_test$E
+
+$(OBJ_DIR)/sat_presolve_test.$O:$(EX_DIR)/tests/sat_presolve_test.cc $(SRC_DIR)/sat/sat_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/sat_presolve_test.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat_presolve_test.$O
+
+$(BIN_DIR)/sat_presolve_test$E: $(DYNAMIC_SAT_DEPS) $(OBJ_DIR)/sat_presolve_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/sat_presolve_test.$O $(DYNAMIC_SAT_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Ssat_presolve_test$E
+
+$(OBJ_DIR)/alldiff_test.$O:$(EX_DIR)/tests/alldiff_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/alldiff_test.cc $(OBJ_OUT)$(OBJ_DIR)$Salldiff_test.$O
+
+$(BIN_DIR)/alldiff_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/alldiff_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/alldiff_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Salldiff_test$E
+
+$(OBJ_DIR)/diffn_test.$O:$(EX_DIR)/tests/diffn_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/diffn_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sdiffn_test.$O
+
+$(BIN_DIR)/diffn_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/diffn_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/diffn_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sdiffn_test$E
+
+$(OBJ_DIR)/cumulative_test.$O:$(EX_DIR)/tests/cumulative_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/cumulative_test.cc $(OBJ_OUT)$(OBJ_DIR)$Scumulative_test.$O
+
+$(BIN_DIR)/cumulative_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/cumulative_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/cumulative_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Scumulative_test$E
+
+$(OBJ_DIR)/shortestpaths_test.$O:$(EX_DIR)/tests/shortestpaths_test.cc $(SRC_DIR)/graph/shortestpaths.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/shortestpaths_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sshortestpaths_test.$O
+
+$(BIN_DIR)/shortestpaths_test$E: $(DYNAMIC_GRAPH_DEPS) $(OBJ_DIR)/shortestpaths_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/shortestpaths_test.$O $(DYNAMIC_GRAPH_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sshortestpaths_test$E
+
+$(OBJ_DIR)/granular_operators_test.$O:$(EX_DIR)/tests/granular_operators_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/granular_operators_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sgranular_operators_test.$O
+
+$(BIN_DIR)/granular_operators_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/granular_operators_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/granular_operators_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sgranular_operators_test$E
+
+$(OBJ_DIR)/path_cumul_filter_test.$O:$(EX_DIR)/tests/path_cumul_filter_test.cc $(SRC_DIR)/constraint_solver/routing.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/path_cumul_filter_test.cc $(OBJ_OUT)$(OBJ_DIR)$Spath_cumul_filter_test.$O
+
+$(BIN_DIR)/path_cumul_filter_test$E: $(DYNAMIC_ROUTING_DEPS) $(OBJ_DIR)/path_cumul_filter_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/path_cumul_filter_test.$O $(DYNAMIC_ROUTING_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Spath_cumul_filter_test$E
+
+$(OBJ_DIR)/sat_clause_arena_test.$O:$(EX_DIR)/tests/sat_clause_arena_test.cc $(SRC_DIR)/sat/sat_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/sat_clause_arena_test.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat_clause_arena_test.$O
+
+$(BIN_DIR)/sat_clause_arena_test$E: $(DYNAMIC_SAT_DEPS) $(OBJ_DIR)/sat_clause_arena_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/sat_clause_arena_test.$O $(DYNAMIC_SAT_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Ssat_clause_arena_test$E
+
+$(OBJ_DIR)/arena_allocator_test.$O:$(EX_DIR)/tests/arena_allocator_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/arena_allocator_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sarena_allocator_test.$O
+
+$(BIN_DIR)/arena_allocator_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/arena_allocator_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/arena_allocator_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sarena_allocator_test$E
+
+$(OBJ_DIR)/assignment_container_test.$O:$(EX_DIR)/tests/assignment_container_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/assignment_container_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sassignment_container_test.$O
+
+$(BIN_DIR)/assignment_container_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/assignment_container_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/assignment_container_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sassignment_container_test$E
+
+$(OBJ_DIR)/bandit_operator_test.$O:$(EX_DIR)/tests/bandit_operator_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/bandit_operator_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sbandit_operator_test.$O
+
+$(BIN_DIR)/bandit_operator_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/bandit_operator_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/bandit_operator_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sbandit_operator_test$E
+
+$(OBJ_DIR)/gls_penalties_test.$O:$(EX_DIR)/tests/gls_penalties_test.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
+	$(CCC) $(CFLAGS) -c $(EX_DIR)$Stests/gls_penalties_test.cc $(OBJ_OUT)$(OBJ_DIR)$Sgls_penalties_test.$O
+
+$(BIN_DIR)/gls_penalties_test$E: $(DYNAMIC_CP_DEPS) $(OBJ_DIR)/gls_penalties_test.$O
+	$(CCC) $(CFLAGS) $(OBJ_DIR)/gls_penalties_test.$O $(DYNAMIC_CP_LNK) $(DYNAMIC_LD_FLAGS) $(EXE_OUT)$(BIN_DIR)$Sgls_penalties_test$E
+
 $(OBJ_DIR)/ls_api.$O:$(EX_DIR)/cpp/ls_api.cc $(SRC_DIR)/constraint_solver/constraint_solver.h
 	$(CCC) $(CFLAGS) -c $(EX_DIR)$Scpp/ls_api.cc $(OBJ_OUT)$(OBJ_DIR)$Sls_api.$O
 
@@ -1217,6 +1347,7 @@ SAT_LIB_OBJS = \
 	$(OBJ_DIR)/sat/pb_constraint.$O\
 	$(OBJ_DIR)/sat/sat_parameters.pb.$O\
 	$(OBJ_DIR)/sat/sat_solver.$O\
+	$(OBJ_DIR)/sat/simplification.$O\
 	$(OBJ_DIR)/sat/symmetry.$O\
 	$(OBJ_DIR)/sat/unsat_proof.$O
 
@@ -1245,6 +1376,9 @@ $(OBJ_DIR)/sat/clause.$O: $(SRC_DIR)/sat/clause.cc $(SRC_DIR)/sat/sat_base.h $(S
 $(OBJ_DIR)/sat/unsat_proof.$O: $(SRC_DIR)/sat/unsat_proof.cc $(SRC_DIR)/sat/sat_base.h $(SRC_DIR)/sat/unsat_proof.h
 	$(CCC) $(CFLAGS) -c $(SRC_DIR)/sat/unsat_proof.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat$Sunsat_proof.$O
 
+$(OBJ_DIR)/sat/simplification.$O: $(SRC_DIR)/sat/simplification.cc $(SRC_DIR)/sat/simplification.h $(SRC_DIR)/sat/sat_base.h $(SRC_DIR)/sat/sat_solver.h $(SRC_DIR)/sat/boolean_problem.h $(GEN_DIR)/sat/boolean_problem.pb.h $(GEN_DIR)/sat/sat_parameters.pb.h
+	$(CCC) $(CFLAGS) -c $(SRC_DIR)/sat/simplification.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat$Ssimplification.$O
+
 $(OBJ_DIR)/sat/symmetry.$O: $(SRC_DIR)/sat/symmetry.cc $(SRC_DIR)/sat/sat_base.h $(SRC_DIR)/sat/symmetry.h $(SRC_DIR)/sat/clause.h $(SRC_DIR)/sat/unsat_proof.h $(GEN_DIR)/sat/sat_parameters.pb.h
 	$(CCC) $(CFLAGS) -c $(SRC_DIR)/sat/symmetry.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat$Ssymmetry.$O
 
@@ -1264,7 +1398,7 @@ $(LIB_DIR)/$(LIBPREFIX)sat.$(STATIC_LIB_SUFFIX): $(SAT_LIB_OBJS)
 	$(STATIC_LINK_CMD) $(STATIC_LINK_PREFIX)$(LIB_DIR)$S$(LIBPREFIX)sat.$(STATIC_LIB_SUFFIX) $(SAT_LIB_OBJS)
 endif
 
-$(OBJ_DIR)/sat/sat_runner.$O:$(EX_DIR)/cpp/sat_runner.cc $(SRC_DIR)/sat/sat_solver.h $(EX_DIR)/cpp/opb_reader.h $(EX_DIR)/cpp/sat_cnf_reader.h $(GEN_DIR)/sat/sat_parameters.pb.h  $(GEN_DIR)/sat/boolean_problem.pb.h  $(SRC_DIR)/sat/boolean_problem.h  $(SRC_DIR)/sat/sat_base.h
+$(OBJ_DIR)/sat/sat_runner.$O:$(EX_DIR)/cpp/sat_runner.cc $(SRC_DIR)/sat/sat_solver.h $(EX_DIR)/cpp/opb_reader.h $(EX_DIR)/cpp/sat_cnf_reader.h $(GEN_DIR)/sat/sat_parameters.pb.h  $(GEN_DIR)/sat/boolean_problem.pb.h  $(SRC_DIR)/sat/boolean_problem.h  $(SRC_DIR)/sat/sat_base.h $(SRC_DIR)/sat/simplification.h
 	$(CCC) $(CFLAGS) -c $(EX_DIR)$Scpp$Ssat_runner.cc $(OBJ_OUT)$(OBJ_DIR)$Ssat$Ssat_runner.$O
 
 $(BIN_DIR)/sat_runner$E: $(DYNAMIC_SAT_DEPS) $(OBJ_DIR)/sat/sat_runner.$O
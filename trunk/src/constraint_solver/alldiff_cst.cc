@@ -422,6 +422,354 @@ class BoundsAllDifferent : public BaseAllDifferent {
   RangeBipartiteMatching matching_;
 };
 
+// ---------- Domain All Different ----------
+// Maximum sum of the sizes of the domains for the domain consistent
+// propagation.
+const int64 kMaxDomainAllDifferentSize = 1 << 24;
+
+// Domain consistent propagation, see "A filtering algorithm for constraints
+// of difference in CSPs", J-C. Regin, AAAI 1994.
+//
+// The variables are matched to distinct values by a maximum bipartite
+// matching. A value of a variable belongs to a solution iff it is the matched
+// value of the variable, or it lies on an even alternating path starting at a
+// free value, or on an alternating cycle. Alternating paths and cycles are
+// found on the graph whose nodes are the values, with an arc from v to the
+// matched value of each variable whose domain contains v: the values
+// reachable from a free value, and the strongly connected components.
+//
+// The matching is not reversible: as domains only grow on backtrack, a
+// matching stays valid in the ancestors of the node where it was computed.
+// Each propagation only repairs it, with augmenting paths for the variables
+// whose matched value has been removed.
+
+class DomainAllDifferent : public BaseAllDifferent {
+ public:
+  DomainAllDifferent(Solver* const s, const std::vector<IntVar*>& vars)
+      : BaseAllDifferent(s, vars),
+        iterators_(vars.size()),
+        min_value_(0),
+        stamp_(0) {
+    for (int i = 0; i < size(); ++i) {
+      iterators_[i] = vars_[i]->MakeDomainIterator(true);
+    }
+  }
+
+  virtual ~DomainAllDifferent() {}
+
+  virtual void Post() {
+    Demon* const demon = MakeDelayedConstraintDemon0(
+        solver(), this, &DomainAllDifferent::Propagate, "Propagate");
+    for (int i = 0; i < size(); ++i) {
+      vars_[i]->WhenDomain(demon);
+      Demon* const bound = MakeConstraintDemon1(
+          solver(), this, &DomainAllDifferent::PropagateValue,
+          "PropagateValue", i);
+      vars_[i]->WhenBound(bound);
+    }
+  }
+
+  virtual void InitialPropagate() {
+    for (int i = 0; i < size(); ++i) {
+      if (vars_[i]->Bound()) {
+        PropagateValue(i);
+      }
+    }
+    BuildValues();
+    matched_value_.assign(size(), -1);
+    matched_var_.assign(values_.size(), -1);
+    Propagate();
+  }
+
+  void Propagate() {
+    BuildDomains();
+    // Repairs the matching.
+    for (int i = 0; i < size(); ++i) {
+      const int value = matched_value_[i];
+      if (value != -1 && !vars_[i]->Contains(values_[value])) {
+        matched_var_[value] = -1;
+        matched_value_[i] = -1;
+      }
+    }
+    for (int i = 0; i < size(); ++i) {
+      if (matched_value_[i] == -1 && !Augment(i)) {
+        solver()->Fail();
+      }
+    }
+    BuildValueGraph();
+    MarkValuesReachableFromFreeValues();
+    ComputeComponents();
+    // Removes the values that do not belong to any solution.
+    for (int i = 0; i < size(); ++i) {
+      const int matched_component = components_[matched_value_[i]];
+      to_remove_.clear();
+      for (int k = domain_starts_[i]; k < domain_starts_[i + 1]; ++k) {
+        const int value = domains_[k];
+        if (!reachable_[value] && components_[value] != matched_component) {
+          to_remove_.push_back(values_[value]);
+        }
+      }
+      if (!to_remove_.empty()) {
+        vars_[i]->RemoveValues(to_remove_);
+      }
+    }
+  }
+
+  void PropagateValue(int index) {
+    const int64 to_remove = vars_[index]->Value();
+    for (int j = 0; j < size(); j++) {
+      if (j != index) {
+        vars_[j]->RemoveValue(to_remove);
+      }
+    }
+  }
+
+  virtual std::string DebugString() const {
+    return DebugStringInternal("DomainAllDifferent");
+  }
+
+  virtual void Accept(ModelVisitor* const visitor) const {
+    visitor->BeginVisitConstraint(ModelVisitor::kAllDifferent, this);
+    visitor->VisitIntegerVariableArrayArgument(ModelVisitor::kVarsArgument,
+                                               vars_);
+    visitor->VisitIntegerArgument(ModelVisitor::kRangeArgument, 2);
+    visitor->EndVisitConstraint(ModelVisitor::kAllDifferent, this);
+  }
+
+ private:
+  // Collects the values of the initial domains, which contain all the values
+  // the constraint will ever see.
+  void BuildValues() {
+    values_.clear();
+    for (int i = 0; i < size(); ++i) {
+      IntVarIterator* const it = iterators_[i];
+      for (it->Init(); it->Ok(); it->Next()) {
+        values_.push_back(it->Value());
+      }
+    }
+    std::sort(values_.begin(), values_.end());
+    values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+    value_indices_.clear();
+    if (values_.empty()) {
+      return;
+    }
+    min_value_ = values_.front();
+    // Uses a direct table when it is not too sparse, and a binary search in
+    // values_ otherwise.
+    const uint64 range =
+        static_cast<uint64>(values_.back()) - static_cast<uint64>(min_value_);
+    if (range < 2 * values_.size()) {
+      value_indices_.resize(range + 1, -1);
+      for (int i = 0; i < values_.size(); ++i) {
+        value_indices_[values_[i] - min_value_] = i;
+      }
+    }
+  }
+
+  int ValueIndex(int64 value) const {
+    if (!value_indices_.empty()) {
+      return value_indices_[value - min_value_];
+    }
+    return std::lower_bound(values_.begin(), values_.end(), value) -
+           values_.begin();
+  }
+
+  // Copies the current domains, as indices of values, to domains_.
+  void BuildDomains() {
+    domain_starts_.resize(size() + 1);
+    domains_.clear();
+    for (int i = 0; i < size(); ++i) {
+      domain_starts_[i] = domains_.size();
+      IntVarIterator* const it = iterators_[i];
+      for (it->Init(); it->Ok(); it->Next()) {
+        domains_.push_back(ValueIndex(it->Value()));
+      }
+    }
+    domain_starts_[size()] = domains_.size();
+  }
+
+  // Looks for an augmenting path starting at the given unmatched variable
+  // with a breadth-first search, and applies it if there is one.
+  bool Augment(int var) {
+    NewStamp();
+    parents_.resize(values_.size());
+    queue_.clear();
+    queue_.push_back(var);
+    for (int head = 0; head < queue_.size(); ++head) {
+      const int current = queue_[head];
+      for (int k = domain_starts_[current]; k < domain_starts_[current + 1];
+           ++k) {
+        int value = domains_[k];
+        if (stamps_[value] == stamp_) {
+          continue;
+        }
+        stamps_[value] = stamp_;
+        parents_[value] = current;
+        if (matched_var_[value] == -1) {
+          // Flips the path.
+          for (;;) {
+            const int parent = parents_[value];
+            const int previous_value = matched_value_[parent];
+            matched_value_[parent] = value;
+            matched_var_[value] = parent;
+            if (parent == var) {
+              return true;
+            }
+            value = previous_value;
+          }
+        }
+        queue_.push_back(matched_var_[value]);
+      }
+    }
+    return false;
+  }
+
+  // Builds the arcs of the graph on the values, see above.
+  void BuildValueGraph() {
+    const int num_values = values_.size();
+    arc_starts_.assign(num_values + 1, 0);
+    for (int i = 0; i < size(); ++i) {
+      for (int k = domain_starts_[i]; k < domain_starts_[i + 1]; ++k) {
+        ++arc_starts_[domains_[k] + 1];
+      }
+    }
+    for (int value = 0; value < num_values; ++value) {
+      arc_starts_[value + 1] += arc_starts_[value];
+    }
+    arc_heads_.resize(domains_.size());
+    arc_positions_.assign(arc_starts_.begin(), arc_starts_.end() - 1);
+    for (int i = 0; i < size(); ++i) {
+      const int matched = matched_value_[i];
+      for (int k = domain_starts_[i]; k < domain_starts_[i + 1]; ++k) {
+        const int value = domains_[k];
+        if (value != matched) {
+          arc_heads_[arc_positions_[value]++] = matched;
+        }
+      }
+    }
+    // Only keeps the arcs which were filled.
+    arc_ends_.swap(arc_positions_);
+  }
+
+  void MarkValuesReachableFromFreeValues() {
+    const int num_values = values_.size();
+    reachable_.assign(num_values, false);
+    queue_.clear();
+    for (int value = 0; value < num_values; ++value) {
+      if (matched_var_[value] == -1) {
+        reachable_[value] = true;
+        queue_.push_back(value);
+      }
+    }
+    for (int head = 0; head < queue_.size(); ++head) {
+      const int value = queue_[head];
+      for (int k = arc_starts_[value]; k < arc_ends_[value]; ++k) {
+        const int next = arc_heads_[k];
+        if (!reachable_[next]) {
+          reachable_[next] = true;
+          queue_.push_back(next);
+        }
+      }
+    }
+  }
+
+  // Computes the strongly connected components of the graph on the values
+  // with an iterative version of Tarjan's algorithm. Only the values that are
+  // not reachable from a free value need a component.
+  void ComputeComponents() {
+    const int num_values = values_.size();
+    components_.assign(num_values, -1);
+    indices_.assign(num_values, -1);
+    low_links_.resize(num_values);
+    arc_positions_.resize(num_values);
+    tarjan_stack_.clear();
+    int next_index = 0;
+    int num_components = 0;
+    for (int root = 0; root < num_values; ++root) {
+      if (reachable_[root] || indices_[root] != -1) {
+        continue;
+      }
+      queue_.clear();  // Used as the DFS stack.
+      queue_.push_back(root);
+      indices_[root] = low_links_[root] = next_index++;
+      arc_positions_[root] = arc_starts_[root];
+      tarjan_stack_.push_back(root);
+      while (!queue_.empty()) {
+        const int value = queue_.back();
+        if (arc_positions_[value] < arc_ends_[value]) {
+          const int next = arc_heads_[arc_positions_[value]++];
+          if (reachable_[next]) {
+            continue;
+          }
+          if (indices_[next] == -1) {
+            indices_[next] = low_links_[next] = next_index++;
+            arc_positions_[next] = arc_starts_[next];
+            tarjan_stack_.push_back(next);
+            queue_.push_back(next);
+          } else if (components_[next] == -1) {
+            low_links_[value] = std::min(low_links_[value], indices_[next]);
+          }
+          continue;
+        }
+        queue_.pop_back();
+        if (!queue_.empty()) {
+          const int parent = queue_.back();
+          low_links_[parent] = std::min(low_links_[parent], low_links_[value]);
+        }
+        if (low_links_[value] == indices_[value]) {
+          int member;
+          do {
+            member = tarjan_stack_.back();
+            tarjan_stack_.pop_back();
+            components_[member] = num_components;
+          } while (member != value);
+          ++num_components;
+        }
+      }
+    }
+  }
+
+  void NewStamp() {
+    if (stamps_.size() != values_.size()) {
+      stamps_.assign(values_.size(), 0);
+      stamp_ = 0;
+    }
+    ++stamp_;
+  }
+
+  std::vector<IntVarIterator*> iterators_;
+  // The sorted values of the initial domains, and the table from value -
+  // min_value_ to the index of the value in values_, if not too sparse.
+  std::vector<int64> values_;
+  int64 min_value_;
+  std::vector<int> value_indices_;
+  // The matching, as the index of the value matched to each variable and the
+  // variable matched to each value, -1 if none.
+  std::vector<int> matched_value_;
+  std::vector<int> matched_var_;
+  // The current domains: the indices of the values of the variable i are in
+  // [domain_starts_[i], domain_starts_[i + 1]) of domains_.
+  std::vector<int> domain_starts_;
+  std::vector<int> domains_;
+  // The graph on the values: the arcs leaving the value v are in
+  // [arc_starts_[v], arc_ends_[v]) of arc_heads_.
+  std::vector<int> arc_starts_;
+  std::vector<int> arc_ends_;
+  std::vector<int> arc_heads_;
+  std::vector<int> arc_positions_;
+  std::vector<bool> reachable_;
+  std::vector<int> components_;
+  std::vector<int> indices_;
+  std::vector<int> low_links_;
+  std::vector<int> tarjan_stack_;
+  // Work data of the searches.
+  std::vector<int> queue_;
+  std::vector<int> parents_;
+  std::vector<uint64> stamps_;
+  uint64 stamp_;
+  std::vector<int64> to_remove_;
+};
+
 class SortConstraint : public Constraint {
  public:
   SortConstraint(Solver* const solver, const std::vector<IntVar*>& original_vars,
@@ -688,6 +1036,12 @@ Constraint* Solver::MakeAllDifferent(const std::vector<IntVar*>& vars) {
 
 Constraint* Solver::MakeAllDifferent(const std::vector<IntVar*>& vars,
                                      bool stronger_propagation) {
+  return MakeAllDifferent(
+      vars, stronger_propagation ? BOUNDS_CONSISTENCY : VALUE_CONSISTENCY);
+}
+
+Constraint* Solver::MakeAllDifferent(const std::vector<IntVar*>& vars,
+                                     AllDifferentConsistency consistency) {
   const int size = vars.size();
   for (int i = 0; i < size; ++i) {
     CHECK_EQ(this, vars[i]->solver());
@@ -698,11 +1052,26 @@ Constraint* Solver::MakeAllDifferent(const std::vector<IntVar*>& vars,
     return MakeNonEquality(const_cast<IntVar* const>(vars[0]),
                            const_cast<IntVar* const>(vars[1]));
   } else {
-    if (stronger_propagation) {
-      return RevAlloc(new BoundsAllDifferent(this, vars));
-    } else {
-      return RevAlloc(new ValueAllDifferent(this, vars));
+    switch (consistency) {
+      case VALUE_CONSISTENCY:
+        return RevAlloc(new ValueAllDifferent(this, vars));
+      case BOUNDS_CONSISTENCY:
+        return RevAlloc(new BoundsAllDifferent(this, vars));
+      case DOMAIN_CONSISTENCY: {
+        // The propagation copies the domains, it falls back to bounds
+        // consistency when they are too big.
+        int64 total_size = 0;
+        for (int i = 0; i < size; ++i) {
+          total_size += vars[i]->Size();
+        }
+        if (total_size > kMaxDomainAllDifferentSize) {
+          return RevAlloc(new BoundsAllDifferent(this, vars));
+        }
+        return RevAlloc(new DomainAllDifferent(this, vars));
+      }
     }
+    LOG(FATAL) << "Unknown consistency " << consistency;
+    return nullptr;
   }
 }
 
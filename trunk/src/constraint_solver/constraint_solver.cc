@@ -16,6 +16,7 @@
 
 #include "constraint_solver/constraint_solver.h"
 
+#include <algorithm>
 #include <csetjmp>
 #include <string>
 #include <iosfwd>
@@ -36,6 +37,7 @@
 #include "base/stl_util.h"
 #include "constraint_solver/constraint_solveri.h"
 #include "constraint_solver/model.pb.h"
+#include "util/fast_compression.h"
 #include "util/tuple_set.h"
 
 DEFINE_bool(cp_trace_propagation, false,
@@ -73,7 +75,8 @@ SolverParameters::SolverParameters()
       store_names(kDefaultNameStoring),
       profile_level(kDefaultProfileLevel),
       trace_level(kDefaultTraceLevel),
-      name_all_variables(kDefaultNameAllVariables) {}
+      name_all_variables(kDefaultNameAllVariables),
+      use_arena_allocator(kDefaultUseArenaAllocator) {}
 
 // ----- Forward Declarations and Profiling Support -----
 extern DemonProfiler* BuildDemonProfiler(Solver* const solver);
@@ -443,6 +446,9 @@ struct StateMarker {
   int rev_object_array_memory_index_;
   int rev_memory_index_;
   int rev_memory_array_index_;
+  int rev_arena_object_index_;
+  int arena_block_;
+  size_t arena_position_;
   StateInfo info_;
 };
 
@@ -460,6 +466,11 @@ StateMarker::StateMarker(Solver::MarkerType t, const StateInfo& info)
       rev_double_memory_index_(0),
       rev_object_memory_index_(0),
       rev_object_array_memory_index_(0),
+      rev_memory_index_(0),
+      rev_memory_array_index_(0),
+      rev_arena_object_index_(0),
+      arena_block_(-1),
+      arena_position_(0),
       info_(info) {}
 
 // ---------- Trail and Reversibility ----------
@@ -474,7 +485,10 @@ struct addrval {
  public:
   addrval() : address_(nullptr) {}
   explicit addrval(T* adr) : address_(adr), old_value_(*adr) {}
+  addrval(T* adr, T old_value) : address_(adr), old_value_(old_value) {}
   void restore() const { (*address_) = old_value_; }
+  T* address() const { return address_; }
+  const T& old_value() const { return old_value_; }
 
  private:
   T* address_;
@@ -562,6 +576,91 @@ class ZlibTrailPacker : public TrailPacker<T> {
   DISALLOW_COPY_AND_ASSIGN(ZlibTrailPacker<T>);
 };
 
+// Packs the blocks with FastCompress(). Consecutive entries of the trail
+// often save nearby addresses, so the addresses are delta encoded as zigzag
+// varints and stored after the values before compression. This is much
+// faster than zlib, for a slightly lower compression ratio.
+// The packed block starts with the size of the encoded block.
+template <class T>
+class FastTrailPacker : public TrailPacker<T> {
+ public:
+  explicit FastTrailPacker(int block_size)
+      : TrailPacker<T>(block_size),
+        block_size_(block_size),
+        encoded_(new char[MaxEncodedSize(block_size)]),
+        tmp_size_(FastCompressBound(MaxEncodedSize(block_size)) +
+                  sizeof(uint32)),
+        tmp_block_(new char[tmp_size_]) {}
+
+  virtual ~FastTrailPacker() {}
+
+  virtual void Pack(const addrval<T>* block, std::string* packed_block) {
+    DCHECK(block != nullptr);
+    DCHECK(packed_block != nullptr);
+    char* const values = encoded_.get();
+    uint8* delta = reinterpret_cast<uint8*>(values + block_size_ * sizeof(T));
+    uint64 previous = 0;
+    for (int i = 0; i < block_size_; ++i) {
+      memcpy(values + i * sizeof(T), &block[i].old_value(), sizeof(T));
+      const uint64 address = reinterpret_cast<uint64>(block[i].address());
+      const int64 difference = static_cast<int64>(address - previous);
+      previous = address;
+      uint64 zigzag = (static_cast<uint64>(difference) << 1) ^
+                      static_cast<uint64>(difference >> 63);
+      while (zigzag >= 0x80) {
+        *delta++ = static_cast<uint8>(zigzag) | 0x80;
+        zigzag >>= 7;
+      }
+      *delta++ = static_cast<uint8>(zigzag);
+    }
+    const uint32 encoded_size = reinterpret_cast<char*>(delta) - values;
+    memcpy(tmp_block_.get(), &encoded_size, sizeof(encoded_size));
+    const size_t size =
+        FastCompress(values, encoded_size, tmp_block_.get() + sizeof(uint32));
+    packed_block->assign(tmp_block_.get(), size + sizeof(uint32));
+  }
+
+  virtual void Unpack(const std::string& packed_block, addrval<T>* block) {
+    DCHECK(block != nullptr);
+    uint32 encoded_size = 0;
+    memcpy(&encoded_size, packed_block.data(), sizeof(encoded_size));
+    char* const values = encoded_.get();
+    CHECK(FastUncompress(packed_block.data() + sizeof(uint32),
+                         packed_block.size() - sizeof(uint32), values,
+                         encoded_size));
+    const uint8* delta =
+        reinterpret_cast<const uint8*>(values + block_size_ * sizeof(T));
+    uint64 address = 0;
+    for (int i = 0; i < block_size_; ++i) {
+      uint64 zigzag = 0;
+      int shift = 0;
+      uint8 byte;
+      do {
+        byte = *delta++;
+        zigzag |= static_cast<uint64>(byte & 0x7F) << shift;
+        shift += 7;
+      } while (byte & 0x80);
+      address += (zigzag >> 1) ^ -(zigzag & 1);
+      T value;
+      memcpy(&value, values + i * sizeof(T), sizeof(T));
+      block[i] = addrval<T>(reinterpret_cast<T*>(address), value);
+    }
+  }
+
+ private:
+  static const int kMaxVarintSize = 10;
+
+  static int MaxEncodedSize(int block_size) {
+    return block_size * (kMaxVarintSize + sizeof(T));
+  }
+
+  const int block_size_;
+  std::unique_ptr<char[]> encoded_;
+  const size_t tmp_size_;
+  std::unique_ptr<char[]> tmp_block_;
+  DISALLOW_COPY_AND_ASSIGN(FastTrailPacker<T>);
+};
+
 template <class T>
 class CompressedTrail {
  public:
@@ -584,6 +683,10 @@ class CompressedTrail {
         packer_.reset(new ZlibTrailPacker<T>(block_size));
         break;
       }
+      case SolverParameters::COMPRESS_WITH_FAST_LZ: {
+        packer_.reset(new FastTrailPacker<T>(block_size));
+        break;
+      }
     }
 
     // We zero all memory used by addrval arrays.
@@ -681,6 +784,93 @@ class CompressedTrail {
   int current_;
   int size_;
 };
+
+// ----- RevArena -----
+
+// A bump pointer allocator for reversible memory. The memory is allocated
+// in large blocks that are only freed when the arena is destroyed: restoring
+// a previous position releases in O(1) all the memory allocated since, and
+// the blocks are reused by the next allocations.
+class RevArena {
+ public:
+  RevArena() : current_block_(-1), position_(0) {}
+  ~RevArena() {
+    for (int i = 0; i < blocks_.size(); ++i) {
+      delete[] blocks_[i].memory;
+    }
+  }
+
+  void* Allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (current_block_ < 0 || position_ + size > blocks_[current_block_].size) {
+      NextBlock(size);
+    }
+    void* const ptr = blocks_[current_block_].memory + position_;
+    position_ += size;
+    return ptr;
+  }
+
+  int current_block() const { return current_block_; }
+  size_t position() const { return position_; }
+
+  // Returns true if 'ptr' points into one of the blocks of the arena.
+  bool Owns(const void* ptr) const {
+    const char* const address = static_cast<const char*>(ptr);
+    // The last block starting at or before 'address'.
+    std::vector<Block>::const_iterator block =
+        std::upper_bound(blocks_by_address_.begin(), blocks_by_address_.end(),
+                         address, StartsAfter);
+    if (block == blocks_by_address_.begin()) return false;
+    --block;
+    return address < block->memory + block->size;
+  }
+
+  void Restore(int block, size_t position) {
+    DCHECK_LE(block, current_block_);
+    current_block_ = block;
+    position_ = position;
+  }
+
+ private:
+  static const size_t kAlignment = 16;
+  static const size_t kBlockSize = 1 << 16;
+
+  struct Block {
+    char* memory;
+    size_t size;
+  };
+
+  static bool StartsAfter(const char* address, const Block& block) {
+    return address < block.memory;
+  }
+
+  // Moves to the next block, which is created if it doesn't exist or if it
+  // is too small.
+  void NextBlock(size_t size) {
+    ++current_block_;
+    position_ = 0;
+    if (current_block_ < blocks_.size() &&
+        blocks_[current_block_].size >= size) {
+      return;
+    }
+    Block block;
+    block.size = std::max(kBlockSize, size);
+    block.memory = new char[block.size];
+    blocks_.insert(blocks_.begin() + current_block_, block);
+    blocks_by_address_.insert(
+        std::upper_bound(blocks_by_address_.begin(), blocks_by_address_.end(),
+                         block.memory, StartsAfter),
+        block);
+  }
+
+  std::vector<Block> blocks_;
+  // The same blocks, sorted by address.
+  std::vector<Block> blocks_by_address_;
+  int current_block_;
+  size_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(RevArena);
+};
 }  // namespace
 
 // ----- Trail -----
@@ -707,6 +897,10 @@ struct Trail {
   std::vector<BaseObject**> rev_object_array_memory_;
   std::vector<void*> rev_memory_;
   std::vector<void**> rev_memory_array_;
+  // Objects allocated in the arena. Only their destructors are called on
+  // backtrack, their memory is released by restoring the arena.
+  std::vector<BaseObject*> rev_arena_objects_;
+  RevArena arena_;
 
   Trail(int block_size, SolverParameters::TrailCompression compression_level)
       : rev_ints_(block_size, compression_level),
@@ -819,6 +1013,13 @@ struct Trail {
       // delete [] version of the previous unsafe case.
     }
     rev_memory_array_.resize(target);
+
+    target = m->rev_arena_object_index_;
+    for (int curr = rev_arena_objects_.size() - 1; curr >= target; --curr) {
+      rev_arena_objects_[curr]->~BaseObject();
+    }
+    rev_arena_objects_.resize(target);
+    arena_.Restore(m->arena_block_, m->arena_position_);
   }
 };
 
@@ -852,7 +1053,14 @@ void Solver::InternalSaveValue(bool* valptr) {
 
 BaseObject* Solver::SafeRevAlloc(BaseObject* ptr) {
   check_alloc_state();
-  trail_->rev_object_memory_.push_back(ptr);
+  // Objects created with 'new (solver)' are recognized by their address, as
+  // their constructors may themselves create such objects.
+  if (parameters_.use_arena_allocator && ptr != nullptr &&
+      trail_->arena_.Owns(ptr)) {
+    trail_->rev_arena_objects_.push_back(ptr);
+  } else {
+    trail_->rev_object_memory_.push_back(ptr);
+  }
   return ptr;
 }
 
@@ -907,6 +1115,33 @@ void* Solver::UnsafeRevAllocAux(void* ptr) {
   return ptr;
 }
 
+void* Solver::UnsafeRevAllocRaw(size_t size) {
+  if (parameters_.use_arena_allocator) {
+    check_alloc_state();
+    return trail_->arena_.Allocate(size);
+  }
+  return UnsafeRevAllocAux(::operator new(size));
+}
+
+void* Solver::AllocateRevObject(size_t size) {
+  if (!parameters_.use_arena_allocator) {
+    return ::operator new(size);
+  }
+  return trail_->arena_.Allocate(size);
+}
+
+void* BaseObject::operator new(size_t size, Solver* const solver) {
+  return solver->AllocateRevObject(size);
+}
+
+void BaseObject::operator delete(void* ptr, Solver* const solver) {
+  // Only called if a constructor throws. The arena memory is released on
+  // backtrack.
+  if (!solver->parameters_.use_arena_allocator) {
+    ::operator delete(ptr);
+  }
+}
+
 void** Solver::UnsafeRevAllocArrayAux(void** ptr) {
   check_alloc_state();
   trail_->rev_memory_array_.push_back(ptr);
@@ -1134,13 +1369,14 @@ void Solver::SetBranchSelector(
   // We cannot use the trail as the search can be nested and thus
   // deleted upon backtrack. Thus we guard the undo action by a
   // check on the number of nesting of solve().
-  AddBacktrackAction(RevAlloc(new UndoBranchSelector(SolveDepth())), false);
+  AddBacktrackAction(RevAlloc(new (this) UndoBranchSelector(SolveDepth())),
+                     false);
   searches_.back()->SetBranchSelector(bs);
 }
 
 DecisionBuilder* Solver::MakeApplyBranchSelector(
     ResultCallback1<Solver::DecisionModification, Solver*>* const bs) {
-  return RevAlloc(new ApplyBranchSelector(bs));
+  return RevAlloc(new (this) ApplyBranchSelector(bs));
 }
 
 int Solver::SolveDepth() const {
@@ -1421,7 +1657,8 @@ Solver::Solver(const std::string& name, const SolverParameters& parameters)
       additional_constraint_index_(0),
       propagation_monitor_(BuildTrace(this)),
       print_trace_(nullptr),
-      anonymous_variable_index_(0) {
+      anonymous_variable_index_(0),
+      num_int_vars_(0) {
   Init();
 }
 
@@ -1454,7 +1691,8 @@ Solver::Solver(const std::string& name)
       additional_constraint_index_(0),
       propagation_monitor_(BuildTrace(this)),
       print_trace_(nullptr),
-      anonymous_variable_index_(0) {
+      anonymous_variable_index_(0),
+      num_int_vars_(0) {
   Init();
 }
 
@@ -1499,6 +1737,7 @@ const SolverParameters::ProfileLevel SolverParameters::kDefaultProfileLevel =
 const SolverParameters::TraceLevel SolverParameters::kDefaultTraceLevel =
     SolverParameters::NO_TRACE;
 const bool SolverParameters::kDefaultNameAllVariables = false;
+const bool SolverParameters::kDefaultUseArenaAllocator = false;
 
 std::string Solver::DebugString() const {
   std::string out = "Solver(name = \"" + name_ + "\", state = ";
@@ -1575,6 +1814,9 @@ void Solver::PushState(Solver::MarkerType t, const StateInfo& info) {
     m->rev_object_array_memory_index_ = trail_->rev_object_array_memory_.size();
     m->rev_memory_index_ = trail_->rev_memory_.size();
     m->rev_memory_array_index_ = trail_->rev_memory_array_.size();
+    m->rev_arena_object_index_ = trail_->rev_arena_objects_.size();
+    m->arena_block_ = trail_->arena_.current_block();
+    m->arena_position_ = trail_->arena_.position();
   }
   searches_.back()->marker_stack_.push_back(m);
   queue_->increase_stamp();
@@ -2220,7 +2462,7 @@ bool Solver::NextSolution() {
           DecisionModification modification = search->ModifyDecision();
           switch (modification) {
             case SWITCH_BRANCHES: {
-              d = RevAlloc(new ReverseDecision(d));
+              d = RevAlloc(new (this) ReverseDecision(d));
               // We reverse the decision and fall through the normal code.
               FALLTHROUGH_INTENDED;
             }
@@ -63,6 +63,7 @@
 #include "base/hash.h"
 #include "base/hash.h"
 #include <iosfwd>
+#include <new>
 #include "base/unique_ptr.h"
 #include <string>
 #include <utility>
@@ -169,7 +170,7 @@ class SimpleRevFIFO;
 struct SolverParameters {
  public:
   enum TrailCompression {
-    NO_COMPRESSION, COMPRESS_WITH_ZLIB
+    NO_COMPRESSION, COMPRESS_WITH_ZLIB, COMPRESS_WITH_FAST_LZ
   };
 
   enum ProfileLevel { NO_PROFILING, NORMAL_PROFILING };
@@ -183,12 +184,14 @@ struct SolverParameters {
   static const ProfileLevel kDefaultProfileLevel;
   static const TraceLevel kDefaultTraceLevel;
   static const bool kDefaultNameAllVariables;
+  static const bool kDefaultUseArenaAllocator;
 
   SolverParameters();
 
   // This parameter indicates if the solver should compress the trail
   // during the search. No compression means that the solver will be faster,
-  // but will use more memory.
+  // but will use more memory. COMPRESS_WITH_FAST_LZ is much faster than
+  // COMPRESS_WITH_ZLIB, but compresses a bit less.
   TrailCompression compress_trail;
 
   // This parameter indicates the default size of a block of the trail.
@@ -213,6 +216,14 @@ struct SolverParameters {
 
   // Should anonymous variables be given a name.
   bool name_all_variables;
+
+  // If true, the objects created with 'new (solver) MyObject(...)' and the
+  // cells of the internal reversible structures are allocated in a bump
+  // pointer arena owned by the trail instead of on the heap. Their memory is
+  // released in bulk when the search backtracks over their allocation, and
+  // their destructors are still called. This mostly benefits searches that
+  // create many small objects per node, such as decisions.
+  bool use_arena_allocator;
 };
 
 // This struct holds all parameters for the default search.
@@ -799,6 +810,22 @@ class Solver {
     AVOID_DATE
   };
 
+  // This enum is used in Solver::MakeAllDifferent to specify the strength of
+  // the propagation. The values match the range argument of the exported
+  // constraint.
+  enum AllDifferentConsistency {
+    // The value of a bound variable is removed from the other variables.
+    VALUE_CONSISTENCY = 0,
+
+    // Bounds consistent propagation, on the ranges of the variables.
+    BOUNDS_CONSISTENCY = 1,
+
+    // Domain consistent propagation, which removes all the values that do not
+    // belong to a solution of the constraint. This is the slowest, and it is
+    // meant for variables with small domains.
+    DOMAIN_CONSISTENCY = 2
+  };
+
   // The Solver is responsible for creating the search tree. Thanks to the
   // DecisionBuilder, it creates a new decision with two branches at each node:
   // left and right.
@@ -1559,6 +1586,11 @@ class Solver {
   Constraint* MakeAllDifferent(const std::vector<IntVar*>& vars,
                                bool stronger_propagation);
 
+  // All variables are pairwise different, with the given strength of
+  // propagation.
+  Constraint* MakeAllDifferent(const std::vector<IntVar*>& vars,
+                               AllDifferentConsistency consistency);
+
   // All variables are pairwise different, unless they are assigned to
   // the escape value.
   Constraint* MakeAllDifferentExcept(const std::vector<IntVar*>& vars,
@@ -2617,6 +2649,27 @@ class Solver {
   LocalSearchOperator* RandomConcatenateOperators(
       const std::vector<LocalSearchOperator*>& ops, int32 seed);
 
+  // Creates a local search operator which concatenates a vector of operators
+  // and adapts the order in which they are explored to their past
+  // performance. The performance of an operator is the objective improvement
+  // it achieved per neighbor produced (the improvement is measured on the
+  // assignment passed to Start(); operators are rewarded for producing the
+  // last neighbor if it has no objective). Performance is averaged over time,
+  // 'memory_coefficient' (in [0, 1]) being the weight of the latest
+  // observation. Operators are explored by decreasing upper confidence bound
+  // (UCB1) of their performance; 'exploration_coefficient' weighs the
+  // uncertainty term, higher values favoring operators which have produced
+  // few neighbors so far. 'maximize' must match the direction of the
+  // objective.
+  // As the order depends on the neighbors produced by each copy of the
+  // operator, and as the replicas screening neighbors in parallel (see
+  // MakeLocalSearchPhaseParameters()) run ahead of the operator they
+  // replicate, this operator must not be replicated: its replicas would not
+  // generate the neighbors in the same order.
+  LocalSearchOperator* MultiArmedBanditConcatenateOperators(
+      const std::vector<LocalSearchOperator*>& ops, double memory_coefficient,
+      double exploration_coefficient, bool maximize);
+
   // Creates a local search operator that wraps another local search
   // operator and limits the number of neighbors explored (i.e. calls
   // to MakeNextNeighbor from the current solution (between two calls
@@ -2676,6 +2729,23 @@ class Solver {
       LocalSearchOperator* const ls_operator,
       DecisionBuilder* const sub_decision_builder, SearchLimit* const limit,
       const std::vector<LocalSearchFilter*>& filters);
+  // Local search phase parameters screening the neighbors in parallel.
+  // There is one worker thread per replica, plus the calling thread which
+  // uses 'ls_operator' and 'filters'. Each replica of the operator must
+  // generate the same neighbors as 'ls_operator' in the same order, and
+  // filter_replicas[i] are the filters used with operator_replicas[i]. Worker
+  // threads only call the replicas, which must therefore not share mutable
+  // state. The filters get the objective bound set by the metaheuristic on an
+  // empty delta; the deltas they accept are then checked by the metaheuristic
+  // and restored in the solver, in neighborhood order. The same neighbors as
+  // without replicas are therefore accepted, unless the bound set by the
+  // metaheuristic depends on the delta, as with guided local search.
+  LocalSearchPhaseParameters* MakeLocalSearchPhaseParameters(
+      LocalSearchOperator* const ls_operator,
+      DecisionBuilder* const sub_decision_builder, SearchLimit* const limit,
+      const std::vector<LocalSearchFilter*>& filters,
+      const std::vector<LocalSearchOperator*>& operator_replicas,
+      const std::vector<std::vector<LocalSearchFilter*> >& filter_replicas);
 
   LocalSearchPhaseParameters* MakeLocalSearchPhaseParameters(
       SolutionPool* const pool, LocalSearchOperator* const ls_operator,
@@ -2848,6 +2918,7 @@ class Solver {
 
   friend class BaseIntExpr;
   friend class Constraint;
+  friend class BaseObject;
   friend class DemonProfiler;
   friend class FindOneNeighbor;
   friend class IntVar;
@@ -2932,6 +3003,13 @@ class Solver {
     return reinterpret_cast<T*>(
         UnsafeRevAllocAux(reinterpret_cast<void*>(ptr)));
   }
+  // Returns 'size' bytes of raw memory that will be released on backtrack.
+  // This memory comes from the arena if parameters().use_arena_allocator is
+  // true. Only objects with trivial destructors can be built in it.
+  void* UnsafeRevAllocRaw(size_t size);
+  // Returns memory for a BaseObject created with 'new (solver)'. See
+  // BaseObject::operator new(size_t, Solver*).
+  void* AllocateRevObject(size_t size);
   void** UnsafeRevAllocArrayAux(void** ptr);
   template <class T>
   T** UnsafeRevAllocArray(T** ptr) {
@@ -3019,6 +3097,8 @@ class Solver {
   std::unique_ptr<PropagationMonitor> propagation_monitor_;
   PropagationMonitor* print_trace_;
   int anonymous_variable_index_;
+  // Number of integer variables created, used to index them.
+  int num_int_vars_;
 
   DISALLOW_COPY_AND_ASSIGN(Solver);
 };
@@ -3048,6 +3128,28 @@ class BaseObject {
   virtual ~BaseObject() {}
   virtual std::string DebugString() const { return "BaseObject"; }
 
+  // Objects created with 'solver->RevAlloc(new (solver) MyObject(...))' are
+  // allocated in the arena of the solver if its parameters enable it, and on
+  // the heap otherwise. Such an object must be passed to RevAlloc(), possibly
+  // after other objects created by its constructor, and must never be deleted
+  // explicitly.
+#ifndef SWIG
+  static void* operator new(size_t size, Solver* const solver);
+  static void operator delete(void* ptr, Solver* const solver);
+  static void* operator new(size_t size) { return ::operator new(size); }
+  static void operator delete(void* ptr) { ::operator delete(ptr); }
+  // The class-scope operator new above hides the global placement and
+  // nothrow forms, which are therefore redeclared here.
+  static void* operator new(size_t size, void* ptr) { return ptr; }
+  static void operator delete(void* ptr, void* place) {}
+  static void* operator new(size_t size, const std::nothrow_t& nothrow) {
+    return ::operator new(size, nothrow);
+  }
+  static void operator delete(void* ptr, const std::nothrow_t& nothrow) {
+    ::operator delete(ptr, nothrow);
+  }
+#endif  // SWIG
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BaseObject);
 };
@@ -3880,7 +3982,13 @@ class IntVar : public IntExpr {
   virtual IntVar* IsGreaterOrEqual(int64 constant) = 0;
   virtual IntVar* IsLessOrEqual(int64 constant) = 0;
 
+  // Returns the index of the variable among the variables of its solver.
+  // Indices are dense, starting at 0, in creation order. They are used to
+  // replace hash maps keyed by variables with vectors.
+  int index() const { return index_; }
+
  private:
+  const int index_;
   DISALLOW_COPY_AND_ASSIGN(IntVar);
 };
 
@@ -4080,6 +4188,10 @@ class NoGood {
   // term is added to the solver. It returns true if the nogood is
   // still active and needs to be reevaluated.
   bool Apply(Solver* const solver);
+  // Returns the number of terms.
+  int size() const { return terms_.size(); }
+  // Returns the term of the given index.
+  NoGoodTerm* term(int index) const { return terms_[index]; }
   // Pretty print.
   std::string DebugString() const;
   // TODO(user) : support interval variables and more types of constraints.
@@ -4542,10 +4654,19 @@ class SequenceVarElement : public AssignmentElement {
 
 // ----- Assignment element container -----
 
+// Returns the dense index of a variable in its solver, or -1 if this kind of
+// variable has no such index.
+inline int AssignmentVarIndex(const IntVar* const var) { return var->index(); }
+inline int AssignmentVarIndex(const IntervalVar* const var) { return -1; }
+inline int AssignmentVarIndex(const SequenceVar* const var) { return -1; }
+
+// The positions of the elements are indexed by the dense index of their
+// variable when it has one and the indices are not too sparse, and by a hash
+// map otherwise.
 template <class V, class E>
 class AssignmentContainer {
  public:
-  AssignmentContainer() {}
+  AssignmentContainer() : num_indexed_elements_(0) {}
   E* Add(V* var) {
     CHECK(var != nullptr);
     int index = -1;
@@ -4569,6 +4690,15 @@ class AssignmentContainer {
     return &elements_[position];
   }
   void Clear() {
+    if (!dense_positions_.empty()) {
+      for (int i = 0; i < num_indexed_elements_; ++i) {
+        const int var_index = ElementVarIndex(i);
+        if (var_index >= 0 && var_index < dense_positions_.size()) {
+          dense_positions_[var_index] = -1;
+        }
+      }
+    }
+    num_indexed_elements_ = 0;
     elements_.clear();
     if (!elements_map_.empty()) {  // 2x speedup on or-tools.
       elements_map_.clear();
@@ -4660,8 +4790,9 @@ class AssignmentContainer {
     // but also how the map is hashed (e.g., number of buckets). This is not
     // what we want.
     for (const E& element : container.elements_) {
-      const int position = FindWithDefault(elements_map_, element.Var(), -1);
-      if (position < 0 || elements_[position] != element) {
+      int position = -1;
+      if (!FindIndexed(element.Var(), &position) ||
+          elements_[position] != element) {
         return false;
       }
     }
@@ -4672,12 +4803,49 @@ class AssignmentContainer {
   }
 
  private:
+  // Returns the dense index of the variable of the element at the given
+  // position, or -1.
+  int ElementVarIndex(int position) const {
+    const V* const var = elements_[position].Var();
+    return var == nullptr ? -1 : AssignmentVarIndex(var);
+  }
   void EnsureMapIsUpToDate() const {
-    hash_map<const V*, int>* map =
-        const_cast<hash_map<const V*, int>*>(&elements_map_);
-    for (int i = map->size(); i < elements_.size(); ++i) {
-      (*map)[elements_[i].Var()] = i;
+    AssignmentContainer<V, E>* const container =
+        const_cast<AssignmentContainer<V, E>*>(this);
+    // Small containers, like local search deltas, are hashed: reading the
+    // index of their variables would cost more than hashing their address.
+    // The dense positions are limited to a few times the number of elements,
+    // so that a container on a large model stays small.
+    const int kMinSizeForDenseIndex = 64;
+    const int kMaxDenseIndexPerElement = 4;
+    const bool use_dense_index = elements_.size() >= kMinSizeForDenseIndex;
+    for (int i = num_indexed_elements_; i < elements_.size(); ++i) {
+      const int var_index = use_dense_index ? ElementVarIndex(i) : -1;
+      if (var_index >= 0 &&
+          var_index < kMaxDenseIndexPerElement * elements_.size()) {
+        if (var_index >= dense_positions_.size()) {
+          container->dense_positions_.resize(
+              std::max<size_t>(var_index + 1, 2 * dense_positions_.size()),
+              -1);
+        }
+        container->dense_positions_[var_index] = i;
+      } else {
+        container->elements_map_[elements_[i].Var()] = i;
+      }
+    }
+    container->num_indexed_elements_ = elements_.size();
+  }
+  // Same as Find(), once the positions are indexed.
+  bool FindIndexed(const V* const var, int* index) const {
+    if (!dense_positions_.empty()) {
+      const int var_index = AssignmentVarIndex(var);
+      if (var_index >= 0 && var_index < dense_positions_.size() &&
+          dense_positions_[var_index] >= 0) {
+        *index = dense_positions_[var_index];
+        return true;
+      }
     }
+    return !elements_map_.empty() && FindCopy(elements_map_, var, index);
   }
   bool Find(const V* const var, int* index) const {
     // This threshold was determined from microbenchmarks on Nehalem platform.
@@ -4694,13 +4862,18 @@ class AssignmentContainer {
       return false;
     } else {
       EnsureMapIsUpToDate();
-      DCHECK_EQ(elements_map_.size(), elements_.size());
-      return FindCopy(elements_map_, var, index);
+      return FindIndexed(var, index);
     }
   }
 
   std::vector<E> elements_;
+  // Positions of the elements, indexed by dense variable index, -1 for
+  // absent variables.
+  std::vector<int> dense_positions_;
+  // Positions of the other elements.
   hash_map<const V*, int> elements_map_;
+  // Number of elements whose position is indexed.
+  int num_indexed_elements_;
 };
 
 // ----- Assignment -----
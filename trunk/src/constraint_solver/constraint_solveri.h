@@ -53,6 +53,7 @@
 
 #include <math.h>
 #include <stddef.h>
+#include <new>
 #include "base/hash.h"
 #include "base/unique_ptr.h"
 #include <string>
@@ -180,7 +181,10 @@ class SimpleRevFIFO {
 
   void Push(Solver* const s, T val) {
     if (pos_.Value() == 0) {
-      Chunk* const chunk = s->UnsafeRevAlloc(new Chunk(chunks_));
+      // Chunks only hold trivially destructible values and can be built in
+      // raw reversible memory.
+      Chunk* const chunk =
+          new (s->UnsafeRevAllocRaw(sizeof(Chunk))) Chunk(chunks_);
       s->SaveAndSetValue(reinterpret_cast<void**>(&chunks_),
                          reinterpret_cast<void*>(chunk));
       pos_.SetValue(s, CHUNK_SIZE - 1);
@@ -400,6 +404,64 @@ class RevImmutableMultiMap {
   NumericalRev<int> num_items_;
 };
 
+// ----- Arc Map -----
+
+// Open addressing hash map from arcs to int64 values, used by guided local
+// search. Arcs are packed in a single 64-bit key (variable index in the high
+// bits, value in the low bits) stored next to their value in a flat array
+// probed linearly, which avoids the node allocations and pointer chasing of
+// hash_map on the large arc sets of routing problems. Arcs the value of which
+// does not fit in 32 bits are stored in a hash_map.
+class ArcInt64FlatMap {
+ public:
+  // An arc from a variable index to a value.
+  typedef std::pair<int64, int64> Arc;
+
+  ArcInt64FlatMap();
+  bool Empty() const { return size_ == 0 && overflow_.empty(); }
+  // Returns the value of arc, 0 if the arc has no value.
+  int64 Value(const Arc& arc) const;
+  // Returns a pointer to the value of arc, inserting 0 if the arc has no value.
+  // The pointer is invalidated by the next insertion.
+  int64* MutableValue(const Arc& arc);
+  void Clear();
+
+ private:
+  struct Slot {
+    uint64 key;
+    int64 value;
+  };
+  static const int kInitialLogCapacity = 6;
+  static const uint64 kEmptyKey;
+
+  static bool PackArc(const Arc& arc, uint64* key) {
+    DCHECK_GE(arc.first, 0);
+    DCHECK_LT(arc.first, kint32max);
+    if (arc.second < kint32min || arc.second > kint32max) {
+      return false;
+    }
+    *key = (static_cast<uint64>(arc.first) << 32) |
+           static_cast<uint32>(static_cast<int32>(arc.second));
+    return true;
+  }
+  // Fibonacci hashing: the top bits of the product are well mixed.
+  int SlotIndex(uint64 key) const {
+    return static_cast<int>((key * GG_ULONGLONG(0x9E3779B97F4A7C15)) >>
+                            shift_);
+  }
+  int FindSlot(uint64 key) const;
+  void Grow();
+
+  std::vector<Slot> slots_;
+  int size_;
+  int shift_;
+#if defined(_MSC_VER)
+  hash_map<Arc, int64, PairInt64Hasher> overflow_;
+#else
+  hash_map<Arc, int64> overflow_;
+#endif
+};
+
 // A reversible switch that can switch once from false to true.
 class RevSwitch {
  public:
@@ -1198,12 +1260,44 @@ class PathOperator : public IntVarLocalSearchOperator {
   // Number of next variables.
   int number_of_nexts() const { return number_of_nexts_; }
 
+  // Restricts the neighborhood to "granular" neighbors, which create at least
+  // one arc (i, j) such that j is in the sorted vector neighbors->Run(i, p),
+  // p being the path of i. Operators exploring neighbor lists (TwoOpt,
+  // Relocate and Exchange) build their neighbors from the neighbors of the
+  // first base node instead of iterating their other base nodes, which makes
+  // the neighborhood linear in the number of nodes; the neighbors of the other
+  // operators are built as usual and skipped if they create no such arc.
+  // Ownership of 'neighbors' is not taken by this class; it and the vectors
+  // it returns must remain alive during the lifespan of the path operator.
+  // Passing nullptr removes the restriction.
+  void SetNeighbors(
+      ResultCallback2<const std::vector<int>*, int64, int64>* neighbors) {
+    neighbors_ = neighbors;
+    explore_neighbors_ = neighbors != nullptr && ExploresNeighbors();
+  }
+
+  // Enables "don't look bits" on the first base node: once all the neighbors
+  // built from a position of the first base node have been explored without
+  // one being accepted, the position is skipped until one of the arcs around
+  // it is changed by a new solution. When no neighbor is found, a last
+  // complete exploration without skipping is done before failing, so that
+  // local optima are not weakened.
+  void SetUseDontLookBits(bool use_dont_look_bits) {
+    use_dont_look_bits_ = use_dont_look_bits;
+  }
+
  protected:
   // This method should not be overridden. Override MakeNeighbor() instead.
   virtual bool MakeOneNeighbor();
 
   // Returns the index of the variable corresponding to the ith base node.
   int64 BaseNode(int i) const { return base_nodes_[i]; }
+  // Returns true if the operator builds its neighbors from the neighbors of
+  // the first base node; only the first base node is then iterated.
+  bool HasNeighbors() const { return explore_neighbors_; }
+  // Returns the current neighbor of the first base node, or -1 if it has no
+  // neighbor.
+  int64 GetNeighborOfFirstBaseNode() const;
   // Returns the index of the variable corresponding to the current path
   // of the ith base node.
   int64 StartNode(int i) const { return path_starts_[base_paths_[i]]; }
@@ -1240,6 +1334,14 @@ class PathOperator : public IntVarLocalSearchOperator {
     return ignore_path_vars_ ? 0LL : OldValue(node_index + number_of_nexts_);
   }
 
+  // Returns the node before the node of index node_index in the assignment
+  // the operator was last synchronized with, or -1 if it is a path start.
+  // Only available when HasNeighbors() is true.
+  int64 OldPrev(int64 node_index) const {
+    DCHECK(!IsPathEnd(node_index));
+    return prevs_[node_index];
+  }
+
   // Moves the chain starting after the node before_chain and ending at the node
   // chain_end after the node destination
   bool MoveChain(int64 before_chain, int64 chain_end, int64 destination);
@@ -1271,6 +1373,9 @@ class PathOperator : public IntVarLocalSearchOperator {
   // Returns true if operator needs to restart its initial position at each
   // call to Start()
   virtual bool InitPosition() const { return false; }
+  // Returns true if the operator supports exploring neighbor lists (see
+  // SetNeighbors()).
+  virtual bool ExploresNeighbors() const { return false; }
   // Reset the position of the operator to its position when Start() was last
   // called; this can be used to let an operator iterate more than once over
   // the paths.
@@ -1288,13 +1393,31 @@ class PathOperator : public IntVarLocalSearchOperator {
   // Returns true if two nodes are on the same path in the current assignment.
   bool OnSamePath(int64 node1, int64 node2) const;
 
+  // Returns the number of base nodes iterated by IncrementPosition().
+  int NumberOfIteratedBaseNodes() const {
+    return explore_neighbors_ ? 1 : base_nodes_.size();
+  }
+  int NumberOfNeighborsOfFirstBaseNode() const;
   bool CheckEnds() const;
   bool IncrementPosition();
+  // Moves the first base node to the next position along its path which is
+  // not marked by a don't look bit.
+  void IncrementFirstBaseNode();
+  // Returns true if the base nodes which are not bound to the path of the
+  // previous base node are on the last path; the current position of the first
+  // base node has then been explored on all the paths of the other base nodes.
+  bool OtherBaseNodesOnLastPath();
+  // Clears the don't look bits of the nodes around the arcs which changed
+  // since the last call to Start().
+  void UpdateDontLookBits();
   void InitializePathStarts();
   void InitializeInactives();
   void InitializeBaseNodes();
   bool CheckChainValidity(int64 chain_start, int64 chain_end,
                           int64 exclude) const;
+  // Returns true if the current neighbor creates an arc to a node of the
+  // neighbor lists.
+  bool CreatesNeighborArc() const;
   void Synchronize();
 
   std::vector<int> base_nodes_;
@@ -1305,6 +1428,24 @@ class PathOperator : public IntVarLocalSearchOperator {
   bool just_started_;
   bool first_start_;
   ResultCallback1<int, int64>* start_empty_path_class_;
+  ResultCallback2<const std::vector<int>*, int64, int64>* neighbors_;
+  bool explore_neighbors_;
+  // Index of the current neighbor of the first base node, and its value at
+  // the position where the exploration ends.
+  int neighbor_index_;
+  int end_neighbor_index_;
+  std::vector<int64> prevs_;
+  bool use_dont_look_bits_;
+  std::vector<bool> dont_look_bits_;
+  // Value of next variables when the don't look bits were last updated.
+  std::vector<int64> dont_look_nexts_;
+  // True if the current position of the first base node has been explored
+  // with all the positions of the other base nodes since the last Start().
+  bool first_base_node_fully_explored_;
+  // True if positions were skipped since the last complete exploration.
+  bool skipped_base_nodes_;
+  // False during the complete exploration done before failing.
+  bool skip_base_nodes_;
 };
 
 // ----- Operator Factories ------
@@ -1328,6 +1469,18 @@ class MakeChainInactiveOperator;
 class SwapActiveOperator;
 class ExtendedSwapActiveOperator;
 
+// Same as MakeLocalSearchOperator but the neighborhood of the operator is
+// restricted with PathOperator::SetNeighbors(neighbors).
+// Ownership of 'neighbors' is not taken.
+// Can be applied to TwoOpt, Relocate, Exchange and Cross.
+template <class T>
+LocalSearchOperator* MakeGranularLocalSearchOperator(
+    Solver* solver,
+    const std::vector<IntVar*>& vars,
+    const std::vector<IntVar*>& secondary_vars,
+    ResultCallback1<int, int64>* start_empty_path_class,
+    ResultCallback2<const std::vector<int>*, int64, int64>* neighbors);
+
 // ----- Local Search Filters ------
 
 // For fast neighbor pruning
@@ -1359,7 +1512,13 @@ class IntVarLocalSearchFilter : public LocalSearchFilter {
 
   bool FindIndex(IntVar* const var, int64* index) const {
     DCHECK(index != nullptr);
-    return FindCopy(var_to_index_, var, index);
+    const int var_index = var->index();
+    if (var_index < var_index_to_index_.size() &&
+        var_index_to_index_[var_index] != -1) {
+      *index = var_index_to_index_[var_index];
+      return true;
+    }
+    return !var_to_index_.empty() && FindCopy(var_to_index_, var, index);
   }
 
   // Add variables to "track" to the filter.
@@ -1379,6 +1538,11 @@ class IntVarLocalSearchFilter : public LocalSearchFilter {
   std::vector<IntVar*> vars_;
   std::vector<int64> values_;
   std::vector<bool> var_synced_;
+  // Indices of the variables in the filter, indexed by IntVar::index(), -1
+  // for the other variables. As in AssignmentContainer, this vector is
+  // limited to a few times the number of variables of the filter; the
+  // variables with a larger index are stored in var_to_index_.
+  std::vector<int> var_index_to_index_;
   dense_hash_map<const IntVar*, int64> var_to_index_;
 };
 
@@ -12,6 +12,7 @@
 // limitations under the License.
 #include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/integral_types.h"
@@ -40,10 +41,16 @@ class Diffn : public Constraint {
         dx_(x_size),
         dy_(y_size),
         size_(x_vars.size()),
-        fail_stamp_(0) {
+        fail_stamp_(0),
+        in_to_propagate_(x_vars.size(), false),
+        index_fail_stamp_(0),
+        candidate_stamps_(x_vars.size(), 0),
+        candidate_stamp_(0) {
     CHECK_EQ(x_vars.size(), y_vars.size());
     CHECK_EQ(x_vars.size(), x_size.size());
     CHECK_EQ(x_vars.size(), y_size.size());
+    cache_[X].resize(size_);
+    cache_[Y].resize(size_);
   }
 
   virtual ~Diffn() {}
@@ -100,10 +107,11 @@ class Diffn : public Constraint {
     }
 
     // Force propagation on all boxes.
-    to_propagate_.clear();
+    ClearToPropagate();
     for (int i = 0; i < size_; i++) {
-      to_propagate_.insert(i);
+      AddToPropagate(i);
     }
+    index_fail_stamp_ = 0;
     PropagateAll();
   }
 
@@ -129,14 +137,32 @@ class Diffn : public Constraint {
   }
 
  private:
+  // The two dimensions, used to index the cached bounds.
+  enum Dimension { X = 0, Y = 1 };
+
+  // Cached bounds of a box in one dimension. The box is forced to overlap the
+  // interval [lo, hi) iff start_max < hi and end_min > lo. If the box has a
+  // compulsory part, it is [start_max, end_min).
+  struct Extent {
+    Extent() : start_max(0), end_min(0) {}
+    int64 start_max;
+    int64 end_min;
+  };
+
   void PropagateAll() {
-    for (ConstIter<hash_set<int>> it(to_propagate_); !it.at_end(); ++it) {
-      const int box = *it;
-      FillNeighbors(box);
+    UpdateIndex();
+    // Pushes can enqueue new boxes, which will be processed in the next call.
+    processing_.swap(to_propagate_);
+    for (int i = 0; i < processing_.size(); ++i) {
+      in_to_propagate_[processing_[i]] = false;
+    }
+    for (int i = 0; i < processing_.size(); ++i) {
+      const int box = processing_[i];
       FailWhenEnergyIsTooLarge(box);
+      FillNeighbors(box);
       PushOverlappingBoxes(box);
     }
-    to_propagate_.clear();
+    processing_.clear();
     fail_stamp_ = solver()->fail_stamp();
   }
 
@@ -145,64 +171,175 @@ class Diffn : public Constraint {
       // We have failed in the last propagation and the to_propagate_
       // was not cleared.
       fail_stamp_ = solver()->fail_stamp();
-      to_propagate_.clear();
+      ClearToPropagate();
     }
-    to_propagate_.insert(box);
+    AddToPropagate(box);
     EnqueueDelayedDemon(delayed_demon_);
   }
 
-  bool CanBoxedOverlap(int i, int j) const {
-    if (AreBoxedDisjoingHorizontallyForSure(i, j) ||
-        AreBoxedDisjoingVerticallyForSure(i, j)) {
-      return false;
+  void AddToPropagate(int box) {
+    if (!in_to_propagate_[box]) {
+      in_to_propagate_[box] = true;
+      to_propagate_.push_back(box);
     }
-    return true;
   }
 
-  bool AreBoxedDisjoingHorizontallyForSure(int i, int j) const {
-    return (x_[i]->Min() >= x_[j]->Max() + dx_[j]->Max()) ||
-           (x_[j]->Min() >= x_[i]->Max() + dx_[i]->Max());
+  void ClearToPropagate() {
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      in_to_propagate_[to_propagate_[i]] = false;
+    }
+    to_propagate_.clear();
   }
 
-  bool AreBoxedDisjoingVerticallyForSure(int i, int j) const {
-    return (y_[i]->Min() >= y_[j]->Max() + dy_[j]->Max()) ||
-           (y_[j]->Min() >= y_[i]->Max() + dy_[i]->Max());
+  // ----- Sweep index -----
+  //
+  // For each dimension, the boxes are sorted by the latest start of their
+  // compulsory part (start_max). As end_min - start_max is at most
+  // max_compulsory_size_, the boxes forced to overlap [lo, hi) have a
+  // start_max in (lo - max_compulsory_size_, hi), which is a contiguous
+  // window of the sorted boxes.
+  //
+  // The cached bounds are refreshed for the changed boxes at the beginning of
+  // each propagation, and rebuilt after a backtrack. They may be looser than
+  // the current domains, as they are not refreshed after the pushes of the
+  // current propagation. They are only used to select the boxes to look at,
+  // the propagation itself reads the variables.
+
+  void UpdateIndex() {
+    if (index_fail_stamp_ != solver()->fail_stamp()) {
+      index_fail_stamp_ = solver()->fail_stamp();
+      for (int dim = X; dim <= Y; ++dim) {
+        std::vector<std::pair<int64, int> >& sorted = sorted_boxes_[dim];
+        sorted.resize(size_);
+        max_compulsory_size_[dim] = 0;
+        for (int box = 0; box < size_; ++box) {
+          RefreshExtent(box, static_cast<Dimension>(dim));
+          sorted[box] = std::make_pair(cache_[dim][box].start_max, box);
+        }
+        std::sort(sorted.begin(), sorted.end());
+      }
+      return;
+    }
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      const int box = to_propagate_[i];
+      for (int dim = X; dim <= Y; ++dim) {
+        const int64 old_start_max = cache_[dim][box].start_max;
+        RefreshExtent(box, static_cast<Dimension>(dim));
+        const int64 new_start_max = cache_[dim][box].start_max;
+        if (new_start_max != old_start_max) {
+          MoveInIndex(static_cast<Dimension>(dim), box, old_start_max,
+                      new_start_max);
+        }
+      }
+    }
   }
 
-  // Fill neighbors_ with all boxes that can overlap the given box.
-  void FillNeighbors(int box) {
-    // TODO(user): We could maintain a non reversible list of
-    // neighbors and clean it after each failure.
-    neighbors_.clear();
-    for (int other = 0; other < size_; ++other) {
-      if (other != box && CanBoxedOverlap(other, box)) {
-        neighbors_.push_back(other);
+  void RefreshExtent(int box, Dimension dim) {
+    IntVar* const start = dim == X ? x_[box] : y_[box];
+    IntVar* const size = dim == X ? dx_[box] : dy_[box];
+    Extent* const extent = &cache_[dim][box];
+    extent->start_max = start->Max();
+    extent->end_min = start->Min() + size->Min();
+    max_compulsory_size_[dim] = std::max(
+        max_compulsory_size_[dim], extent->end_min - extent->start_max);
+  }
+
+  void MoveInIndex(Dimension dim, int box, int64 old_start_max,
+                   int64 new_start_max) {
+    std::vector<std::pair<int64, int> >& sorted = sorted_boxes_[dim];
+    const std::pair<int64, int> old_entry(old_start_max, box);
+    const std::pair<int64, int> new_entry(new_start_max, box);
+    const int old_position =
+        std::lower_bound(sorted.begin(), sorted.end(), old_entry) -
+        sorted.begin();
+    DCHECK(sorted[old_position] == old_entry);
+    const int new_position =
+        std::lower_bound(sorted.begin(), sorted.end(), new_entry) -
+        sorted.begin();
+    if (new_position <= old_position) {
+      std::rotate(sorted.begin() + new_position, sorted.begin() + old_position,
+                  sorted.begin() + old_position + 1);
+    } else {
+      std::rotate(sorted.begin() + old_position,
+                  sorted.begin() + old_position + 1,
+                  sorted.begin() + new_position);
+    }
+    sorted[new_position <= old_position ? new_position : new_position - 1] =
+        new_entry;
+  }
+
+  // Appends to candidates_ the boxes other than the given one whose cached
+  // bounds force them to overlap [lo, hi) in the given dimension, and which
+  // are not yet in candidates_.
+  void AddCandidates(Dimension dim, int64 lo, int64 hi, int box) {
+    const std::vector<std::pair<int64, int> >& sorted = sorted_boxes_[dim];
+    // Avoids the overflow of lo - max_compulsory_size_.
+    const int64 window_start =
+        lo > kint64min + max_compulsory_size_[dim]
+            ? lo - max_compulsory_size_[dim]
+            : kint64min;
+    for (int i = std::upper_bound(sorted.begin(), sorted.end(),
+                                  std::pair<int64, int>(window_start, size_)) -
+                 sorted.begin();
+         i < sorted.size() && sorted[i].first < hi; ++i) {
+      const int other = sorted[i].second;
+      if (other != box && cache_[dim][other].end_min > lo &&
+          candidate_stamps_[other] != candidate_stamp_) {
+        candidate_stamps_[other] = candidate_stamp_;
+        candidates_.push_back(other);
       }
     }
   }
 
-  // Fails if the minimum area of the given box plus the area of its neighbors
-  // (that must already be computed in neighbors_) is greater than the area of a
-  // bounding box that necessarily contains all these boxes.
+  void NewCandidates() {
+    ++candidate_stamp_;
+    candidates_.clear();
+  }
+
+  // Returns the minimum length of the intersection of [lo, hi) with an
+  // interval of length size_min starting in [start_min, start_max].
+  static int64 MinOverlap(int64 start_min, int64 start_max, int64 size_min,
+                          int64 lo, int64 hi) {
+    return std::max(
+        0LL, std::min(std::min(size_min, hi - lo),
+                      std::min(start_min + size_min - lo, hi - start_max)));
+  }
+
+  // Fills neighbors_ with the boxes that may be pushed by the given box, i.e.
+  // the boxes that are forced to overlap it in at least one dimension.
+  void FillNeighbors(int box) {
+    NewCandidates();
+    AddCandidates(X, x_[box]->Max(), x_[box]->Min() + dx_[box]->Min(), box);
+    AddCandidates(Y, y_[box]->Max(), y_[box]->Min() + dy_[box]->Min(), box);
+    neighbors_.swap(candidates_);
+  }
+
+  // Energetic reasoning on the region where the given box can be placed:
+  // fails if the sum of the minimum areas that the boxes must have inside
+  // this region is greater than its area.
   void FailWhenEnergyIsTooLarge(int box) {
-    int64 area_min_x = x_[box]->Min();
-    int64 area_max_x = x_[box]->Max() + dx_[box]->Max();
-    int64 area_min_y = y_[box]->Min();
-    int64 area_max_y = y_[box]->Max() + dy_[box]->Max();
+    const int64 area_min_x = x_[box]->Min();
+    const int64 area_max_x = x_[box]->Max() + dx_[box]->Max();
+    const int64 area_min_y = y_[box]->Min();
+    const int64 area_max_y = y_[box]->Max() + dy_[box]->Max();
+    const int64 bounding_area =
+        (area_max_x - area_min_x) * (area_max_y - area_min_y);
     int64 sum_of_areas = dx_[box]->Min() * dy_[box]->Min();
-    // TODO(user): Is there a better order, maybe sort by distance
-    // with the current box.
-    for (int i = 0; i < neighbors_.size(); ++i) {
-      const int other = neighbors_[i];
-      // Update Bounding box.
-      area_min_x = std::min(area_min_x, x_[other]->Min());
-      area_max_x = std::max(area_max_x, x_[other]->Max() + dx_[other]->Max());
-      area_min_y = std::min(area_min_y, y_[other]->Min());
-      area_max_y = std::max(area_max_y, y_[other]->Max() + dy_[other]->Max());
-      // Update sum of areas.
-      sum_of_areas += dx_[other]->Min() * dy_[other]->Min();
-      const int64 bounding_area =
-          (area_max_x - area_min_x) * (area_max_y - area_min_y);
+    NewCandidates();
+    AddCandidates(X, area_min_x, area_max_x, box);
+    for (int i = 0; i < candidates_.size(); ++i) {
+      const int other = candidates_[i];
+      if (cache_[Y][other].start_max >= area_max_y ||
+          cache_[Y][other].end_min <= area_min_y) {
+        continue;
+      }
+      const int64 overlap_x =
+          MinOverlap(x_[other]->Min(), x_[other]->Max(), dx_[other]->Min(),
+                     area_min_x, area_max_x);
+      const int64 overlap_y =
+          MinOverlap(y_[other]->Min(), y_[other]->Max(), dy_[other]->Min(),
+                     area_min_y, area_max_y);
+      sum_of_areas += overlap_x * overlap_y;
       if (sum_of_areas > bounding_area) {
         solver()->Fail();
       }
@@ -278,9 +415,20 @@ class Diffn : public Constraint {
   std::vector<IntVar*> dy_;
   const int64 size_;
   Demon* delayed_demon_;
-  hash_set<int> to_propagate_;
-  std::vector<int> neighbors_;
   uint64 fail_stamp_;
+  // The boxes to propagate, in the order of their first change.
+  std::vector<int> to_propagate_;
+  std::vector<bool> in_to_propagate_;
+  std::vector<int> processing_;
+  // The sweep index, see UpdateIndex().
+  uint64 index_fail_stamp_;
+  std::vector<Extent> cache_[2];
+  std::vector<std::pair<int64, int> > sorted_boxes_[2];
+  int64 max_compulsory_size_[2];
+  std::vector<int> neighbors_;
+  std::vector<int> candidates_;
+  std::vector<uint64> candidate_stamps_;
+  uint64 candidate_stamp_;
 };
 }  // namespace
 
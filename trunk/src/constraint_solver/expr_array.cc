@@ -18,6 +18,7 @@
 #include <string>
 #include <vector>
 
+#include "base/commandlineflags.h"
 #include "base/integral_types.h"
 #include "base/logging.h"
 #include "base/stringprintf.h"
@@ -25,9 +26,15 @@
 #include "constraint_solver/constraint_solver.h"
 #include "constraint_solver/constraint_solveri.h"
 
+#include "util/bitset.h"
 #include "util/saturated_arithmetic.h"
 #include "util/string_array.h"
 
+DEFINE_int32(cp_long_sum_size, 1024,
+             "Sums with at least this many terms are propagated with "
+             "incremental bounds instead of a tree of partial sums. "
+             "0 disables it.");
+
 namespace operations_research {
 namespace {
 // ----- Tree Array Constraint -----
@@ -286,6 +293,206 @@ class SumConstraint : public TreeArrayConstraint {
   Demon* sum_demon_;
 };
 
+// ----- LongSumConstraint -----
+
+// This constraint implements sum(vars) == sum_var, for sums with many terms.
+// Instead of the tree of partial sums of SumConstraint, it maintains the sum
+// of the minimums and the sum of the maximums of the terms, which are updated
+// in O(1) when a term changes. The bounds of the sum are pushed down to the
+// terms whose span (max - min) is bigger than the slack of the sum (the
+// difference between the sum of the mins and the max of sum_var, or between
+// the sum of the maxes and the min of sum_var), as the others cannot be
+// reduced. The unbound terms are kept in a reversible list sorted by
+// decreasing initial span class (the position of the most significant bit of
+// the span), and the push down stops at the first class whose spans cannot be
+// bigger than the slack.
+// The sums of the bounds of the terms must not overflow.
+class LongSumConstraint : public CastConstraint {
+ public:
+  LongSumConstraint(Solver* const solver, const std::vector<IntVar*>& vars,
+                    IntVar* const sum_var)
+      : CastConstraint(solver, sum_var),
+        vars_(vars),
+        size_(vars.size()),
+        sum_of_mins_(0),
+        sum_of_maxes_(0),
+        mins_(size_, 0),
+        maxes_(size_, 0),
+        next_(size_ + 1, size_),
+        previous_(size_ + 1, size_),
+        sum_demon_(nullptr) {}
+
+  virtual ~LongSumConstraint() {}
+
+  virtual void Post() {
+    for (int i = 0; i < size_; ++i) {
+      Demon* const demon = MakeConstraintDemon1(
+          solver(), this, &LongSumConstraint::LeafChanged, "LeafChanged", i);
+      vars_[i]->WhenRange(demon);
+    }
+    sum_demon_ = solver()->RegisterDemon(MakeDelayedConstraintDemon0(
+        solver(), this, &LongSumConstraint::SumChanged, "SumChanged"));
+    target_var_->WhenRange(sum_demon_);
+  }
+
+  virtual void InitialPropagate() {
+    int64 sum_min = 0;
+    int64 sum_max = 0;
+    // The span class of a term is the position of the most significant bit of
+    // its span plus one, 0 for bound terms.
+    std::vector<int> span_classes(size_);
+    std::vector<int> class_starts(kNumSpanClasses + 1, 0);
+    for (int i = 0; i < size_; ++i) {
+      const int64 var_min = vars_[i]->Min();
+      const int64 var_max = vars_[i]->Max();
+      sum_min += var_min;
+      sum_max += var_max;
+      mins_.SetValue(solver(), i, var_min);
+      maxes_.SetValue(solver(), i, var_max);
+      const int64 span = var_max - var_min;
+      span_classes[i] =
+          span == 0 ? 0 : MostSignificantBitPosition64(span) + 1;
+      ++class_starts[kNumSpanClasses - span_classes[i]];
+    }
+    sum_of_mins_.SetValue(solver(), sum_min);
+    sum_of_maxes_.SetValue(solver(), sum_max);
+    // Counting sort by decreasing span class.
+    int start = 0;
+    for (int i = 0; i <= kNumSpanClasses; ++i) {
+      const int count = class_starts[i];
+      class_starts[i] = start;
+      start += count;
+    }
+    sorted_terms_.resize(size_);
+    positions_.resize(size_);
+    span_bounds_.resize(size_);
+    for (int i = 0; i < size_; ++i) {
+      const int position = class_starts[kNumSpanClasses - span_classes[i]]++;
+      sorted_terms_[position] = i;
+      positions_[i] = position;
+      span_bounds_[position] = span_classes[i] == 0
+                                   ? 0
+                                   : kint64max >> (63 - span_classes[i]);
+    }
+    int last = size_;
+    for (int i = 0; i < size_; ++i) {
+      const int term = sorted_terms_[i];
+      if (mins_[term] != maxes_[term]) {
+        next_.SetValue(solver(), last, i);
+        previous_.SetValue(solver(), i, last);
+        last = i;
+      }
+    }
+    next_.SetValue(solver(), last, size_);
+    previous_.SetValue(solver(), size_, last);
+    target_var_->SetRange(sum_min, sum_max);
+    SumChanged();
+  }
+
+  void SumChanged() {
+    const int64 sum_min = sum_of_mins_.Value();
+    const int64 sum_max = sum_of_maxes_.Value();
+    const int64 target_min = target_var_->Min();
+    const int64 target_max = target_var_->Max();
+    if (target_max < sum_min || target_min > sum_max) {
+      solver()->Fail();
+    }
+    const int64 slack = std::min(target_max - sum_min, sum_max - target_min);
+    for (int position = next_[size_];
+         position != size_ && span_bounds_[position] > slack;
+         position = next_[position]) {
+      const int term = sorted_terms_[position];
+      const int64 var_min = mins_[term];
+      const int64 var_max = maxes_[term];
+      const int64 new_min = target_min - (sum_max - var_max);
+      const int64 new_max = target_max - (sum_min - var_min);
+      if (new_min > var_min || new_max < var_max) {
+        vars_[term]->SetRange(new_min, new_max);
+      }
+    }
+  }
+
+  void LeafChanged(int term_index) {
+    IntVar* const var = vars_[term_index];
+    const int64 var_min = var->Min();
+    const int64 var_max = var->Max();
+    if (var_min != mins_[term_index]) {
+      sum_of_mins_.Add(solver(), var_min - mins_[term_index]);
+      mins_.SetValue(solver(), term_index, var_min);
+    }
+    if (var_max != maxes_[term_index]) {
+      sum_of_maxes_.Add(solver(), var_max - maxes_[term_index]);
+      maxes_.SetValue(solver(), term_index, var_max);
+    }
+    if (var_min == var_max) {
+      Unlink(positions_[term_index]);
+    }
+    target_var_->SetRange(sum_of_mins_.Value(), sum_of_maxes_.Value());
+    EnqueueDelayedDemon(sum_demon_);
+  }
+
+  virtual std::string DebugString() const {
+    return StringPrintf("LongSum(%s) == %s",
+                        JoinDebugStringPtr(vars_, ", ").c_str(),
+                        target_var_->DebugString().c_str());
+  }
+
+  virtual void Accept(ModelVisitor* const visitor) const {
+    visitor->BeginVisitConstraint(ModelVisitor::kSumEqual, this);
+    visitor->VisitIntegerVariableArrayArgument(ModelVisitor::kVarsArgument,
+                                               vars_);
+    visitor->VisitIntegerExpressionArgument(ModelVisitor::kTargetArgument,
+                                            target_var_);
+    visitor->EndVisitConstraint(ModelVisitor::kSumEqual, this);
+  }
+
+ private:
+  // Removes the term at the given sorted position from the list of unbound
+  // terms, if it is still in it.
+  void Unlink(int position) {
+    const int previous = previous_[position];
+    if (next_[previous] != position) {
+      return;
+    }
+    const int next = next_[position];
+    next_.SetValue(solver(), previous, next);
+    previous_.SetValue(solver(), next, previous);
+  }
+
+  static const int kNumSpanClasses = 64;
+
+  const std::vector<IntVar*> vars_;
+  const int size_;
+  NumericalRev<int64> sum_of_mins_;
+  NumericalRev<int64> sum_of_maxes_;
+  // The terms sorted by decreasing span class at the initial propagation, and
+  // the position of each term in this order. The terms of the same class are
+  // sorted by index, so that they are visited in memory order. The spans of
+  // the terms in a class are at most the corresponding span_bounds_.
+  std::vector<int> sorted_terms_;
+  std::vector<int> positions_;
+  std::vector<int64> span_bounds_;
+  // The bounds of the terms.
+  RevArray<int64> mins_;
+  RevArray<int64> maxes_;
+  // Doubly linked list of the sorted positions of the unbound terms. The list
+  // starts and ends at the sentinel position size_.
+  RevArray<int> next_;
+  RevArray<int> previous_;
+  Demon* sum_demon_;
+};
+
+// Creates the constraint sum(vars) == sum_var, when the sum of the bounds of
+// vars cannot overflow.
+Constraint* MakeSumConstraint(Solver* const solver,
+                              const std::vector<IntVar*>& vars,
+                              IntVar* const sum_var) {
+  if (FLAGS_cp_long_sum_size > 0 && vars.size() >= FLAGS_cp_long_sum_size) {
+    return solver->RevAlloc(new LongSumConstraint(solver, vars, sum_var));
+  }
+  return solver->RevAlloc(new SumConstraint(solver, vars, sum_var));
+}
+
 // ----- SafeSumConstraint -----
 
 bool DetectSumOverflow(const std::vector<IntVar*>& vars) {
@@ -2582,8 +2789,7 @@ IntExpr* MakeSumArrayAux(Solver* const solver, const std::vector<IntVar*>& vars,
       solver->AddConstraint(
           solver->RevAlloc(new SumBooleanEqualToVar(solver, vars, sum_var)));
     } else {
-      solver->AddConstraint(
-          solver->RevAlloc(new SumConstraint(solver, vars, sum_var)));
+      solver->AddConstraint(MakeSumConstraint(solver, vars, sum_var));
     }
     solver->Cache()->InsertVarArrayExpression(sum_var, vars,
                                               ModelCache::VAR_ARRAY_SUM);
@@ -2940,7 +3146,7 @@ Constraint* Solver::MakeSumEquality(const std::vector<IntVar*>& vars, int64 cst)
     if (DetectSumOverflow(vars)) {
       return RevAlloc(new SafeSumConstraint(this, vars, MakeIntConst(cst)));
     } else {
-      return RevAlloc(new SumConstraint(this, vars, MakeIntConst(cst)));
+      return MakeSumConstraint(this, vars, MakeIntConst(cst));
     }
   }
 }
@@ -2963,7 +3169,7 @@ Constraint* Solver::MakeSumEquality(const std::vector<IntVar*>& vars,
     if (DetectSumOverflow(vars)) {
       return RevAlloc(new SafeSumConstraint(this, vars, var));
     } else {
-      return RevAlloc(new SumConstraint(this, vars, var));
+      return MakeSumConstraint(this, vars, var);
     }
   }
 }
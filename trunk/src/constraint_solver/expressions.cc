@@ -50,9 +50,10 @@ IntVar* IntExpr::VarWithName(const std::string& name) {
 
 // ---------- IntVar ----------
 
-IntVar::IntVar(Solver* const s) : IntExpr(s) {}
+IntVar::IntVar(Solver* const s) : IntExpr(s), index_(s->num_int_vars_++) {}
 
-IntVar::IntVar(Solver* const s, const std::string& name) : IntExpr(s) {
+IntVar::IntVar(Solver* const s, const std::string& name)
+    : IntExpr(s), index_(s->num_int_vars_++) {
   set_name(name);
 }
 
@@ -196,11 +197,11 @@ namespace {
 class DomainIntVar : public IntVar {
  public:
   // Utility classes
+  // Iterates over the values of a BitSet. Init() must be called with the
+  // bounds of the variable, which are always in the BitSet.
   class BitSetIterator : public BaseObject {
    public:
-    BitSetIterator(uint64* const bitset, int64 omin)
-        : bitset_(bitset), omin_(omin), max_(kint64min), current_(kint64max) {}
-
+    BitSetIterator() : max_(kint64min), current_(kint64max) {}
     virtual ~BitSetIterator() {}
 
     void Init(int64 min, int64 max) {
@@ -214,17 +215,18 @@ class DomainIntVar : public IntVar {
 
     void Next() {
       if (++current_ <= max_) {
-        current_ = UnsafeLeastSignificantBitPosition64(
-                       bitset_, current_ - omin_, max_ - omin_) +
-                   omin_;
+        current_ = NextValue(current_, max_);
       }
     }
 
     virtual std::string DebugString() const { return "BitSetIterator"; }
 
+   protected:
+    // Returns the smallest value of the BitSet in [value, max]. There is
+    // always one since max is in the BitSet.
+    virtual int64 NextValue(int64 value, int64 max) const = 0;
+
    private:
-    uint64* const bitset_;
-    const int64 omin_;
     int64 max_;
     int64 current_;
   };
@@ -239,12 +241,39 @@ class DomainIntVar : public IntVar {
     virtual bool Contains(int64 val) const = 0;
     virtual bool SetValue(int64 val) = 0;
     virtual bool RemoveValue(int64 val) = 0;
+    // Removes all the values of [l, u], which must be within the original
+    // bounds of the bitset. Returns true if a value was removed.
+    virtual bool RemoveInterval(int64 l, int64 u) {
+      bool removed = false;
+      for (int64 v = l; v <= u; ++v) {
+        removed |= RemoveValue(v);
+      }
+      return removed;
+    }
+    // Removes the given values that are strictly between 'lower' and
+    // 'upper'. Returns true if a value was removed.
+    virtual bool RemoveValues(const std::vector<int64>& values, int64 lower,
+                              int64 upper) {
+      bool removed = false;
+      for (int i = 0; i < values.size(); ++i) {
+        const int64 v = values[i];
+        if (v > lower && v < upper) {
+          removed |= RemoveValue(v);
+        }
+      }
+      return removed;
+    }
     virtual uint64 Size() const = 0;
     virtual void DelayRemoveValue(int64 val) = 0;
     virtual void ApplyRemovedValues(DomainIntVar* var) = 0;
     virtual void ClearRemovedValues() = 0;
     virtual std::string pretty_DebugString(int64 min, int64 max) const = 0;
     virtual BitSetIterator* MakeIterator() = 0;
+    // Returns a denser bitset with the same values on [min, max], to replace
+    // this one when it has too many holes for its representation, or nullptr.
+    virtual BitSet* MakeDenseIfFragmented(int64 min, int64 max) {
+      return nullptr;
+    }
 
     void InitHoles() {
       const uint64 current_stamp = solver_->stamp();
@@ -256,15 +285,27 @@ class DomainIntVar : public IntVar {
 
     virtual void ClearHoles() { holes_.clear(); }
 
-    const std::vector<int64>& Holes() { return holes_; }
+    // The holes of the current propagation event, as closed intervals of
+    // removed values.
+    const std::vector<std::pair<int64, int64> >& Holes() { return holes_; }
 
-    void AddHole(int64 value) { holes_.push_back(value); }
+    void AddHole(int64 value) { AddHoles(value, value); }
+
+    // Merges [start, end] with the last interval of holes if it follows it.
+    void AddHoles(int64 start, int64 end) {
+      if (!holes_.empty() && holes_.back().second < start &&
+          holes_.back().second + 1 == start) {
+        holes_.back().second = end;
+      } else {
+        holes_.push_back(std::make_pair(start, end));
+      }
+    }
 
    protected:
     Solver* const solver_;
 
    private:
-    std::vector<int64> holes_;
+    std::vector<std::pair<int64, int64> > holes_;
     uint64 holes_stamp_;
   };
 
@@ -782,7 +823,9 @@ class DomainIntVar : public IntVar {
   }
   virtual void RemoveValue(int64 v);
   virtual void RemoveInterval(int64 l, int64 u);
+  virtual void RemoveValues(const std::vector<int64>& values);
   void CreateBits();
+  void DensifyBitsIfNeeded();
   virtual void WhenBound(Demon* d) {
     if (min_.Value() != max_.Value()) {
       if (d->priority() == Solver::DELAYED_PRIORITY) {
@@ -1006,6 +1049,52 @@ inline bool ClosedIntervalNoLargerThan(int64 a, int64 b, int64 K) {
   }
 }
 
+// A SparseBitSet is used for the domains with a range of more than
+// kMaxSimpleBitSetRange values, and for the domains spanning at least
+// kMinSparseBitSetRange values with less than one maximal interval of holes
+// per kSparseBitSetDensity values. A SimpleBitSet is used for the other
+// domains, and replaces a SparseBitSet whose holes become denser.
+const int64 kMaxSimpleBitSetRange = 0xFFFFFFFF;
+const int64 kMinSparseBitSetRange = 1 << 20;
+const int64 kSparseBitSetDensity = 128;
+
+bool UseSparseBitSet(int64 vmin, int64 vmax, int64 num_gaps) {
+  return !ClosedIntervalNoLargerThan(vmin, vmax, kMaxSimpleBitSetRange) ||
+         (!ClosedIntervalNoLargerThan(vmin, vmax, kMinSparseBitSetRange - 1) &&
+          !ClosedIntervalNoLargerThan(vmin, vmax,
+                                      kSparseBitSetDensity * num_gaps));
+}
+
+// Returns the number of maximal intervals of missing values in a sorted
+// vector of distinct values.
+int64 NumGaps(const std::vector<int64>& sorted_values) {
+  int64 num_gaps = 0;
+  for (int i = 1; i < sorted_values.size(); ++i) {
+    if (sorted_values[i] > sorted_values[i - 1] + 1) ++num_gaps;
+  }
+  return num_gaps;
+}
+
+// Iterator on the bits of a SimpleBitSet or a SmallBitSet.
+class DenseBitSetIterator : public DomainIntVar::BitSetIterator {
+ public:
+  DenseBitSetIterator(uint64* const bitset, int64 omin)
+      : bitset_(bitset), omin_(omin) {}
+
+  virtual ~DenseBitSetIterator() {}
+
+ protected:
+  virtual int64 NextValue(int64 value, int64 max) const {
+    return UnsafeLeastSignificantBitPosition64(bitset_, value - omin_,
+                                               max - omin_) +
+           omin_;
+  }
+
+ private:
+  uint64* const bitset_;
+  const int64 omin_;
+};
+
 class SimpleBitSet : public DomainIntVar::BitSet {
  public:
   SimpleBitSet(Solver* const s, int64 vmin, int64 vmax)
@@ -1016,7 +1105,7 @@ class SimpleBitSet : public DomainIntVar::BitSet {
         omax_(vmax),
         size_(vmax - vmin + 1),
         bsize_(BitLength64(size_.Value())) {
-    CHECK(ClosedIntervalNoLargerThan(vmin, vmax, 0xFFFFFFFF))
+    CHECK(ClosedIntervalNoLargerThan(vmin, vmax, kMaxSimpleBitSetRange))
         << "Bitset too large: [" << vmin << ", " << vmax << "]";
     bits_ = new uint64[bsize_];
     stamps_ = new uint64[bsize_];
@@ -1037,7 +1126,7 @@ class SimpleBitSet : public DomainIntVar::BitSet {
         omax_(vmax),
         size_(sorted_values.size()),
         bsize_(BitLength64(vmax - vmin + 1)) {
-    CHECK(ClosedIntervalNoLargerThan(vmin, vmax, 0xFFFFFFFF))
+    CHECK(ClosedIntervalNoLargerThan(vmin, vmax, kMaxSimpleBitSetRange))
         << "Bitset too large: [" << vmin << ", " << vmax << "]";
     bits_ = new uint64[bsize_];
     stamps_ = new uint64[bsize_];
@@ -1128,6 +1217,46 @@ class SimpleBitSet : public DomainIntVar::BitSet {
     AddHole(val);
     return true;
   }
+
+  // Works one word at a time: each modified word is saved once, and the
+  // removed bits are counted with BitCount64().
+  virtual bool RemoveInterval(int64 l, int64 u) {
+    DCHECK_GE(l, omin_);
+    DCHECK_LE(u, omax_);
+    DCHECK_LE(l, u);
+    const uint64 start = l - omin_;
+    const uint64 end = u - omin_;
+    const int offset_start = BitOffset64(start);
+    const int offset_end = BitOffset64(end);
+    int64 removed = 0;
+    for (int offset = offset_start; offset <= offset_end; ++offset) {
+      uint64 mask = kAllBits64;
+      if (offset == offset_start) mask &= IntervalUp64(BitPos64(start));
+      if (offset == offset_end) mask &= IntervalDown64(BitPos64(end));
+      removed += ClearBits(offset, bits_[offset] & mask);
+    }
+    if (removed == 0) return false;
+    size_.Add(solver_, -removed);
+    return true;
+  }
+
+  virtual bool RemoveValues(const std::vector<int64>& values, int64 lower,
+                            int64 upper) {
+    int64 removed = 0;
+    for (int i = 0; i < values.size(); ++i) {
+      const int64 v = values[i];
+      if (v > lower && v < upper) {
+        const uint64 v_offset = v - omin_;
+        removed += ClearBits(BitOffset64(v_offset),
+                             bits_[BitOffset64(v_offset)] &
+                                 OneBit64(BitPos64(v_offset)));
+      }
+    }
+    if (removed == 0) return false;
+    size_.Add(solver_, -removed);
+    return true;
+  }
+
   virtual uint64 Size() const { return size_.Value(); }
 
   virtual std::string DebugString() const {
@@ -1200,10 +1329,30 @@ class SimpleBitSet : public DomainIntVar::BitSet {
   }
 
   virtual DomainIntVar::BitSetIterator* MakeIterator() {
-    return new DomainIntVar::BitSetIterator(bits_, omin_);
+    return new DenseBitSetIterator(bits_, omin_);
   }
 
  private:
+  // Clears the given bits of the word at 'offset', records them as holes and
+  // returns their number. Does not update size_.
+  int ClearBits(int offset, uint64 to_clear) {
+    if (to_clear == 0) return 0;
+    const uint64 current_stamp = solver_->stamp();
+    if (stamps_[offset] < current_stamp) {
+      stamps_[offset] = current_stamp;
+      solver_->SaveValue(&bits_[offset]);
+    }
+    bits_[offset] &= ~to_clear;
+    InitHoles();
+    const int64 base = BitShift64(offset) + omin_;
+    const int count = BitCount64(to_clear);
+    while (to_clear != 0) {
+      AddHole(base + LeastSignificantBitPosition64(to_clear));
+      to_clear &= to_clear - 1;
+    }
+    return count;
+  }
+
   uint64* bits_;
   uint64* stamps_;
   const int64 omin_;
@@ -1345,6 +1494,25 @@ class SmallBitSet : public DomainIntVar::BitSet {
     }
   }
 
+  virtual bool RemoveInterval(int64 l, int64 u) {
+    DCHECK_GE(l, omin_);
+    DCHECK_LE(u, omax_);
+    DCHECK_LE(l, u);
+    return ClearBits(bits_ & OneRange64(l - omin_, u - omin_));
+  }
+
+  virtual bool RemoveValues(const std::vector<int64>& values, int64 lower,
+                            int64 upper) {
+    uint64 to_clear = GG_ULONGLONG(0);
+    for (int i = 0; i < values.size(); ++i) {
+      const int64 v = values[i];
+      if (v > lower && v < upper) {
+        to_clear |= OneBit64(v - omin_);
+      }
+    }
+    return ClearBits(bits_ & to_clear);
+  }
+
   virtual uint64 Size() const { return size_.Value(); }
 
   virtual std::string DebugString() const {
@@ -1415,10 +1583,29 @@ class SmallBitSet : public DomainIntVar::BitSet {
   }
 
   virtual DomainIntVar::BitSetIterator* MakeIterator() {
-    return new DomainIntVar::BitSetIterator(&bits_, omin_);
+    return new DenseBitSetIterator(&bits_, omin_);
   }
 
  private:
+  // Clears the given bits, which must be set, and records them as holes.
+  // Returns false if there are none.
+  bool ClearBits(uint64 to_clear) {
+    if (to_clear == GG_ULONGLONG(0)) return false;
+    const uint64 current_stamp = solver_->stamp();
+    if (stamp_ < current_stamp) {
+      stamp_ = current_stamp;
+      solver_->SaveValue(&bits_);
+    }
+    bits_ &= ~to_clear;
+    size_.Add(solver_, -static_cast<int64>(BitCount64(to_clear)));
+    InitHoles();
+    while (to_clear != GG_ULONGLONG(0)) {
+      AddHole(LeastSignificantBitPosition64(to_clear) + omin_);
+      to_clear &= to_clear - 1;
+    }
+    return true;
+  }
+
   uint64 bits_;
   uint64 stamp_;
   const int64 omin_;
@@ -1427,6 +1614,370 @@ class SmallBitSet : public DomainIntVar::BitSet {
   std::vector<int64> removed_;
 };
 
+// This bitset is used for domains with a huge range and few holes, for which
+// a SimpleBitSet would be too large. It stores the removed values as a list
+// of disjoint intervals. The removals are appended to a log in chronological
+// order, and only the number of removals in the log is reversible. The
+// maximal intervals of removed values, sorted by start, are used for the
+// queries: a removal adjacent to existing holes is merged with them. They are
+// updated lazily: when the search backtracks, the removals that are no longer
+// in the log are undone the next time they are accessed.
+// The cost of the operations is linear in the number of maximal intervals of
+// holes, the bitset is thus only used when they are few compared to the size
+// of the range.
+class SparseBitSet : public DomainIntVar::BitSet {
+ public:
+  SparseBitSet(Solver* const s, int64 vmin, int64 vmax)
+      : BitSet(s),
+        omin_(vmin),
+        omax_(vmax),
+        size_(vmax - vmin + 1),
+        num_removed_(0),
+        num_sorted_(0) {}
+
+  SparseBitSet(Solver* const s, const std::vector<int64>& sorted_values,
+               int64 vmin, int64 vmax)
+      : BitSet(s),
+        omin_(vmin),
+        omax_(vmax),
+        size_(sorted_values.size()),
+        sorted_removed_(Gaps(sorted_values)),
+        num_removed_(sorted_removed_.size()),
+        num_sorted_(sorted_removed_.size()) {
+    for (int i = 0; i < sorted_removed_.size(); ++i) {
+      removed_.push_back(Removal(sorted_removed_[i]));
+    }
+  }
+
+  virtual ~SparseBitSet() {}
+
+  virtual int64 ComputeNewMin(int64 nmin, int64 cmin, int64 cmax) {
+    DCHECK_GE(nmin, cmin);
+    DCHECK_LE(nmin, cmax);
+    DCHECK_LE(cmin, cmax);
+    DCHECK_GE(cmin, omin_);
+    DCHECK_LE(cmax, omax_);
+    const int64 new_min = NextValue(nmin);
+    size_.Add(solver_, -CountValues(cmin, new_min - 1));
+    return new_min;
+  }
+
+  virtual int64 ComputeNewMax(int64 nmax, int64 cmin, int64 cmax) {
+    DCHECK_GE(nmax, cmin);
+    DCHECK_LE(nmax, cmax);
+    DCHECK_LE(cmin, cmax);
+    DCHECK_GE(cmin, omin_);
+    DCHECK_LE(cmax, omax_);
+    const int64 new_max = PreviousValue(nmax);
+    size_.Add(solver_, -CountValues(new_max + 1, cmax));
+    return new_max;
+  }
+
+  virtual bool SetValue(int64 val) {
+    DCHECK_GE(val, omin_);
+    DCHECK_LE(val, omax_);
+    if (Contains(val)) {
+      size_.SetValue(solver_, 1);
+      return true;
+    }
+    return false;
+  }
+
+  virtual bool Contains(int64 val) const {
+    DCHECK_GE(val, omin_);
+    DCHECK_LE(val, omax_);
+    return NextValue(val) == val;
+  }
+
+  virtual bool RemoveValue(int64 val) {
+    if (val < omin_ || val > omax_ || !Contains(val)) {
+      return false;
+    }
+    AddRemovedInterval(val, val);
+    return true;
+  }
+
+  // Adds one interval per maximal range of values of [l, u].
+  virtual bool RemoveInterval(int64 l, int64 u) {
+    DCHECK_GE(l, omin_);
+    DCHECK_LE(u, omax_);
+    bool removed = false;
+    int64 start = NextValue(l);
+    while (start <= u) {
+      const std::vector<Interval>::const_iterator it = FirstHoleAfter(start);
+      const int64 end =
+          it == sorted_removed_.end() || it->start > u ? u : it->start - 1;
+      AddRemovedInterval(start, end);
+      removed = true;
+      if (end == u) break;
+      start = NextValue(end + 1);
+    }
+    return removed;
+  }
+
+  virtual uint64 Size() const { return size_.Value(); }
+
+  virtual std::string DebugString() const {
+    std::string out;
+    SStringPrintf(&out,
+                  "SparseBitSet(%" GG_LL_FORMAT "d..%" GG_LL_FORMAT "d : ",
+                  omin_, omax_);
+    Synchronize();
+    for (int i = 0; i < sorted_removed_.size(); ++i) {
+      StringAppendF(&out, "%s%" GG_LL_FORMAT "d..%" GG_LL_FORMAT "d",
+                    i == 0 ? "-" : " -", sorted_removed_[i].start,
+                    sorted_removed_[i].end);
+    }
+    out += ")";
+    return out;
+  }
+
+  virtual void DelayRemoveValue(int64 val) { removed_values_.push_back(val); }
+
+  virtual void ApplyRemovedValues(DomainIntVar* var) {
+    std::sort(removed_values_.begin(), removed_values_.end());
+    for (std::vector<int64>::iterator it = removed_values_.begin();
+         it != removed_values_.end(); ++it) {
+      var->RemoveValue(*it);
+    }
+  }
+
+  virtual void ClearRemovedValues() { removed_values_.clear(); }
+
+  virtual std::string pretty_DebugString(int64 min, int64 max) const {
+    DCHECK(Contains(min));
+    DCHECK(Contains(max));
+    std::string out;
+    int64 start = min;
+    while (start <= max) {
+      // [start, end] is a maximal range of values.
+      const std::vector<Interval>::const_iterator it = FirstHoleAfter(start);
+      const int64 end =
+          it == sorted_removed_.end() || it->start > max ? max : it->start - 1;
+      if (!out.empty()) out += " ";
+      if (end == start) {
+        StringAppendF(&out, "%" GG_LL_FORMAT "d", start);
+      } else if (end == start + 1) {
+        StringAppendF(&out, "%" GG_LL_FORMAT "d %" GG_LL_FORMAT "d", start,
+                      end);
+      } else {
+        StringAppendF(&out, "%" GG_LL_FORMAT "d..%" GG_LL_FORMAT "d", start,
+                      end);
+      }
+      if (end == max) break;
+      start = NextValue(end + 1);
+    }
+    return out;
+  }
+
+  virtual DomainIntVar::BitSetIterator* MakeIterator() {
+    return new Iterator(this);
+  }
+
+  // Returns a SimpleBitSet on [min, max] when there is more than one maximal
+  // interval of holes per kSparseBitSetDensity values in this range. The
+  // holes of the current propagation event are kept.
+  virtual BitSet* MakeDenseIfFragmented(int64 min, int64 max) {
+    Synchronize();
+    // min and max are in the domain: no hole contains them.
+    if (!ClosedIntervalNoLargerThan(min, max, kMaxSimpleBitSetRange) ||
+        !ClosedIntervalNoLargerThan(
+            min, max, kSparseBitSetDensity * sorted_removed_.size())) {
+      return nullptr;
+    }
+    const std::vector<Interval>::iterator begin = std::lower_bound(
+        sorted_removed_.begin(), sorted_removed_.end(), Interval(min, min));
+    const std::vector<Interval>::iterator end = std::lower_bound(
+        begin, sorted_removed_.end(), Interval(max, max));
+    if (!ClosedIntervalNoLargerThan(min, max,
+                                    kSparseBitSetDensity * (end - begin))) {
+      return nullptr;
+    }
+    SimpleBitSet* const dense = new SimpleBitSet(solver_, min, max);
+    for (std::vector<Interval>::iterator it = begin; it != end; ++it) {
+      dense->RemoveInterval(it->start, it->end);
+    }
+    InitHoles();
+    dense->InitHoles();
+    dense->ClearHoles();
+    const std::vector<std::pair<int64, int64> >& holes = Holes();
+    for (int i = 0; i < holes.size(); ++i) {
+      dense->AddHoles(holes[i].first, holes[i].second);
+    }
+    return dense;
+  }
+
+ private:
+  // A range of removed values.
+  struct Interval {
+    Interval(int64 s, int64 e) : start(s), end(e) {}
+    bool operator<(const Interval& other) const { return start < other.start; }
+    bool Empty() const { return start > end; }
+    int64 start;
+    int64 end;
+  };
+
+  // An entry of the log: the maximal interval of holes created by the
+  // removal, and the maximal intervals it was merged with, which are empty if
+  // there were no adjacent holes.
+  struct Removal {
+    explicit Removal(const Interval& i)
+        : merged(i), left(1, 0), right(1, 0) {}
+    Interval merged;
+    Interval left;
+    Interval right;
+  };
+
+  class Iterator : public DomainIntVar::BitSetIterator {
+   public:
+    explicit Iterator(const SparseBitSet* const bitset) : bitset_(bitset) {}
+    virtual ~Iterator() {}
+
+   protected:
+    virtual int64 NextValue(int64 value, int64 max) const {
+      return bitset_->NextValue(value);
+    }
+
+   private:
+    const SparseBitSet* const bitset_;
+  };
+
+  // Removes [start, end], which must only contain values of the bitset.
+  void AddRemovedInterval(int64 start, int64 end) {
+    Synchronize();
+    // Merge with the adjacent holes.
+    Removal removal(Interval(start, end));
+    std::vector<Interval>::iterator it = std::lower_bound(
+        sorted_removed_.begin(), sorted_removed_.end(), removal.merged);
+    const bool merge_left =
+        it != sorted_removed_.begin() && (it - 1)->end == start - 1;
+    const bool merge_right =
+        it != sorted_removed_.end() && it->start == end + 1;
+    if (merge_left) {
+      removal.left = *(it - 1);
+      removal.merged.start = removal.left.start;
+    }
+    if (merge_right) {
+      removal.right = *it;
+      removal.merged.end = removal.right.end;
+    }
+    if (merge_left) {
+      *(it - 1) = removal.merged;
+      if (merge_right) {
+        sorted_removed_.erase(it);
+      }
+    } else if (merge_right) {
+      *it = removal.merged;
+    } else {
+      sorted_removed_.insert(it, removal.merged);
+    }
+    ++num_sorted_;
+    // Log. The entries after num_removed_ have been undone by a backtrack
+    // and are overwritten.
+    const int index = num_removed_.Value();
+    if (index < removed_.size()) {
+      removed_[index] = removal;
+    } else {
+      removed_.push_back(removal);
+    }
+    num_removed_.Incr(solver_);
+    // Size.
+    size_.Add(solver_, start - end - 1);
+    // Holes.
+    InitHoles();
+    AddHoles(start, end);
+  }
+
+  // Returns the intervals between consecutive values.
+  static std::vector<Interval> Gaps(const std::vector<int64>& sorted_values) {
+    std::vector<Interval> gaps;
+    for (int i = 1; i < sorted_values.size(); ++i) {
+      if (sorted_values[i] > sorted_values[i - 1] + 1) {
+        gaps.push_back(Interval(sorted_values[i - 1] + 1, sorted_values[i] - 1));
+      }
+    }
+    return gaps;
+  }
+
+  // Undoes in sorted_removed_ the removals undone by a backtrack, in reverse
+  // chronological order.
+  void Synchronize() const {
+    while (num_sorted_ > num_removed_.Value()) {
+      --num_sorted_;
+      const Removal& undone = removed_[num_sorted_];
+      std::vector<Interval>::iterator it = std::lower_bound(
+          sorted_removed_.begin(), sorted_removed_.end(), undone.merged);
+      DCHECK(it != sorted_removed_.end());
+      DCHECK_EQ(undone.merged.start, it->start);
+      if (!undone.left.Empty()) {
+        *it = undone.left;
+        if (!undone.right.Empty()) {
+          sorted_removed_.insert(it + 1, undone.right);
+        }
+      } else if (!undone.right.Empty()) {
+        *it = undone.right;
+      } else {
+        sorted_removed_.erase(it);
+      }
+    }
+  }
+
+  // Returns the first interval of removed values that ends after 'value'.
+  std::vector<Interval>::const_iterator FirstHoleAfter(int64 value) const {
+    Synchronize();
+    std::vector<Interval>::const_iterator it = std::upper_bound(
+        sorted_removed_.begin(), sorted_removed_.end(), Interval(value, value));
+    if (it != sorted_removed_.begin() && (it - 1)->end >= value) --it;
+    return it;
+  }
+
+  // Returns the smallest value of the bitset greater or equal to 'value'.
+  int64 NextValue(int64 value) const {
+    for (std::vector<Interval>::const_iterator it = FirstHoleAfter(value);
+         it != sorted_removed_.end() && it->start <= value; ++it) {
+      value = it->end + 1;
+    }
+    return value;
+  }
+
+  // Returns the largest value of the bitset smaller or equal to 'value'.
+  int64 PreviousValue(int64 value) const {
+    std::vector<Interval>::const_iterator it = FirstHoleAfter(value);
+    if (it != sorted_removed_.end() && it->start <= value) {
+      value = it->start - 1;
+    }
+    while (it != sorted_removed_.begin() && (it - 1)->end == value) {
+      --it;
+      value = it->start - 1;
+    }
+    return value;
+  }
+
+  // Returns the number of values of the bitset in [a, b].
+  int64 CountValues(int64 a, int64 b) const {
+    if (a > b) return 0;
+    int64 count = b - a + 1;
+    for (std::vector<Interval>::const_iterator it = FirstHoleAfter(a);
+         it != sorted_removed_.end() && it->start <= b; ++it) {
+      count -= std::min(b, it->end) - std::max(a, it->start) + 1;
+    }
+    return count;
+  }
+
+  const int64 omin_;
+  const int64 omax_;
+  NumericalRev<int64> size_;
+  // The maximal intervals of holes after the first num_sorted_ removals of
+  // removed_, sorted by start.
+  mutable std::vector<Interval> sorted_removed_;
+  // Chronological log of the removals, only the first num_removed_ ones are
+  // valid.
+  std::vector<Removal> removed_;
+  NumericalRev<int> num_removed_;
+  mutable int num_sorted_;
+  std::vector<int64> removed_values_;
+};
+
 class EmptyIterator : public IntVarIterator {
  public:
   virtual ~EmptyIterator() {}
@@ -1468,7 +2019,12 @@ class RangeIterator : public IntVarIterator {
 class DomainIntVarHoleIterator : public IntVarIterator {
  public:
   explicit DomainIntVarHoleIterator(const DomainIntVar* const v)
-      : var_(v), bits_(nullptr), values_(nullptr), size_(0), index_(0) {}
+      : var_(v),
+        bits_(nullptr),
+        intervals_(nullptr),
+        size_(0),
+        index_(0),
+        current_(0) {}
 
   ~DomainIntVarHoleIterator() {}
 
@@ -1476,13 +2032,14 @@ class DomainIntVarHoleIterator : public IntVarIterator {
     bits_ = var_->bitset();
     if (bits_ != 0) {
       bits_->InitHoles();
-      values_ = bits_->Holes().data();
+      intervals_ = bits_->Holes().data();
       size_ = bits_->Holes().size();
     } else {
-      values_ = nullptr;
+      intervals_ = nullptr;
       size_ = 0;
     }
     index_ = 0;
+    current_ = size_ > 0 ? intervals_[0].first : 0;
   }
 
   virtual bool Ok() const { return index_ < size_; }
@@ -1490,17 +2047,26 @@ class DomainIntVarHoleIterator : public IntVarIterator {
   virtual int64 Value() const {
     DCHECK(bits_ != nullptr);
     DCHECK(index_ < size_);
-    return values_[index_];
+    return current_;
   }
 
-  virtual void Next() { index_++; }
+  // Walks the values of the current interval of holes, then moves to the
+  // next one.
+  virtual void Next() {
+    if (current_ < intervals_[index_].second) {
+      current_++;
+    } else if (++index_ < size_) {
+      current_ = intervals_[index_].first;
+    }
+  }
 
  private:
   const DomainIntVar* const var_;
   DomainIntVar::BitSet* bits_;
-  const int64* values_;
+  const std::pair<int64, int64>* intervals_;
   int size_;
   int index_;
+  int64 current_;
 };
 
 class DomainIntVarDomainIterator : public IntVarIterator {
@@ -1646,6 +2212,9 @@ DomainIntVar::DomainIntVar(Solver* const s, const std::vector<int64>& sorted_val
     if (vmax - vmin + 1 < 65) {
       bits_ = solver()->RevAlloc(
           new SmallBitSet(solver(), sorted_values, vmin, vmax));
+    } else if (UseSparseBitSet(vmin, vmax, NumGaps(sorted_values))) {
+      bits_ = solver()->RevAlloc(
+          new SparseBitSet(solver(), sorted_values, vmin, vmax));
     } else {
       bits_ = solver()->RevAlloc(
           new SimpleBitSet(solver(), sorted_values, vmin, vmax));
@@ -1783,6 +2352,7 @@ void DomainIntVar::RemoveValue(int64 v) {
       }
     } else {
       if (bits_->RemoveValue(v)) {
+        DensifyBitsIfNeeded();
         Push();
       }
     }
@@ -1794,10 +2364,53 @@ void DomainIntVar::RemoveInterval(int64 l, int64 u) {
     SetMin(u + 1);
   } else if (u >= max_.Value()) {
     SetMax(l - 1);
-  } else {
+  } else if (in_process_) {
     for (int64 v = l; v <= u; ++v) {
       RemoveValue(v);
     }
+  } else {
+    if (bits_ == nullptr) {
+      CreateBits();
+    }
+    if (bits_->RemoveInterval(l, u)) {
+      DensifyBitsIfNeeded();
+      Push();
+    }
+  }
+}
+
+void DomainIntVar::RemoveValues(const std::vector<int64>& values) {
+  if (in_process_ || values.size() < 4) {
+    IntVar::RemoveValues(values);
+    return;
+  }
+  // The values strictly inside the bounds are removed in one pass on the
+  // bitset, then the bounds are updated.
+  const int64 vmin = min_.Value();
+  const int64 vmax = max_.Value();
+  bool remove_min = false;
+  bool remove_max = false;
+  bool has_inner_value = false;
+  for (int i = 0; i < values.size(); ++i) {
+    const int64 v = values[i];
+    remove_min |= v == vmin;
+    remove_max |= v == vmax;
+    has_inner_value |= v > vmin && v < vmax;
+  }
+  if (has_inner_value) {
+    if (bits_ == nullptr) {
+      CreateBits();
+    }
+    if (bits_->RemoveValues(values, vmin, vmax)) {
+      DensifyBitsIfNeeded();
+      Push();
+    }
+  }
+  if (remove_min) {
+    SetMin(vmin + 1);
+  }
+  if (remove_max) {
+    SetMax(vmax - 1);
   }
 }
 
@@ -1806,12 +2419,27 @@ void DomainIntVar::CreateBits() {
   if (max_.Value() - min_.Value() < 64) {
     bits_ = solver()->RevAlloc(
         new SmallBitSet(solver(), min_.Value(), max_.Value()));
+  } else if (!ClosedIntervalNoLargerThan(min_.Value(), max_.Value(),
+                                        kMinSparseBitSetRange - 1)) {
+    // The domain has no holes yet: a SparseBitSet is used, and replaced by a
+    // SimpleBitSet if its holes become dense, see DensifyBitsIfNeeded().
+    bits_ = solver()->RevAlloc(
+        new SparseBitSet(solver(), min_.Value(), max_.Value()));
   } else {
     bits_ = solver()->RevAlloc(
         new SimpleBitSet(solver(), min_.Value(), max_.Value()));
   }
 }
 
+void DomainIntVar::DensifyBitsIfNeeded() {
+  BitSet* const dense =
+      bits_->MakeDenseIfFragmented(min_.Value(), max_.Value());
+  if (dense != nullptr) {
+    solver()->SaveValue(reinterpret_cast<void**>(&bits_));
+    bits_ = solver()->RevAlloc(dense);
+  }
+}
+
 void DomainIntVar::ClearInProcess() {
   in_process_ = false;
   if (bits_ != nullptr) {
@@ -1000,7 +1000,8 @@ Constraint* BuildAllDifferent(CPModelLoader* const builder,
   } else {
     int64 range = 0;
     VERIFY(builder->ScanArguments(ModelVisitor::kRangeArgument, proto, &range));
-    return builder->solver()->MakeAllDifferent(vars, range);
+    return builder->solver()->MakeAllDifferent(
+        vars, static_cast<Solver::AllDifferentConsistency>(range));
   }
 }
 
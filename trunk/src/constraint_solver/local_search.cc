@@ -12,6 +12,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cmath>
 #include "base/hash.h"
 #include "base/hash.h"
 #include <iterator>
@@ -29,6 +30,9 @@
 #include "base/concise_iterator.h"
 #include "base/map_util.h"
 #include "base/hash.h"
+#include "base/stl_util.h"
+#include "base/synchronization.h"
+#include "base/threadpool.h"
 #include "constraint_solver/constraint_solver.h"
 #include "constraint_solver/constraint_solveri.h"
 #include "graph/hamiltonian_path.h"
@@ -44,6 +48,11 @@ DEFINE_int32(cp_local_search_tsp_opt_size, 13,
 DEFINE_int32(cp_local_search_tsp_lns_size, 10,
              "Size of TSPs solved in the TSPLns operator.");
 
+DEFINE_int32(cp_local_search_screening_block_size, 256,
+             "Maximum number of consecutive neighbors screened by a worker "
+             "thread when local search operators and filters are "
+             "replicated.");
+
 DEFINE_bool(cp_use_empty_path_symmetry_breaker, true,
             "If true, equivalent empty paths are removed from the neighborhood "
             "of PathOperators");
@@ -332,7 +341,15 @@ PathOperator::PathOperator(const std::vector<IntVar*>& next_vars,
       base_paths_(number_of_base_nodes),
       just_started_(false),
       first_start_(true),
-      start_empty_path_class_(start_empty_path_class) {
+      start_empty_path_class_(start_empty_path_class),
+      neighbors_(nullptr),
+      explore_neighbors_(false),
+      neighbor_index_(0),
+      end_neighbor_index_(0),
+      use_dont_look_bits_(false),
+      first_base_node_fully_explored_(false),
+      skipped_base_nodes_(false),
+      skip_base_nodes_(true) {
   if (!ignore_path_vars_) {
     AddVars(path_vars);
   }
@@ -340,21 +357,107 @@ PathOperator::PathOperator(const std::vector<IntVar*>& next_vars,
 
 void PathOperator::OnStart() {
   InitializeBaseNodes();
+  if (use_dont_look_bits_) {
+    UpdateDontLookBits();
+  }
   OnNodeInitialization();
 }
 
+void PathOperator::UpdateDontLookBits() {
+  if (dont_look_bits_.size() != number_of_nexts_) {
+    dont_look_bits_.assign(number_of_nexts_, false);
+    dont_look_nexts_.resize(number_of_nexts_);
+    for (int i = 0; i < number_of_nexts_; ++i) {
+      dont_look_nexts_[i] = OldNext(i);
+    }
+  } else {
+    for (int i = 0; i < number_of_nexts_; ++i) {
+      const int64 next = OldNext(i);
+      const int64 previous_next = dont_look_nexts_[i];
+      if (next != previous_next) {
+        dont_look_bits_[i] = false;
+        if (!IsPathEnd(next)) {
+          dont_look_bits_[next] = false;
+        }
+        if (!IsPathEnd(previous_next)) {
+          dont_look_bits_[previous_next] = false;
+        }
+        dont_look_nexts_[i] = next;
+      }
+    }
+  }
+  // The exploration resumes in the middle of the current position of the
+  // first base node.
+  first_base_node_fully_explored_ = false;
+  skipped_base_nodes_ = false;
+  skip_base_nodes_ = true;
+}
+
 bool PathOperator::MakeOneNeighbor() {
-  while (IncrementPosition()) {
-    // Need to revert changes here since MakeNeighbor might have returned false
-    // and have done changes in the previous iteration.
-    RevertChanges(true);
-    if (MakeNeighbor()) {
-      return true;
+  bool skipped_neighbor = false;
+  for (;;) {
+    while (IncrementPosition()) {
+      // Need to revert changes here since MakeNeighbor might have returned
+      // false and have done changes in the previous iteration.
+      RevertChanges(true);
+      if (MakeNeighbor()) {
+        if (neighbors_ == nullptr || explore_neighbors_ ||
+            CreatesNeighborArc()) {
+          if (skipped_neighbor && IsIncremental()) {
+            // Incremental operators build on the skipped neighbors, the
+            // changes of which must therefore be part of the next deltadelta.
+            for (const int64 index : changes_.PositionsSetAtLeastOnce()) {
+              delta_changes_.Set(index);
+            }
+          }
+          return true;
+        }
+        skipped_neighbor = true;
+      }
+    }
+    if (!skipped_base_nodes_) {
+      return false;
+    }
+    // Positions were skipped: explore the whole neighborhood once more,
+    // without skipping any position, before failing. This exploration starts
+    // over from the end position as after a call to Start(), and is done at
+    // most once between two calls to Start().
+    skipped_base_nodes_ = false;
+    skip_base_nodes_ = false;
+    just_started_ = true;
+    OnNodeInitialization();
+  }
+}
+
+bool PathOperator::CreatesNeighborArc() const {
+  for (const int64 index : changes_.PositionsSetAtLeastOnce()) {
+    if (index < number_of_nexts_) {
+      const int64 next = Value(index);
+      if (next != index && next != OldValue(index)) {
+        const std::vector<int>& neighbors = *neighbors_->Run(index, Path(index));
+        if (std::binary_search(neighbors.begin(), neighbors.end(), next)) {
+          return true;
+        }
+      }
     }
   }
   return false;
 }
 
+int PathOperator::NumberOfNeighborsOfFirstBaseNode() const {
+  const int64 node = base_nodes_[0];
+  return IsPathEnd(node) ? 0 : neighbors_->Run(node, OldPath(node))->size();
+}
+
+int64 PathOperator::GetNeighborOfFirstBaseNode() const {
+  const int64 node = base_nodes_[0];
+  if (IsPathEnd(node)) {
+    return -1;
+  }
+  const std::vector<int>& neighbors = *neighbors_->Run(node, OldPath(node));
+  return neighbor_index_ < neighbors.size() ? neighbors[neighbor_index_] : -1;
+}
+
 bool PathOperator::SkipUnchanged(int index) const {
   if (ignore_path_vars_) {
     return true;
@@ -444,18 +547,26 @@ bool PathOperator::MakeChainInactive(int64 before_chain, int64 chain_end) {
 }
 
 bool PathOperator::CheckEnds() const {
-  const int base_node_size = base_nodes_.size();
+  const int base_node_size = NumberOfIteratedBaseNodes();
   for (int i = 0; i < base_node_size; ++i) {
     if (base_nodes_[i] != end_nodes_[i]) {
       return true;
     }
   }
-  return false;
+  return explore_neighbors_ && neighbor_index_ != end_neighbor_index_;
 }
 
 bool PathOperator::IncrementPosition() {
-  const int base_node_size = base_nodes_.size();
+  const int base_node_size = NumberOfIteratedBaseNodes();
   if (!just_started_) {
+    if (explore_neighbors_) {
+      // All the neighbors of the first base node are explored before it is
+      // moved.
+      if (++neighbor_index_ < NumberOfNeighborsOfFirstBaseNode()) {
+        return CheckEnds();
+      }
+      neighbor_index_ = 0;
+    }
     const int number_of_paths = path_starts_.size();
     // Finding next base node positions.
     // Increment the position of inner base nodes first (higher index nodes);
@@ -465,7 +576,11 @@ bool PathOperator::IncrementPosition() {
     int last_restarted = base_node_size;
     for (int i = base_node_size - 1; i >= 0; --i) {
       if (base_nodes_[i] < number_of_nexts_) {
-        base_nodes_[i] = OldNext(base_nodes_[i]);
+        if (i == 0 && use_dont_look_bits_) {
+          IncrementFirstBaseNode();
+        } else {
+          base_nodes_[i] = OldNext(base_nodes_[i]);
+        }
         break;
       }
       base_nodes_[i] = StartNode(i);
@@ -493,6 +608,7 @@ bool PathOperator::IncrementPosition() {
         base_paths_[i] = next_path_index;
         base_nodes_[i] = path_starts_[next_path_index];
         if (i == 0 || !OnSamePathAsPreviousBase(i)) {
+          first_base_node_fully_explored_ |= i == 0;
           return CheckEnds();
         }
       } else {
@@ -500,6 +616,7 @@ bool PathOperator::IncrementPosition() {
         base_nodes_[i] = path_starts_[0];
       }
     }
+    first_base_node_fully_explored_ = true;
   } else {
     just_started_ = false;
     return true;
@@ -507,6 +624,35 @@ bool PathOperator::IncrementPosition() {
   return CheckEnds();
 }
 
+void PathOperator::IncrementFirstBaseNode() {
+  int64 node = base_nodes_[0];
+  // The first base node goes through its path once for each path of the other
+  // base nodes; its position is only fully explored after the last one.
+  if (first_base_node_fully_explored_ && OtherBaseNodesOnLastPath()) {
+    dont_look_bits_[node] = true;
+  }
+  node = OldNext(node);
+  if (skip_base_nodes_) {
+    // Never skip the position at which the exploration must end.
+    while (!IsPathEnd(node) && node != end_nodes_[0] && dont_look_bits_[node]) {
+      node = OldNext(node);
+      skipped_base_nodes_ = true;
+    }
+  }
+  base_nodes_[0] = node;
+  first_base_node_fully_explored_ = true;
+}
+
+bool PathOperator::OtherBaseNodesOnLastPath() {
+  const int last_path = path_starts_.size() - 1;
+  for (int i = 1; i < NumberOfIteratedBaseNodes(); ++i) {
+    if (!OnSamePathAsPreviousBase(i) && base_paths_[i] != last_path) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void PathOperator::InitializePathStarts() {
   // Detect nodes which do not have any possible predecessor in a path; these
   // nodes are path starts.
@@ -573,6 +719,15 @@ void PathOperator::InitializeInactives() {
   for (int i = 0; i < number_of_nexts_; ++i) {
     inactives_.push_back(OldNext(i) == i);
   }
+  if (explore_neighbors_) {
+    prevs_.assign(number_of_nexts_, -1);
+    for (int i = 0; i < number_of_nexts_; ++i) {
+      const int64 next = OldNext(i);
+      if (next != i && !IsPathEnd(next)) {
+        prevs_[next] = i;
+      }
+    }
+  }
 }
 
 void PathOperator::InitializeBaseNodes() {
@@ -596,9 +751,16 @@ void PathOperator::InitializeBaseNodes() {
     }
     end_nodes_[i] = base_node;
   }
+  if (explore_neighbors_) {
+    // The neighbors of the first base node change with its path.
+    if (neighbor_index_ >= std::max(1, NumberOfNeighborsOfFirstBaseNode())) {
+      neighbor_index_ = 0;
+    }
+    end_neighbor_index_ = neighbor_index_;
+  }
   // Repair end_nodes_ in case some must be on the same path and are not anymore
   // (due to other operators moving these nodes).
-  for (int i = 1; i < base_nodes_.size(); ++i) {
+  for (int i = 1; i < NumberOfIteratedBaseNodes(); ++i) {
     if (OnSamePathAsPreviousBase(i) &&
         !OnSamePath(base_nodes_[i - 1], base_nodes_[i])) {
       const int64 base_node = base_nodes_[i - 1];
@@ -671,7 +833,8 @@ class TwoOpt : public PathOperator {
         last_(-1) {}
   virtual ~TwoOpt() {}
   virtual bool MakeNeighbor();
-  virtual bool IsIncremental() const { return true; }
+  // Neighbors built from neighbor lists are not built incrementally.
+  virtual bool IsIncremental() const { return !HasNeighbors(); }
 
   virtual std::string DebugString() const { return "TwoOpt"; }
 
@@ -680,6 +843,7 @@ class TwoOpt : public PathOperator {
     // Both base nodes have to be on the same path.
     return true;
   }
+  virtual bool ExploresNeighbors() const { return true; }
 
  private:
   virtual void OnNodeInitialization() { last_ = -1; }
@@ -689,6 +853,18 @@ class TwoOpt : public PathOperator {
 };
 
 bool TwoOpt::MakeNeighbor() {
+  if (HasNeighbors()) {
+    // Reverses the chain from the node after the first base node to its
+    // neighbor, creating the arc from the first base node to its neighbor.
+    const int64 base = BaseNode(0);
+    const int64 neighbor = GetNeighborOfFirstBaseNode();
+    if (IsPathEnd(base) || neighbor < 0 || IsPathEnd(neighbor) ||
+        IsInactive(neighbor) || Next(base) == neighbor) {
+      return false;
+    }
+    int64 chain_last;
+    return ReverseChain(base, Next(neighbor), &chain_last);
+  }
   DCHECK_EQ(StartNode(0), StartNode(1));
   if (last_base_ != BaseNode(0) || last_ == -1) {
     RevertChanges(false);
@@ -752,15 +928,35 @@ class Relocate : public PathOperator {
     // version.
     return single_path_;
   }
+  // Neighbors can be on any path, so only the multi-path version explores
+  // neighbor lists.
+  virtual bool ExploresNeighbors() const { return !single_path_; }
 
  private:
+  // Moves the chain of chain_length_ nodes after before_chain after
+  // destination.
+  bool MoveChainAfter(int64 before_chain, int64 destination);
+
   const int64 chain_length_;
   const bool single_path_;
 };
 
 bool Relocate::MakeNeighbor() {
+  if (HasNeighbors()) {
+    // Moves the chain starting at the neighbor of the first base node after
+    // the first base node.
+    const int64 neighbor = GetNeighborOfFirstBaseNode();
+    if (neighbor < 0 || IsPathEnd(neighbor) || IsInactive(neighbor) ||
+        OldPrev(neighbor) < 0) {
+      return false;
+    }
+    return MoveChainAfter(OldPrev(neighbor), BaseNode(0));
+  }
   DCHECK(!single_path_ || StartNode(0) == StartNode(1));
-  const int64 before_chain = BaseNode(0);
+  return MoveChainAfter(BaseNode(0), BaseNode(1));
+}
+
+bool Relocate::MoveChainAfter(int64 before_chain, int64 destination) {
   int64 chain_end = before_chain;
   for (int i = 0; i < chain_length_; ++i) {
     if (IsPathEnd(chain_end)) {
@@ -768,7 +964,6 @@ bool Relocate::MakeNeighbor() {
     }
     chain_end = Next(chain_end);
   }
-  const int64 destination = BaseNode(1);
   return MoveChain(before_chain, chain_end, destination);
 }
 
@@ -791,13 +986,28 @@ class Exchange : public PathOperator {
   virtual bool MakeNeighbor();
 
   virtual std::string DebugString() const { return "Exchange"; }
+
+ protected:
+  virtual bool ExploresNeighbors() const { return true; }
 };
 
 bool Exchange::MakeNeighbor() {
   const int64 prev_node0 = BaseNode(0);
   if (IsPathEnd(prev_node0)) return false;
   const int64 node0 = Next(prev_node0);
-  const int64 prev_node1 = BaseNode(1);
+  int64 prev_node1 = -1;
+  if (HasNeighbors()) {
+    // Exchanges the node after the first base node with the neighbor of the
+    // first base node.
+    const int64 neighbor = GetNeighborOfFirstBaseNode();
+    if (neighbor < 0 || IsPathEnd(neighbor) || IsInactive(neighbor)) {
+      return false;
+    }
+    prev_node1 = OldPrev(neighbor);
+    if (prev_node1 < 0) return false;
+  } else {
+    prev_node1 = BaseNode(1);
+  }
   if (IsPathEnd(prev_node1)) return false;
   const int64 node1 = Next(prev_node1);
   if (node0 == prev_node1) {
@@ -1827,6 +2037,172 @@ LocalSearchOperator* Solver::RandomConcatenateOperators(
   return RevAlloc(new RandomCompoundOperator(ops, seed));
 }
 
+namespace {
+// Compound operator which adapts the order in which operators are explored to
+// their past performance, following the UCB1 multi-armed bandit policy.
+// Each time Start() is called, the operator which produced the last neighbor
+// is rewarded with the objective improvement since the previous call to
+// Start(), divided by the number of neighbors it produced to get there; all
+// other operators which produced neighbors in between get a reward of 0.
+// Rewards are normalized by the best reward seen so far and averaged with an
+// exponential decay ('memory_coefficient'), so that operators which were
+// useful early in the search but stopped being so are gradually demoted.
+// Operators are then explored by decreasing score:
+//   average reward + exploration_coefficient *
+//                    sqrt(2 * log(1 + total neighbors) / (1 + neighbors)).
+// If the assignment has no objective, producing the last neighbor is
+// rewarded with 1.
+class MultiArmedBanditCompoundOperator : public LocalSearchOperator {
+ public:
+  MultiArmedBanditCompoundOperator(
+      const std::vector<LocalSearchOperator*>& operators,
+      double memory_coefficient, double exploration_coefficient,
+      bool maximize);
+  virtual ~MultiArmedBanditCompoundOperator() {}
+  virtual void Start(const Assignment* assignment);
+  virtual bool MakeNextNeighbor(Assignment* delta, Assignment* deltadelta);
+
+  virtual std::string DebugString() const {
+    return "MultiArmedBanditCompoundOperator";
+  }
+
+ private:
+  class ScoreComparator {
+   public:
+    explicit ScoreComparator(const std::vector<double>& scores)
+        : scores_(scores) {}
+    bool operator()(int lhs, int rhs) const {
+      return scores_[lhs] > scores_[rhs] ||
+             (scores_[lhs] == scores_[rhs] && lhs < rhs);
+    }
+
+   private:
+    const std::vector<double>& scores_;
+  };
+
+  void UpdateRewards(const Assignment* assignment);
+  double Score(int operator_index) const;
+
+  int index_;
+  int last_operator_;
+  bool has_last_objective_;
+  int64 last_objective_;
+  int64 total_neighbors_;
+  double max_reward_;
+  const double memory_coefficient_;
+  const double exploration_coefficient_;
+  const bool maximize_;
+  std::vector<LocalSearchOperator*> operators_;
+  std::vector<int> operator_indices_;
+  // Number of neighbors produced by each operator since the last Start().
+  std::vector<int64> episode_neighbors_;
+  std::vector<int64> neighbors_;
+  std::vector<double> average_rewards_;
+  std::vector<double> scores_;
+};
+
+MultiArmedBanditCompoundOperator::MultiArmedBanditCompoundOperator(
+    const std::vector<LocalSearchOperator*>& operators,
+    double memory_coefficient, double exploration_coefficient, bool maximize)
+    : index_(0),
+      last_operator_(-1),
+      has_last_objective_(false),
+      last_objective_(0),
+      total_neighbors_(0),
+      max_reward_(0),
+      memory_coefficient_(memory_coefficient),
+      exploration_coefficient_(exploration_coefficient),
+      maximize_(maximize) {
+  CHECK_GE(memory_coefficient_, 0);
+  CHECK_LE(memory_coefficient_, 1);
+  CHECK_GE(exploration_coefficient_, 0);
+  for (int i = 0; i < operators.size(); ++i) {
+    if (operators[i] != nullptr) {
+      operator_indices_.push_back(operators_.size());
+      operators_.push_back(operators[i]);
+    }
+  }
+  episode_neighbors_.resize(operators_.size(), 0);
+  neighbors_.resize(operators_.size(), 0);
+  average_rewards_.resize(operators_.size(), 0);
+  scores_.resize(operators_.size(), 0);
+}
+
+void MultiArmedBanditCompoundOperator::UpdateRewards(
+    const Assignment* assignment) {
+  double improvement = last_operator_ != -1 ? 1 : 0;
+  if (assignment != nullptr && assignment->HasObjective()) {
+    const int64 objective = assignment->ObjectiveValue();
+    if (has_last_objective_) {
+      improvement = maximize_ ? objective - last_objective_
+                              : last_objective_ - objective;
+    } else {
+      improvement = 0;
+    }
+    has_last_objective_ = true;
+    last_objective_ = objective;
+  }
+  double last_reward = 0;
+  if (last_operator_ != -1 && improvement > 0) {
+    last_reward = improvement / episode_neighbors_[last_operator_];
+    max_reward_ = std::max(max_reward_, last_reward);
+  }
+  for (int i = 0; i < operators_.size(); ++i) {
+    if (episode_neighbors_[i] > 0) {
+      const double reward =
+          i == last_operator_ && last_reward > 0 ? last_reward / max_reward_
+                                                 : 0;
+      average_rewards_[i] +=
+          memory_coefficient_ * (reward - average_rewards_[i]);
+      episode_neighbors_[i] = 0;
+    }
+  }
+}
+
+double MultiArmedBanditCompoundOperator::Score(int operator_index) const {
+  return average_rewards_[operator_index] +
+         exploration_coefficient_ *
+             sqrt(2 * log(1.0 + total_neighbors_) /
+                  (1 + neighbors_[operator_index]));
+}
+
+void MultiArmedBanditCompoundOperator::Start(const Assignment* assignment) {
+  UpdateRewards(assignment);
+  last_operator_ = -1;
+  index_ = 0;
+  for (int i = 0; i < operators_.size(); ++i) {
+    operators_[i]->Start(assignment);
+    scores_[i] = Score(i);
+  }
+  std::sort(operator_indices_.begin(), operator_indices_.end(),
+            ScoreComparator(scores_));
+}
+
+bool MultiArmedBanditCompoundOperator::MakeNextNeighbor(
+    Assignment* delta, Assignment* deltadelta) {
+  while (index_ < operator_indices_.size()) {
+    const int operator_index = operator_indices_[index_];
+    if (operators_[operator_index]->MakeNextNeighbor(delta, deltadelta)) {
+      ++episode_neighbors_[operator_index];
+      ++neighbors_[operator_index];
+      ++total_neighbors_;
+      last_operator_ = operator_index;
+      return true;
+    }
+    ++index_;
+  }
+  last_operator_ = -1;
+  return false;
+}
+}  // namespace
+
+LocalSearchOperator* Solver::MultiArmedBanditConcatenateOperators(
+    const std::vector<LocalSearchOperator*>& ops, double memory_coefficient,
+    double exploration_coefficient, bool maximize) {
+  return RevAlloc(new MultiArmedBanditCompoundOperator(
+      ops, memory_coefficient, exploration_coefficient, maximize));
+}
+
 // ----- Operator factory -----
 
 template <class T>
@@ -1859,6 +2235,26 @@ MAKE_LOCAL_SEARCH_OPERATOR(ExtendedSwapActiveOperator)
 
 #undef MAKE_LOCAL_SEARCH_OPERATOR
 
+#define MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR(OperatorClass)                   \
+  template <>                                                                \
+  LocalSearchOperator* MakeGranularLocalSearchOperator<OperatorClass>(       \
+      Solver* solver, const std::vector<IntVar*>& vars,                           \
+      const std::vector<IntVar*>& secondary_vars,                                 \
+      ResultCallback1<int, int64>* start_empty_path_class,                   \
+      ResultCallback2<const std::vector<int>*, int64, int64>* neighbors) {    \
+    OperatorClass* const path_operator = solver->RevAlloc(                   \
+        new OperatorClass(vars, secondary_vars, start_empty_path_class));    \
+    path_operator->SetNeighbors(neighbors);                                  \
+    return path_operator;                                                    \
+  }
+
+MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR(TwoOpt)
+MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR(Relocate)
+MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR(Exchange)
+MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR(Cross)
+
+#undef MAKE_GRANULAR_LOCAL_SEARCH_OPERATOR
+
 LocalSearchOperator* Solver::MakeOperator(const std::vector<IntVar*>& vars,
                                           Solver::LocalSearchOperators op) {
   return MakeOperator(vars, std::vector<IntVar*>(), op);
@@ -2113,8 +2509,19 @@ IntVarLocalSearchFilter::IntVarLocalSearchFilter(const std::vector<IntVar*>& var
 
 void IntVarLocalSearchFilter::AddVars(const std::vector<IntVar*>& vars) {
   if (!vars.empty()) {
+    const int kMaxDenseIndexPerVar = 4;
+    const int max_dense_index =
+        kMaxDenseIndexPerVar * (vars_.size() + vars.size());
     for (int i = 0; i < vars.size(); ++i) {
-      var_to_index_[vars[i]] = i + vars_.size();
+      const int var_index = vars[i]->index();
+      if (var_index >= 0 && var_index < max_dense_index) {
+        if (var_index >= var_index_to_index_.size()) {
+          var_index_to_index_.resize(var_index + 1, -1);
+        }
+        var_index_to_index_[var_index] = i + vars_.size();
+      } else {
+        var_to_index_[vars[i]] = i + vars_.size();
+      }
     }
     vars_.insert(vars_.end(), vars.begin(), vars.end());
     values_.resize(vars_.size(), /*junk*/ 0);
@@ -2497,19 +2904,193 @@ LocalSearchFilter* Solver::MakeLocalSearchObjectiveFilter(
 
 // ----- Finds a neighbor of the assignment passed -----
 
+namespace {
+// Calls the filters on the delta; returns true if all of them accept it.
+bool FiltersAccept(const std::vector<LocalSearchFilter*>& filters,
+                   const Assignment* delta, const Assignment* deltadelta) {
+  bool ok = true;
+  for (int i = 0; i < filters.size(); ++i) {
+    if (filters[i]->IsIncremental()) {
+      ok = filters[i]->Accept(delta, deltadelta) && ok;
+    } else {
+      ok = ok && filters[i]->Accept(delta, deltadelta);
+    }
+  }
+  return ok;
+}
+
+// Screens the neighbors of a local search operator with filters, possibly in
+// a worker thread. All the screeners of a FindOneNeighbor own replicas of the
+// same operator and filters, generate the same sequence of neighbors, and
+// each of them only filters its own blocks of this sequence.
+class NeighborScreener {
+ public:
+  NeighborScreener(Solver* const solver, LocalSearchOperator* const ls_operator,
+                   const std::vector<LocalSearchFilter*>& filters)
+      : ls_operator_(ls_operator),
+        filters_(filters),
+        delta_(solver->MakeAssignment()),
+        deltadelta_(solver->MakeAssignment()),
+        objective_(nullptr),
+        objective_min_(kint64min),
+        objective_max_(kint64max),
+        start_needed_(false),
+        num_neighbors_(0),
+        num_screened_(0),
+        exhausted_(false) {
+    CHECK(nullptr != ls_operator);
+  }
+  ~NeighborScreener() { STLDeleteElements(&candidates_); }
+
+  // The operator and the filters will start from a copy of the given
+  // assignment at the next call to Screen(), in the thread of the screener.
+  // Must be called from the thread owning 'reference': even reading an
+  // assignment updates its index of variables.
+  void Synchronize(const Assignment* const reference) {
+    if (reference_ == nullptr) {
+      reference_.reset(new Assignment(reference));
+    } else {
+      reference_->Copy(reference);
+    }
+    start_needed_ = true;
+    exhausted_ = false;
+  }
+
+  // Sets the bound on the objective given to the filters in the deltas, from
+  // the objective of 'bound' if it has one.
+  void SetObjectiveBound(const Assignment* const bound) {
+    if (bound->HasObjective()) {
+      objective_ = bound->Objective();
+      objective_min_ = bound->ObjectiveMin();
+      objective_max_ = bound->ObjectiveMax();
+    } else {
+      objective_ = nullptr;
+    }
+  }
+
+  // Generates the neighbors up to the end-th one, and keeps the ones in
+  // [begin, end) which are accepted by the filters.
+  void Screen(int64 begin, int64 end) {
+    if (start_needed_) {
+      ls_operator_->Start(reference_.get());
+      for (int i = 0; i < filters_.size(); ++i) {
+        filters_[i]->Synchronize(reference_.get());
+      }
+      start_needed_ = false;
+      num_neighbors_ = 0;
+    }
+    STLDeleteElements(&candidates_);
+    num_screened_ = 0;
+    while (num_neighbors_ < end && !exhausted_) {
+      delta_->Clear();
+      deltadelta_->Clear();
+      if (!ls_operator_->MakeNextNeighbor(delta_, deltadelta_)) {
+        exhausted_ = true;
+        break;
+      }
+      const int64 index = num_neighbors_++;
+      if (index < begin) {
+        continue;
+      }
+      // The filters did not see the previous neighbor of a block.
+      if (index == begin) {
+        deltadelta_->Clear();
+      }
+      ++num_screened_;
+      // As in the sequential loop, the filters get the objective bound of the
+      // metaheuristic. Candidates keep their own bound, which the
+      // metaheuristic sets again on the master.
+      const bool bound_objective =
+          objective_ != nullptr &&
+          (!delta_->HasObjective() || delta_->Objective() == objective_);
+      int64 delta_objective_min = kint64min;
+      int64 delta_objective_max = kint64max;
+      if (bound_objective) {
+        if (!delta_->HasObjective()) {
+          delta_->AddObjective(objective_);
+        }
+        delta_objective_min = delta_->ObjectiveMin();
+        delta_objective_max = delta_->ObjectiveMax();
+        delta_->SetObjectiveRange(std::max(objective_min_, delta_objective_min),
+                                  std::min(objective_max_, delta_objective_max));
+      }
+      if (FiltersAccept(filters_, delta_, deltadelta_)) {
+        Assignment* const candidate = new Assignment(delta_);
+        if (bound_objective) {
+          candidate->SetObjectiveRange(delta_objective_min, delta_objective_max);
+        }
+        candidates_.push_back(candidate);
+      }
+    }
+  }
+
+  // The deltas accepted by the last call to Screen(), in neighborhood order.
+  const std::vector<Assignment*>& candidates() const { return candidates_; }
+  int64 num_screened() const { return num_screened_; }
+  bool exhausted() const { return exhausted_; }
+
+ private:
+  LocalSearchOperator* const ls_operator_;
+  const std::vector<LocalSearchFilter*> filters_;
+  Assignment* const delta_;
+  Assignment* const deltadelta_;
+  std::unique_ptr<Assignment> reference_;
+  IntVar* objective_;
+  int64 objective_min_;
+  int64 objective_max_;
+  bool start_needed_;
+  int64 num_neighbors_;
+  int64 num_screened_;
+  bool exhausted_;
+  std::vector<Assignment*> candidates_;
+  DISALLOW_COPY_AND_ASSIGN(NeighborScreener);
+};
+
+// Screens a block of neighbors, then waits for the other screeners of the
+// round. The last thread to leave the barrier deletes it.
+void ScreenAndWait(NeighborScreener* const screener, int64 begin, int64 end,
+                   Barrier* const barrier) {
+  screener->Screen(begin, end);
+  if (barrier->Block()) {
+    delete barrier;
+  }
+}
+}  // namespace
+
+// When replicas of the operator and of the filters are given, the neighbors
+// are screened in parallel by one NeighborScreener per replica, the first one
+// using the operator and the filters of the FindOneNeighbor. The screeners
+// filter consecutive blocks of the neighborhood in turn, and only the deltas
+// accepted by the filters are checked by the metaheuristic and restored in
+// the solver, in neighborhood order.
 class FindOneNeighbor : public DecisionBuilder {
  public:
   FindOneNeighbor(Assignment* const assignment, SolutionPool* const pool,
                   LocalSearchOperator* const ls_operator,
                   DecisionBuilder* const sub_decision_builder,
                   const SearchLimit* const limit,
-                  const std::vector<LocalSearchFilter*>& filters);
-  virtual ~FindOneNeighbor() {}
+                  const std::vector<LocalSearchFilter*>& filters,
+                  const std::vector<LocalSearchOperator*>& operator_replicas,
+                  const std::vector<std::vector<LocalSearchFilter*> >&
+                      filter_replicas);
+  virtual ~FindOneNeighbor() {
+    thread_pool_.reset(nullptr);
+    STLDeleteElements(&screeners_);
+  }
   virtual Decision* Next(Solver* const solver);
   virtual std::string DebugString() const { return "FindOneNeighbor"; }
 
  private:
   bool FilterAccept(const Assignment* delta, const Assignment* deltadelta);
+  DecisionBuilder* MakeRestoreNeighbor(Solver* const solver,
+                                       Assignment* const assignment_copy);
+  bool RestoreNeighbor(Solver* const solver, DecisionBuilder* const restore,
+                       Assignment* const assignment_copy,
+                       const Assignment* const delta);
+  bool SynchronizeOnNeighborFound(Solver* const solver);
+  bool FindNeighborInParallel(Solver* const solver);
+  Assignment* NextCandidate(Solver* const solver);
+  void ScreenNeighbors(Solver* const solver);
   void SynchronizeAll();
   void SynchronizeFilters(const Assignment* assignment);
 
@@ -2522,17 +3103,30 @@ class FindOneNeighbor : public DecisionBuilder {
   const SearchLimit* const original_limit_;
   bool neighbor_found_;
   std::vector<LocalSearchFilter*> filters_;
+  // Parallel screening; empty if there are no replicas.
+  std::vector<NeighborScreener*> screeners_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  // Empty delta on which the metaheuristic sets the objective bound given to
+  // the screeners.
+  std::unique_ptr<Assignment> objective_bound_;
+  std::unique_ptr<Assignment> empty_deltadelta_;
+  int64 next_neighbor_;
+  int64 block_size_;
+  int current_screener_;
+  int current_candidate_;
 };
 
 // reference_assignment_ is used to keep track of the last assignment on which
 // operators were started, assignment_ corresponding to the last successful
 // neighbor.
-FindOneNeighbor::FindOneNeighbor(Assignment* const assignment,
-                                 SolutionPool* const pool,
-                                 LocalSearchOperator* const ls_operator,
-                                 DecisionBuilder* const sub_decision_builder,
-                                 const SearchLimit* const limit,
-                                 const std::vector<LocalSearchFilter*>& filters)
+FindOneNeighbor::FindOneNeighbor(
+    Assignment* const assignment, SolutionPool* const pool,
+    LocalSearchOperator* const ls_operator,
+    DecisionBuilder* const sub_decision_builder,
+    const SearchLimit* const limit,
+    const std::vector<LocalSearchFilter*>& filters,
+    const std::vector<LocalSearchOperator*>& operator_replicas,
+    const std::vector<std::vector<LocalSearchFilter*> >& filter_replicas)
     : assignment_(assignment),
       reference_assignment_(new Assignment(assignment_)),
       pool_(pool),
@@ -2541,17 +3135,31 @@ FindOneNeighbor::FindOneNeighbor(Assignment* const assignment,
       limit_(nullptr),
       original_limit_(limit),
       neighbor_found_(false),
-      filters_(filters) {
+      filters_(filters),
+      next_neighbor_(0),
+      block_size_(1),
+      current_screener_(0),
+      current_candidate_(0) {
   CHECK(nullptr != assignment);
   CHECK(nullptr != ls_operator);
+  CHECK_EQ(operator_replicas.size(), filter_replicas.size());
 
+  Solver* const solver = assignment_->solver();
   // If limit is nullptr, default limit is 1 solution
   if (nullptr == limit) {
-    Solver* const solver = assignment_->solver();
     limit_ = solver->MakeLimit(kint64max, kint64max, kint64max, 1);
   } else {
     limit_ = limit->MakeClone();
   }
+  if (!operator_replicas.empty()) {
+    objective_bound_.reset(new Assignment(solver));
+    empty_deltadelta_.reset(new Assignment(solver));
+    screeners_.push_back(new NeighborScreener(solver, ls_operator, filters));
+    for (int i = 0; i < operator_replicas.size(); ++i) {
+      screeners_.push_back(new NeighborScreener(solver, operator_replicas[i],
+                                                filter_replicas[i]));
+    }
+  }
 }
 
 Decision* FindOneNeighbor::Next(Solver* const solver) {
@@ -2572,16 +3180,21 @@ Decision* FindOneNeighbor::Next(Solver* const solver) {
     SynchronizeAll();
   }
 
+  if (!screeners_.empty()) {
+    if (FindNeighborInParallel(solver)) {
+      return nullptr;
+    }
+    solver->Fail();
+    return nullptr;
+  }
+
   {
     // Another assignment is needed to apply the delta
     Assignment* assignment_copy =
         solver->MakeAssignment(reference_assignment_.get());
     int counter = 0;
 
-    DecisionBuilder* restore = solver->MakeRestoreAssignment(assignment_copy);
-    if (sub_decision_builder_) {
-      restore = solver->Compose(restore, sub_decision_builder_);
-    }
+    DecisionBuilder* restore = MakeRestoreNeighbor(solver, assignment_copy);
     Assignment* delta = solver->MakeAssignment();
     Assignment* deltadelta = solver->MakeAssignment();
     while (true) {
@@ -2606,28 +3219,12 @@ Decision* FindOneNeighbor::Next(Solver* const solver) {
         const bool mh_filter =
             AcceptDelta(solver->ParentSearch(), delta, deltadelta);
         const bool move_filter = FilterAccept(delta, deltadelta);
-        if (mh_filter && move_filter) {
-          solver->filtered_neighbors_ += 1;
-          assignment_copy->Copy(reference_assignment_.get());
-          assignment_copy->Copy(delta);
-          if (solver->SolveAndCommit(restore)) {
-            solver->accepted_neighbors_ += 1;
-            assignment_->Store();
-            neighbor_found_ = true;
-            return nullptr;
-          }
-        }
-      } else {
-        if (neighbor_found_) {
-          AcceptNeighbor(solver->ParentSearch());
-          // Keeping the code in case a performance problem forces us to
-          // use the old code with a zero test on pool_.
-          //          reference_assignment_->Copy(assignment_);
-          pool_->RegisterNewSolution(assignment_);
-          SynchronizeAll();
-        } else {
-          break;
+        if (mh_filter && move_filter &&
+            RestoreNeighbor(solver, restore, assignment_copy, delta)) {
+          return nullptr;
         }
+      } else if (!SynchronizeOnNeighborFound(solver)) {
+        break;
       }
     }
   }
@@ -2637,23 +3234,162 @@ Decision* FindOneNeighbor::Next(Solver* const solver) {
 
 bool FindOneNeighbor::FilterAccept(const Assignment* delta,
                                    const Assignment* deltadelta) {
-  bool ok = true;
-  for (int i = 0; i < filters_.size(); ++i) {
-    if (filters_[i]->IsIncremental()) {
-      ok = filters_[i]->Accept(delta, deltadelta) && ok;
-    } else {
-      ok = ok && filters_[i]->Accept(delta, deltadelta);
+  return FiltersAccept(filters_, delta, deltadelta);
+}
+
+// Returns a decision builder restoring 'assignment_copy' then running the
+// sub decision builder.
+DecisionBuilder* FindOneNeighbor::MakeRestoreNeighbor(
+    Solver* const solver, Assignment* const assignment_copy) {
+  DecisionBuilder* restore = solver->MakeRestoreAssignment(assignment_copy);
+  if (sub_decision_builder_) {
+    restore = solver->Compose(restore, sub_decision_builder_);
+  }
+  return restore;
+}
+
+// Restores the neighbor defined by 'delta', accepted by the metaheuristic and
+// by the filters, in the solver. Returns true if it is a solution, which is
+// then stored in assignment_.
+bool FindOneNeighbor::RestoreNeighbor(Solver* const solver,
+                                      DecisionBuilder* const restore,
+                                      Assignment* const assignment_copy,
+                                      const Assignment* const delta) {
+  solver->filtered_neighbors_ += 1;
+  assignment_copy->Copy(reference_assignment_.get());
+  assignment_copy->Copy(delta);
+  if (solver->SolveAndCommit(restore)) {
+    solver->accepted_neighbors_ += 1;
+    assignment_->Store();
+    neighbor_found_ = true;
+    return true;
+  }
+  return false;
+}
+
+// Called when the neighborhood is exhausted. If a neighbor was found, it is
+// accepted and the search goes on from it, and true is returned.
+bool FindOneNeighbor::SynchronizeOnNeighborFound(Solver* const solver) {
+  if (!neighbor_found_) {
+    return false;
+  }
+  AcceptNeighbor(solver->ParentSearch());
+  // Keeping the code in case a performance problem forces us to
+  // use the old code with a zero test on pool_.
+  //          reference_assignment_->Copy(assignment_);
+  pool_->RegisterNewSolution(assignment_);
+  SynchronizeAll();
+  return true;
+}
+
+// Same as the sequential loop of Next(), on the deltas accepted by the
+// screeners. Returns true if a neighbor was found.
+bool FindOneNeighbor::FindNeighborInParallel(Solver* const solver) {
+  Assignment* assignment_copy =
+      solver->MakeAssignment(reference_assignment_.get());
+  int counter = 0;
+
+  DecisionBuilder* restore = MakeRestoreNeighbor(solver, assignment_copy);
+  // The candidates are not consecutive neighbors: the metaheuristic gets no
+  // deltadelta.
+  Assignment* deltadelta = solver->MakeAssignment();
+  while (true) {
+    solver->TopPeriodicCheck();
+    if (++counter >= FLAGS_cp_local_search_sync_frequency &&
+        pool_->SyncNeeded(reference_assignment_.get())) {
+      counter = 0;
+      SynchronizeAll();
+    }
+    Assignment* const delta =
+        limit_->Check() ? nullptr : NextCandidate(solver);
+    if (delta != nullptr) {
+      if (AcceptDelta(solver->ParentSearch(), delta, deltadelta) &&
+          RestoreNeighbor(solver, restore, assignment_copy, delta)) {
+        return true;
+      }
+    } else if (!SynchronizeOnNeighborFound(solver)) {
+      return false;
     }
   }
-  return ok;
+}
+
+// Returns the next candidate in neighborhood order, screening more neighbors
+// if needed, or nullptr if the neighborhood is exhausted.
+Assignment* FindOneNeighbor::NextCandidate(Solver* const solver) {
+  while (true) {
+    while (current_screener_ < screeners_.size()) {
+      const std::vector<Assignment*>& candidates =
+          screeners_[current_screener_]->candidates();
+      if (current_candidate_ < candidates.size()) {
+        return candidates[current_candidate_++];
+      }
+      ++current_screener_;
+      current_candidate_ = 0;
+    }
+    // The last screener generates all the neighbors of a round.
+    if (screeners_.back()->exhausted()) {
+      return nullptr;
+    }
+    ScreenNeighbors(solver);
+  }
+}
+
+// Screens the next round of neighbors, each screener filtering its own block,
+// the first one in the current thread. The blocks are small after a
+// synchronization, as a neighbor is then often found early, and grow
+// exponentially up to FLAGS_cp_local_search_screening_block_size.
+void FindOneNeighbor::ScreenNeighbors(Solver* const solver) {
+  // The filters of the screeners get the objective bound which the
+  // metaheuristic sets on an empty delta, read on the master thread.
+  objective_bound_->Clear();
+  empty_deltadelta_->Clear();
+  AcceptDelta(solver->ParentSearch(), objective_bound_.get(),
+              empty_deltadelta_.get());
+  for (int i = 0; i < screeners_.size(); ++i) {
+    screeners_[i]->SetObjectiveBound(objective_bound_.get());
+  }
+  const int64 block_size = block_size_;
+  block_size_ = std::min(2 * block_size_,
+                         std::max<int64>(
+                             1, FLAGS_cp_local_search_screening_block_size));
+  const int num_screeners = screeners_.size();
+  if (thread_pool_ == nullptr) {
+    thread_pool_.reset(
+        new ThreadPool("LocalSearchScreening", num_screeners - 1));
+    thread_pool_->StartWorkers();
+  }
+  Barrier* const barrier = new Barrier(num_screeners);
+  for (int i = 1; i < num_screeners; ++i) {
+    const int64 begin = next_neighbor_ + i * block_size;
+    thread_pool_->Add(NewCallback(&ScreenAndWait, screeners_[i], begin,
+                                  begin + block_size, barrier));
+  }
+  ScreenAndWait(screeners_[0], next_neighbor_, next_neighbor_ + block_size,
+                barrier);
+  next_neighbor_ += num_screeners * block_size;
+  for (int i = 0; i < num_screeners; ++i) {
+    solver->neighbors_ += screeners_[i]->num_screened();
+  }
+  current_screener_ = 0;
+  current_candidate_ = 0;
 }
 
 void FindOneNeighbor::SynchronizeAll() {
   pool_->GetNextSolution(reference_assignment_.get());
   neighbor_found_ = false;
   limit_->Init();
-  ls_operator_->Start(reference_assignment_.get());
-  SynchronizeFilters(reference_assignment_.get());
+  if (screeners_.empty()) {
+    ls_operator_->Start(reference_assignment_.get());
+    SynchronizeFilters(reference_assignment_.get());
+  } else {
+    for (int i = 0; i < screeners_.size(); ++i) {
+      screeners_[i]->Synchronize(reference_assignment_.get());
+    }
+    next_neighbor_ = 0;
+    block_size_ = 1;
+    current_screener_ = screeners_.size();
+    current_candidate_ = 0;
+  }
 }
 
 void FindOneNeighbor::SynchronizeFilters(const Assignment* assignment) {
@@ -2666,16 +3402,19 @@ void FindOneNeighbor::SynchronizeFilters(const Assignment* assignment) {
 
 class LocalSearchPhaseParameters : public BaseObject {
  public:
-  LocalSearchPhaseParameters(SolutionPool* const pool,
-                             LocalSearchOperator* ls_operator,
-                             DecisionBuilder* sub_decision_builder,
-                             SearchLimit* const limit,
-                             const std::vector<LocalSearchFilter*>& filters)
+  LocalSearchPhaseParameters(
+      SolutionPool* const pool, LocalSearchOperator* ls_operator,
+      DecisionBuilder* sub_decision_builder, SearchLimit* const limit,
+      const std::vector<LocalSearchFilter*>& filters,
+      const std::vector<LocalSearchOperator*>& operator_replicas,
+      const std::vector<std::vector<LocalSearchFilter*> >& filter_replicas)
       : solution_pool_(pool),
         ls_operator_(ls_operator),
         sub_decision_builder_(sub_decision_builder),
         limit_(limit),
-        filters_(filters) {}
+        filters_(filters),
+        operator_replicas_(operator_replicas),
+        filter_replicas_(filter_replicas) {}
   ~LocalSearchPhaseParameters() {}
   virtual std::string DebugString() const { return "LocalSearchPhaseParameters"; }
 
@@ -2686,6 +3425,12 @@ class LocalSearchPhaseParameters : public BaseObject {
   }
   SearchLimit* limit() const { return limit_; }
   const std::vector<LocalSearchFilter*>& filters() const { return filters_; }
+  const std::vector<LocalSearchOperator*>& operator_replicas() const {
+    return operator_replicas_;
+  }
+  const std::vector<std::vector<LocalSearchFilter*> >& filter_replicas() const {
+    return filter_replicas_;
+  }
 
  private:
   SolutionPool* const solution_pool_;
@@ -2693,6 +3438,8 @@ class LocalSearchPhaseParameters : public BaseObject {
   DecisionBuilder* const sub_decision_builder_;
   SearchLimit* const limit_;
   std::vector<LocalSearchFilter*> filters_;
+  std::vector<LocalSearchOperator*> operator_replicas_;
+  std::vector<std::vector<LocalSearchFilter*> > filter_replicas_;
 };
 
 LocalSearchPhaseParameters* Solver::MakeLocalSearchPhaseParameters(
@@ -2738,7 +3485,21 @@ LocalSearchPhaseParameters* Solver::MakeLocalSearchPhaseParameters(
     DecisionBuilder* const sub_decision_builder, SearchLimit* const limit,
     const std::vector<LocalSearchFilter*>& filters) {
   return RevAlloc(new LocalSearchPhaseParameters(
-      pool, ls_operator, sub_decision_builder, limit, filters));
+      pool, ls_operator, sub_decision_builder, limit, filters,
+      std::vector<LocalSearchOperator*>(),
+      std::vector<std::vector<LocalSearchFilter*> >()));
+}
+
+LocalSearchPhaseParameters* Solver::MakeLocalSearchPhaseParameters(
+    LocalSearchOperator* const ls_operator,
+    DecisionBuilder* const sub_decision_builder, SearchLimit* const limit,
+    const std::vector<LocalSearchFilter*>& filters,
+    const std::vector<LocalSearchOperator*>& operator_replicas,
+    const std::vector<std::vector<LocalSearchFilter*> >& filter_replicas) {
+  CHECK_EQ(operator_replicas.size(), filter_replicas.size());
+  return RevAlloc(new LocalSearchPhaseParameters(
+      MakeDefaultSolutionPool(), ls_operator, sub_decision_builder, limit,
+      filters, operator_replicas, filter_replicas));
 }
 
 namespace {
@@ -2826,7 +3587,10 @@ class LocalSearch : public DecisionBuilder {
               LocalSearchOperator* const ls_operator,
               DecisionBuilder* const sub_decision_builder,
               SearchLimit* const limit,
-              const std::vector<LocalSearchFilter*>& filters);
+              const std::vector<LocalSearchFilter*>& filters,
+              const std::vector<LocalSearchOperator*>& operator_replicas,
+              const std::vector<std::vector<LocalSearchFilter*> >&
+                  filter_replicas);
   // TODO(user): find a way to not have to pass vars here: redundant with
   // variables in operators
   LocalSearch(const std::vector<IntVar*>& vars, SolutionPool* const pool,
@@ -2834,13 +3598,19 @@ class LocalSearch : public DecisionBuilder {
               LocalSearchOperator* const ls_operator,
               DecisionBuilder* const sub_decision_builder,
               SearchLimit* const limit,
-              const std::vector<LocalSearchFilter*>& filters);
+              const std::vector<LocalSearchFilter*>& filters,
+              const std::vector<LocalSearchOperator*>& operator_replicas,
+              const std::vector<std::vector<LocalSearchFilter*> >&
+                  filter_replicas);
   LocalSearch(const std::vector<SequenceVar*>& vars, SolutionPool* const pool,
               DecisionBuilder* const first_solution,
               LocalSearchOperator* const ls_operator,
               DecisionBuilder* const sub_decision_builder,
               SearchLimit* const limit,
-              const std::vector<LocalSearchFilter*>& filters);
+              const std::vector<LocalSearchFilter*>& filters,
+              const std::vector<LocalSearchOperator*>& operator_replicas,
+              const std::vector<std::vector<LocalSearchFilter*> >&
+                  filter_replicas);
   virtual ~LocalSearch();
   virtual Decision* Next(Solver* const solver);
   virtual std::string DebugString() const { return "LocalSearch"; }
@@ -2859,6 +3629,8 @@ class LocalSearch : public DecisionBuilder {
   int nested_decision_index_;
   SearchLimit* const limit_;
   const std::vector<LocalSearchFilter*> filters_;
+  const std::vector<LocalSearchOperator*> operator_replicas_;
+  const std::vector<std::vector<LocalSearchFilter*> > filter_replicas_;
   bool has_started_;
 };
 
@@ -2866,7 +3638,11 @@ LocalSearch::LocalSearch(Assignment* const assignment, SolutionPool* const pool,
                          LocalSearchOperator* const ls_operator,
                          DecisionBuilder* const sub_decision_builder,
                          SearchLimit* const limit,
-                         const std::vector<LocalSearchFilter*>& filters)
+                         const std::vector<LocalSearchFilter*>& filters,
+                         const std::vector<LocalSearchOperator*>&
+                             operator_replicas,
+                         const std::vector<std::vector<LocalSearchFilter*> >&
+                             filter_replicas)
     : assignment_(assignment),
       pool_(pool),
       ls_operator_(ls_operator),
@@ -2874,6 +3650,8 @@ LocalSearch::LocalSearch(Assignment* const assignment, SolutionPool* const pool,
       nested_decision_index_(0),
       limit_(limit),
       filters_(filters),
+      operator_replicas_(operator_replicas),
+      filter_replicas_(filter_replicas),
       has_started_(false) {
   CHECK(nullptr != assignment);
   CHECK(nullptr != ls_operator);
@@ -2888,7 +3666,11 @@ LocalSearch::LocalSearch(const std::vector<IntVar*>& vars, SolutionPool* const p
                          LocalSearchOperator* const ls_operator,
                          DecisionBuilder* const sub_decision_builder,
                          SearchLimit* const limit,
-                         const std::vector<LocalSearchFilter*>& filters)
+                         const std::vector<LocalSearchFilter*>& filters,
+                         const std::vector<LocalSearchOperator*>&
+                             operator_replicas,
+                         const std::vector<std::vector<LocalSearchFilter*> >&
+                             filter_replicas)
     : assignment_(nullptr),
       pool_(pool),
       ls_operator_(ls_operator),
@@ -2896,6 +3678,8 @@ LocalSearch::LocalSearch(const std::vector<IntVar*>& vars, SolutionPool* const p
       nested_decision_index_(0),
       limit_(limit),
       filters_(filters),
+      operator_replicas_(operator_replicas),
+      filter_replicas_(filter_replicas),
       has_started_(false) {
   CHECK(nullptr != first_solution);
   CHECK(nullptr != ls_operator);
@@ -2913,7 +3697,11 @@ LocalSearch::LocalSearch(const std::vector<SequenceVar*>& vars,
                          LocalSearchOperator* const ls_operator,
                          DecisionBuilder* const sub_decision_builder,
                          SearchLimit* const limit,
-                         const std::vector<LocalSearchFilter*>& filters)
+                         const std::vector<LocalSearchFilter*>& filters,
+                         const std::vector<LocalSearchOperator*>&
+                             operator_replicas,
+                         const std::vector<std::vector<LocalSearchFilter*> >&
+                             filter_replicas)
     : assignment_(nullptr),
       pool_(pool),
       ls_operator_(ls_operator),
@@ -2921,6 +3709,8 @@ LocalSearch::LocalSearch(const std::vector<SequenceVar*>& vars,
       nested_decision_index_(0),
       limit_(limit),
       filters_(filters),
+      operator_replicas_(operator_replicas),
+      filter_replicas_(filter_replicas),
       has_started_(false) {
   CHECK(nullptr != first_solution);
   CHECK(nullptr != ls_operator);
@@ -3030,7 +3820,8 @@ void LocalSearch::PushLocalSearchDecision() {
   Solver* const solver = assignment_->solver();
   DecisionBuilder* find_neighbors = solver->RevAlloc(
       new FindOneNeighbor(assignment_, pool_, ls_operator_,
-                          sub_decision_builder_, limit_, filters_));
+                          sub_decision_builder_, limit_, filters_,
+                          operator_replicas_, filter_replicas_));
   nested_decisions_.push_back(
       solver->RevAlloc(new NestedSolveDecision(find_neighbors, false)));
 }
@@ -3071,7 +3862,9 @@ DecisionBuilder* Solver::MakeLocalSearchPhase(
   return RevAlloc(new LocalSearch(assignment, parameters->solution_pool(),
                                   parameters->ls_operator(),
                                   parameters->sub_decision_builder(),
-                                  parameters->limit(), parameters->filters()));
+                                  parameters->limit(), parameters->filters(),
+                                  parameters->operator_replicas(),
+                                  parameters->filter_replicas()));
 }
 
 DecisionBuilder* Solver::MakeLocalSearchPhase(
@@ -3080,7 +3873,9 @@ DecisionBuilder* Solver::MakeLocalSearchPhase(
   return RevAlloc(new LocalSearch(vars, parameters->solution_pool(),
                                   first_solution, parameters->ls_operator(),
                                   parameters->sub_decision_builder(),
-                                  parameters->limit(), parameters->filters()));
+                                  parameters->limit(), parameters->filters(),
+                                  parameters->operator_replicas(),
+                                  parameters->filter_replicas()));
 }
 
 DecisionBuilder* Solver::MakeLocalSearchPhase(
@@ -3089,6 +3884,8 @@ DecisionBuilder* Solver::MakeLocalSearchPhase(
   return RevAlloc(new LocalSearch(vars, parameters->solution_pool(),
                                   first_solution, parameters->ls_operator(),
                                   parameters->sub_decision_builder(),
-                                  parameters->limit(), parameters->filters()));
+                                  parameters->limit(), parameters->filters(),
+                                  parameters->operator_replicas(),
+                                  parameters->filter_replicas()));
 }
 }  // namespace operations_research
@@ -11,17 +11,29 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "base/commandlineflags.h"
+#include "base/hash.h"
 #include "base/integral_types.h"
 #include "base/logging.h"
 #include "base/macros.h"
+#include "base/map_util.h"
 #include "base/stringprintf.h"
 #include "base/stl_util.h"
 #include "constraint_solver/constraint_solver.h"
 #include "util/string_array.h"
 
+DEFINE_int32(cp_max_nogoods, 50000,
+             "Maximum number of nogoods stored by a nogood manager. Beyond "
+             "this number, the least active nogoods are removed.");
+DEFINE_bool(cp_use_naive_nogood_manager, false,
+            "Use the naive nogood manager, which scans all nogoods at each "
+            "decision, instead of the watched one.");
+
 namespace operations_research {
 
 // ----- Base Class -----
@@ -183,12 +195,490 @@ class NaiveNoGoodManager : public NoGoodManager {
  private:
   std::vector<NoGood*> nogoods_;
 };
+
+// ----- WatchedNoGoodManager -----
+
+// This implementation watches two terms per nogood, which are not known to be
+// true, as the two watched literals of a SAT solver. A nogood is only looked
+// at when one of its watched terms becomes true. Another term not known to be
+// true is then watched instead. If there is none, the other watched term is
+// refuted.
+//
+// As in a SAT solver, the watched terms are not restored upon backtrack. This
+// relies on the watches being chosen at the root of the search: a watched
+// term that is true there stays true in the whole search tree. Below the
+// root, a true term chosen as a watch could be undone by a backtrack while
+// the terms made true after it stay true, and the nogood would not be
+// propagated when it becomes unit again. The nogoods added below the root,
+// e.g. by the restarts of the default search, are thus evaluated in full at
+// each decision, as by the naive manager, and are only watched at the next
+// root.
+//
+// The watchers of a variable are grouped by watched term, i.e. by value and
+// by kind of term. Visiting a variable thus costs one test per watched value,
+// and the nogoods are only looked at when their watched term is true.
+// Nogoods with a single term are not watched, and are refuted at each
+// decision.
+//
+// The watched variables are listened to by demons. These demons are attached
+// during search, and are thus detached upon backtrack. The variables with an
+// attached demon are kept in a stack, whose size is reversible, so that the
+// demons that were detached by a backtrack can be attached again at the next
+// decision.
+//
+// When there are more than FLAGS_cp_max_nogoods nogoods, the least active
+// half is removed, the activity of a nogood being the number of times it
+// propagated or failed, and its size breaking ties. The newest nogoods have
+// not had the chance to propagate yet: the most recently added quarter is
+// always kept.
+class WatchedNoGoodManager : public NoGoodManager {
+ public:
+  explicit WatchedNoGoodManager(Solver* const solver)
+      : NoGoodManager(solver), num_attached_(0), live_nogoods_(0) {}
+
+  virtual ~WatchedNoGoodManager() {
+    Clear();
+    STLDeleteElements(&demons_);
+  }
+
+  virtual void Clear() {
+    STLDeleteElements(&nogoods_);
+    activities_.clear();
+    watches_.clear();
+    new_nogoods_.clear();
+    unit_nogoods_.clear();
+    ClearWatchers();
+    live_nogoods_ = 0;
+  }
+
+  // Watches all the nogoods again, as the propagations done in the previous
+  // search have been undone.
+  virtual void Init() {
+    ClearWatchers();
+    new_nogoods_.clear();
+    for (int i = 0; i < nogoods_.size(); ++i) {
+      if (nogoods_[i]->size() > 1) {
+        new_nogoods_.push_back(i);
+      }
+    }
+  }
+
+  virtual void AddNoGood(NoGood* const nogood) {
+    if (nogood->size() == 0) {
+      delete nogood;
+      return;
+    }
+    for (int i = 0; i < nogood->size(); ++i) {
+      RegisterVariable(Term(nogood, i)->integer_variable());
+    }
+    if (nogood->size() == 1) {
+      unit_nogoods_.push_back(nogoods_.size());
+    } else {
+      new_nogoods_.push_back(nogoods_.size());
+    }
+    nogoods_.push_back(nogood);
+    activities_.push_back(0);
+    watches_.push_back(0);
+    watches_.push_back(1);
+    ++live_nogoods_;
+    if (live_nogoods_ > FLAGS_cp_max_nogoods) {
+      RemoveInactiveNoGoods();
+    }
+  }
+
+  virtual int NoGoodCount() const { return live_nogoods_; }
+
+  virtual void Apply() {
+    // The units of a failed propagation are obsolete.
+    unit_terms_.clear();
+    AttachDemons();
+    ApplyUnitNoGoods();
+    WatchNewNoGoods();
+    while (!to_visit_.empty()) {
+      const int var_index = to_visit_.back();
+      to_visit_.pop_back();
+      in_to_visit_[var_index] = false;
+      VisitWatchers(var_index);
+      RefuteUnitTerms();
+    }
+  }
+
+  void OnVariableChanged(int var_index) {
+    if (!in_to_visit_[var_index]) {
+      in_to_visit_[var_index] = true;
+      to_visit_.push_back(var_index);
+    }
+  }
+
+  std::string DebugString() const {
+    return StringPrintf("WatchedNoGoodManager(%d)", NoGoodCount());
+  }
+
+ private:
+  // Demon that tells the manager that a variable has changed.
+  class WatchedVariableDemon : public Demon {
+   public:
+    WatchedVariableDemon(WatchedNoGoodManager* const manager, int var_index)
+        : manager_(manager), var_index_(var_index) {}
+    virtual ~WatchedVariableDemon() {}
+
+    virtual void Run(Solver* const s) {
+      manager_->OnVariableChanged(var_index_);
+    }
+
+    virtual std::string DebugString() const {
+      return StringPrintf("WatchedVariableDemon(%d)", var_index_);
+    }
+
+   private:
+    WatchedNoGoodManager* const manager_;
+    const int var_index_;
+  };
+
+  // A term watched by some nogoods, with these nogoods, as
+  // 2 * nogood index + 0 or 1.
+  struct WatchedTerm {
+    WatchedTerm(int64 v, bool a) : value(v), assign(a) {}
+    int64 value;
+    bool assign;
+    std::vector<int> watchers;
+  };
+
+  // NoGood only builds integer variable terms.
+  static const IntegerVariableNoGoodTerm* Term(const NoGood* const nogood,
+                                               int index) {
+    return static_cast<const IntegerVariableNoGoodTerm*>(nogood->term(index));
+  }
+
+  // Adds the variable to the watched ones, if it is not already there.
+  void RegisterVariable(IntVar* const var) {
+    if (ContainsKey(var_indices_, var)) {
+      return;
+    }
+    const int var_index = vars_.size();
+    var_indices_[var] = var_index;
+    vars_.push_back(var);
+    demons_.push_back(new WatchedVariableDemon(this, var_index));
+    watched_terms_.resize(vars_.size());
+    equal_terms_.resize(vars_.size());
+    not_equal_terms_.resize(vars_.size());
+    is_attached_.push_back(false);
+    in_to_visit_.push_back(false);
+  }
+
+  void ClearWatchers() {
+    for (int i = 0; i < watched_terms_.size(); ++i) {
+      for (int j = 0; j < watched_terms_[i].size(); ++j) {
+        watched_terms_[i][j].watchers.clear();
+      }
+    }
+  }
+
+  // Attaches the demons of the variables that do not have one, because they
+  // are new or because it was detached by a backtrack. Their variables may
+  // have changed while they had no demon, so they are visited.
+  void AttachDemons() {
+    Solver* const s = solver();
+    while (attached_.size() > num_attached_.Value()) {
+      is_attached_[attached_.back()] = false;
+      attached_.pop_back();
+    }
+    if (attached_.size() == vars_.size()) {
+      return;
+    }
+    for (int var_index = 0; var_index < vars_.size(); ++var_index) {
+      if (!is_attached_[var_index]) {
+        vars_[var_index]->WhenDomain(demons_[var_index]);
+        is_attached_[var_index] = true;
+        attached_.push_back(var_index);
+        OnVariableChanged(var_index);
+      }
+    }
+    num_attached_.SetValue(s, attached_.size());
+  }
+
+  // Fails or refutes the nogoods with a single term. Their propagation is
+  // undone upon backtrack, and their variable may not change afterwards.
+  void ApplyUnitNoGoods() {
+    Solver* const s = solver();
+    for (int i = 0; i < unit_nogoods_.size(); ++i) {
+      const int index = unit_nogoods_[i];
+      NoGoodTerm* const term = nogoods_[index]->term(0);
+      switch (term->Evaluate()) {
+        case NoGoodTerm::ALWAYS_TRUE: {
+          ++activities_[index];
+          VLOG(2) << "No Good " << nogoods_[index]->DebugString() << " -> Fail";
+          s->Fail();
+          break;
+        }
+        case NoGoodTerm::ALWAYS_FALSE: { break; }
+        case NoGoodTerm::UNDECIDED: {
+          ++activities_[index];
+          term->Refute();
+          break;
+        }
+      }
+    }
+  }
+
+  // Chooses the watched terms of the new nogoods, and propagates them. Below
+  // the root, the new nogoods are only propagated.
+  void WatchNewNoGoods() {
+    Solver* const s = solver();
+    if (s->SearchDepth() > 0) {
+      for (int i = 0; i < new_nogoods_.size(); ++i) {
+        nogoods_[new_nogoods_[i]]->Apply(s);
+      }
+      return;
+    }
+    for (int i = 0; i < new_nogoods_.size(); ++i) {
+      const int index = new_nogoods_[i];
+      NoGood* const nogood = nogoods_[index];
+      // Watches the first two terms not known to be true, if any.
+      int num_watched = 0;
+      for (int t = 0; t < nogood->size() && num_watched < 2; ++t) {
+        if (nogood->term(t)->Evaluate() != NoGoodTerm::ALWAYS_TRUE) {
+          watches_[2 * index + num_watched++] = t;
+        }
+      }
+      if (num_watched == 0) {
+        watches_[2 * index] = 0;
+        watches_[2 * index + 1] = 1;
+      } else if (num_watched == 1) {
+        // Watches any other term, which is true in the whole search tree.
+        watches_[2 * index + 1] = watches_[2 * index] == 0 ? 1 : 0;
+      }
+      // Visiting the watched terms propagates the nogood if needed.
+      OnVariableChanged(AddWatcher(index, 0));
+      OnVariableChanged(AddWatcher(index, 1));
+    }
+    new_nogoods_.clear();
+  }
+
+  // Adds the watcher to its watched term, and returns the index of the
+  // variable of this term.
+  int AddWatcher(int nogood_index, int which) {
+    const IntegerVariableNoGoodTerm* const term =
+        Term(nogoods_[nogood_index], watches_[2 * nogood_index + which]);
+    const int var_index = var_indices_[term->integer_variable()];
+    hash_map<int64, int>& indices = term->assign()
+                                        ? equal_terms_[var_index]
+                                        : not_equal_terms_[var_index];
+    std::vector<WatchedTerm>& terms = watched_terms_[var_index];
+    int* const term_index =
+        &LookupOrInsert(&indices, term->value(), terms.size());
+    if (*term_index == terms.size()) {
+      terms.push_back(WatchedTerm(term->value(), term->assign()));
+    }
+    terms[*term_index].watchers.push_back(2 * nogood_index + which);
+    return var_index;
+  }
+
+  // Visits the nogoods watching a term on the given variable which is true.
+  void VisitWatchers(int var_index) {
+    IntVar* const var = vars_[var_index];
+    std::vector<WatchedTerm>& terms = watched_terms_[var_index];
+    bool failed = false;
+    for (int w = 0; w < terms.size() && !failed; ++w) {
+      const WatchedTerm& watched_term = terms[w];
+      const bool is_true =
+          watched_term.assign
+              ? var->Bound() && var->Min() == watched_term.value
+              : !var->Contains(watched_term.value);
+      if (is_true) {
+        failed = VisitTrueTerm(&terms[w].watchers);
+      }
+    }
+    // The moved watchers are added after the visit, as they can watch the
+    // same variable.
+    for (int i = 0; i < moved_watchers_.size(); ++i) {
+      AddWatcher(moved_watchers_[i] / 2, moved_watchers_[i] % 2);
+    }
+    moved_watchers_.clear();
+    if (failed) {
+      unit_terms_.clear();
+      VLOG(2) << "No Good -> Fail";
+      solver()->Fail();
+    }
+  }
+
+  // Moves the given watchers of a true term to other terms, or propagates
+  // their nogood. Returns true if a nogood is violated.
+  bool VisitTrueTerm(std::vector<int>* const watchers) {
+    int kept = 0;
+    bool failed = false;
+    for (int i = 0; i < watchers->size(); ++i) {
+      const int watcher = (*watchers)[i];
+      if (failed) {
+        (*watchers)[kept++] = watcher;
+        continue;
+      }
+      const int index = watcher / 2;
+      NoGood* const nogood = nogoods_[index];
+      const int other = watches_[watcher ^ 1];
+      int replacement = -1;
+      for (int t = 0; t < nogood->size(); ++t) {
+        if (t != watches_[watcher] && t != other &&
+            nogood->term(t)->Evaluate() != NoGoodTerm::ALWAYS_TRUE) {
+          replacement = t;
+          break;
+        }
+      }
+      if (replacement != -1) {
+        watches_[watcher] = replacement;
+        moved_watchers_.push_back(watcher);
+        continue;
+      }
+      (*watchers)[kept++] = watcher;
+      switch (nogood->term(other)->Evaluate()) {
+        case NoGoodTerm::ALWAYS_TRUE: {
+          ++activities_[index];
+          failed = true;
+          break;
+        }
+        case NoGoodTerm::ALWAYS_FALSE: { break; }
+        case NoGoodTerm::UNDECIDED: {
+          ++activities_[index];
+          unit_terms_.push_back(std::make_pair(index, other));
+          break;
+        }
+      }
+    }
+    watchers->resize(kept);
+    return failed;
+  }
+
+  // Refutes the terms found to be the last undecided term of their nogood.
+  void RefuteUnitTerms() {
+    for (int i = 0; i < unit_terms_.size(); ++i) {
+      NoGoodTerm* const term =
+          nogoods_[unit_terms_[i].first]->term(unit_terms_[i].second);
+      VLOG(2) << "No Good " << nogoods_[unit_terms_[i].first]->DebugString()
+              << " -> Refute " << term->DebugString();
+      term->Refute();
+    }
+    unit_terms_.clear();
+  }
+
+  // Compares nogoods by decreasing activity, then by increasing size.
+  class MoreActive {
+   public:
+    explicit MoreActive(const WatchedNoGoodManager* const manager)
+        : manager_(manager) {}
+    bool operator()(int index1, int index2) const {
+      const int64 activity1 = manager_->activities_[index1];
+      const int64 activity2 = manager_->activities_[index2];
+      if (activity1 != activity2) {
+        return activity1 > activity2;
+      }
+      return manager_->nogoods_[index1]->size() <
+             manager_->nogoods_[index2]->size();
+    }
+
+   private:
+    const WatchedNoGoodManager* const manager_;
+  };
+
+  // Removes the least active half of the nogoods, except the most recent
+  // ones, and halves the activities of the remaining ones.
+  void RemoveInactiveNoGoods() {
+    const int kept = nogoods_.size() / 2;
+    // The nogoods are in the order they were added.
+    const int num_recent = kept / 2;
+    std::vector<int> order(nogoods_.size() - num_recent);
+    for (int i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    const int kept_old = kept - num_recent;
+    std::nth_element(order.begin(), order.begin() + kept_old, order.end(),
+                     MoreActive(this));
+    for (int i = kept_old; i < order.size(); ++i) {
+      delete nogoods_[order[i]];
+      nogoods_[order[i]] = nullptr;
+    }
+    // Compacts the nogoods, keeping their order.
+    std::vector<int> new_indices(nogoods_.size(), -1);
+    int num_nogoods = 0;
+    for (int i = 0; i < nogoods_.size(); ++i) {
+      if (nogoods_[i] != nullptr) {
+        new_indices[i] = num_nogoods;
+        nogoods_[num_nogoods] = nogoods_[i];
+        activities_[num_nogoods] = activities_[i] / 2;
+        watches_[2 * num_nogoods] = watches_[2 * i];
+        watches_[2 * num_nogoods + 1] = watches_[2 * i + 1];
+        ++num_nogoods;
+      }
+    }
+    nogoods_.resize(num_nogoods);
+    activities_.resize(num_nogoods);
+    watches_.resize(2 * num_nogoods);
+    live_nogoods_ = num_nogoods;
+    std::vector<bool> is_watched(num_nogoods, true);
+    RemapIndices(new_indices, &new_nogoods_, &is_watched);
+    RemapIndices(new_indices, &unit_nogoods_, &is_watched);
+    // Rebuilds the watchers of the nogoods that are already watched.
+    ClearWatchers();
+    for (int i = 0; i < num_nogoods; ++i) {
+      if (is_watched[i]) {
+        AddWatcher(i, 0);
+        AddWatcher(i, 1);
+      }
+    }
+  }
+
+  // Renumbers the given nogoods after a compaction, drops the removed ones,
+  // and marks the remaining ones as not watched.
+  static void RemapIndices(const std::vector<int>& new_indices,
+                           std::vector<int>* const nogoods,
+                           std::vector<bool>* const is_watched) {
+    int num_nogoods = 0;
+    for (int i = 0; i < nogoods->size(); ++i) {
+      const int new_index = new_indices[(*nogoods)[i]];
+      if (new_index != -1) {
+        (*nogoods)[num_nogoods++] = new_index;
+        (*is_watched)[new_index] = false;
+      }
+    }
+    nogoods->resize(num_nogoods);
+  }
+
+  std::vector<NoGood*> nogoods_;
+  std::vector<int64> activities_;
+  // Indices of the two watched terms of each nogood.
+  std::vector<int> watches_;
+  // The nogoods added since the last root, which are not watched yet.
+  std::vector<int> new_nogoods_;
+  // The nogoods with a single term.
+  std::vector<int> unit_nogoods_;
+  // The watched variables, and for each of them, the watched terms on it,
+  // indexed by value for each kind of term.
+  hash_map<IntVar*, int> var_indices_;
+  std::vector<IntVar*> vars_;
+  std::vector<Demon*> demons_;
+  std::vector<std::vector<WatchedTerm> > watched_terms_;
+  std::vector<hash_map<int64, int> > equal_terms_;
+  std::vector<hash_map<int64, int> > not_equal_terms_;
+  // Stack of the variables with an attached demon.
+  std::vector<int> attached_;
+  std::vector<bool> is_attached_;
+  NumericalRev<int> num_attached_;
+  // Variables that changed since they were last visited.
+  std::vector<int> to_visit_;
+  std::vector<bool> in_to_visit_;
+  // Buffers.
+  std::vector<int> moved_watchers_;
+  std::vector<std::pair<int, int> > unit_terms_;
+  int live_nogoods_;
+};
 }  // namespace
 
 // ----- API -----
 
 NoGoodManager* Solver::MakeNoGoodManager() {
-  return RevAlloc(new NaiveNoGoodManager(this));
+  if (FLAGS_cp_use_naive_nogood_manager) {
+    return RevAlloc(new NaiveNoGoodManager(this));
+  }
+  return RevAlloc(new WatchedNoGoodManager(this));
 }
 
 }  // namespace operations_research
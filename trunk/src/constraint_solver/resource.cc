@@ -48,6 +48,10 @@ DEFINE_bool(cp_use_cumulative_edge_finder, true,
             "Resources in O(kn log n)' by Petr Vilim, CP 2009.");
 DEFINE_bool(cp_use_cumulative_time_table, true,
             "Use a O(n^2) cumulative time table propagation algorithm.");
+DEFINE_bool(cp_use_cumulative_time_table_edge_finder, false,
+            "Use the timetable edge finding algorithm described in "
+            "'Timetable Edge Finding Filtering Algorithm for Discrete "
+            "Cumulative Resources' by Petr Vilim, CPAIOR 2011.");
 DEFINE_bool(cp_use_sequence_high_demand_tasks, true,
             "Use a sequence constraints for cumulative tasks that have a "
             "demand greater than half of the capacity of the resource.");
@@ -218,6 +222,28 @@ struct LambdaThetaNode {
     DCHECK_GE(index, 0);
   }
 
+  // Constructor for a single task in the Theta set, with the given energy and
+  // energetic end min.
+  LambdaThetaNode(int64 _energy, int64 _energetic_end_min)
+      : energy(_energy),
+        energetic_end_min(_energetic_end_min),
+        energy_opt(_energy),
+        argmax_energy_opt(kNone),
+        energetic_end_min_opt(_energetic_end_min),
+        argmax_energetic_end_min_opt(kNone) {}
+
+  // Constructor for a single task in the Lambda set, with the given energy and
+  // energetic end min.
+  LambdaThetaNode(int64 _energy, int64 _energetic_end_min, int index)
+      : energy(0LL),
+        energetic_end_min(kint64min),
+        energy_opt(_energy),
+        argmax_energy_opt(index),
+        energetic_end_min_opt(_energetic_end_min),
+        argmax_energetic_end_min_opt(index) {
+    DCHECK_GE(index, 0);
+  }
+
   // Constructor for a single interval in the Theta set
   explicit LambdaThetaNode(const IntervalVar* const interval)
       : energy(interval->DurationMin()),
@@ -1524,45 +1550,66 @@ bool TimeLessThan(const ProfileDelta& delta1, const ProfileDelta& delta2) {
 
 // Cumulative time-table.
 //
-// This class implements a propagator for the CumulativeConstraint which is not
-// incremental, and where a call to InitialPropagate() takes time which is
-// O(n^2) and Omega(n log n) with n the number of cumulative tasks.
+// This class implements a propagator for the CumulativeConstraint which is
+// incremental: the usage profile of the compulsory parts is updated only for
+// the tasks whose compulsory part changed, and only the tasks that changed, or
+// whose time window meets a part of the profile whose usage increased, are
+// pushed. A full propagation takes time which is O(n^2) and Omega(n log n) with
+// n the number of cumulative tasks, and an incremental one takes time which is
+// linear in the size of the profile, plus the cost of pushing the tasks.
 //
 // Despite the high complexity, this propagator is needed, because of those
 // implemented, it is the only one that satisfy that if all instantiated, no
 // contradiction will be detected if and only if the constraint is satisfied.
 //
-// The implementation is quite naive, and could certainly be improved, for
-// example by maintaining the profile incrementally.
+// The profile is not reversible itself. Each change of the compulsory part of a
+// task is recorded in a log, whose size is reversible. After a backtrack, the
+// changes beyond the restored size are undone before propagating.
 class CumulativeTimeTable : public Constraint {
  public:
   CumulativeTimeTable(Solver* const solver,
                       const std::vector<CumulativeTask*>& tasks, int64 capacity)
-      : Constraint(solver), by_start_min_(tasks), capacity_(capacity) {
+      : Constraint(solver),
+        tasks_(tasks),
+        capacity_(capacity),
+        compulsory_starts_(tasks.size(), 0),
+        compulsory_ends_(tasks.size(), 0),
+        log_size_(0),
+        to_propagate_fail_stamp_(0),
+        in_to_propagate_(tasks.size(), false),
+        to_push_(tasks.size(), false) {
     // There may be up to 2 delta's per interval (one on each side),
     // plus two sentinels
     const int profile_max_size = 2 * NumTasks() + 2;
-    profile_non_unique_time_.reserve(profile_max_size);
-    profile_unique_time_.reserve(profile_max_size);
+    profile_.reserve(profile_max_size);
+    profile_.push_back(ProfileDelta(kint64min, 0));
+    profile_.push_back(ProfileDelta(kint64max, 0));
+    // The sentinels are never removed.
+    profile_refs_.assign(2, 1);
+    profile_usage_.assign(2, 0);
   }
 
-  virtual ~CumulativeTimeTable() { STLDeleteElements(&by_start_min_); }
+  virtual ~CumulativeTimeTable() { STLDeleteElements(&tasks_); }
 
   virtual void InitialPropagate() {
-    BuildProfile();
-    PushTasks();
+    for (int i = 0; i < NumTasks(); ++i) {
+      AddToPropagate(i);
+    }
+    PropagateAll();
   }
 
   virtual void Post() {
-    Demon* d = MakeDelayedConstraintDemon0(
-        solver(), this, &CumulativeTimeTable::InitialPropagate,
-        "InitialPropagate");
+    Solver* const s = solver();
     for (int i = 0; i < NumTasks(); ++i) {
-      by_start_min_[i]->interval->WhenAnything(d);
+      Demon* const demon = MakeConstraintDemon1(
+          s, this, &CumulativeTimeTable::OnTaskChange, "OnTaskChange", i);
+      tasks_[i]->interval->WhenAnything(demon);
     }
+    delayed_demon_ = MakeDelayedConstraintDemon0(
+        s, this, &CumulativeTimeTable::PropagateAll, "PropagateAll");
   }
 
-  int NumTasks() const { return by_start_min_.size(); }
+  int NumTasks() const { return tasks_.size(); }
 
   void Accept(ModelVisitor* const visitor) const {
     LOG(FATAL) << "Should not be visited";
@@ -1571,64 +1618,237 @@ class CumulativeTimeTable : public Constraint {
   virtual std::string DebugString() const { return "CumulativeTimeTable"; }
 
  private:
-  // Build the usage profile. Runs in O(n log n).
-  void BuildProfile() {
-    // Build profile with non unique time
-    profile_non_unique_time_.clear();
-    for (int i = 0; i < NumTasks(); ++i) {
-      const CumulativeTask* const task = by_start_min_[i];
-      const IntervalVar* const interval = task->interval;
-      const int64 start_max = interval->StartMax();
-      const int64 end_min = interval->EndMin();
-      if (interval->MustBePerformed() && start_max < end_min) {
-        const int64 demand = task->demand;
-        profile_non_unique_time_.push_back(ProfileDelta(start_max, +demand));
-        profile_non_unique_time_.push_back(ProfileDelta(end_min, -demand));
-      }
+  // A change of the profile, see UpdateProfile().
+  struct ProfileChange {
+    ProfileChange(int64 _time, int64 _delta, int _refs)
+        : time(_time), delta(_delta), refs(_refs) {}
+    int64 time;
+    int64 delta;
+    int refs;
+  };
+
+  // A change of the compulsory part of a task, see the class comment.
+  struct LogEntry {
+    LogEntry(int _task, int64 _old_start, int64 _old_end)
+        : task(_task), old_start(_old_start), old_end(_old_end) {}
+    int task;
+    int64 old_start;
+    int64 old_end;
+  };
+
+  static bool ChangeTimeLessThan(const ProfileChange& change1,
+                                 const ProfileChange& change2) {
+    return change1.time < change2.time;
+  }
+
+  void OnTaskChange(int task_index) {
+    if (solver()->fail_stamp() != to_propagate_fail_stamp_) {
+      // The changes recorded before the last failure are obsolete.
+      to_propagate_fail_stamp_ = solver()->fail_stamp();
+      ClearToPropagate();
+    }
+    AddToPropagate(task_index);
+    EnqueueDelayedDemon(delayed_demon_);
+  }
+
+  void AddToPropagate(int task_index) {
+    if (!in_to_propagate_[task_index]) {
+      in_to_propagate_[task_index] = true;
+      to_propagate_.push_back(task_index);
+    }
+  }
+
+  void ClearToPropagate() {
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      in_to_propagate_[to_propagate_[i]] = false;
+      to_push_[to_propagate_[i]] = false;
     }
-    // Sort
-    std::sort(profile_non_unique_time_.begin(), profile_non_unique_time_.end(),
-         TimeLessThan);
-    // Build profile with unique times
-    profile_unique_time_.clear();
-    profile_unique_time_.push_back(ProfileDelta(kint64min, 0));
-    for (int i = 0; i < profile_non_unique_time_.size(); ++i) {
-      const ProfileDelta& profile_delta = profile_non_unique_time_[i];
-      if (profile_delta.time == profile_unique_time_.back().time) {
-        profile_unique_time_.back().delta += profile_delta.delta;
+    to_propagate_.clear();
+  }
+
+  void PropagateAll() {
+    UpdateProfile();
+    PushTasks();
+    ClearToPropagate();
+    to_propagate_fail_stamp_ = solver()->fail_stamp();
+  }
+
+  // Computes the compulsory part of the task, or an empty interval.
+  void CompulsoryPart(int task_index, int64* start, int64* end) const {
+    const IntervalVar* const interval = tasks_[task_index]->interval;
+    *start = interval->StartMax();
+    *end = interval->EndMin();
+    if (!interval->MustBePerformed() || *start >= *end) {
+      *start = 0;
+      *end = 0;
+    }
+  }
+
+  // Records the replacement of the compulsory part [old_start, old_end) by
+  // [new_start, new_end) in the profile.
+  void ChangeCompulsoryPart(int task_index, int64 old_start, int64 old_end,
+                            int64 new_start, int64 new_end) {
+    const int64 demand = tasks_[task_index]->demand;
+    if (old_start < old_end) {
+      pending_changes_.push_back(ProfileChange(old_start, -demand, -1));
+      pending_changes_.push_back(ProfileChange(old_end, +demand, -1));
+    }
+    if (new_start < new_end) {
+      pending_changes_.push_back(ProfileChange(new_start, +demand, +1));
+      pending_changes_.push_back(ProfileChange(new_end, -demand, +1));
+    }
+    compulsory_starts_[task_index] = new_start;
+    compulsory_ends_[task_index] = new_end;
+  }
+
+  // Brings the profile up to date: undoes the changes that were backtracked,
+  // and applies the compulsory parts of the changed tasks. Fills
+  // increased_segments_ with the parts of the profile where the usage may have
+  // increased. Runs in O(p + k log k), p being the size of the profile and k
+  // the number of changes.
+  void UpdateProfile() {
+    pending_changes_.clear();
+    increased_segments_.clear();
+    while (log_.size() > log_size_.Value()) {
+      const LogEntry& entry = log_.back();
+      ChangeCompulsoryPart(entry.task, compulsory_starts_[entry.task],
+                           compulsory_ends_[entry.task], entry.old_start,
+                           entry.old_end);
+      log_.pop_back();
+    }
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      const int task_index = to_propagate_[i];
+      const int64 old_start = compulsory_starts_[task_index];
+      const int64 old_end = compulsory_ends_[task_index];
+      int64 new_start = 0;
+      int64 new_end = 0;
+      CompulsoryPart(task_index, &new_start, &new_end);
+      if (new_start == old_start && new_end == old_end) {
+        continue;
+      }
+      log_.push_back(LogEntry(task_index, old_start, old_end));
+      ChangeCompulsoryPart(task_index, old_start, old_end, new_start, new_end);
+      if (old_start >= old_end || new_start > old_start || new_end < old_end) {
+        increased_segments_.push_back(std::make_pair(new_start, new_end));
       } else {
-        profile_unique_time_.push_back(profile_delta);
+        if (new_start < old_start) {
+          increased_segments_.push_back(std::make_pair(new_start, old_start));
+        }
+        if (new_end > old_end) {
+          increased_segments_.push_back(std::make_pair(old_end, new_end));
+        }
       }
     }
+    log_size_.SetValue(solver(), log_.size());
+    if (pending_changes_.empty()) {
+      return;
+    }
+    MergePendingChanges();
     // Re-scan profile to check max usage w.r.t. capacity, and check
     // final usage to be 0.
+    profile_usage_.resize(profile_.size());
     int64 usage = 0;
-    for (int i = 0; i < profile_unique_time_.size(); ++i) {
-      const ProfileDelta& profile_delta = profile_unique_time_[i];
-      usage += profile_delta.delta;
-      if (usage > capacity_) {
+    for (int i = 0; i < profile_.size(); ++i) {
+      usage += profile_[i].delta;
+      profile_usage_[i] = usage;
+    }
+    DCHECK_EQ(0, usage);
+    for (int i = 0; i < profile_.size(); ++i) {
+      if (profile_usage_[i] > capacity_) {
         solver()->Fail();
       }
     }
-    DCHECK_EQ(0, usage);
-    profile_unique_time_.push_back(ProfileDelta(kint64max, 0));
+    // Sorts and merges the segments, so that their ends are increasing.
+    std::sort(increased_segments_.begin(), increased_segments_.end());
+    int merged = 0;
+    for (int i = 0; i < increased_segments_.size(); ++i) {
+      if (merged > 0 &&
+          increased_segments_[i].first <= increased_segments_[merged - 1].second) {
+        increased_segments_[merged - 1].second = std::max(
+            increased_segments_[merged - 1].second, increased_segments_[i].second);
+      } else {
+        increased_segments_[merged++] = increased_segments_[i];
+      }
+    }
+    increased_segments_.resize(merged);
+  }
+
+  // Merges the sorted pending changes into the profile. Times that are no
+  // longer the bound of a compulsory part are removed.
+  void MergePendingChanges() {
+    std::sort(pending_changes_.begin(), pending_changes_.end(),
+              ChangeTimeLessThan);
+    new_profile_.clear();
+    new_profile_refs_.clear();
+    int change_index = 0;
+    for (int i = 0; i < profile_.size(); ++i) {
+      while (change_index < pending_changes_.size() &&
+             pending_changes_[change_index].time <= profile_[i].time) {
+        AddChange(pending_changes_[change_index++]);
+      }
+      AddChange(ProfileChange(profile_[i].time, profile_[i].delta,
+                              profile_refs_[i]));
+    }
+    DCHECK_EQ(pending_changes_.size(), change_index);
+    profile_.clear();
+    profile_refs_.clear();
+    for (int i = 0; i < new_profile_.size(); ++i) {
+      if (new_profile_refs_[i] > 0) {
+        profile_.push_back(new_profile_[i]);
+        profile_refs_.push_back(new_profile_refs_[i]);
+      } else {
+        DCHECK_EQ(0, new_profile_[i].delta);
+      }
+    }
+  }
+
+  void AddChange(const ProfileChange& change) {
+    if (!new_profile_.empty() && new_profile_.back().time == change.time) {
+      new_profile_.back().delta += change.delta;
+      new_profile_refs_.back() += change.refs;
+    } else {
+      new_profile_.push_back(ProfileDelta(change.time, change.delta));
+      new_profile_refs_.push_back(change.refs);
+    }
+  }
+
+  // Returns true if the time window of the task meets a segment of the profile
+  // where the usage increased.
+  bool MeetsIncreasedSegment(const CumulativeTask* const task) const {
+    const IntervalVar* const interval = task->interval;
+    const int64 window_start = interval->StartMin();
+    const int64 window_end = interval->StartMax() + interval->DurationMin();
+    // First segment ending after the start of the window.
+    const std::vector<std::pair<int64, int64> >::const_iterator it =
+        std::upper_bound(increased_segments_.begin(), increased_segments_.end(),
+                         std::make_pair(kint64min, window_start),
+                         SegmentEndLessThan);
+    return it != increased_segments_.end() && it->first < window_end;
   }
 
-  // Update the start min for all tasks. Runs in O(n^2) and Omega(n).
+  static bool SegmentEndLessThan(const std::pair<int64, int64>& segment1,
+                                 const std::pair<int64, int64>& segment2) {
+    return segment1.second < segment2.second;
+  }
+
+  // Update the start min of the changed tasks, and of the tasks meeting a
+  // segment where the usage increased.
   void PushTasks() {
-    std::sort(by_start_min_.begin(), by_start_min_.end(),
-         StartMinLessThan<CumulativeTask>);
-    int64 usage = 0;
-    int profile_index = 0;
-    for (int task_index = 0; task_index < NumTasks(); ++task_index) {
-      const CumulativeTask* const task = by_start_min_[task_index];
-      while (task->interval->StartMin() >
-             profile_unique_time_[profile_index].time) {
-        DCHECK(profile_index < profile_unique_time_.size());
-        ++profile_index;
-        usage += profile_unique_time_[profile_index].delta;
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      to_push_[to_propagate_[i]] = true;
+    }
+    if (!increased_segments_.empty()) {
+      for (int task_index = 0; task_index < NumTasks(); ++task_index) {
+        if (!to_push_[task_index] &&
+            MeetsIncreasedSegment(tasks_[task_index])) {
+          to_push_[task_index] = true;
+          to_propagate_.push_back(task_index);
+        }
       }
-      PushTask(task, profile_index, usage);
+    }
+    // The tasks added above are cleared from to_propagate_ by the caller.
+    for (int i = 0; i < to_propagate_.size(); ++i) {
+      PushTask(to_propagate_[i]);
     }
   }
 
@@ -1636,14 +1856,20 @@ class CumulativeTimeTable : public Constraint {
   // that the profile usage for all tasks, excluding the current one, does not
   // exceed capacity_ - task->demand on the interval
   // [new_start_min, new_start_min + task->interval->DurationMin() ).
-  void PushTask(const CumulativeTask* const task, int profile_index,
-                int64 usage) {
+  void PushTask(int task_index) {
     // Init
+    const CumulativeTask* const task = tasks_[task_index];
     const IntervalVar* const interval = task->interval;
     const int64 demand = task->demand;
     const int64 residual_capacity = capacity_ - demand;
     const int64 duration = task->interval->DurationMin();
-    const ProfileDelta& first_prof_delta = profile_unique_time_[profile_index];
+    // First profile delta at or after the start min.
+    int profile_index =
+        std::lower_bound(profile_.begin(), profile_.end(),
+                         ProfileDelta(interval->StartMin(), 0), TimeLessThan) -
+        profile_.begin();
+    int64 usage = profile_usage_[profile_index];
+    const ProfileDelta& first_prof_delta = profile_[profile_index];
 
     int64 new_start_min = interval->StartMin();
 
@@ -1652,31 +1878,29 @@ class CumulativeTimeTable : public Constraint {
     if (first_prof_delta.time > interval->StartMin()) {
       // There was no profile delta at a time between interval->StartMin()
       // (included) and the current one.
-      // As we don't delete delta's of 0 value, this means the current task
-      // does not contribute to the usage before:
-      DCHECK((interval->StartMax() >= first_prof_delta.time) ||
-             (interval->StartMax() >= interval->EndMin()));
-      // The 'usage' given in argument is valid at first_prof_delta.time. To
+      // As the bounds of the compulsory parts are not removed from the
+      // profile, this means the current task does not contribute to the usage
+      // before.
+      // The 'usage' computed above is valid at first_prof_delta.time. To
       // compute the usage at the start min, we need to remove the last delta.
       const int64 usage_at_start_min = usage - first_prof_delta.delta;
       if (usage_at_start_min > residual_capacity) {
-        new_start_min = profile_unique_time_[profile_index].time;
+        new_start_min = profile_[profile_index].time;
       }
     }
 
-    // Influence of current task
-    const int64 start_max = interval->StartMax();
-    const int64 end_min = interval->EndMin();
+    // Influence of current task, as recorded in the profile.
+    const int64 start_max = compulsory_starts_[task_index];
+    const int64 end_min = compulsory_ends_[task_index];
     ProfileDelta delta_start(start_max, 0);
     ProfileDelta delta_end(end_min, 0);
-    if (interval->MustBePerformed() && start_max < end_min) {
+    if (start_max < end_min) {
       delta_start.delta = +demand;
       delta_end.delta = -demand;
     }
-    while (profile_unique_time_[profile_index].time <
-           duration + new_start_min) {
-      const ProfileDelta& profile_delta = profile_unique_time_[profile_index];
-      DCHECK(profile_index < profile_unique_time_.size());
+    while (profile_[profile_index].time < duration + new_start_min) {
+      const ProfileDelta& profile_delta = profile_[profile_index];
+      DCHECK(profile_index < profile_.size());
       // Compensate for current task
       if (profile_delta.time == delta_start.time) {
         usage -= delta_start.delta;
@@ -1686,26 +1910,333 @@ class CumulativeTimeTable : public Constraint {
       }
       // Increment time
       ++profile_index;
-      DCHECK(profile_index < profile_unique_time_.size());
+      DCHECK(profile_index < profile_.size());
       // Does it fit?
       if (usage > residual_capacity) {
-        new_start_min = profile_unique_time_[profile_index].time;
+        new_start_min = profile_[profile_index].time;
       }
-      usage += profile_unique_time_[profile_index].delta;
+      usage += profile_[profile_index].delta;
     }
     task->interval->SetStartMin(new_start_min);
   }
 
   typedef std::vector<ProfileDelta> Profile;
 
-  Profile profile_unique_time_;
-  Profile profile_non_unique_time_;
-  std::vector<CumulativeTask*> by_start_min_;
+  std::vector<CumulativeTask*> tasks_;
   const int64 capacity_;
+  Demon* delayed_demon_;
+  // The usage profile, sorted by time, with the number of bounds of
+  // compulsory parts at each time, and the usage starting at each time.
+  Profile profile_;
+  std::vector<int> profile_refs_;
+  std::vector<int64> profile_usage_;
+  // The compulsory parts of the tasks, as recorded in the profile.
+  std::vector<int64> compulsory_starts_;
+  std::vector<int64> compulsory_ends_;
+  std::vector<LogEntry> log_;
+  NumericalRev<int> log_size_;
+  // The tasks that changed since the last propagation.
+  uint64 to_propagate_fail_stamp_;
+  std::vector<int> to_propagate_;
+  std::vector<bool> in_to_propagate_;
+  std::vector<bool> to_push_;
+  // Buffers.
+  std::vector<ProfileChange> pending_changes_;
+  Profile new_profile_;
+  std::vector<int> new_profile_refs_;
+  std::vector<std::pair<int64, int64> > increased_segments_;
 
   DISALLOW_COPY_AND_ASSIGN(CumulativeTimeTable);
 };
 
+// One-sided cumulative timetable edge finder.
+//
+// This is based on 'Timetable Edge Finding Filtering Algorithm for Discrete
+// Cumulative Resources' by Petr Vilim, CPAIOR 2011.
+//
+// The energy of each task is split between its compulsory part, which is
+// accounted for by the usage profile of all the compulsory parts, and its free
+// part. The edge-finding rules are applied to the free parts, where the energy
+// available in a window [start, end) is reduced by the energy of the profile in
+// that window: with ttAfter(t) the energy of the profile after t, a set S of
+// tasks overloads the window iff
+//     capacity * start_min(S) + ttAfter(start_min(S)) + free_energy(S)
+//   > capacity * end_max(S) + ttAfter(end_max(S)).
+// The left hand side is the energetic end min of a theta-tree whose leaves are
+// shifted by ttAfter(start min), so that the overload checking runs in
+// O(n log n). Each task detected to end after a window then has its start min
+// updated in O(n).
+class TimeTableEdgeFinder : public Constraint {
+ public:
+  TimeTableEdgeFinder(Solver* const solver,
+                      const std::vector<CumulativeTask*>& tasks, int64 capacity)
+      : Constraint(solver),
+        capacity_(capacity),
+        by_start_min_(tasks),
+        by_end_max_(tasks),
+        compulsory_starts_(tasks.size()),
+        compulsory_ends_(tasks.size()),
+        free_energies_(tasks.size()),
+        energetic_start_mins_(tasks.size()),
+        end_max_ranks_(tasks.size()),
+        lt_tree_(tasks.size()) {}
+
+  virtual ~TimeTableEdgeFinder() { STLDeleteElements(&by_start_min_); }
+
+  virtual void Post() {
+    // Delay propagation, as this constraint is not incremental.
+    Demon* const demon = MakeDelayedConstraintDemon0(
+        solver(), this, &TimeTableEdgeFinder::InitialPropagate,
+        "RangeChanged");
+    for (int i = 0; i < by_start_min_.size(); ++i) {
+      by_start_min_[i]->interval->WhenAnything(demon);
+    }
+  }
+
+  virtual void InitialPropagate() {
+    InitPropagation();
+    FillInTree();
+    PropagateBasedOnEnergy();
+    ApplyNewBounds();
+  }
+
+  void Accept(ModelVisitor* const visitor) const {
+    LOG(FATAL) << "Should Not Be Visited";
+  }
+
+  virtual std::string DebugString() const { return "TimeTableEdgeFinder"; }
+
+ private:
+  int NumTasks() const { return by_start_min_.size(); }
+
+  // Sorts the tasks, builds the profile of the compulsory parts, and computes
+  // the free energies.
+  void InitPropagation() {
+    new_start_min_.clear();
+    std::sort(by_start_min_.begin(), by_start_min_.end(),
+              StartMinLessThan<CumulativeTask>);
+    for (int i = 0; i < NumTasks(); ++i) {
+      by_start_min_[i]->index = i;
+    }
+    std::sort(by_end_max_.begin(), by_end_max_.end(),
+              EndMaxLessThan<CumulativeTask>);
+    for (int i = 0; i < NumTasks(); ++i) {
+      end_max_ranks_[by_end_max_[i]->index] = i;
+    }
+    profile_deltas_.clear();
+    for (int i = 0; i < NumTasks(); ++i) {
+      const CumulativeTask* const task = by_start_min_[i];
+      const IntervalVar* const interval = task->interval;
+      int64 compulsory_size = 0;
+      compulsory_starts_[i] = interval->StartMax();
+      compulsory_ends_[i] = interval->EndMin();
+      if (interval->MustBePerformed() &&
+          compulsory_starts_[i] < compulsory_ends_[i]) {
+        compulsory_size = compulsory_ends_[i] - compulsory_starts_[i];
+        profile_deltas_.push_back(
+            ProfileDelta(compulsory_starts_[i], task->demand));
+        profile_deltas_.push_back(
+            ProfileDelta(compulsory_ends_[i], -task->demand));
+      } else {
+        compulsory_starts_[i] = 0;
+        compulsory_ends_[i] = 0;
+      }
+      free_energies_[i] =
+          task->demand *
+          std::max(0LL, interval->DurationMin() - compulsory_size);
+    }
+    BuildProfile();
+    for (int i = 0; i < NumTasks(); ++i) {
+      energetic_start_mins_[i] =
+          capacity_ * by_start_min_[i]->interval->StartMin() +
+          EnergyAfter(by_start_min_[i]->interval->StartMin());
+    }
+    lt_tree_.Clear();
+  }
+
+  // Builds the profile with unique times, and the energy of the profile before
+  // each time.
+  void BuildProfile() {
+    std::sort(profile_deltas_.begin(), profile_deltas_.end(), TimeLessThan);
+    profile_times_.clear();
+    profile_usages_.clear();
+    profile_energies_.clear();
+    int64 usage = 0;
+    int64 energy = 0;
+    for (int i = 0; i < profile_deltas_.size(); ++i) {
+      const ProfileDelta& profile_delta = profile_deltas_[i];
+      if (!profile_times_.empty() &&
+          profile_times_.back() == profile_delta.time) {
+        usage += profile_delta.delta;
+        profile_usages_.back() = usage;
+        continue;
+      }
+      if (!profile_times_.empty()) {
+        energy += profile_usages_.back() *
+                  (profile_delta.time - profile_times_.back());
+      }
+      usage += profile_delta.delta;
+      profile_times_.push_back(profile_delta.time);
+      profile_usages_.push_back(usage);
+      profile_energies_.push_back(energy);
+    }
+    DCHECK_EQ(0, usage);
+    total_profile_energy_ = energy;
+  }
+
+  // Returns the energy of the profile before the given time.
+  int64 EnergyBefore(int64 time) const {
+    const int index = std::upper_bound(profile_times_.begin(),
+                                       profile_times_.end(), time) -
+                      profile_times_.begin() - 1;
+    if (index < 0) {
+      return 0;
+    }
+    return profile_energies_[index] +
+           profile_usages_[index] * (time - profile_times_[index]);
+  }
+
+  // Returns the energy of the profile after the given time.
+  int64 EnergyAfter(int64 time) const {
+    return total_profile_energy_ - EnergyBefore(time);
+  }
+
+  // Maximum energetic end min of a set of tasks that ends before the given
+  // time without overload.
+  int64 MaxFeasibleEnergeticEndMin(int64 end_max) const {
+    return CapAdd(SafeProduct(capacity_, end_max), EnergyAfter(end_max));
+  }
+
+  // Fill the theta-lambda-tree, and check for overloading.
+  void FillInTree() {
+    for (int i = 0; i < NumTasks(); ++i) {
+      const CumulativeTask* const task = by_end_max_[i];
+      const int index = task->index;
+      lt_tree_.Set(index, LambdaThetaNode(free_energies_[index],
+                                          energetic_start_mins_[index] +
+                                              free_energies_[index]));
+      if (lt_tree_.result().energetic_end_min >
+          MaxFeasibleEnergeticEndMin(task->interval->EndMax())) {
+        solver()->Fail();
+      }
+    }
+  }
+
+  // Should be called with all tasks being in the Theta set. Detects the tasks
+  // that must end after the end max of the Theta set, and pushes them.
+  void PropagateBasedOnEnergy() {
+    for (int j = NumTasks() - 2; j >= 0; --j) {
+      const int grey = by_end_max_[j + 1]->index;
+      lt_tree_.Set(grey, LambdaThetaNode(free_energies_[grey],
+                                         energetic_start_mins_[grey] +
+                                             free_energies_[grey],
+                                         grey));
+      const int64 end_max = by_end_max_[j]->interval->EndMax();
+      const int64 max_feasible = MaxFeasibleEnergeticEndMin(end_max);
+      while (lt_tree_.result().energetic_end_min_opt > max_feasible) {
+        const int i = lt_tree_.result().argmax_energetic_end_min_opt;
+        DCHECK_GE(i, 0);
+        PropagateTaskCannotEndBefore(i, j);
+        lt_tree_.Reset(i);
+      }
+    }
+  }
+
+  // The task of the given index cannot end before the end max of the Theta
+  // set, made of the tasks by_end_max_[0..end_max_index]. For each window
+  // [start, end_max) starting at the start min of a task of the Theta set, the
+  // free part of the task can only use the energy left in the window by the
+  // profile and the free parts of the tasks of the Theta set starting in it.
+  void PropagateTaskCannotEndBefore(int index, int end_max_index) {
+    const CumulativeTask* const task = by_start_min_[index];
+    const int64 demand = task->demand;
+    const int64 end_max = by_end_max_[end_max_index]->interval->EndMax();
+    const int64 start_min = task->interval->StartMin();
+    if (start_min >= end_max) {
+      return;
+    }
+    // The free part of the task in the window if it starts at its start min.
+    const int64 free_energy_in = std::min(
+        free_energies_[index], SafeProduct(demand, end_max - start_min));
+    const int64 energy_before_end_max = EnergyBefore(end_max);
+    // The free energy of the tasks of the Theta set that start at or after
+    // the start min of the task.
+    int64 theta_free_energy = 0;
+    for (int k = index + 1; k < NumTasks(); ++k) {
+      if (end_max_ranks_[k] <= end_max_index) {
+        theta_free_energy += free_energies_[k];
+      }
+    }
+    int64 new_start_min = start_min;
+    for (int k = index; k >= 0; --k) {
+      if (k != index) {
+        if (end_max_ranks_[k] > end_max_index) {
+          continue;
+        }
+        theta_free_energy += free_energies_[k];
+      }
+      const int64 window_start = by_start_min_[k]->interval->StartMin();
+      const int64 available =
+          SafeProduct(capacity_, end_max - window_start) - theta_free_energy -
+          (energy_before_end_max - EnergyBefore(window_start));
+      if (available < 0 || free_energy_in <= available) {
+        continue;
+      }
+      // The part of the compulsory part of the task in the window.
+      const int64 compulsory_in =
+          std::max(0LL, std::min(compulsory_ends_[index], end_max) -
+                            std::max(compulsory_starts_[index], window_start));
+      new_start_min = std::max(
+          new_start_min, end_max - compulsory_in - available / demand);
+    }
+    if (new_start_min > start_min) {
+      new_start_min_.push_back(StartMinUpdater(task->interval, new_start_min));
+    }
+  }
+
+  // Applies the previously computed updates.
+  void ApplyNewBounds() {
+    for (int i = 0; i < new_start_min_.size(); ++i) {
+      new_start_min_[i].Run();
+    }
+  }
+
+  // Capacity of the cumulative resource.
+  const int64 capacity_;
+
+  // Cumulative tasks, ordered by non-decreasing start min.
+  std::vector<CumulativeTask*> by_start_min_;
+
+  // Cumulative tasks, ordered by non-decreasing end max.
+  std::vector<CumulativeTask*> by_end_max_;
+
+  // The compulsory parts, free energies, and capacity * start min +
+  // ttAfter(start min), indexed by position in by_start_min_.
+  std::vector<int64> compulsory_starts_;
+  std::vector<int64> compulsory_ends_;
+  std::vector<int64> free_energies_;
+  std::vector<int64> energetic_start_mins_;
+
+  // Position in by_end_max_, indexed by position in by_start_min_.
+  std::vector<int> end_max_ranks_;
+
+  // Usage profile of the compulsory parts: the usage starting at each time,
+  // and the energy before each time.
+  std::vector<ProfileDelta> profile_deltas_;
+  std::vector<int64> profile_times_;
+  std::vector<int64> profile_usages_;
+  std::vector<int64> profile_energies_;
+  int64 total_profile_energy_;
+
+  // Theta-lambda tree on the free energies.
+  MonoidOperationTree<LambdaThetaNode> lt_tree_;
+
+  // Stack of updates to the new start min to do.
+  std::vector<StartMinUpdater> new_start_min_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimeTableEdgeFinder);
+};
+
 class CumulativeConstraint : public Constraint {
  public:
   CumulativeConstraint(Solver* const s, const std::vector<IntervalVar*>& intervals,
@@ -1726,12 +2257,16 @@ class CumulativeConstraint : public Constraint {
     // don't dominate each other. So the strongest propagation is obtained
     // by posting a bunch of different propagators.
     if (FLAGS_cp_use_cumulative_time_table) {
-      PostOneSidedConstraint(false, false);
-      PostOneSidedConstraint(true, false);
+      PostOneSidedConstraint(false, TIME_TABLE);
+      PostOneSidedConstraint(true, TIME_TABLE);
     }
     if (FLAGS_cp_use_cumulative_edge_finder) {
-      PostOneSidedConstraint(false, true);
-      PostOneSidedConstraint(true, true);
+      PostOneSidedConstraint(false, EDGE_FINDER);
+      PostOneSidedConstraint(true, EDGE_FINDER);
+    }
+    if (FLAGS_cp_use_cumulative_time_table_edge_finder) {
+      PostOneSidedConstraint(false, TIME_TABLE_EDGE_FINDER);
+      PostOneSidedConstraint(true, TIME_TABLE_EDGE_FINDER);
     }
     if (FLAGS_cp_use_sequence_high_demand_tasks) {
       PostHighDemandSequenceConstraint();
@@ -1759,6 +2294,13 @@ class CumulativeConstraint : public Constraint {
   virtual std::string DebugString() const { return "CumulativeConstraint"; }
 
  private:
+  // The one-sided propagators.
+  enum OneSidedPropagator {
+    TIME_TABLE,
+    EDGE_FINDER,
+    TIME_TABLE_EDGE_FINDER
+  };
+
   // Post temporal disjunctions for tasks that cannot overlap.
   void PostAllDisjunctions() {
     for (int i = 0; i < intervals_.size(); ++i) {
@@ -1837,26 +2379,32 @@ class CumulativeConstraint : public Constraint {
     }
   }
 
-  // Makes and return an edge-finder or a time table, or nullptr if it is not
-  // necessary.
-  Constraint* MakeOneSidedConstraint(bool mirror, bool edge_finder) {
+  // Makes and return an edge-finder, a time table or a time table
+  // edge-finder, or nullptr if it is not necessary.
+  Constraint* MakeOneSidedConstraint(bool mirror,
+                                     OneSidedPropagator propagator) {
     std::vector<CumulativeTask*> useful_tasks;
     PopulateVectorUsefulTasks(mirror, &useful_tasks);
     if (useful_tasks.empty()) {
       return nullptr;
     } else {
       Solver* const s = solver();
-      if (edge_finder) {
-        return s->RevAlloc(new EdgeFinder(s, useful_tasks, capacity_));
-      } else {
-        return s->RevAlloc(new CumulativeTimeTable(s, useful_tasks, capacity_));
+      switch (propagator) {
+        case EDGE_FINDER:
+          return s->RevAlloc(new EdgeFinder(s, useful_tasks, capacity_));
+        case TIME_TABLE_EDGE_FINDER:
+          return s->RevAlloc(
+              new TimeTableEdgeFinder(s, useful_tasks, capacity_));
+        default:
+          return s->RevAlloc(
+              new CumulativeTimeTable(s, useful_tasks, capacity_));
       }
     }
   }
 
-  // Post a straight or mirrored edge-finder, if needed
-  void PostOneSidedConstraint(bool mirror, bool edge_finder) {
-    Constraint* const constraint = MakeOneSidedConstraint(mirror, edge_finder);
+  // Post a straight or mirrored one-sided propagator, if needed
+  void PostOneSidedConstraint(bool mirror, OneSidedPropagator propagator) {
+    Constraint* const constraint = MakeOneSidedConstraint(mirror, propagator);
     if (constraint != nullptr) {
       solver()->AddConstraint(constraint);
     }
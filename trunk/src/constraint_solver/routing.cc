@@ -30,6 +30,9 @@
 #include "base/stl_util.h"
 #include "base/fingerprint2011.h"
 #include "base/hash.h"
+#include "base/mutex.h"
+#include "base/split.h"
+#include "base/threadpool.h"
 #include "graph/linear_assignment.h"
 #include "util/saturated_arithmetic.h"
 
@@ -67,6 +70,23 @@ DEFINE_bool(routing_use_chain_make_inactive, false,
             "Routing: use chain version of MakeInactive neighborhood.");
 DEFINE_bool(routing_use_extended_swap_active, false,
             "Routing: use extended version of SwapActive neighborhood.");
+DEFINE_int64(routing_granular_neighbors, 0,
+             "Routing: if positive, restricts the Relocate, Exchange, Cross "
+             "and 2Opt neighborhoods to neighbors creating an arc from a node "
+             "to one of its routing_granular_neighbors nearest nodes.");
+DEFINE_bool(routing_use_dont_look_bits, true,
+            "Routing: skip the positions of the Relocate, Exchange, Cross and "
+            "2Opt neighborhoods around which nothing changed since they were "
+            "last explored without success.");
+DEFINE_bool(routing_use_multi_armed_bandit_concatenate_operators, false,
+            "Routing: explore neighborhoods in the order given by a "
+            "multi-armed bandit policy instead of a fixed order.");
+DEFINE_double(routing_multi_armed_bandit_memory_coefficient, 0.04,
+              "Routing: weight of the latest observation when averaging the "
+              "performance of neighborhoods (multi-armed bandit policy).");
+DEFINE_double(routing_multi_armed_bandit_exploration_coefficient, 1e-3,
+              "Routing: weight of the exploration term when ranking "
+              "neighborhoods (multi-armed bandit policy).");
 
 // Search limits
 DEFINE_int64(routing_solution_limit, kint64max,
@@ -90,6 +110,12 @@ DEFINE_string(routing_first_solution, "",
               "in the code to get a full list.");
 DEFINE_bool(routing_use_first_solution_dive, false,
             "Dive (left-branch) for first solution.");
+DEFINE_string(routing_first_solution_portfolio, "",
+              "Routing: comma-separated list of first solution heuristics run "
+              "in parallel by RoutingModel::SolveWithFirstSolutionPortfolio().");
+DEFINE_int32(routing_first_solution_portfolio_threads, 1,
+             "Routing: number of threads running the first solution "
+             "portfolio.");
 DEFINE_int64(routing_optimization_step, 1, "Optimization step.");
 DEFINE_bool(routing_use_filtered_first_solutions, true,
             "Use filtered version of first solution heuristics if available.");
@@ -132,6 +158,12 @@ DEFINE_bool(routing_use_light_propagation, false,
 DEFINE_bool(routing_cache_callbacks, false, "Cache callback calls.");
 DEFINE_int64(routing_max_cache_size, 1000,
              "Maximum cache size when callback caching is on.");
+DEFINE_bool(routing_precompute_callbacks, false,
+            "Precompute all callback calls in dense matrices when the model is "
+            "built. Takes precedence over routing_cache_callbacks.");
+DEFINE_int32(routing_precompute_callbacks_threads, 1,
+             "Number of threads used to precompute callbacks; callbacks must "
+             "be thread-safe if greater than 1.");
 DEFINE_bool(routing_trace, false, "Routing: trace search.");
 DEFINE_bool(routing_search_trace, false,
             "Routing: use SearchTrace for monitoring search.");
@@ -609,7 +641,7 @@ LocalSearchOperator* MakePairRelocate(
 
 // Cached callbacks
 
-class RoutingCache {
+class RoutingCache : public BaseObject {
  public:
   RoutingCache(RoutingModel::NodeEvaluator2* callback, int size)
       : cached_(size), cache_(size), callback_(callback) {
@@ -619,6 +651,7 @@ class RoutingCache {
     }
     callback->CheckIsRepeatable();
   }
+  virtual ~RoutingCache() {}
   int64 Run(RoutingModel::NodeIndex i, RoutingModel::NodeIndex j) {
     // This method does lazy caching of results of callbacks: first
     // checks if it has been run with these parameters before, and
@@ -643,6 +676,77 @@ class RoutingCache {
   std::unique_ptr<RoutingModel::NodeEvaluator2> callback_;
 };
 
+namespace {
+void RunRowsInThread(Callback1<int>* fill_row, int first_row, int row_step,
+                     int num_rows) {
+  for (int row = first_row; row < num_rows; row += row_step) {
+    fill_row->Run(row);
+  }
+}
+
+// Calls fill_row->Run(row) for all rows in [0, num_rows), spreading the rows
+// over 'num_threads' threads. Takes ownership of 'fill_row'.
+void FillRowsInParallel(int num_rows, int num_threads,
+                        Callback1<int>* fill_row) {
+  std::unique_ptr<Callback1<int> > delete_fill_row(fill_row);
+  num_threads = std::max(1, std::min(num_threads, num_rows));
+  if (num_threads == 1) {
+    RunRowsInThread(fill_row, 0, 1, num_rows);
+    return;
+  }
+  // The destructor of the pool waits for all the rows to be filled.
+  ThreadPool pool("RoutingPrecompute", num_threads);
+  pool.StartWorkers();
+  for (int i = 0; i < num_threads; ++i) {
+    pool.Add(NewCallback(&RunRowsInThread, fill_row, i, num_threads, num_rows));
+  }
+}
+
+// Fills the row-major matrix of all the values of a node callback.
+class NodeEvaluatorMatrixFiller {
+ public:
+  NodeEvaluatorMatrixFiller(RoutingModel::NodeEvaluator2* callback, int size,
+                            std::vector<int64>* values)
+      : callback_(callback), size_(size), values_(values) {}
+  void FillRow(int row) {
+    int64* const row_values =
+        values_->data() + static_cast<int64>(row) * size_;
+    for (int j = 0; j < size_; ++j) {
+      row_values[j] = callback_->Run(RoutingModel::NodeIndex(row),
+                                     RoutingModel::NodeIndex(j));
+    }
+  }
+
+ private:
+  RoutingModel::NodeEvaluator2* const callback_;
+  const int size_;
+  std::vector<int64>* const values_;
+};
+}  // namespace
+
+// Precomputed callbacks: all the values of the callback are computed when the
+// cache is created, and stored in a contiguous row-major matrix of T (int32 if
+// all values fit, int64 otherwise). Contrary to RoutingCache, a lookup is a
+// single load, and since the matrix is never modified afterwards the cache is
+// MT-safe.
+template <class T>
+class RoutingDenseCache : public BaseObject {
+ public:
+  RoutingDenseCache(RoutingModel::NodeEvaluator2* callback, int size,
+                    const std::vector<int64>& values)
+      : size_(size), cache_(values.begin(), values.end()), callback_(callback) {}
+  virtual ~RoutingDenseCache() {}
+  int64 Run(RoutingModel::NodeIndex i, RoutingModel::NodeIndex j) const {
+    return cache_[static_cast<int64>(i.value()) * size_ + j.value()];
+  }
+
+ private:
+  const int size_;
+  const std::vector<T> cache_;
+  // Kept alive as its address is used to identify the callback.
+  std::unique_ptr<RoutingModel::NodeEvaluator2> callback_;
+};
+
 namespace {
 
 // Evaluators
@@ -673,6 +777,27 @@ class MatrixEvaluator : public BaseObject {
   RoutingModel* const model_;
 };
 
+// Same as MatrixEvaluator, with the values stored in a contiguous row-major
+// matrix.
+class RowMajorMatrixEvaluator : public BaseObject {
+ public:
+  RowMajorMatrixEvaluator(std::vector<int64>* values, int nodes)
+      : nodes_(nodes) {
+    CHECK(values) << "null pointer";
+    CHECK_EQ(static_cast<int64>(nodes) * nodes,
+             static_cast<int64>(values->size()));
+    values_.swap(*values);
+  }
+  virtual ~RowMajorMatrixEvaluator() {}
+  int64 Value(RoutingModel::NodeIndex i, RoutingModel::NodeIndex j) const {
+    return values_[static_cast<int64>(i.value()) * nodes_ + j.value()];
+  }
+
+ private:
+  std::vector<int64> values_;
+  const int nodes_;
+};
+
 class VectorEvaluator : public BaseObject {
  public:
   VectorEvaluator(const int64* values, int64 nodes, RoutingModel* model)
@@ -730,6 +855,8 @@ void RoutingModel::SetGlobalParameters(const RoutingParameters& p) {
   FLAGS_routing_use_light_propagation = p.use_light_propagation;
   FLAGS_routing_cache_callbacks = p.cache_callbacks;
   FLAGS_routing_max_cache_size = p.max_cache_size;
+  FLAGS_routing_precompute_callbacks = p.precompute_callbacks;
+  FLAGS_routing_precompute_callbacks_threads = p.precompute_callbacks_threads;
 }
 
 RoutingModel::RoutingModel(int nodes, int vehicles)
@@ -1059,6 +1186,13 @@ void RoutingModel::SetArcCostEvaluatorOfAllVehicles(NodeEvaluator2* evaluator) {
   }
 }
 
+void RoutingModel::SetArcCostMatrixOfAllVehicles(std::vector<int64>* costs) {
+  RowMajorMatrixEvaluator* const evaluator =
+      solver_->RevAlloc(new RowMajorMatrixEvaluator(costs, nodes_));
+  SetArcCostEvaluatorOfAllVehicles(
+      NewPermanentCallback(evaluator, &RowMajorMatrixEvaluator::Value));
+}
+
 void RoutingModel::SetArcCostEvaluatorOfVehicle(NodeEvaluator2* evaluator,
                                                 int vehicle) {
   CHECK(evaluator != nullptr);
@@ -1216,7 +1350,15 @@ void RoutingModel::ComputeCostClasses() {
     NodeEvaluator2** cached_evaluator =
         &LookupOrInsert(&fprint_to_cached_evaluator, evaluator_fprint, nullptr);
     if (*cached_evaluator == nullptr) {
-      *cached_evaluator = NewCachedCallback(uncached_evaluator);
+      if (FLAGS_routing_precompute_callbacks) {
+        // Arc costs are precomputed per cost class by
+        // PrecomputeArcCostsOfCostClasses(), there's no need to precompute the
+        // evaluator itself.
+        owned_node_callbacks_.insert(uncached_evaluator);
+        *cached_evaluator = uncached_evaluator;
+      } else {
+        *cached_evaluator = NewCachedCallback(uncached_evaluator);
+      }
     }
     CostClass cost_class(*cached_evaluator);
     // Insert the dimension data in a canonical way.
@@ -1556,6 +1698,9 @@ void RoutingModel::CloseModel() {
 
   ComputeCostClasses();
   ComputeVehicleClasses();
+  if (FLAGS_routing_precompute_callbacks) {
+    PrecomputeArcCostsOfCostClasses();
+  }
   vehicle_start_class_callback_.reset(
       NewPermanentCallback(this, &RoutingModel::GetVehicleStartClass));
 
@@ -2598,7 +2743,12 @@ void RoutingModel::AddSearchMonitor(SearchMonitor* const monitor) {
 }
 
 const Assignment* RoutingModel::SolveWithParameters(
-    const RoutingSearchParameters& p, const Assignment* assignment) {
+    const RoutingSearchParameters& parameters, const Assignment* assignment) {
+  SetSearchParameters(parameters);
+  return Solve(assignment);
+}
+
+void RoutingModel::SetSearchParameters(const RoutingSearchParameters& p) {
   FLAGS_routing_no_lns = p.no_lns;
   FLAGS_routing_no_fullpathlns = p.no_fullpathlns;
   FLAGS_routing_no_relocate = p.no_relocate;
@@ -2613,6 +2763,14 @@ const Assignment* RoutingModel::SolveWithParameters(
   FLAGS_routing_no_tsplns = p.no_tsplns;
   FLAGS_routing_use_chain_make_inactive = p.use_chain_make_inactive;
   FLAGS_routing_use_extended_swap_active = p.use_extended_swap_active;
+  FLAGS_routing_granular_neighbors = p.granular_neighbors;
+  FLAGS_routing_use_dont_look_bits = p.use_dont_look_bits;
+  FLAGS_routing_use_multi_armed_bandit_concatenate_operators =
+      p.use_multi_armed_bandit_concatenate_operators;
+  FLAGS_routing_multi_armed_bandit_memory_coefficient =
+      p.multi_armed_bandit_memory_coefficient;
+  FLAGS_routing_multi_armed_bandit_exploration_coefficient =
+      p.multi_armed_bandit_exploration_coefficient;
   FLAGS_routing_solution_limit = p.solution_limit;
   FLAGS_routing_time_limit = p.time_limit;
   time_limit_ms_ = p.time_limit;
@@ -2626,10 +2784,11 @@ const Assignment* RoutingModel::SolveWithParameters(
   FLAGS_routing_dfs = p.dfs;
   FLAGS_routing_first_solution = p.first_solution;
   FLAGS_routing_use_first_solution_dive = p.use_first_solution_dive;
+  FLAGS_routing_first_solution_portfolio = p.first_solution_portfolio;
+  FLAGS_routing_first_solution_portfolio_threads =
+      p.first_solution_portfolio_threads;
   FLAGS_routing_optimization_step = p.optimization_step;
   FLAGS_routing_trace = p.trace;
-
-  return Solve(assignment);
 }
 
 const Assignment* RoutingModel::Solve(const Assignment* assignment) {
@@ -2655,6 +2814,115 @@ const Assignment* RoutingModel::Solve(const Assignment* assignment) {
   }
 }
 
+namespace {
+// Keeps the best first solution found by the strategies of a first solution
+// portfolio; ties are broken on the rank of the strategies in the portfolio
+// to keep the result independent of thread scheduling.
+class FirstSolutionPortfolio {
+ public:
+  FirstSolutionPortfolio() : best_cost_(kint64max), best_rank_(-1) {}
+  // Solves 'model' with 'strategy', the strategy of rank 'rank' in the
+  // portfolio, and deletes 'model'.
+  void Run(RoutingModel* model, RoutingModel::RoutingStrategy strategy,
+           int rank) {
+    std::unique_ptr<RoutingModel> delete_model(model);
+    model->set_first_solution_strategy(strategy);
+    const Assignment* const solution = model->Solve();
+    if (solution == nullptr) {
+      VLOG(1) << RoutingModel::RoutingStrategyName(strategy)
+              << ": no solution found";
+      return;
+    }
+    const int64 cost = solution->ObjectiveValue();
+    VLOG(1) << RoutingModel::RoutingStrategyName(strategy) << ": " << cost;
+    MutexLock lock(&mutex_);
+    if (best_rank_ == -1 || cost < best_cost_ ||
+        (cost == best_cost_ && rank < best_rank_)) {
+      best_cost_ = cost;
+      best_rank_ = rank;
+      model->AssignmentToRoutes(*solution, &best_routes_);
+    }
+  }
+  bool HasSolution() const { return best_rank_ != -1; }
+  const std::vector<std::vector<RoutingModel::NodeIndex> >& best_routes() const {
+    return best_routes_;
+  }
+
+ private:
+  Mutex mutex_;
+  int64 best_cost_;
+  int best_rank_;
+  std::vector<std::vector<RoutingModel::NodeIndex> > best_routes_;
+
+  DISALLOW_COPY_AND_ASSIGN(FirstSolutionPortfolio);
+};
+}  // namespace
+
+const Assignment* RoutingModel::SolveWithFirstSolutionPortfolio(
+    const RoutingSearchParameters& parameters, ModelBuilder* model_builder) {
+  SetSearchParameters(parameters);
+  std::vector<RoutingStrategy> strategies;
+  for (const std::string& name :
+       strings::Split(FLAGS_routing_first_solution_portfolio, ",",
+                      strings::SkipEmpty())) {
+    RoutingStrategy strategy;
+    CHECK(ParseRoutingStrategy(name, &strategy))
+        << "Unknown first solution strategy " << name;
+    strategies.push_back(strategy);
+  }
+  if (strategies.empty()) {
+    return Solve();
+  }
+  const int64 start_time_ms = solver_->wall_time();
+  // Models are built sequentially as building them sets global flags; only
+  // their first solutions are searched for in parallel.
+  std::vector<RoutingModel*> models;
+  for (int i = 0; i < strategies.size(); ++i) {
+    models.push_back(model_builder->Run());
+    CHECK_EQ(Size(), models.back()->Size());
+    CHECK_EQ(vehicles(), models.back()->vehicles());
+  }
+  RoutingSearchParameters first_solution_parameters = parameters;
+  first_solution_parameters.first_solution = "";
+  first_solution_parameters.solution_limit = 1;
+  SetSearchParameters(first_solution_parameters);
+  FirstSolutionPortfolio portfolio;
+  {
+    const int num_threads = std::max(
+        1, std::min<int>(FLAGS_routing_first_solution_portfolio_threads,
+                         strategies.size()));
+    // The destructor of the pool waits for all the strategies to be run.
+    ThreadPool pool("RoutingFirstSolutionPortfolio", num_threads);
+    pool.StartWorkers();
+    for (int i = 0; i < strategies.size(); ++i) {
+      pool.Add(NewCallback(&portfolio, &FirstSolutionPortfolio::Run, models[i],
+                           strategies[i], i));
+    }
+  }
+  SetSearchParameters(parameters);
+  const Assignment* first_solution = nullptr;
+  if (portfolio.HasSolution()) {
+    // The best first solution is restored without time limit, through the
+    // solution finalizer which binds the cumul and objective variables, and
+    // collected: it is complete even if no time is left for local search.
+    UpdateTimeLimit(kint64max);
+    first_solution = ReadAssignmentFromRoutes(portfolio.best_routes(), false);
+  }
+  // Local search starts from the best first solution and gets the remaining
+  // time.
+  int64 remaining_time_ms = kint64max;
+  if (parameters.time_limit != kint64max) {
+    remaining_time_ms =
+        std::max<int64>(0, parameters.time_limit -
+                               (solver_->wall_time() - start_time_ms));
+  }
+  UpdateTimeLimit(remaining_time_ms);
+  if (remaining_time_ms == 0 && first_solution != nullptr) {
+    return first_solution;
+  }
+  return Solve(first_solution);
+}
+
 // Computing a lower bound to the cost of a vehicle routing problem solving a
 // a linear assignment problem (minimum-cost perfect bipartite matching).
 // A bipartite graph is created with left nodes representing the nodes of the
@@ -3238,35 +3506,171 @@ int64 RoutingModel::GetArcCostForClassInternal(
   DCHECK(closed_);
   DCHECK_GE(cost_class_index, 0);
   DCHECK_LT(cost_class_index, cost_classes_.size());
+  if (!precomputed_arc_costs_.empty()) {
+    // Same as ComputeArcCostForClass().
+    if (!IsStart(i)) {
+      return GetPrecomputedNodeArcCost(i, j, cost_class_index);
+    } else if (!IsEnd(j)) {
+      return GetPrecomputedNodeArcCost(i, j, cost_class_index) +
+             fixed_cost_of_vehicle_[index_to_vehicle_[i]];
+    } else {
+      return 0;
+    }
+  }
   CostCacheElement* const cache = &cost_cache_[i];
   // See the comment in CostCacheElement in the .h for the int64->int cast.
   if (cache->index == static_cast<int>(j) &&
       cache->cost_class_index == cost_class_index) {
     return cache->cost;
   }
-  const NodeIndex node_i = IndexToNode(i);
-  const NodeIndex node_j = IndexToNode(j);
-  int64 cost = 0;
-  const CostClass& cost_class = cost_classes_[cost_class_index];
+  const int64 cost = ComputeArcCostForClass(i, j, cost_class_index);
+  cache->index = static_cast<int>(j);
+  cache->cost_class_index = cost_class_index;
+  cache->cost = cost;
+  return cost;
+}
+
+int64 RoutingModel::ComputeArcCostForClass(
+    int64 i, int64 j, CostClassIndex cost_class_index) const {
   if (!IsStart(i)) {
-    // TODO(user): fix overflows.
-    cost = cost_class.arc_cost_evaluator->Run(node_i, node_j) +
-           GetDimensionTransitCostSum(i, j, cost_class);
+    return ComputeNodeArcCostForClass(i, j, cost_class_index);
   } else if (!IsEnd(j)) {
     // Apply route fixed cost on first non-first/last node, in other words on
     // the arc from the first node to its next node if it's not the last node.
-    cost = cost_class.arc_cost_evaluator->Run(node_i, node_j) +
-           GetDimensionTransitCostSum(i, j, cost_class) +
+    return ComputeNodeArcCostForClass(i, j, cost_class_index) +
            fixed_cost_of_vehicle_[index_to_vehicle_[i]];
   } else {
     // If there's only the first and last nodes on the route, it is considered
     // as an empty route thus the cost of 0.
-    cost = 0;
+    return 0;
   }
-  cache->index = static_cast<int>(j);
-  cache->cost_class_index = cost_class_index;
-  cache->cost = cost;
-  return cost;
+}
+
+int64 RoutingModel::ComputeNodeArcCostForClass(
+    int64 i, int64 j, CostClassIndex cost_class_index) const {
+  const CostClass& cost_class = cost_classes_[cost_class_index];
+  // TODO(user): fix overflows.
+  return cost_class.arc_cost_evaluator->Run(IndexToNode(i), IndexToNode(j)) +
+         GetDimensionTransitCostSum(i, j, cost_class);
+}
+
+int64 RoutingModel::GetPrecomputedNodeArcCost(
+    int64 i, int64 j, CostClassIndex cost_class_index) const {
+  const PrecomputedArcCosts& costs = precomputed_arc_costs_[cost_class_index];
+  const int64 position =
+      static_cast<int64>(index_to_node_[i].value()) * nodes_ +
+      index_to_node_[j].value();
+  return costs.int64_costs.empty() ? costs.int32_costs[position]
+                                   : costs.int64_costs[position];
+}
+
+void RoutingModel::FillPrecomputedArcCostsRow(
+    CostClassIndex cost_class_index, const std::vector<int64>* node_indices,
+    std::vector<char>* row_overflows, int row) {
+  const int64 from_index = (*node_indices)[row];
+  if (from_index == -1) return;
+  PrecomputedArcCosts* const costs = &precomputed_arc_costs_[cost_class_index];
+  const int64 row_start = static_cast<int64>(row) * nodes_;
+  for (int j = 0; j < nodes_; ++j) {
+    const int64 to_index = (*node_indices)[j];
+    if (to_index == -1) continue;
+    const int64 cost =
+        ComputeNodeArcCostForClass(from_index, to_index, cost_class_index);
+    if (!costs->int64_costs.empty()) {
+      costs->int64_costs[row_start + j] = cost;
+    } else if (cost < kint32min || cost > kint32max) {
+      (*row_overflows)[row] = true;
+      return;
+    } else {
+      costs->int32_costs[row_start + j] = static_cast<int32>(cost);
+    }
+  }
+}
+
+void RoutingModel::PrecomputeArcCostsOfCostClasses() {
+  // The arc costs only depend on the nodes of the arcs, apart from the fixed
+  // costs of the vehicles which are added on lookup; so the matrices are
+  // indexed by node, which avoids duplicating the rows and columns of the
+  // depots. The nodes without an index are never on an arc.
+  std::vector<int64> node_indices(nodes_, -1);
+  for (int64 index = Size() + vehicles_ - 1; index >= 0; --index) {
+    node_indices[IndexToNode(index).value()] = index;
+  }
+  const int64 matrix_size = static_cast<int64>(nodes_) * nodes_;
+  precomputed_arc_costs_.clear();
+  precomputed_arc_costs_.resize(cost_classes_.size());
+  for (CostClassIndex cost_class_index(0);
+       cost_class_index < cost_classes_.size(); ++cost_class_index) {
+    PrecomputedArcCosts* const costs =
+        &precomputed_arc_costs_[cost_class_index];
+    std::vector<char> row_overflows(nodes_, false);
+    costs->int32_costs.resize(matrix_size, 0);
+    FillRowsInParallel(
+        nodes_, FLAGS_routing_precompute_callbacks_threads,
+        NewPermanentCallback(this, &RoutingModel::FillPrecomputedArcCostsRow,
+                             cost_class_index, &node_indices, &row_overflows));
+    if (std::find(row_overflows.begin(), row_overflows.end(), true) !=
+        row_overflows.end()) {
+      std::vector<int32>().swap(costs->int32_costs);
+      costs->int64_costs.resize(matrix_size, 0);
+      FillRowsInParallel(
+          nodes_, FLAGS_routing_precompute_callbacks_threads,
+          NewPermanentCallback(this, &RoutingModel::FillPrecomputedArcCostsRow,
+                               cost_class_index, &node_indices,
+                               &row_overflows));
+    }
+  }
+}
+
+void RoutingModel::FillGranularNeighborsRow(CostClassIndex cost_class_index,
+                                            int num_neighbors, int row) {
+  IntVar* const next = nexts_[row];
+  const int num_indices = Size() + vehicles_;
+  std::vector<std::pair<int64, int> > candidates;
+  for (int j = 0; j < num_indices; ++j) {
+    if (j != row && next->Contains(j)) {
+      candidates.push_back(std::make_pair(
+          GetArcCostForClassInternal(row, j, cost_class_index), j));
+    }
+  }
+  if (candidates.size() > static_cast<size_t>(num_neighbors)) {
+    std::nth_element(candidates.begin(), candidates.begin() + num_neighbors,
+                     candidates.end());
+    candidates.resize(num_neighbors);
+  }
+  std::vector<int>* const neighbors =
+      &granular_neighbors_[cost_class_index][row];
+  neighbors->clear();
+  for (const std::pair<int64, int>& candidate : candidates) {
+    neighbors->push_back(candidate.second);
+  }
+  std::sort(neighbors->begin(), neighbors->end());
+}
+
+void RoutingModel::ComputeGranularNeighbors(int num_neighbors) {
+  // Rows can only be computed concurrently when arc costs are precomputed,
+  // cached callbacks not being thread-safe.
+  const int num_threads = precomputed_arc_costs_.empty()
+                              ? 1
+                              : FLAGS_routing_precompute_callbacks_threads;
+  granular_neighbors_.clear();
+  granular_neighbors_.resize(cost_classes_.size());
+  for (CostClassIndex cost_class_index(0);
+       cost_class_index < cost_classes_.size(); ++cost_class_index) {
+    granular_neighbors_[cost_class_index].resize(Size());
+    FillRowsInParallel(
+        Size(), num_threads,
+        NewPermanentCallback(this, &RoutingModel::FillGranularNeighborsRow,
+                             cost_class_index, num_neighbors));
+  }
+  granular_neighbors_callback_.reset(
+      NewPermanentCallback(this, &RoutingModel::GetGranularNeighbors));
+}
+
+const std::vector<int>* RoutingModel::GetGranularNeighbors(int64 node,
+                                                           int64 vehicle) {
+  return &granular_neighbors_[CostClassIndex(
+      SafeGetCostClassInt64OfVehicle(vehicle))][node];
 }
 
 bool RoutingModel::IsStart(int64 index) const {
@@ -3587,6 +3991,21 @@ LocalSearchOperator* RoutingModel::CreateInsertionOperator() {
                                               : vehicle_vars_,     \
           vehicle_start_class_callback_.get());
 
+#define CP_ROUTING_ADD_GRANULAR_OPERATOR(operator_type, cp_operator_class) \
+  if (granular_neighbors_callback_ != nullptr) {                           \
+    local_search_operators_[operator_type] =                               \
+        MakeGranularLocalSearchOperator<cp_operator_class>(                \
+            solver_.get(), nexts_,                                         \
+            CostsAreHomogeneousAcrossVehicles() ? std::vector<IntVar*>()        \
+                                                : vehicle_vars_,           \
+            vehicle_start_class_callback_.get(),                           \
+            granular_neighbors_callback_.get());                           \
+  } else {                                                                 \
+    CP_ROUTING_ADD_OPERATOR2(operator_type, cp_operator_class);            \
+  }                                                                        \
+  static_cast<PathOperator*>(local_search_operators_[operator_type])       \
+      ->SetUseDontLookBits(FLAGS_routing_use_dont_look_bits);
+
 #define CP_ROUTING_ADD_CALLBACK_OPERATOR(operator_type, cp_operator_type) \
   if (CostsAreHomogeneousAcrossVehicles()) {                              \
     local_search_operators_[operator_type] = solver_->MakeOperator(       \
@@ -3604,7 +4023,10 @@ void RoutingModel::CreateNeighborhoodOperators() {
   local_search_operators_.clear();
   local_search_operators_.resize(ROUTING_LOCAL_SEARCH_OPERATOR_COUNTER,
                                  nullptr);
-  CP_ROUTING_ADD_OPERATOR2(ROUTING_RELOCATE, Relocate);
+  if (FLAGS_routing_granular_neighbors > 0) {
+    ComputeGranularNeighbors(FLAGS_routing_granular_neighbors);
+  }
+  CP_ROUTING_ADD_GRANULAR_OPERATOR(ROUTING_RELOCATE, Relocate);
   std::vector<IntVar*> empty;
   local_search_operators_[ROUTING_PAIR_RELOCATE] = MakePairRelocate(
       solver_.get(), nexts_,
@@ -3615,9 +4037,9 @@ void RoutingModel::CreateNeighborhoodOperators() {
       CostsAreHomogeneousAcrossVehicles() ? empty : vehicle_vars_,
       vehicle_start_class_callback_.get(),
       NewPermanentCallback(this, &RoutingModel::GetHomogeneousCost));
-  CP_ROUTING_ADD_OPERATOR2(ROUTING_EXCHANGE, Exchange);
-  CP_ROUTING_ADD_OPERATOR2(ROUTING_CROSS, Cross);
-  CP_ROUTING_ADD_OPERATOR2(ROUTING_TWO_OPT, TwoOpt);
+  CP_ROUTING_ADD_GRANULAR_OPERATOR(ROUTING_EXCHANGE, Exchange);
+  CP_ROUTING_ADD_GRANULAR_OPERATOR(ROUTING_CROSS, Cross);
+  CP_ROUTING_ADD_GRANULAR_OPERATOR(ROUTING_TWO_OPT, TwoOpt);
   CP_ROUTING_ADD_OPERATOR(ROUTING_OR_OPT, Solver::OROPT);
   CP_ROUTING_ADD_CALLBACK_OPERATOR(ROUTING_LKH, Solver::LK);
   local_search_operators_[ROUTING_MAKE_ACTIVE] = CreateInsertionOperator();
@@ -3635,6 +4057,7 @@ void RoutingModel::CreateNeighborhoodOperators() {
 }
 
 #undef CP_ROUTING_ADD_CALLBACK_OPERATOR
+#undef CP_ROUTING_ADD_GRANULAR_OPERATOR
 #undef CP_ROUTING_ADD_OPERATOR
 
 LocalSearchOperator* RoutingModel::GetNeighborhoodOperators() const {
@@ -3704,6 +4127,11 @@ LocalSearchOperator* RoutingModel::GetNeighborhoodOperators() const {
       operators.push_back(local_search_operators_[ROUTING_INACTIVE_LNS]);
     }
   }
+  if (FLAGS_routing_use_multi_armed_bandit_concatenate_operators) {
+    return solver_->MultiArmedBanditConcatenateOperators(
+        operators, FLAGS_routing_multi_armed_bandit_memory_coefficient,
+        FLAGS_routing_multi_armed_bandit_exploration_coefficient, false);
+  }
   return solver_->ConcatenateOperators(operators);
 }
 
@@ -4116,10 +4544,44 @@ void RoutingModel::AddToAssignment(IntVar* const var) {
 RoutingModel::NodeEvaluator2* RoutingModel::NewCachedCallback(
     NodeEvaluator2* callback) {
   const int size = node_to_index_.size();
-  if (FLAGS_routing_cache_callbacks && size <= FLAGS_routing_max_cache_size) {
-    routing_caches_.push_back(new RoutingCache(callback, size));
+  if (FLAGS_routing_precompute_callbacks) {
+    callback->CheckIsRepeatable();
+    std::vector<int64> values(static_cast<int64>(size) * size);
+    NodeEvaluatorMatrixFiller filler(callback, size, &values);
+    FillRowsInParallel(
+        size, FLAGS_routing_precompute_callbacks_threads,
+        NewPermanentCallback(&filler, &NodeEvaluatorMatrixFiller::FillRow));
+    bool fits_in_int32 = true;
+    for (const int64 value : values) {
+      if (value < kint32min || value > kint32max) {
+        fits_in_int32 = false;
+        break;
+      }
+    }
+    NodeEvaluator2* cached_evaluator = nullptr;
+    if (fits_in_int32) {
+      RoutingDenseCache<int32>* const cache =
+          new RoutingDenseCache<int32>(callback, size, values);
+      routing_caches_.push_back(cache);
+      cached_evaluator =
+          NewPermanentCallback(cache, &RoutingDenseCache<int32>::Run);
+    } else {
+      RoutingDenseCache<int64>* const cache =
+          new RoutingDenseCache<int64>(callback, size, values);
+      routing_caches_.push_back(cache);
+      cached_evaluator =
+          NewPermanentCallback(cache, &RoutingDenseCache<int64>::Run);
+    }
+    // Cache takes ownership of callback,
+    owned_node_callbacks_.erase(callback);
+    owned_node_callbacks_.insert(cached_evaluator);
+    return cached_evaluator;
+  } else if (FLAGS_routing_cache_callbacks &&
+             size <= FLAGS_routing_max_cache_size) {
+    RoutingCache* const cache = new RoutingCache(callback, size);
+    routing_caches_.push_back(cache);
     NodeEvaluator2* const cached_evaluator =
-        NewPermanentCallback(routing_caches_.back(), &RoutingCache::Run);
+        NewPermanentCallback(cache, &RoutingCache::Run);
     // Cache takes ownership of callback,
     owned_node_callbacks_.erase(callback);
     owned_node_callbacks_.insert(cached_evaluator);
@@ -175,7 +175,6 @@
 namespace operations_research {
 
 class LocalSearchOperator;
-class RoutingCache;
 class RoutingDimension;
 #ifndef SWIG
 class SweepArranger;
@@ -197,6 +196,8 @@ struct RoutingParameters {
     use_light_propagation = false;
     cache_callbacks = false;
     max_cache_size = 1000;
+    precompute_callbacks = false;
+    precompute_callbacks_threads = 1;
   }
 
   // Use constraints with light propagation in routing model.
@@ -205,6 +206,16 @@ struct RoutingParameters {
   bool cache_callbacks;
   // Maximum cache size when callback caching is on.
   int64 max_cache_size;
+  // Precompute all callback calls when the model is built: each callback is
+  // evaluated on all pairs of nodes and stored in a dense matrix, and the arc
+  // costs between the nodes of each cost class are stored in a dense matrix
+  // when the model is closed. The matrices hold int32 values when they all
+  // fit. Lookups are then a single load, and the matrices can be read
+  // concurrently. Takes precedence over cache_callbacks.
+  bool precompute_callbacks;
+  // Number of threads used to precompute callbacks. Callbacks must be
+  // thread-safe if this is greater than 1.
+  int precompute_callbacks_threads;
 };
 
 // This class stores search parameters.
@@ -224,6 +235,11 @@ struct RoutingSearchParameters {
     no_tsplns = true;
     use_chain_make_inactive = false;
     use_extended_swap_active = false;
+    granular_neighbors = 0;
+    use_dont_look_bits = true;
+    use_multi_armed_bandit_concatenate_operators = false;
+    multi_armed_bandit_memory_coefficient = 0.04;
+    multi_armed_bandit_exploration_coefficient = 1e-3;
     solution_limit = kint64max;
     time_limit = kint64max;
     lns_time_limit = 100;
@@ -234,6 +250,8 @@ struct RoutingSearchParameters {
     dfs = false;
     first_solution = "";
     use_first_solution_dive = false;
+    first_solution_portfolio = "";
+    first_solution_portfolio_threads = 1;
     optimization_step = 1;
     trace = false;
   }
@@ -268,6 +286,27 @@ struct RoutingSearchParameters {
   bool use_chain_make_inactive;
   // Routing: use extended version of SwapActive neighborhood.
   bool use_extended_swap_active;
+  // Routing: if positive, the Relocate, Exchange, Cross and 2Opt
+  // neighborhoods only consider neighbors creating at least one arc from a
+  // node to one of its 'granular_neighbors' nearest nodes (according to the
+  // arc costs of the vehicle). Nearest nodes are computed once for each cost
+  // class when the model is closed; Relocate, Exchange and 2Opt are built
+  // from them, so that their neighborhoods are linear in the number of nodes
+  // (see PathOperator::SetNeighbors()).
+  int64 granular_neighbors;
+  // Routing: the Relocate, Exchange, Cross and 2Opt neighborhoods skip the
+  // nodes around which nothing changed since they were last explored without
+  // success (see PathOperator::SetUseDontLookBits()).
+  bool use_dont_look_bits;
+  // Routing: explore neighborhoods in the order given by a multi-armed bandit
+  // policy (see Solver::MultiArmedBanditConcatenateOperators()) instead of a
+  // fixed order.
+  bool use_multi_armed_bandit_concatenate_operators;
+  // Weight of the latest observation when averaging the performance of
+  // neighborhoods.
+  double multi_armed_bandit_memory_coefficient;
+  // Weight of the exploration term when ranking neighborhoods.
+  double multi_armed_bandit_exploration_coefficient;
 
   // ----- Search limits -----
 
@@ -298,6 +337,11 @@ struct RoutingSearchParameters {
   std::string first_solution;
   // Dive (left-branch) for first solution.
   bool use_first_solution_dive;
+  // Routing: comma-separated list of first solution heuristics run in
+  // parallel by RoutingModel::SolveWithFirstSolutionPortfolio().
+  std::string first_solution_portfolio;
+  // Routing: number of threads running the first solution portfolio.
+  int first_solution_portfolio_threads;
   // Optimization step.
   int64 optimization_step;
   // Trace search.
@@ -402,6 +446,9 @@ class RoutingModel {
   typedef ResultCallback2<int64, NodeIndex, NodeIndex> NodeEvaluator2;
   typedef std::pair<int, int> NodePair;
   typedef std::vector<NodePair> NodePairs;
+  // Builds a new model, identical to the current one but sharing no state
+  // with it (solver, callbacks). The returned model is owned by the caller.
+  typedef ResultCallback<RoutingModel*> ModelBuilder;
 
 #if !defined(SWIG)
   struct CostClass {
@@ -689,6 +736,12 @@ class RoutingModel {
   // route between node 'from' and 'to' is evaluator(from, to), whatever the
   // route or vehicle performing the route.
   void SetArcCostEvaluatorOfAllVehicles(NodeEvaluator2* evaluator);
+  // Same as SetArcCostEvaluatorOfAllVehicles() with the cost of the segment
+  // between 'from' and 'to' read from the row-major matrix 'costs' at position
+  // from * nodes() + to, such as the matrices computed by
+  // ComputeManyToManyShortestPaths() (see graph/shortestpaths.h). The content
+  // of 'costs' is moved to the model, leaving 'costs' empty.
+  void SetArcCostMatrixOfAllVehicles(std::vector<int64>* costs);
   // Sets the cost function for a given vehicle route.
   void SetArcCostEvaluatorOfVehicle(NodeEvaluator2* evaluator, int vehicle);
   // Sets the fixed cost of all vehicle routes. It is equivalent to calling
@@ -760,6 +813,21 @@ class RoutingModel {
   const Assignment* SolveWithParameters(
       const RoutingSearchParameters& parameters,
       const Assignment* assignment);
+  // Solves the current routing model with the given parameters, starting
+  // local search from the best of the first solutions found by the
+  // heuristics of parameters.first_solution_portfolio. Each heuristic is run
+  // on a separate model built by 'model_builder', the models being solved in
+  // parallel by parameters.first_solution_portfolio_threads threads;
+  // callbacks of different models must therefore not share mutable state.
+  // The time spent finding first solutions is deducted from the time limit
+  // of local search; if no time is left, the best first solution is returned
+  // with all its variables bound. If no heuristic finds a solution, local
+  // search starts from the first solution of the current model. If the
+  // portfolio is empty, this is equivalent to
+  // SolveWithParameters(parameters, nullptr).
+  // Closes the current model. Does not take ownership of 'model_builder'.
+  const Assignment* SolveWithFirstSolutionPortfolio(
+      const RoutingSearchParameters& parameters, ModelBuilder* model_builder);
   // Computes a lower bound to the routing problem solving a linear assignment
   // problem. The routing model must be closed before calling this method.
   // Note that problems with node disjunction constraints (including optional
@@ -1096,6 +1164,16 @@ class RoutingModel {
     int64 cost;
   };
 
+  // Arc costs between the nodes of a cost class, see
+  // RoutingParameters::precompute_callbacks. Only one of the two matrices is
+  // filled: int32_costs if all the costs fit in an int32, int64_costs
+  // otherwise. The cost of the arc from node i to node j is at
+  // i * nodes() + j.
+  struct PrecomputedArcCosts {
+    std::vector<int32> int32_costs;
+    std::vector<int64> int64_costs;
+  };
+
   // Internal methods.
   void Initialize();
   void SetStartEnd(const std::vector<std::pair<NodeIndex, NodeIndex> >& start_end);
@@ -1111,6 +1189,31 @@ class RoutingModel {
   void ComputeVehicleClasses();
   int64 GetArcCostForClassInternal(int64 from_index, int64 to_index,
                                    CostClassIndex cost_class_index);
+  // Computes the cost of an arc without any cache lookup.
+  int64 ComputeArcCostForClass(int64 from_index, int64 to_index,
+                               CostClassIndex cost_class_index) const;
+  // Same as ComputeArcCostForClass() without the fixed cost of the vehicle,
+  // i.e. the part of the cost which only depends on the nodes of the arc.
+  int64 ComputeNodeArcCostForClass(int64 from_index, int64 to_index,
+                                   CostClassIndex cost_class_index) const;
+  // Returns the part of the cost of an arc which only depends on its nodes,
+  // from precomputed_arc_costs_.
+  int64 GetPrecomputedNodeArcCost(int64 from_index, int64 to_index,
+                                  CostClassIndex cost_class_index) const;
+  // Fills precomputed_arc_costs_, see RoutingParameters::precompute_callbacks.
+  void PrecomputeArcCostsOfCostClasses();
+  // Fills a row of the int32 matrix of precomputed_arc_costs_ if it is not
+  // empty, and sets (*row_overflows)[row] if a cost does not fit in an int32;
+  // fills a row of the int64 matrix otherwise. 'node_indices' contains an
+  // index of each node, or -1 if the node has no index.
+  void FillPrecomputedArcCostsRow(CostClassIndex cost_class_index,
+                                  const std::vector<int64>* node_indices,
+                                  std::vector<char>* row_overflows, int row);
+  // Fills granular_neighbors_, see RoutingSearchParameters::granular_neighbors.
+  void ComputeGranularNeighbors(int num_neighbors);
+  void FillGranularNeighborsRow(CostClassIndex cost_class_index,
+                                int num_neighbors, int row);
+  const std::vector<int>* GetGranularNeighbors(int64 node, int64 vehicle);
   void AppendHomogeneousArcCosts(int node_index,
                                  std::vector<IntVar*>* cost_elements);
   void AppendArcCosts(int node_index, std::vector<IntVar*>* cost_elements);
@@ -1144,6 +1247,8 @@ class RoutingModel {
 
   NodeEvaluator2* NewCachedCallback(NodeEvaluator2* callback);
   void CheckDepot();
+  // Sets the search flags from 'parameters'.
+  void SetSearchParameters(const RoutingSearchParameters& parameters);
   void QuietCloseModel() {
     if (!closed_) {
       CloseModel();
@@ -1204,7 +1309,15 @@ class RoutingModel {
 #endif  // SWIG
   bool costs_are_homogeneous_across_vehicles_;
   std::vector<CostCacheElement> cost_cache_;  // Index by source index.
-  std::vector<RoutingCache*> routing_caches_;
+  // Arc costs of each cost class, only filled when callbacks are precomputed.
+  ITIVector<CostClassIndex, PrecomputedArcCosts> precomputed_arc_costs_;
+  // Sorted nearest nodes of each node for each cost class, only filled in
+  // granular neighborhood mode.
+  ITIVector<CostClassIndex, std::vector<std::vector<int> > >
+      granular_neighbors_;
+  std::unique_ptr<ResultCallback2<const std::vector<int>*, int64, int64> >
+      granular_neighbors_callback_;
+  std::vector<BaseObject*> routing_caches_;
   std::vector<VehicleClassIndex> vehicle_class_index_of_vehicle_;
 #ifndef SWIG
   ITIVector<VehicleClassIndex, VehicleClass> vehicle_classes_;
@@ -1596,14 +1709,18 @@ class GlobalCheapestInsertionFilteredDecisionBuilder
   virtual bool BuildSolution();
 
  private:
+  class NodeEntry;
   typedef std::pair<int64, int64> InsertionPosition;
-  // Computes the possible insertion positions for all non-inserted nodes and
-  // sorts them according to the current cost evaluator.
-  // Each InsertionPosition of the output represents an already performed node,
-  // followed by a non-inserted node that should be set as the "Next" of the
-  // former.
-  void ComputeEvaluatorSortedPositions(
-      std::vector<InsertionPosition>* sorted_positions);
+  // Inserts the remaining non-inserted nodes at their cheapest position. The
+  // cheapest insertion positions of each node are kept in a priority queue;
+  // after an insertion, nodes are only evaluated on the two positions created
+  // by the insertion, unless all their known positions have been destroyed or
+  // rejected by filters.
+  void InsertNodes();
+  // Sets 'entry' to the cheapest insertion positions of its node, skipping
+  // 'failed_positions' (nodes after which the insertion was rejected).
+  void ComputeCheapestPositions(const std::vector<int64>& failed_positions,
+                                NodeEntry* entry);
   // Same as above but limited to pickup and delivery pairs. Each pair of
   // InsertionPosition applies respectively to a pickup and its delivery.
   void ComputeEvaluatorSortedPositionPairs(
@@ -19,9 +19,17 @@
 
 #include <map>
 #include <set>
+#include "base/adjustable_priority_queue.h"
+#include "base/commandlineflags.h"
 #include "base/small_map.h"
 #include "base/small_ordered_set.h"
 #include "util/bitset.h"
+#include "util/saturated_arithmetic.h"
+
+DEFINE_bool(routing_use_cumul_node_summaries, true,
+            "Check the delta paths in PathCumulFilter with summaries of the "
+            "nodes of the current solution when neither span nor slack costs "
+            "are filtered.");
 
 namespace operations_research {
 
@@ -182,6 +190,11 @@ class BasePathFilter : public RoutingLocalSearchFilter {
   int NumPaths() const { return starts_.size(); }
   int64 Start(int i) const { return starts_[i]; }
   int GetPath(int64 node) const { return paths_[node]; }
+  // Returns true if the next of node has been changed by the delta being
+  // accepted.
+  bool HasNewNext(int64 node) const { return new_nexts_[node] != kUnassigned; }
+  // Nodes the next of which has been changed by the delta being accepted.
+  const std::vector<int>& TouchedNodes() const { return delta_touched_; }
 
  private:
   virtual void InitializeAcceptPath() {}
@@ -364,9 +377,40 @@ class PathCumulFilter : public BasePathFilter {
     std::vector<std::vector<int64>> transits_;
   };
 
-  virtual void InitializeAcceptPath() {
-    cumul_cost_delta_ = total_current_cumul_cost_value_;
-  }
+  // Summary of a node of a path of the solution to which the filter was
+  // synchronized. Positions on a path range from 0 (path start) to n (path
+  // end); P(i) is the sum of the transits (including slack minima) from the
+  // start to the node at position i, and CumulMax(i) is capped by the
+  // capacity of the vehicle of the path.
+  struct NodeSummary {
+    NodeSummary()
+        : path(-1),
+          position(-1),
+          cumul(0),
+          total_transit(0),
+          soft_cost(0),
+          prefix_max_cumul_min(kint64min),
+          prefix_min_cumul_max(kint64max),
+          suffix_max_cumul_min(kint64min),
+          suffix_min_cumul_max(kint64max) {}
+    // Path of the node, -1 if the node is not on a path.
+    int path;
+    int position;
+    int64 cumul;
+    // P(position).
+    int64 total_transit;
+    // Sum of the soft bound costs of the nodes at positions [0, position].
+    int64 soft_cost;
+    // Max of CumulMin(i) - P(i) and min of CumulMax(i) - P(i) for i in
+    // ]1, position].
+    int64 prefix_max_cumul_min;
+    int64 prefix_min_cumul_max;
+    // Same for i in ]position, n].
+    int64 suffix_max_cumul_min;
+    int64 suffix_min_cumul_max;
+  };
+
+  virtual void InitializeAcceptPath();
   virtual bool AcceptPath(int64 path_start);
   virtual bool FinalizeAcceptPath();
 
@@ -376,6 +420,24 @@ class PathCumulFilter : public BasePathFilter {
     return has_nonzero_vehicle_span_cost_coefficients_;
   }
 
+  // Span and slack costs need all the transits of the delta paths; without
+  // them, delta paths are checked by jumping over the sub-paths of the current
+  // solution they contain, using node summaries (unless
+  // --routing_use_cumul_node_summaries is false).
+  bool UseNodeSummaries() const { return use_node_summaries_; }
+  void SynchronizeNodeSummaries();
+  bool AcceptPathWithNodeSummaries(int64 path_start);
+  // Evaluates the sub-path of the current solution starting at 'node' and
+  // ending at the first node after it which is touched by the delta (or at
+  // the path end), 'cumul' being the cumul of 'node' on a delta path of
+  // 'vehicle'. Returns false if this cannot be done in constant time.
+  // Otherwise sets 'last' to the last node of the sub-path, 'cumul' to its
+  // cumul, adds the soft bound costs of the sub-path (minus 'node') to
+  // 'cost' and sets 'feasible' to false if cumul bounds are violated.
+  bool EvaluateUnchangedSubPath(int64 node, int vehicle, int64 capacity,
+                                int64* last, int64* cumul, int64* cost,
+                                bool* feasible) const;
+
   bool FilterCumulSoftBounds() const { return !cumul_soft_bounds_.empty(); }
 
   int64 GetCumulSoftCost(int64 node, int64 cumul_value) const;
@@ -414,6 +476,15 @@ class PathCumulFilter : public BasePathFilter {
   int64 delta_max_end_cumul_;
   // Note: small_ordered_set only support non-hash sets.
   small_ordered_set<std::set<int>> delta_paths_;
+  // Node summaries of the current solution, see NodeSummary.
+  std::vector<NodeSummary> node_summaries_;
+  // path_nodes_[r][i] is the node at position i on path r.
+  std::vector<std::vector<int64> > path_nodes_;
+  std::vector<int64> path_capacities_;
+  // Sorted (path, position) pairs of the touched nodes of the delta which are
+  // on a path of the current solution.
+  std::vector<std::pair<int, int> > delta_touched_positions_;
+  bool use_node_summaries_;
   const std::string name_;
 
   bool lns_detected_;
@@ -437,6 +508,7 @@ PathCumulFilter::PathCumulFilter(const RoutingModel& routing_model,
       cost_var_(routing_model.CostVar()),
       capacity_evaluator_(dimension.capacity_evaluator()),
       delta_max_end_cumul_(kint64min),
+      use_node_summaries_(false),
       name_(dimension.name()),
       lns_detected_(false) {
   for (const int64 coefficient : vehicle_span_cost_coefficients_) {
@@ -483,6 +555,8 @@ PathCumulFilter::PathCumulFilter(const RoutingModel& routing_model,
     start_to_vehicle_[routing_model.Start(i)] = i;
     evaluators_[i] = dimension.transit_evaluator(i);
   }
+  use_node_summaries_ = FLAGS_routing_use_cumul_node_summaries &&
+                        !FilterSpanCost() && !FilterSlackCost();
 }
 
 int64 PathCumulFilter::GetCumulSoftCost(int64 node, int64 cumul_value) const {
@@ -561,6 +635,9 @@ void PathCumulFilter::OnSynchronize() {
       }
     }
   }
+  if (UseNodeSummaries()) {
+    SynchronizeNodeSummaries();
+  }
   // Initialize this before considering any deltas (neighbor).
   delta_max_end_cumul_ = kint64min;
   lns_detected_ = false;
@@ -573,7 +650,184 @@ void PathCumulFilter::OnSynchronize() {
   }
 }
 
+void PathCumulFilter::SynchronizeNodeSummaries() {
+  node_summaries_.assign(cumuls_.size(), NodeSummary());
+  path_nodes_.resize(NumPaths());
+  path_capacities_.resize(NumPaths());
+  for (int r = 0; r < NumPaths(); ++r) {
+    const int vehicle = start_to_vehicle_[Start(r)];
+    Solver::IndexEvaluator2* const evaluator = evaluators_[vehicle];
+    const int64 capacity = capacity_evaluator_ == nullptr
+                               ? kint64max
+                               : capacity_evaluator_->Run(vehicle);
+    path_capacities_[r] = capacity;
+    std::vector<int64>* const nodes = &path_nodes_[r];
+    nodes->clear();
+    int64 node = Start(r);
+    int64 cumul = cumuls_[node]->Min();
+    int64 total_transit = 0;
+    int64 soft_cost = GetCumulSoftCost(node, cumul);
+    int64 max_cumul_min = kint64min;
+    int64 min_cumul_max = kint64max;
+    while (true) {
+      NodeSummary* const summary = &node_summaries_[node];
+      summary->path = r;
+      summary->position = nodes->size();
+      summary->cumul = cumul;
+      summary->total_transit = total_transit;
+      summary->soft_cost = soft_cost;
+      if (summary->position > 1) {
+        max_cumul_min = std::max(
+            max_cumul_min, CapSub(cumuls_[node]->Min(), total_transit));
+        min_cumul_max = std::min(
+            min_cumul_max,
+            CapSub(std::min(capacity, cumuls_[node]->Max()), total_transit));
+      }
+      summary->prefix_max_cumul_min = max_cumul_min;
+      summary->prefix_min_cumul_max = min_cumul_max;
+      nodes->push_back(node);
+      if (node >= Size()) break;
+      const int64 next = Value(node);
+      const int64 transit_slack =
+          evaluator->Run(node, next) + slacks_[node]->Min();
+      total_transit = CapAdd(total_transit, transit_slack);
+      cumul = std::max(cumuls_[next]->Min(), CapAdd(cumul, transit_slack));
+      node = next;
+      soft_cost += GetCumulSoftCost(node, cumul);
+    }
+    max_cumul_min = kint64min;
+    min_cumul_max = kint64max;
+    for (int i = nodes->size() - 1; i >= 0; --i) {
+      const int64 node = (*nodes)[i];
+      NodeSummary* const summary = &node_summaries_[node];
+      summary->suffix_max_cumul_min = max_cumul_min;
+      summary->suffix_min_cumul_max = min_cumul_max;
+      max_cumul_min = std::max(
+          max_cumul_min, CapSub(cumuls_[node]->Min(), summary->total_transit));
+      min_cumul_max =
+          std::min(min_cumul_max,
+                   CapSub(std::min(capacity, cumuls_[node]->Max()),
+                          summary->total_transit));
+    }
+  }
+}
+
+void PathCumulFilter::InitializeAcceptPath() {
+  cumul_cost_delta_ = total_current_cumul_cost_value_;
+  if (UseNodeSummaries()) {
+    delta_touched_positions_.clear();
+    for (const int touched : TouchedNodes()) {
+      const NodeSummary& summary = node_summaries_[touched];
+      if (summary.path >= 0) {
+        delta_touched_positions_.push_back(
+            std::make_pair(summary.path, summary.position));
+      }
+    }
+    std::sort(delta_touched_positions_.begin(),
+              delta_touched_positions_.end());
+  }
+}
+
+bool PathCumulFilter::EvaluateUnchangedSubPath(int64 node, int vehicle,
+                                               int64 capacity, int64* last,
+                                               int64* cumul, int64* cost,
+                                               bool* feasible) const {
+  const NodeSummary& first = node_summaries_[node];
+  if (first.path < 0 || path_capacities_[first.path] != capacity ||
+      evaluators_[start_to_vehicle_[Start(first.path)]] !=
+          evaluators_[vehicle]) {
+    return false;
+  }
+  // The sub-path ends at the first touched node after 'node' on its path,
+  // or at the end of the path.
+  const std::vector<std::pair<int, int> >::const_iterator touched =
+      std::upper_bound(delta_touched_positions_.begin(),
+                       delta_touched_positions_.end(),
+                       std::make_pair(first.path, first.position));
+  const bool is_suffix = touched == delta_touched_positions_.end() ||
+                         touched->first != first.path;
+  const std::vector<int64>& nodes = path_nodes_[first.path];
+  *last = is_suffix ? nodes.back() : nodes[touched->second];
+  const NodeSummary& summary = node_summaries_[*last];
+  *feasible = true;
+  if (*cumul == first.cumul) {
+    // Cumuls are the same as in the current solution up to 'last'.
+    *cumul = summary.cumul;
+    *cost += summary.soft_cost - first.soft_cost;
+    return true;
+  }
+  // Soft bound costs need all the cumuls of the sub-path; the min and max
+  // summaries are only available for prefixes (starting after the path
+  // start) and suffixes.
+  if (FilterCumulSoftBounds() || (!is_suffix && first.position != 1)) {
+    return false;
+  }
+  const int64 max_cumul_min =
+      is_suffix ? first.suffix_max_cumul_min : summary.prefix_max_cumul_min;
+  const int64 min_cumul_max =
+      is_suffix ? first.suffix_min_cumul_max : summary.prefix_min_cumul_max;
+  const int64 transit = summary.total_transit - first.total_transit;
+  if (*cumul > first.cumul) {
+    // Cumuls are the max of their current value and the cumul of 'node' plus
+    // the transits from 'node'.
+    *feasible = CapSub(*cumul, first.total_transit) <= min_cumul_max;
+    *cumul = std::max(summary.cumul, CapAdd(*cumul, transit));
+  } else {
+    // Cumuls are lower than their current (feasible) value.
+    *cumul = std::max(CapAdd(summary.total_transit, max_cumul_min),
+                      CapAdd(*cumul, transit));
+  }
+  return true;
+}
+
+bool PathCumulFilter::AcceptPathWithNodeSummaries(int64 path_start) {
+  int64 node = path_start;
+  int64 cumul = cumuls_[node]->Min();
+  cumul_cost_delta_ += GetCumulSoftCost(node, cumul);
+  const int vehicle = start_to_vehicle_[path_start];
+  const int64 capacity = capacity_evaluator_ == nullptr
+                             ? kint64max
+                             : capacity_evaluator_->Run(vehicle);
+  Solver::IndexEvaluator2* const evaluator = evaluators_[vehicle];
+  while (node < Size()) {
+    if (!HasNewNext(node)) {
+      int64 last = kUnassigned;
+      bool feasible = true;
+      if (EvaluateUnchangedSubPath(node, vehicle, capacity, &last, &cumul,
+                                   &cumul_cost_delta_, &feasible)) {
+        if (!feasible) {
+          return false;
+        }
+        node = last;
+        continue;
+      }
+    }
+    const int64 next = GetNext(node);
+    if (next == kUnassigned) {
+      // LNS detected, return true since other paths were ok up to now.
+      lns_detected_ = true;
+      return true;
+    }
+    cumul += evaluator->Run(node, next) + slacks_[node]->Min();
+    if (cumul > std::min(capacity, cumuls_[next]->Max())) {
+      return false;
+    }
+    cumul = std::max(cumuls_[next]->Min(), cumul);
+    node = next;
+    cumul_cost_delta_ += GetCumulSoftCost(node, cumul);
+  }
+  if (FilterCumulSoftBounds()) {
+    delta_paths_.insert(GetPath(path_start));
+    delta_max_end_cumul_ = std::max(delta_max_end_cumul_, cumul);
+    cumul_cost_delta_ -= current_cumul_cost_values_[path_start];
+  }
+  return true;
+}
+
 bool PathCumulFilter::AcceptPath(int64 path_start) {
+  if (UseNodeSummaries()) {
+    return AcceptPathWithNodeSummaries(path_start);
+  }
   int64 node = path_start;
   int64 cumul = cumuls_[node]->Min();
   cumul_cost_delta_ += GetCumulSoftCost(node, cumul);
@@ -1113,47 +1367,206 @@ bool GlobalCheapestInsertionFilteredDecisionBuilder::BuildSolution() {
       }
     }
   }
-  // Node insertions currently being considered.
-  std::vector<std::pair<int64, int64>> insertions;
-  // Iterating on remaining nodes.
-  found = true;
-  while (found) {
-    found = false;
-    ComputeEvaluatorSortedPositions(&insertions);
-    for (const std::pair<int64, int64> insertion : insertions) {
-      InsertBetween(insertion.second, insertion.first, Value(insertion.first));
-      if (Commit()) {
-        found = true;
-        break;
-      }
-    }
-  }
+  InsertNodes();
   MakeUnassignedNodesUnperformed();
   return Commit();
 }
 
-void
-GlobalCheapestInsertionFilteredDecisionBuilder::ComputeEvaluatorSortedPositions(
-    std::vector<InsertionPosition>* sorted_positions) {
-  CHECK(sorted_positions != nullptr);
-  sorted_positions->clear();
-  std::vector<std::pair<int64, InsertionPosition>> valued_insertions;
+// Cheapest insertion positions of a node, as stored in the priority queue of
+// GlobalCheapestInsertionFilteredDecisionBuilder::InsertNodes(). Only the
+// kMaxPositions cheapest positions are kept, sorted by increasing value
+// (ties broken on the node after which to insert). All positions which are
+// not kept are not cheaper than 'bound_'.
+class GlobalCheapestInsertionFilteredDecisionBuilder::NodeEntry {
+ public:
+  typedef std::pair<int64, int64> ValuedPosition;
+
+  explicit NodeEntry(int64 node)
+      : heap_index_(-1), node_(node), bound_(kNoBound) {}
+  // AdjustablePriorityQueue is a max-heap: the cheapest position has the
+  // highest priority, ties being broken on positions then on nodes.
+  bool operator<(const NodeEntry& other) const {
+    const ValuedPosition position = Cheapest();
+    const ValuedPosition other_position = other.Cheapest();
+    if (position != other_position) {
+      return position > other_position;
+    }
+    return node_ > other.node_;
+  }
+  void SetHeapIndex(int h) { heap_index_ = h; }
+  int GetHeapIndex() const { return heap_index_; }
+  int64 node() const { return node_; }
+  // Returns true if the cheapest position is known, which is the case when
+  // positions are kept or when no position has been dropped.
+  bool IsCheapestKnown() const {
+    return !positions_.empty() || bound_ == kNoBound;
+  }
+  bool HasPosition() const { return !positions_.empty(); }
+  int64 insert_after() const { return positions_.front().second; }
+  // Clears all positions, to be followed by calls to AddScannedPosition()
+  // on all positions and by FinishScan().
+  void StartScan() {
+    positions_.clear();
+    bound_ = kNoBound;
+  }
+  void AddScannedPosition(const ValuedPosition& position) {
+    if (positions_.size() <= kMaxPositions || position < positions_.back()) {
+      positions_.insert(std::upper_bound(positions_.begin(), positions_.end(),
+                                         position),
+                        position);
+      if (positions_.size() > kMaxPositions + 1) {
+        positions_.pop_back();
+      }
+    }
+  }
+  void FinishScan() {
+    if (positions_.size() > kMaxPositions) {
+      bound_ = positions_.back();
+      positions_.pop_back();
+    }
+  }
+  // Adds a new position; returns true if the cheapest position changed.
+  bool AddPosition(const ValuedPosition& position) {
+    if (bound_ != kNoBound && !(position < bound_)) {
+      return false;
+    }
+    const bool cheapest = positions_.empty() || position < positions_.front();
+    positions_.insert(
+        std::upper_bound(positions_.begin(), positions_.end(), position),
+        position);
+    if (positions_.size() > kMaxPositions) {
+      bound_ = std::min(bound_, positions_.back());
+      positions_.pop_back();
+    }
+    return cheapest;
+  }
+  // Removes the position after 'insert_after' if it is kept; returns true if
+  // the cheapest position changed.
+  bool RemovePosition(int64 insert_after) {
+    for (int i = 0; i < positions_.size(); ++i) {
+      if (positions_[i].second == insert_after) {
+        positions_.erase(positions_.begin() + i);
+        return i == 0;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static const int kMaxPositions;
+  static const ValuedPosition kNoBound;
+
+  ValuedPosition Cheapest() const {
+    return positions_.empty() ? kNoBound : positions_.front();
+  }
+
+  int heap_index_;
+  const int64 node_;
+  std::vector<ValuedPosition> positions_;
+  ValuedPosition bound_;
+};
+
+const int GlobalCheapestInsertionFilteredDecisionBuilder::NodeEntry::
+    kMaxPositions = 16;
+const GlobalCheapestInsertionFilteredDecisionBuilder::NodeEntry::ValuedPosition
+    GlobalCheapestInsertionFilteredDecisionBuilder::NodeEntry::kNoBound(
+        kint64max, kint64max);
+
+void GlobalCheapestInsertionFilteredDecisionBuilder::InsertNodes() {
+  std::vector<std::unique_ptr<NodeEntry> > entries(model()->Size());
+  std::vector<std::vector<int64> > failed_positions(model()->Size());
+  std::vector<int64> nodes_to_insert;
+  AdjustablePriorityQueue<NodeEntry> queue;
   for (int node = 0; node < model()->Size(); ++node) {
-    if (Contains(node)) {
+    if (!Contains(node)) {
+      entries[node].reset(new NodeEntry(node));
+      ComputeCheapestPositions(failed_positions[node], entries[node].get());
+      if (entries[node]->HasPosition()) {
+        queue.Add(entries[node].get());
+      }
+      nodes_to_insert.push_back(node);
+    }
+  }
+  while (!queue.IsEmpty()) {
+    NodeEntry* const entry = queue.Top();
+    const int64 node = entry->node();
+    const int64 insert_after = entry->insert_after();
+    const int64 insert_before = Value(insert_after);
+    InsertBetween(node, insert_after, insert_before);
+    if (!Commit()) {
+      failed_positions[node].push_back(insert_after);
+      entry->RemovePosition(insert_after);
+      if (!entry->IsCheapestKnown()) {
+        ComputeCheapestPositions(failed_positions[node], entry);
+      }
+      if (entry->HasPosition()) {
+        queue.NoteChangedPriority(entry);
+      } else {
+        queue.Remove(entry);
+      }
       continue;
     }
-    std::vector<ValuedPosition> valued_positions;
-    for (int vehicle = 0; vehicle < model()->vehicles(); ++vehicle) {
-      const int64 start = model()->Start(vehicle);
-      AppendEvaluatedPositionsAfter(node, start, Value(start),
-                                    &valued_positions);
+    // The position after 'insert_after' has been replaced by the positions
+    // after 'insert_after' and after 'node'; other positions are unchanged.
+    int new_size = 0;
+    for (const int64 other : nodes_to_insert) {
+      NodeEntry* const other_entry = entries[other].get();
+      if (Contains(other)) {
+        // Inserted or made unperformed by a disjunction.
+        if (queue.Contains(other_entry)) {
+          queue.Remove(other_entry);
+        }
+        continue;
+      }
+      nodes_to_insert[new_size++] = other;
+      std::vector<int64>* const failed = &failed_positions[other];
+      failed->erase(std::remove(failed->begin(), failed->end(), insert_after),
+                    failed->end());
+      bool changed = other_entry->RemovePosition(insert_after);
+      if (!other_entry->IsCheapestKnown()) {
+        ComputeCheapestPositions(*failed, other_entry);
+        changed = true;
+      }
+      changed |= other_entry->AddPosition(std::make_pair(
+          evaluator_->Run(insert_after, other) + evaluator_->Run(other, node) -
+              evaluator_->Run(insert_after, node),
+          insert_after));
+      changed |= other_entry->AddPosition(std::make_pair(
+          evaluator_->Run(node, other) + evaluator_->Run(other, insert_before) -
+              evaluator_->Run(node, insert_before),
+          node));
+      if (changed) {
+        if (queue.Contains(other_entry)) {
+          queue.NoteChangedPriority(other_entry);
+        } else {
+          queue.Add(other_entry);
+        }
+      }
     }
-    for (const std::pair<int64, int64>& valued_position : valued_positions) {
-      valued_insertions.push_back(std::make_pair(
-          valued_position.first, std::make_pair(valued_position.second, node)));
+    nodes_to_insert.resize(new_size);
+  }
+}
+
+void GlobalCheapestInsertionFilteredDecisionBuilder::ComputeCheapestPositions(
+    const std::vector<int64>& failed_positions, NodeEntry* entry) {
+  const int64 node = entry->node();
+  entry->StartScan();
+  for (int vehicle = 0; vehicle < model()->vehicles(); ++vehicle) {
+    int64 insert_after = model()->Start(vehicle);
+    while (!model()->IsEnd(insert_after)) {
+      const int64 insert_before = Value(insert_after);
+      if (std::find(failed_positions.begin(), failed_positions.end(),
+                    insert_after) == failed_positions.end()) {
+        entry->AddScannedPosition(std::make_pair(
+            evaluator_->Run(insert_after, node) +
+                evaluator_->Run(node, insert_before) -
+                evaluator_->Run(insert_after, insert_before),
+            insert_after));
+      }
+      insert_after = insert_before;
     }
   }
-  SortAndExtractPairSeconds(&valued_insertions, sorted_positions);
+  entry->FinishScan();
 }
 
 void GlobalCheapestInsertionFilteredDecisionBuilder::
@@ -1635,7 +1635,7 @@ void AssignOneVariableValue::Refute(Solver* const s) {
 }  // namespace
 
 Decision* Solver::MakeAssignVariableValue(IntVar* const v, int64 val) {
-  return RevAlloc(new AssignOneVariableValue(v, val));
+  return RevAlloc(new (this) AssignOneVariableValue(v, val));
 }
 
 // ----- AssignOneVariableValueOrFail decision -----
@@ -1674,7 +1674,7 @@ void AssignOneVariableValueOrFail::Refute(Solver* const s) { s->Fail(); }
 }  // namespace
 
 Decision* Solver::MakeAssignVariableValueOrFail(IntVar* const v, int64 value) {
-  return RevAlloc(new AssignOneVariableValueOrFail(v, value));
+  return RevAlloc(new (this) AssignOneVariableValueOrFail(v, value));
 }
 
 // ----- AssignOneVariableValue decision -----
@@ -1730,7 +1730,7 @@ void SplitOneVariable::Refute(Solver* const s) {
 
 Decision* Solver::MakeSplitVariableDomain(IntVar* const v, int64 val,
                                           bool start_with_lower_half) {
-  return RevAlloc(new SplitOneVariable(v, val, start_with_lower_half));
+  return RevAlloc(new (this) SplitOneVariable(v, val, start_with_lower_half));
 }
 
 Decision* Solver::MakeVariableLessOrEqualValue(IntVar* const var, int64 value) {
@@ -1928,11 +1928,11 @@ Decision* BaseAssignVariables::Next(Solver* const s) {
     const int64 value = selector_->SelectValue(var, id);
     switch (mode_) {
       case ASSIGN:
-        return s->RevAlloc(new AssignOneVariableValue(var, value));
+        return s->RevAlloc(new (s) AssignOneVariableValue(var, value));
       case SPLIT_LOWER:
-        return s->RevAlloc(new SplitOneVariable(var, value, true));
+        return s->RevAlloc(new (s) SplitOneVariable(var, value, true));
       case SPLIT_UPPER:
-        return s->RevAlloc(new SplitOneVariable(var, value, false));
+        return s->RevAlloc(new (s) SplitOneVariable(var, value, false));
     }
   }
   return nullptr;
@@ -3151,42 +3151,117 @@ int64 GuidedLocalSearchPenaltiesTable::Value(const Arc& arc) const {
   }
 }
 
-// Sparse GLS penalties implementation using a hash_map to store penalties.
+}  // namespace
+
+const uint64 ArcInt64FlatMap::kEmptyKey = kuint64max;
+
+ArcInt64FlatMap::ArcInt64FlatMap()
+    : slots_(1 << kInitialLogCapacity), size_(0),
+      shift_(64 - kInitialLogCapacity) {
+  for (Slot& slot : slots_) {
+    slot.key = kEmptyKey;
+    slot.value = 0;
+  }
+}
+
+// Returns the slot containing key, or the empty slot where it would be
+// inserted. There is always an empty slot as the load factor is kept below
+// 1/2.
+int ArcInt64FlatMap::FindSlot(uint64 key) const {
+  const int mask = slots_.size() - 1;
+  int index = SlotIndex(key);
+  while (slots_[index].key != key && slots_[index].key != kEmptyKey) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+int64 ArcInt64FlatMap::Value(const Arc& arc) const {
+  uint64 key = 0;
+  if (!PackArc(arc, &key)) {
+    return FindWithDefault(overflow_, arc, 0LL);
+  }
+  return slots_[FindSlot(key)].value;
+}
+
+int64* ArcInt64FlatMap::MutableValue(const Arc& arc) {
+  uint64 key = 0;
+  if (!PackArc(arc, &key)) {
+    return &overflow_[arc];
+  }
+  int index = FindSlot(key);
+  if (slots_[index].key == kEmptyKey) {
+    if (2 * (size_ + 1) > static_cast<int>(slots_.size())) {
+      Grow();
+      index = FindSlot(key);
+    }
+    slots_[index].key = key;
+    slots_[index].value = 0;
+    ++size_;
+  }
+  return &slots_[index].value;
+}
+
+void ArcInt64FlatMap::Grow() {
+  std::vector<Slot> old_slots(2 * slots_.size());
+  old_slots.swap(slots_);
+  --shift_;
+  for (Slot& slot : slots_) {
+    slot.key = kEmptyKey;
+    slot.value = 0;
+  }
+  for (const Slot& old_slot : old_slots) {
+    if (old_slot.key != kEmptyKey) {
+      slots_[FindSlot(old_slot.key)] = old_slot;
+    }
+  }
+}
+
+void ArcInt64FlatMap::Clear() {
+  if (size_ > 0) {
+    for (Slot& slot : slots_) {
+      slot.key = kEmptyKey;
+      slot.value = 0;
+    }
+    size_ = 0;
+  }
+  overflow_.clear();
+}
+
+namespace {
+// Sparse GLS penalties implementation using an ArcInt64FlatMap to store
+// penalties.
 
 class GuidedLocalSearchPenaltiesMap : public GuidedLocalSearchPenalties {
  public:
   explicit GuidedLocalSearchPenaltiesMap(int size);
   virtual ~GuidedLocalSearchPenaltiesMap() {}
-  virtual bool HasValues() const { return (penalties_.size() != 0); }
+  virtual bool HasValues() const { return !penalties_.Empty(); }
   virtual void Increment(const Arc& arc);
   virtual int64 Value(const Arc& arc) const;
   virtual void Reset();
 
  private:
   Bitmap penalized_;
-#if defined(_MSC_VER)
-  hash_map<Arc, int64, PairInt64Hasher> penalties_;
-#else
-  hash_map<Arc, int64> penalties_;
-#endif
+  ArcInt64FlatMap penalties_;
 };
 
 GuidedLocalSearchPenaltiesMap::GuidedLocalSearchPenaltiesMap(int size)
     : penalized_(size, false) {}
 
 void GuidedLocalSearchPenaltiesMap::Increment(const Arc& arc) {
-  ++penalties_[arc];
+  ++*penalties_.MutableValue(arc);
   penalized_.Set(arc.first, true);
 }
 
 void GuidedLocalSearchPenaltiesMap::Reset() {
-  penalties_.clear();
+  penalties_.Clear();
   penalized_.Clear();
 }
 
 int64 GuidedLocalSearchPenaltiesMap::Value(const Arc& arc) const {
   if (penalized_.Get(arc.first)) {
-    return FindWithDefault(penalties_, arc, 0LL);
+    return penalties_.Value(arc);
   }
   return 0LL;
 }
@@ -3213,6 +3288,9 @@ class GuidedLocalSearch : public Metaheuristic {
   virtual std::string DebugString() const { return "Guided Local Search"; }
 
  protected:
+  // Increments the penalty of arc; called on the arcs of maximal utility at
+  // local optima.
+  virtual void IncrementPenalty(const Arc& arc) { penalties_->Increment(arc); }
   struct Comparator {
     bool operator()(const std::pair<Arc, double>& i, const std::pair<Arc, double>& j) {
       return i.second > j.second;
@@ -3423,10 +3501,10 @@ bool GuidedLocalSearch::LocalOptimum() {
   Comparator comparator;
   std::stable_sort(utility.begin(), utility.end(), comparator);
   int64 utility_value = utility[0].second;
-  penalties_->Increment(utility[0].first);
+  IncrementPenalty(utility[0].first);
   for (int i = 1; i < utility.size() && utility_value == utility[i].second;
        ++i) {
-    penalties_->Increment(utility[i].first);
+    IncrementPenalty(utility[i].first);
   }
   if (maximize_) {
     current_ = kint64min;
@@ -3443,6 +3521,7 @@ class BinaryGuidedLocalSearch : public GuidedLocalSearch {
                           bool maximize, int64 step,
                           const std::vector<IntVar*>& vars, double penalty_factor);
   virtual ~BinaryGuidedLocalSearch() {}
+  virtual void EnterSearch();
   virtual IntExpr* MakeElementPenalty(int index);
   virtual int64 AssignmentElementPenalty(const Assignment& assignment,
                                          int index);
@@ -3452,9 +3531,19 @@ class BinaryGuidedLocalSearch : public GuidedLocalSearch {
                                     int64 index, int* container_index,
                                     int64* penalty);
 
+ protected:
+  virtual void IncrementPenalty(const Arc& arc);
+
  private:
   int64 PenalizedValue(int64 i, int64 j);
+  int64 ComputePenalizedValue(const Arc& arc);
   std::unique_ptr<Solver::IndexEvaluator2> objective_function_;
+  // With sparse penalties, the penalized values of the penalized arcs,
+  // updated when their penalty is incremented; this avoids a hash lookup and
+  // a call to objective_function_ each time the penalized value of an arc of
+  // a delta is evaluated. Dense penalties are read from their table.
+  const bool cache_penalized_values_;
+  ArcInt64FlatMap penalized_values_;
 };
 
 BinaryGuidedLocalSearch::BinaryGuidedLocalSearch(
@@ -3463,10 +3552,23 @@ BinaryGuidedLocalSearch::BinaryGuidedLocalSearch(
     const std::vector<IntVar*>& vars, double penalty_factor)
     : GuidedLocalSearch(solver, objective, maximize, step, vars,
                         penalty_factor),
-      objective_function_(objective_function) {
+      objective_function_(objective_function),
+      cache_penalized_values_(FLAGS_cp_use_sparse_gls_penalties) {
   objective_function_->CheckIsRepeatable();
 }
 
+void BinaryGuidedLocalSearch::EnterSearch() {
+  GuidedLocalSearch::EnterSearch();
+  penalized_values_.Clear();
+}
+
+void BinaryGuidedLocalSearch::IncrementPenalty(const Arc& arc) {
+  GuidedLocalSearch::IncrementPenalty(arc);
+  if (cache_penalized_values_) {
+    *penalized_values_.MutableValue(arc) = ComputePenalizedValue(arc);
+  }
+}
+
 IntExpr* BinaryGuidedLocalSearch::MakeElementPenalty(int index) {
   return solver()->MakeElement(
       NewPermanentCallback(this, &BinaryGuidedLocalSearch::PenalizedValue,
@@ -3498,10 +3600,18 @@ bool BinaryGuidedLocalSearch::EvaluateElementValue(
 // Penalized value for (i, j) = penalty_factor_ * penalty(i, j) * cost (i, j)
 int64 BinaryGuidedLocalSearch::PenalizedValue(int64 i, int64 j) {
   const Arc arc(i, j);
+  if (cache_penalized_values_) {
+    return penalized_values_.Value(arc);
+  }
+  return ComputePenalizedValue(arc);
+}
+
+int64 BinaryGuidedLocalSearch::ComputePenalizedValue(const Arc& arc) {
   const int64 penalty = penalties_->Value(arc);
   if (penalty != 0) {  // objective_function_->Run(i, j) can be costly
     const int64 penalized_value =
-        penalty_factor_ * penalty * objective_function_->Run(i, j);
+        penalty_factor_ * penalty *
+        objective_function_->Run(arc.first, arc.second);
     if (maximize_) {
       return -penalized_value;
     } else {
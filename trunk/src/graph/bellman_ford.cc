@@ -77,7 +77,7 @@ void BellmanFord::Update() {
 bool BellmanFord::Check() const {
   for (int u = 0; u < node_count_; u++) {
     for (int v = 0; v < node_count_; v++) {
-      const int graph_u_v = graph_->Run(u, v);
+      const int64 graph_u_v = graph_->Run(u, v);
       if (graph_u_v != disconnected_distance_) {
         if (distance_[v] > distance_[u] + graph_u_v) {
           return false;
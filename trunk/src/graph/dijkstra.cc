@@ -11,13 +11,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "base/hash.h"
+#include <algorithm>
 #include "base/unique_ptr.h"
 #include <vector>
 
 #include "base/callback.h"
 #include "base/integral_types.h"
 #include "base/adjustable_priority_queue.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/stl_util.h"
+#include "base/threadpool.h"
+#include "graph/graph.h"
+#include "graph/shortestpaths.h"
 
 namespace operations_research {
 namespace {
@@ -55,7 +61,9 @@ class DijkstraSP {
         graph_(graph),
         disconnected_distance_(disconnected_distance),
         predecessor_(new int[node_count]),
-        elements_(node_count) {
+        elements_(node_count),
+        not_visited_position_(node_count, -1),
+        added_to_the_frontier_(node_count, false) {
     graph->CheckIsRepeatable();
   }
   bool ShortestPath(int end_node, std::vector<int>* nodes);
@@ -73,8 +81,11 @@ class DijkstraSP {
   std::unique_ptr<int[]> predecessor_;
   AdjustablePriorityQueue<Element> frontier_;
   std::vector<Element> elements_;
-  hash_set<int> not_visited_;
-  hash_set<int> added_to_the_frontier_;
+  // Dense set of the nodes not visited yet: not_visited_position_[node] is
+  // the position of node in not_visited_, or -1.
+  std::vector<int> not_visited_;
+  std::vector<int> not_visited_position_;
+  std::vector<bool> added_to_the_frontier_;
 };
 
 void DijkstraSP::Initialize() {
@@ -87,7 +98,8 @@ void DijkstraSP::Initialize() {
     } else {
       elements_[i].set_distance(kInfinity);
       predecessor_[i] = start_node_;
-      not_visited_.insert(i);
+      not_visited_position_[i] = not_visited_.size();
+      not_visited_.push_back(i);
     }
   }
 }
@@ -96,21 +108,26 @@ int DijkstraSP::SelectClosestNode(int64* distance) {
   const int node = frontier_.Top()->node();
   *distance = frontier_.Top()->distance();
   frontier_.Pop();
-  not_visited_.erase(node);
-  added_to_the_frontier_.erase(node);
+  const int position = not_visited_position_[node];
+  if (position != -1) {
+    const int last = not_visited_.back();
+    not_visited_[position] = last;
+    not_visited_position_[last] = position;
+    not_visited_.pop_back();
+    not_visited_position_[node] = -1;
+  }
+  added_to_the_frontier_[node] = false;
   return node;
 }
 
 void DijkstraSP::Update(int node) {
-  for (hash_set<int>::const_iterator it = not_visited_.begin();
-       it != not_visited_.end(); ++it) {
-    const int other_node = *it;
+  for (int i = 0; i < not_visited_.size(); ++i) {
+    const int other_node = not_visited_[i];
     const int64 graph_node_i = graph_->Run(node, other_node);
     if (graph_node_i != disconnected_distance_) {
-      if (added_to_the_frontier_.find(other_node) ==
-          added_to_the_frontier_.end()) {
+      if (!added_to_the_frontier_[other_node]) {
         frontier_.Add(&elements_[other_node]);
-        added_to_the_frontier_.insert(other_node);
+        added_to_the_frontier_[other_node] = true;
       }
       const int64 other_distance = elements_[node].distance() + graph_node_i;
       if (elements_[other_node].distance() > other_distance) {
@@ -158,4 +175,286 @@ bool DijkstraShortestPath(int node_count, int start_node, int end_node,
   DijkstraSP bf(node_count, start_node, graph, disconnected_distance);
   return bf.ShortestPath(end_node, nodes);
 }
+
+// ----- GenericDijkstra -----
+
+// The heap is a 4-ary heap: it is shallower than a binary heap and the four
+// children of a node share a cache line.
+namespace {
+const int kHeapArity = 4;
+}  // namespace
+
+template <typename Graph>
+const int64 GenericDijkstra<Graph>::kInfinity = kint64max / 2;
+
+template <typename Graph>
+GenericDijkstra<Graph>::GenericDijkstra(const Graph* graph,
+                                        const std::vector<int64>* arc_lengths)
+    : graph_(graph),
+      arc_lengths_(arc_lengths),
+      distance_(graph->num_nodes(), kInfinity),
+      predecessor_(graph->num_nodes(), -1),
+      settled_(graph->num_nodes(), false),
+      is_target_(graph->num_nodes(), false),
+      heap_position_(graph->num_nodes(), -1) {
+  CHECK_GE(arc_lengths->size(), graph->num_arcs());
+}
+
+template <typename Graph>
+void GenericDijkstra<Graph>::Clear() {
+  for (const NodeIndex node : touched_nodes_) {
+    distance_[node] = kInfinity;
+    predecessor_[node] = -1;
+    settled_[node] = false;
+    heap_position_[node] = -1;
+  }
+  touched_nodes_.clear();
+  settled_nodes_.clear();
+  heap_.clear();
+}
+
+template <typename Graph>
+void GenericDijkstra<Graph>::SiftUp(int position) {
+  const NodeIndex node = heap_[position];
+  const int64 distance = distance_[node];
+  while (position > 0) {
+    const int parent = (position - 1) / kHeapArity;
+    const NodeIndex parent_node = heap_[parent];
+    if (distance_[parent_node] <= distance) break;
+    heap_[position] = parent_node;
+    heap_position_[parent_node] = position;
+    position = parent;
+  }
+  heap_[position] = node;
+  heap_position_[node] = position;
+}
+
+template <typename Graph>
+void GenericDijkstra<Graph>::SiftDown(int position) {
+  const int size = heap_.size();
+  const NodeIndex node = heap_[position];
+  const int64 distance = distance_[node];
+  for (;;) {
+    const int first_child = position * kHeapArity + 1;
+    if (first_child >= size) break;
+    const int last_child = std::min(first_child + kHeapArity, size);
+    int best_child = first_child;
+    int64 best_distance = distance_[heap_[first_child]];
+    for (int child = first_child + 1; child < last_child; ++child) {
+      const int64 child_distance = distance_[heap_[child]];
+      if (child_distance < best_distance) {
+        best_child = child;
+        best_distance = child_distance;
+      }
+    }
+    if (best_distance >= distance) break;
+    const NodeIndex child_node = heap_[best_child];
+    heap_[position] = child_node;
+    heap_position_[child_node] = position;
+    position = best_child;
+  }
+  heap_[position] = node;
+  heap_position_[node] = position;
+}
+
+template <typename Graph>
+void GenericDijkstra<Graph>::Relax(NodeIndex node, NodeIndex predecessor,
+                                   int64 distance) {
+  if (distance >= distance_[node]) return;
+  if (distance_[node] == kInfinity) {
+    touched_nodes_.push_back(node);
+  }
+  distance_[node] = distance;
+  predecessor_[node] = predecessor;
+  if (heap_position_[node] == -1) {
+    heap_.push_back(node);
+    SiftUp(heap_.size() - 1);
+  } else {
+    SiftUp(heap_position_[node]);
+  }
+}
+
+template <typename Graph>
+typename GenericDijkstra<Graph>::NodeIndex GenericDijkstra<Graph>::PopMin() {
+  const NodeIndex top = heap_[0];
+  heap_position_[top] = -1;
+  const NodeIndex last = heap_.back();
+  heap_.pop_back();
+  if (!heap_.empty()) {
+    heap_[0] = last;
+    SiftDown(0);
+  }
+  return top;
+}
+
+template <typename Graph>
+bool GenericDijkstra<Graph>::Search(NodeIndex source, int64 distance_limit,
+                                    int num_targets) {
+  DCHECK(graph_->IsNodeValid(source));
+  Clear();
+  Relax(source, -1, 0);
+  const std::vector<int64>& arc_lengths = *arc_lengths_;
+  int remaining_targets = num_targets;
+  while (!heap_.empty()) {
+    const NodeIndex node = PopMin();
+    const int64 distance = distance_[node];
+    if (distance > distance_limit) break;
+    settled_[node] = true;
+    settled_nodes_.push_back(node);
+    if (is_target_[node] && --remaining_targets == 0) break;
+    for (const ArcIndex arc : graph_->OutgoingArcs(node)) {
+      const NodeIndex head = graph_->Head(arc);
+      if (settled_[head]) continue;
+      const int64 arc_length = arc_lengths[arc];
+      DCHECK_GE(arc_length, 0);
+      // Also avoids the overflow of distance + arc_length.
+      if (arc_length >= kInfinity - distance) continue;
+      Relax(head, node, distance + arc_length);
+    }
+  }
+  return remaining_targets == 0;
+}
+
+template <typename Graph>
+bool GenericDijkstra<Graph>::RunWithLimit(NodeIndex source, NodeIndex target,
+                                          int64 distance_limit) {
+  if (target == -1) {
+    return Search(source, distance_limit, 0);
+  }
+  is_target_[target] = true;
+  const bool found = Search(source, distance_limit, 1);
+  is_target_[target] = false;
+  return found;
+}
+
+template <typename Graph>
+bool GenericDijkstra<Graph>::RunToTargets(NodeIndex source,
+                                          const std::vector<NodeIndex>& targets,
+                                          int64 distance_limit) {
+  int num_targets = 0;
+  for (const NodeIndex target : targets) {
+    if (!is_target_[target]) {
+      is_target_[target] = true;
+      ++num_targets;
+    }
+  }
+  const bool found = Search(source, distance_limit, num_targets);
+  for (const NodeIndex target : targets) {
+    is_target_[target] = false;
+  }
+  return found;
+}
+
+template <typename Graph>
+bool GenericDijkstra<Graph>::GetPath(NodeIndex target,
+                                     std::vector<NodeIndex>* nodes) const {
+  nodes->clear();
+  if (!settled_[target]) return false;
+  for (NodeIndex node = target; node != -1; node = predecessor_[node]) {
+    nodes->push_back(node);
+  }
+  std::reverse(nodes->begin(), nodes->end());
+  return true;
+}
+
+// ----- ComputeManyToManyShortestPaths -----
+
+namespace {
+// Computes the rows of the distance matrix of the sources assigned to one
+// thread, i.e. the sources whose index is congruent to 'first_source' modulo
+// 'source_step'. Each worker owns its GenericDijkstra, and writes to disjoint
+// rows of the matrix.
+template <typename Graph>
+class ManyToManyWorker {
+ public:
+  typedef typename Graph::NodeIndex NodeIndex;
+
+  ManyToManyWorker(const Graph* graph, const std::vector<int64>* arc_lengths,
+                   const std::vector<NodeIndex>* sources,
+                   const std::vector<NodeIndex>* destinations,
+                   int64 distance_limit, int64 disconnected_distance,
+                   int first_source, int source_step,
+                   std::vector<int64>* distances)
+      : dijkstra_(graph, arc_lengths),
+        sources_(sources),
+        destinations_(destinations),
+        distance_limit_(distance_limit),
+        disconnected_distance_(disconnected_distance),
+        first_source_(first_source),
+        source_step_(source_step),
+        distances_(distances) {}
+
+  void Run() {
+    const int num_destinations = destinations_->size();
+    for (int i = first_source_; i < sources_->size(); i += source_step_) {
+      dijkstra_.RunToTargets((*sources_)[i], *destinations_, distance_limit_);
+      int64* const row =
+          distances_->data() + static_cast<int64>(i) * num_destinations;
+      for (int j = 0; j < num_destinations; ++j) {
+        const int64 distance = dijkstra_.Distance((*destinations_)[j]);
+        row[j] = distance == GenericDijkstra<Graph>::kInfinity
+                     ? disconnected_distance_
+                     : distance;
+      }
+    }
+  }
+
+ private:
+  GenericDijkstra<Graph> dijkstra_;
+  const std::vector<NodeIndex>* const sources_;
+  const std::vector<NodeIndex>* const destinations_;
+  const int64 distance_limit_;
+  const int64 disconnected_distance_;
+  const int first_source_;
+  const int source_step_;
+  std::vector<int64>* const distances_;
+
+  DISALLOW_COPY_AND_ASSIGN(ManyToManyWorker);
+};
+}  // namespace
+
+template <typename Graph>
+void ComputeManyToManyShortestPaths(
+    const Graph& graph, const std::vector<int64>& arc_lengths,
+    const std::vector<typename Graph::NodeIndex>& sources,
+    const std::vector<typename Graph::NodeIndex>& destinations,
+    int64 distance_limit, int64 disconnected_distance, int num_threads,
+    std::vector<int64>* distances) {
+  CHECK(distances != nullptr);
+  distances->assign(sources.size() * destinations.size(),
+                    disconnected_distance);
+  const int num_workers =
+      std::max(1, std::min<int>(num_threads, sources.size()));
+  std::vector<ManyToManyWorker<Graph>*> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.push_back(new ManyToManyWorker<Graph>(
+        &graph, &arc_lengths, &sources, &destinations, distance_limit,
+        disconnected_distance, i, num_workers, distances));
+  }
+  if (num_workers == 1) {
+    workers[0]->Run();
+  } else {
+    // The destructor of the pool waits for all the workers to finish.
+    ThreadPool pool("ManyToManyShortestPaths", num_workers);
+    pool.StartWorkers();
+    for (int i = 0; i < num_workers; ++i) {
+      pool.Add(NewCallback(workers[i], &ManyToManyWorker<Graph>::Run));
+    }
+  }
+  STLDeleteElements(&workers);
+}
+
+// Explicit instantiations that can be used by a client.
+template class GenericDijkstra<StaticGraph<> >;
+template class GenericDijkstra<ReverseArcStaticGraph<> >;
+template void ComputeManyToManyShortestPaths<StaticGraph<> >(
+    const StaticGraph<>& graph, const std::vector<int64>& arc_lengths,
+    const std::vector<int32>& sources, const std::vector<int32>& destinations,
+    int64 distance_limit, int64 disconnected_distance, int num_threads,
+    std::vector<int64>* distances);
+template void ComputeManyToManyShortestPaths<ReverseArcStaticGraph<> >(
+    const ReverseArcStaticGraph<>& graph, const std::vector<int64>& arc_lengths,
+    const std::vector<int32>& sources, const std::vector<int32>& destinations,
+    int64 distance_limit, int64 disconnected_distance, int num_threads,
+    std::vector<int64>* distances);
 }  // namespace operations_research
@@ -24,7 +24,9 @@
 
 #include "base/callback.h"
 #include "base/integral_types.h"
+#include "base/logging.h"
 #include "base/macros.h"
+#include "graph/graph.h"
 
 namespace operations_research {
 
@@ -49,6 +51,128 @@ bool DijkstraShortestPath(int node_count, int start_node, int end_node,
 bool BellmanFordShortestPath(int node_count, int start_node, int end_node,
                              ResultCallback2<int64, int, int>* const graph,
                              int64 disconnected_distance, std::vector<int>* nodes);
+
+// Dijkstra shortest paths on the static graphs of graph.h. Unlike the
+// callback-based DijkstraShortestPath() above, which needs O(n^2) callback
+// calls per query, this class only scans the outgoing arcs of the settled
+// nodes and uses a flat 4-ary heap over dense distance and predecessor
+// vectors. See the end of dijkstra.cc for the exact graph types this class is
+// compiled for.
+//
+// The arc lengths are given as a flat vector indexed by arc, they must be
+// non-negative. Nodes which can only be reached at a distance of kInfinity or
+// more are not reached, so an arc of length kInfinity or more (e.g. kint64max)
+// can be used as a missing arc. Note that if the graph was built with a
+// permutation, the lengths must be indexed by the permuted arcs.
+//
+// All the internal buffers are allocated once in the constructor and reused
+// across calls to Run(): a query only resets the nodes touched by the previous
+// query, so many small queries on a large graph are cheap.
+//
+// Usage:
+//   GenericDijkstra<StaticGraph<> > dijkstra(&graph, &arc_lengths);
+//   if (dijkstra.Run(source, target)) {
+//     const int64 distance = dijkstra.Distance(target);
+//     dijkstra.GetPath(target, &path);
+//   }
+template <typename Graph>
+class GenericDijkstra {
+ public:
+  typedef typename Graph::NodeIndex NodeIndex;
+  typedef typename Graph::ArcIndex ArcIndex;
+  static const int64 kInfinity;
+
+  // Neither the graph nor the arc lengths are owned, they must outlive this
+  // object. The graph must be fully built.
+  GenericDijkstra(const Graph* graph, const std::vector<int64>* arc_lengths);
+
+  // Computes the shortest paths from 'source'. The search stops as soon as
+  // 'target' is settled; pass -1 to compute the full shortest path tree.
+  // Returns true if 'target' was reached (always true if target is -1).
+  bool Run(NodeIndex source, NodeIndex target) {
+    return RunWithLimit(source, target, kInfinity);
+  }
+
+  // Same as Run(), but nodes at a distance strictly greater than
+  // 'distance_limit' from 'source' are not settled.
+  bool RunWithLimit(NodeIndex source, NodeIndex target, int64 distance_limit);
+
+  // Same as RunWithLimit(), but the search stops as soon as all the nodes in
+  // 'targets' are settled. Returns true if they all were.
+  bool RunToTargets(NodeIndex source, const std::vector<NodeIndex>& targets,
+                    int64 distance_limit);
+
+  // Returns the distance from the source of the last Run() to 'node', or
+  // kInfinity if 'node' was not settled.
+  int64 Distance(NodeIndex node) const {
+    return settled_[node] ? distance_[node] : kInfinity;
+  }
+
+  // Returns the predecessor of 'node' on its shortest path from the source of
+  // the last Run(), or -1 for the source and the nodes that were not settled.
+  NodeIndex Predecessor(NodeIndex node) const {
+    return settled_[node] ? predecessor_[node] : -1;
+  }
+
+  // Fills 'nodes' with the shortest path from the source of the last Run() to
+  // 'target', starting with the source. Returns false (and leaves 'nodes'
+  // empty) if 'target' was not settled.
+  bool GetPath(NodeIndex target, std::vector<NodeIndex>* nodes) const;
+
+  // The nodes settled by the last Run(), by non-decreasing distance.
+  const std::vector<NodeIndex>& settled_nodes() const { return settled_nodes_; }
+
+  const Graph* graph() const { return graph_; }
+
+ private:
+  // Settles nodes from 'source' until 'num_targets' nodes marked in
+  // is_target_ are settled or the distance limit is exceeded. Returns true if
+  // all the targets were settled.
+  bool Search(NodeIndex source, int64 distance_limit, int num_targets);
+  // Resets the state of the nodes touched by the previous query.
+  void Clear();
+  // Inserts 'node' in the heap or decreases its key to 'distance'.
+  void Relax(NodeIndex node, NodeIndex predecessor, int64 distance);
+  // Removes and returns the node with the smallest distance from the heap.
+  NodeIndex PopMin();
+  void SiftUp(int position);
+  void SiftDown(int position);
+
+  const Graph* const graph_;
+  const std::vector<int64>* const arc_lengths_;
+  // Indexed by node, only valid for the nodes in touched_nodes_.
+  std::vector<int64> distance_;
+  std::vector<NodeIndex> predecessor_;
+  std::vector<bool> settled_;
+  std::vector<bool> is_target_;
+  // Position of each node in heap_, -1 if not in the heap.
+  std::vector<int> heap_position_;
+  std::vector<NodeIndex> heap_;
+  std::vector<NodeIndex> touched_nodes_;
+  std::vector<NodeIndex> settled_nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(GenericDijkstra);
+};
+
+// Computes the shortest path distances from each node of 'sources' to each
+// node of 'destinations', running one GenericDijkstra per source which stops
+// as soon as all the destinations are settled. The sources are spread over
+// 'num_threads' threads, each thread owning its own search buffers.
+// On return, 'distances' is a row-major matrix of size
+// sources.size() * destinations.size(): the distance from sources[i] to
+// destinations[j] is in distances[i * destinations.size() + j]. It is
+// 'disconnected_distance' if destinations[j] cannot be reached from sources[i]
+// or if its distance is greater than 'distance_limit'.
+// Using all the nodes of the graph as sources and destinations gives the
+// all-pairs distance matrix, which can be passed to
+// RoutingModel::SetArcCostMatrixOfAllVehicles().
+template <typename Graph>
+void ComputeManyToManyShortestPaths(
+    const Graph& graph, const std::vector<int64>& arc_lengths,
+    const std::vector<typename Graph::NodeIndex>& sources,
+    const std::vector<typename Graph::NodeIndex>& destinations,
+    int64 distance_limit, int64 disconnected_distance, int num_threads,
+    std::vector<int64>* distances);
 }  // namespace operations_research
 
 #endif  // OR_TOOLS_GRAPH_SHORTESTPATHS_H_
@@ -33,9 +33,9 @@ namespace {
 // Returns true if the given watcher list contains the given clause.
 template <typename Watcher>
 bool WatcherListContains(const std::vector<Watcher>& list,
-                         const SatClause& candidate) {
+                         ClauseOffset candidate) {
   for (const Watcher& watcher : list) {
-    if (watcher.clause == &candidate) return true;
+    if (watcher.clause == candidate) return true;
   }
   return false;
 }
@@ -47,18 +47,27 @@ void RemoveIf(Container c, Predicate p) {
 }
 
 // Removes dettached clauses from a watcher list.
-template <typename Watcher>
-bool CleanUpPredicate(const Watcher& watcher) {
-  return !watcher.clause->IsAttached();
-}
+class CleanUpPredicate {
+ public:
+  explicit CleanUpPredicate(const ClauseArena& arena) : arena_(arena) {}
+  template <typename Watcher>
+  bool operator()(const Watcher& watcher) const {
+    return !arena_.Clause(watcher.clause)->IsAttached();
+  }
+
+ private:
+  const ClauseArena& arena_;
+};
 
 }  // namespace
 
 // ----- LiteralWatchers -----
 
-LiteralWatchers::LiteralWatchers()
-    : is_clean_(true),
+LiteralWatchers::LiteralWatchers(ClauseArena* arena)
+    : arena_(arena),
+      is_clean_(true),
       num_inspected_clauses_(0),
+      num_blocked_clauses_(0),
       num_watched_clauses_(0),
       stats_("LiteralWatchers") {}
 
@@ -75,10 +84,10 @@ void LiteralWatchers::Resize(int num_variables) {
 
 // Note that this is the only place where we add Watcher so the DCHECK
 // guarantees that there are no duplicates.
-void LiteralWatchers::AttachOnFalse(Literal a, Literal b, SatClause* clause) {
+void LiteralWatchers::AttachOnFalse(Literal a, Literal b, ClauseOffset clause) {
   SCOPED_TIME_STAT(&stats_);
   DCHECK(is_clean_);
-  DCHECK(!WatcherListContains(watchers_on_false_[a.Index()], *clause));
+  DCHECK(!WatcherListContains(watchers_on_false_[a.Index()], clause));
   watchers_on_false_[a.Index()].push_back(Watcher(clause, b));
 }
 
@@ -91,20 +100,26 @@ bool LiteralWatchers::PropagateOnFalse(Literal false_literal, Trail* trail) {
   // Note(user): It sounds better to inspect the list in order, this is because
   // small clauses like binary or ternary clauses will often propagate and thus
   // stay at the beginning of the list.
+  const bool use_blocking_literals = parameters_.use_blocking_literals();
+  int64 num_blocked_clauses = 0;
   std::vector<Watcher>::iterator new_it = watchers.begin();
   for (std::vector<Watcher>::iterator it = watchers.begin(); it != watchers.end();
        ++it) {
     // Don't even look at the clause memory if the blocking literal is true.
-    if (assignment.IsLiteralTrue(it->blocking_literal)) {
+    if (use_blocking_literals &&
+        assignment.IsLiteralTrue(it->blocking_literal)) {
+      ++num_blocked_clauses;
       *new_it++ = *it;
       continue;
     }
 
     // If the other watched literal is true, just change the blocking literal.
-    Literal* literals = it->clause->literals();
+    SatClause* const clause = arena_->Clause(it->clause);
+    Literal* literals = clause->literals();
     const Literal other_watched_literal =
         (literals[1] == false_literal) ? literals[0] : literals[1];
-    if (other_watched_literal != it->blocking_literal &&
+    if ((!use_blocking_literals ||
+         other_watched_literal != it->blocking_literal) &&
         assignment.IsLiteralTrue(other_watched_literal)) {
       *new_it++ = Watcher(it->clause, other_watched_literal);
       continue;
@@ -113,7 +128,7 @@ bool LiteralWatchers::PropagateOnFalse(Literal false_literal, Trail* trail) {
     // Look for another literal to watch.
     {
       int i = 2;
-      const int size = it->clause->Size();
+      const int size = clause->Size();
       while (i < size && assignment.IsLiteralFalse(literals[i])) ++i;
       if (i < size) {
         // literal[i] is undefined or true, it's now the new literal to watch.
@@ -131,10 +146,11 @@ bool LiteralWatchers::PropagateOnFalse(Literal false_literal, Trail* trail) {
     // other literals are false.
     if (assignment.IsLiteralFalse(other_watched_literal)) {
       // Conflict: All literals of it->clause are false.
-      trail->SetFailingSatClause(
-          ClauseRef(it->clause->begin(), it->clause->end()), it->clause);
-      trail->SetFailingResolutionNode(it->clause->ResolutionNodePointer());
+      trail->SetFailingSatClause(ClauseRef(clause->begin(), clause->end()),
+                                 it->clause);
+      trail->SetFailingResolutionNode(clause->ResolutionNodePointer());
       num_inspected_clauses_ += it - watchers.begin() + 1;
+      num_blocked_clauses_ += num_blocked_clauses;
       watchers.erase(new_it, it);
       return false;
     } else {
@@ -149,12 +165,14 @@ bool LiteralWatchers::PropagateOnFalse(Literal false_literal, Trail* trail) {
     }
   }
   num_inspected_clauses_ += watchers.size();
+  num_blocked_clauses_ += num_blocked_clauses;
   watchers.erase(new_it, watchers.end());
   return true;
 }
 
-bool LiteralWatchers::AttachAndPropagate(SatClause* clause, Trail* trail) {
+bool LiteralWatchers::AttachAndPropagate(ClauseOffset offset, Trail* trail) {
   SCOPED_TIME_STAT(&stats_);
+  SatClause* const clause = arena_->Clause(offset);
   ++num_watched_clauses_;
   // Updating the statistics for each learned clause take quite a lot of time
   // (like 6% of the total running time). So for now, we just compute the
@@ -167,11 +185,12 @@ bool LiteralWatchers::AttachAndPropagate(SatClause* clause, Trail* trail) {
   // relies on this.
   if (!clause->IsLearned()) UpdateStatistics(*clause, /*added=*/true);
   clause->SortLiterals(statistics_, parameters_);
-  return clause->AttachAndEnqueuePotentialUnitPropagation(trail, this);
+  return clause->AttachAndEnqueuePotentialUnitPropagation(offset, trail, this);
 }
 
-void LiteralWatchers::LazyDetach(SatClause* clause) {
+void LiteralWatchers::LazyDetach(ClauseOffset offset) {
   SCOPED_TIME_STAT(&stats_);
+  SatClause* const clause = arena_->Clause(offset);
   --num_watched_clauses_;
   if (!clause->IsLearned()) UpdateStatistics(*clause, /*added=*/false);
   clause->LazyDetach();
@@ -185,13 +204,24 @@ void LiteralWatchers::CleanUpWatchers() {
   for (int i = 0; i < needs_cleaning_.size(); ++i) {
     if (needs_cleaning_[LiteralIndex(i)]) {
       RemoveIf(&(watchers_on_false_[LiteralIndex(i)]),
-               CleanUpPredicate<Watcher>);
+               CleanUpPredicate(*arena_));
       needs_cleaning_[LiteralIndex(i)] = false;
     }
   }
   is_clean_ = true;
 }
 
+void LiteralWatchers::RelocateWatchers() {
+  SCOPED_TIME_STAT(&stats_);
+  DCHECK(is_clean_);
+  for (std::vector<Watcher>& watchers : watchers_on_false_) {
+    for (Watcher& watcher : watchers) {
+      watcher.clause = arena_->Relocate(watcher.clause);
+      DCHECK_NE(watcher.clause, kNoClauseOffset);
+    }
+  }
+}
+
 void LiteralWatchers::UpdateStatistics(const SatClause& clause, bool added) {
   SCOPED_TIME_STAT(&stats_);
   for (const Literal literal : clause) {
@@ -460,26 +490,71 @@ void BinaryImplicationGraph::RemoveFixedVariables(
   }
 }
 
-// ----- SatClause -----
+// ----- ClauseArena -----
 
-// static
-SatClause* SatClause::Create(const std::vector<Literal>& literals, ClauseType type,
-                             ResolutionNode* node) {
+ClauseOffset ClauseArena::Create(const std::vector<Literal>& literals,
+                                 SatClause::ClauseType type,
+                                 bool with_resolution_node,
+                                 ResolutionNode* node) {
   CHECK_GE(literals.size(), 2);
-  SatClause* clause = reinterpret_cast<SatClause*>(
-      ::operator new(sizeof(SatClause) + literals.size() * sizeof(Literal)));
+  DCHECK(with_resolution_node || node == nullptr);
+  int64 start = storage_.size();
+  storage_.resize(start + NumWords(literals.size(), with_resolution_node));
+  if (with_resolution_node) ++start;
+  CHECK_LE(start, kint32max) << "Too many clauses.";
+  const ClauseOffset offset(start);
+  SatClause* const clause = Clause(offset);
   clause->size_ = literals.size();
   for (int i = 0; i < literals.size(); ++i) {
     clause->literals_[i] = literals[i];
   }
-  clause->is_learned_ = (type == LEARNED_CLAUSE);
+  clause->is_learned_ = (type == SatClause::LEARNED_CLAUSE);
   clause->is_attached_ = false;
+  clause->has_resolution_node_ = with_resolution_node;
+  clause->is_deleted_ = false;
+  clause->is_relocated_ = false;
   clause->activity_ = 0.0;
   clause->lbd_ = 0;
-  clause->resolution_node_ = node;
-  return clause;
+  if (with_resolution_node) *clause->ResolutionNodeAddress() = node;
+  return offset;
+}
+
+void ClauseArena::Delete(ClauseOffset offset) {
+  SatClause* const clause = Clause(offset);
+  DCHECK(!clause->is_deleted_);
+  clause->is_deleted_ = true;
+  num_deleted_words_ += NumWords(clause->Size(), clause->has_resolution_node_);
 }
 
+void ClauseArena::StartCompaction() {
+  compacted_storage_.clear();
+  compacted_storage_.reserve(storage_.size() - num_deleted_words_);
+}
+
+ClauseOffset ClauseArena::Relocate(ClauseOffset offset) {
+  if (offset == kNoClauseOffset) return kNoClauseOffset;
+  SatClause* const clause = Clause(offset);
+  if (clause->is_deleted_) return kNoClauseOffset;
+  if (clause->is_relocated_) return ClauseOffset(clause->size_);
+  const int num_words = NumWords(clause->Size(), clause->has_resolution_node_);
+  const uint64* const begin =
+      &storage_[offset.value() - (clause->has_resolution_node_ ? 1 : 0)];
+  const ClauseOffset new_offset(compacted_storage_.size() +
+                                (clause->has_resolution_node_ ? 1 : 0));
+  compacted_storage_.insert(compacted_storage_.end(), begin, begin + num_words);
+  clause->is_relocated_ = true;
+  clause->size_ = new_offset.value();
+  return new_offset;
+}
+
+void ClauseArena::FinishCompaction() {
+  storage_.swap(compacted_storage_);
+  std::vector<uint64>().swap(compacted_storage_);
+  num_deleted_words_ = 0;
+}
+
+// ----- SatClause -----
+
 // Note that for an attached clause, removing fixed literal is okay because if
 // any of them is assigned, then the clause is necessary true.
 bool SatClause::RemoveFixedLiteralsAndTestIfTrue(
@@ -565,7 +640,7 @@ void SatClause::SortLiterals(
 }
 
 bool SatClause::AttachAndEnqueuePotentialUnitPropagation(
-    Trail* trail, LiteralWatchers* demons) {
+    ClauseOffset offset, Trail* trail, LiteralWatchers* demons) {
   CHECK(!IsAttached());
   // Select the first two literals that are not assigned to false and put them
   // on position 0 and 1.
@@ -599,14 +674,14 @@ bool SatClause::AttachAndEnqueuePotentialUnitPropagation(
 
     // Propagates literals_[0] if it is undefined.
     if (!trail->Assignment().IsLiteralTrue(literals_[0])) {
-      trail->EnqueueWithSatClauseReason(literals_[0], this);
+      trail->EnqueueWithSatClauseReason(literals_[0], offset);
     }
   }
 
   // Attach the watchers.
   is_attached_ = true;
-  demons->AttachOnFalse(literals_[0], literals_[1], this);
-  demons->AttachOnFalse(literals_[1], literals_[0], this);
+  demons->AttachOnFalse(literals_[0], literals_[1], offset);
+  demons->AttachOnFalse(literals_[1], literals_[0], offset);
   return true;
 }
 
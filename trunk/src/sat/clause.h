@@ -37,6 +37,7 @@ namespace sat {
 
 // Forward declarations.
 // TODO(user): This cyclic dependency can be relatively easily removed.
+class ClauseArena;
 class LiteralWatchers;
 
 // Variable information. This is updated each time we attach/detach a clause.
@@ -56,16 +57,14 @@ struct VariableInfo {
 // This is how the SatSolver store a clause. A clause is just a disjunction of
 // literals. In many places, we just use std::vector<literal> to encode one. However,
 // the solver needs to keep a few extra fields attached to each clause.
+//
+// Clauses are created by, and stored in, a ClauseArena (see below).
 class SatClause {
  public:
-  // Creates a sat clause. There must be at least 2 literals.
-  // Smaller clause are treated separatly and never constructed.
   enum ClauseType {
     PROBLEM_CLAUSE,
     LEARNED_CLAUSE,
   };
-  static SatClause* Create(const std::vector<Literal>& literals, ClauseType type,
-                           ResolutionNode* node);
 
   // Number of literals in the clause.
   int Size() const { return size_; }
@@ -115,8 +114,10 @@ class SatClause {
   // and attaches the clause to the event: one of the watched literals become
   // false. It returns false if the clause only contains literals assigned to
   // false. If only one literals is not false, it propagates it to true if it
-  // is not already assigned.
-  bool AttachAndEnqueuePotentialUnitPropagation(Trail* trail,
+  // is not already assigned. 'offset' must be the offset of this clause in
+  // its arena.
+  bool AttachAndEnqueuePotentialUnitPropagation(ClauseOffset offset,
+                                                Trail* trail,
                                                 LiteralWatchers* demons);
 
   // Modify and get the clause activity.
@@ -138,28 +139,42 @@ class SatClause {
 
   // Returns the node of the resolution DAG associated to this clause.
   // This will always be nullptr if the parameter unsat_proof() is false.
-  ResolutionNode* ResolutionNodePointer() const { return resolution_node_; }
-  void ChangeResolutionNode(ResolutionNode* node) { resolution_node_ = node; }
+  ResolutionNode* ResolutionNodePointer() const {
+    return has_resolution_node_ ? *ResolutionNodeAddress() : nullptr;
+  }
+  void ChangeResolutionNode(ResolutionNode* node) {
+    DCHECK(has_resolution_node_);
+    *ResolutionNodeAddress() = node;
+  }
 
   std::string DebugString() const;
 
  private:
+  friend class ClauseArena;
+
+  // The resolution node, if any, is stored in the arena word preceding the
+  // clause. This way, no memory is used for it when the parameter
+  // unsat_proof() is false.
+  ResolutionNode** ResolutionNodeAddress() const {
+    return reinterpret_cast<ResolutionNode**>(
+        reinterpret_cast<uint64*>(const_cast<SatClause*>(this)) - 1);
+  }
+
   // The data is packed so that only 16 bytes are used for these fields.
   // Note that the max lbd is the maximum depth of the search tree (decision
-  // levels), so it should fit easily in 30 bits. Note that we can also upper
+  // levels), so it should fit easily in 27 bits. Note that we can also upper
   // bound it without hurting too much the clause cleaning heuristic.
   bool is_learned_ : 1;
   bool is_attached_ : 1;
-  int lbd_ : 30;
+  bool has_resolution_node_ : 1;
+  // Only used by the ClauseArena. When is_relocated_ is true, size_ contains
+  // the new offset of the clause.
+  bool is_deleted_ : 1;
+  bool is_relocated_ : 1;
+  int lbd_ : 27;
   int size_ : 32;
   double activity_;
 
-  // This is only needed when the parameter unsat_proof() is true.
-  // TODO(user): It is possible to use less memory when this is not the case
-  // by some tweaks in Create() and in the way we access it. Note that not
-  // storing this seems to gain about 2% in speed overall.
-  ResolutionNode* resolution_node_;
-
   // This class store the literals inline, and literals_ mark the starts of the
   // variable length portion.
   Literal literals_[0];
@@ -167,12 +182,79 @@ class SatClause {
   DISALLOW_COPY_AND_ASSIGN(SatClause);
 };
 
+// Stores all the clauses of a solver in a single growable array, so that they
+// are contiguous in memory and referred to by a 32-bit ClauseOffset. The memory
+// of the deleted clauses is only reclaimed by a compaction, which moves the
+// clauses and thus changes their offset:
+//
+//   arena.StartCompaction();
+//   for each stored offset of a clause: offset = arena.Relocate(offset);
+//   arena.FinishCompaction();
+//
+// IMPORTANT: Creating a clause or compacting the arena invalidates all the
+// SatClause pointers and the ClauseRef obtained from the clauses of the arena.
+class ClauseArena {
+ public:
+  ClauseArena() : num_deleted_words_(0) {}
+
+  // Creates a clause and returns its offset. There must be at least 2
+  // literals; smaller clauses are treated separately and never constructed. If
+  // 'with_resolution_node' is false, 'node' must be nullptr and no memory is
+  // used to store it.
+  ClauseOffset Create(const std::vector<Literal>& literals,
+                      SatClause::ClauseType type, bool with_resolution_node,
+                      ResolutionNode* node);
+
+  // Returns the clause at the given offset.
+  SatClause* Clause(ClauseOffset offset) {
+    return reinterpret_cast<SatClause*>(&storage_[offset.value()]);
+  }
+  const SatClause* Clause(ClauseOffset offset) const {
+    return reinterpret_cast<const SatClause*>(&storage_[offset.value()]);
+  }
+
+  // Deletes a clause. Its memory will be reclaimed by the next compaction.
+  void Delete(ClauseOffset offset);
+
+  // Returns true if the deleted clauses use a significant part of the memory.
+  bool NeedsCompaction() const {
+    return num_deleted_words_ > storage_.size() / 4;
+  }
+
+  // Compaction of the arena, see the class comment. The clauses are stored in
+  // the order of the first call to Relocate() on their offset. Relocate()
+  // returns the new offset of the clause, or kNoClauseOffset if it was deleted
+  // (or if the given offset is kNoClauseOffset).
+  void StartCompaction();
+  ClauseOffset Relocate(ClauseOffset offset);
+  void FinishCompaction();
+
+  // Number of 64-bit words used by the arena.
+  int64 NumWords() const { return storage_.size(); }
+
+ private:
+  // Number of words of the header of a clause, and of a clause.
+  static const int kHeaderWords = sizeof(SatClause) / sizeof(uint64);
+  static int NumWords(int size, bool with_resolution_node) {
+    return kHeaderWords + (with_resolution_node ? 1 : 0) + (size + 1) / 2;
+  }
+
+  std::vector<uint64> storage_;
+  int64 num_deleted_words_;
+
+  // The storage into which the clauses are moved during a compaction.
+  std::vector<uint64> compacted_storage_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClauseArena);
+};
+
 // Stores the 2-watched literals data structure.  See
 // http://www.cs.berkeley.edu/~necula/autded/lecture24-sat.pdf for
 // detail.
 class LiteralWatchers {
  public:
-  LiteralWatchers();
+  // Does not take ownership of the arena storing the watched clauses.
+  explicit LiteralWatchers(ClauseArena* arena);
   ~LiteralWatchers();
 
   // Resizes the data structure.
@@ -180,20 +262,24 @@ class LiteralWatchers {
 
   // Attaches the given clause. This eventually propagates a literal which is
   // enqueued on the trail. Returns false if a contradiction was encountered.
-  bool AttachAndPropagate(SatClause* clause, Trail* trail);
+  bool AttachAndPropagate(ClauseOffset clause, Trail* trail);
 
   // Attaches the given clause to the event: the given literal becomes false.
   // The blocking_literal can be any literal from the clause, it is used to
   // speed up PropagateOnFalse() by skipping the clause if it is true.
   void AttachOnFalse(Literal literal, Literal blocking_literal,
-                     SatClause* clause);
+                     ClauseOffset clause);
 
   // Lazily detach the given clause. The deletion will actually occur when
   // CleanUpWatchers() is called. The later needs to be called before any other
   // function in this class can be called. This is DCHECKed.
-  void LazyDetach(SatClause* clause);
+  void LazyDetach(ClauseOffset clause);
   void CleanUpWatchers();
 
+  // Updates the watched clause offsets during a compaction of the arena, see
+  // ClauseArena::Relocate(). The watchers must be clean.
+  void RelocateWatchers();
+
   // Launches all propagation when the given literal becomes false.
   // Returns false if a contradiction was encountered.
   bool PropagateOnFalse(Literal false_literal, Trail* trail);
@@ -201,6 +287,10 @@ class LiteralWatchers {
   // Total number of clauses inspected during calls to PropagateOnFalse().
   int64 num_inspected_clauses() const { return num_inspected_clauses_; }
 
+  // Number of inspected clauses that were skipped because their blocking
+  // literal was true, i.e. without looking at the clause memory.
+  int64 num_blocked_clauses() const { return num_blocked_clauses_; }
+
   // Number of clauses currently watched.
   int64 num_watched_clauses() const { return num_watched_clauses_; }
 
@@ -224,10 +314,11 @@ class LiteralWatchers {
   // when the corresponding literal becomes false.
   struct Watcher {
     Watcher() {}
-    Watcher(SatClause* c, Literal b) : clause(c), blocking_literal(b) {}
-    SatClause* clause;
+    Watcher(ClauseOffset c, Literal b) : clause(c), blocking_literal(b) {}
+    ClauseOffset clause;
     Literal blocking_literal;
   };
+  ClauseArena* const arena_;
   ITIVector<LiteralIndex, std::vector<Watcher> > watchers_on_false_;
 
   // Indicates if the corresponding watchers_on_false_ list need to be
@@ -238,6 +329,7 @@ class LiteralWatchers {
   ITIVector<VariableIndex, VariableInfo> statistics_;
   SatParameters parameters_;
   int64 num_inspected_clauses_;
+  int64 num_blocked_clauses_;
   int64 num_watched_clauses_;
   mutable StatsGroup stats_;
   DISALLOW_COPY_AND_ASSIGN(LiteralWatchers);
@@ -282,10 +282,13 @@ class PbConstraints {
 
   // Computes the reason for the given variable assignement.
   // Note that this should only be called if the reason type is PB_PROPAGATION.
+  // The type may already be CACHED_REASON, as the reason is computed directly
+  // in the cache of the trail.
   void ReasonFor(VariableIndex var, std::vector<Literal>* reason) const {
     SCOPED_TIME_STAT(&stats_);
     const AssignmentInfo& info = trail_->Info(var);
-    DCHECK_EQ(info.type, AssignmentInfo::PB_PROPAGATION);
+    DCHECK_EQ(trail_->InitialAssignmentType(var),
+              AssignmentInfo::PB_PROPAGATION);
     info.pb_constraint->FillReason(*trail_, info.source_trail_index, var,
                                    reason);
   }
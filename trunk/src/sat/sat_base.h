@@ -32,6 +32,13 @@ DEFINE_INT_TYPE(VariableIndex, int);
 
 // Index of a literal (>= 0), see Literal below.
 DEFINE_INT_TYPE(LiteralIndex, int);
+const LiteralIndex kNoLiteralIndex(-1);
+
+// Offset of a SatClause in the ClauseArena storing it, see clause.h. Clauses
+// are referred to by their offset rather than by a pointer to halve the memory
+// used by the watchers and the reasons.
+DEFINE_INT_TYPE(ClauseOffset, int32);
+const ClauseOffset kNoClauseOffset(-1);
 
 // A literal is used to represent a variable or its negation. If it represents
 // the variable it is said to be positive. If it represent its negation, it is
@@ -238,8 +245,10 @@ struct AssignmentInfo {
   // some fields will not be used and left uninitialized. We use unions to gain
   // a bit of memory.
 
+  // Note that sat_clause is the value() of a ClauseOffset as an IntType can't
+  // be part of an union.
   union {
-    SatClause* sat_clause;
+    int32 sat_clause;
     ResolutionNode* resolution_node;
     UpperBoundedLinearConstraint* pb_constraint;
     int symmetry_index;
@@ -262,13 +271,22 @@ struct AssignmentInfo {
 // and the information of each assignment.
 class Trail {
  public:
-  Trail() : num_enqueues_(0), trail_index_(0), need_level_zero_(false) {
+  Trail()
+      : num_enqueues_(0),
+        trail_index_(0),
+        failing_sat_clause_(kNoClauseOffset),
+        need_level_zero_(false) {
     current_info_.level = 0;
   }
 
   void Resize(int num_variables) {
     assignment_.Resize(num_variables);
-    info_.resize(num_variables);
+    // The type of the variables never assigned is defined so that
+    // ChangeSatClauseReason() can be used on all the variables.
+    AssignmentInfo never_assigned;
+    never_assigned.type = AssignmentInfo::SEARCH_DECISION;
+    never_assigned.level = 0;
+    info_.resize(num_variables, never_assigned);
     trail_.resize(num_variables);
     cached_reasons_.resize(num_variables);
     old_type_.resize(num_variables);
@@ -297,8 +315,8 @@ class Trail {
     current_info_.literal = reason;
     Enqueue(true_literal, AssignmentInfo::BINARY_PROPAGATION);
   }
-  void EnqueueWithSatClauseReason(Literal true_literal, SatClause* clause) {
-    current_info_.sat_clause = clause;
+  void EnqueueWithSatClauseReason(Literal true_literal, ClauseOffset clause) {
+    current_info_.sat_clause = clause.value();
     Enqueue(true_literal, AssignmentInfo::CLAUSE_PROPAGATION);
   }
   void EnqueueWithPbReason(Literal true_literal, int source_trail_index,
@@ -374,17 +392,17 @@ class Trail {
   // Functions to store a failing clause.
   // There is a special version for a SatClause, because in this case we need to
   // be able to update its activity later.
-  void SetFailingSatClause(ClauseRef ref, SatClause* clause) {
+  void SetFailingSatClause(ClauseRef ref, ClauseOffset clause) {
     failing_clause_ = ref;
     failing_sat_clause_ = clause;
   }
   void SetFailingClause(ClauseRef ref) {
     failing_clause_ = ref;
-    failing_sat_clause_ = nullptr;
+    failing_sat_clause_ = kNoClauseOffset;
   }
   void SetFailingResolutionNode(ResolutionNode* node) { failing_node_ = node; }
   ClauseRef FailingClause() const { return failing_clause_; }
-  SatClause* FailingSatClause() const { return failing_sat_clause_; }
+  ClauseOffset FailingSatClause() const { return failing_sat_clause_; }
   ResolutionNode* FailingResolutionNode() const { return failing_node_; }
 
   // This is required for producing correct unsat proof. Recall that a fixed
@@ -407,6 +425,13 @@ class Trail {
     info_[var].resolution_node = node;
   }
 
+  // Changes the clause of an assignment (current or past) whose type is
+  // CLAUSE_PROPAGATION. This is needed when the clauses are moved in memory.
+  void ChangeSatClauseReason(VariableIndex var, ClauseOffset clause) {
+    DCHECK_EQ(info_[var].type, AssignmentInfo::CLAUSE_PROPAGATION);
+    info_[var].sat_clause = clause.value();
+  }
+
  private:
   int64 num_enqueues_;
   int trail_index_;
@@ -415,7 +440,7 @@ class Trail {
   std::vector<Literal> trail_;
   ITIVector<VariableIndex, AssignmentInfo> info_;
   ClauseRef failing_clause_;
-  SatClause* failing_sat_clause_;
+  ClauseOffset failing_sat_clause_;
   ResolutionNode* failing_node_;
   bool need_level_zero_;
 
@@ -31,6 +31,7 @@ namespace sat {
 SatSolver::SatSolver()
     : num_variables_(0),
       num_constraints_(0),
+      watched_clauses_(&clause_arena_),
       pb_constraints_(&trail_),
       symmetry_propagator_(&trail_),
       assumption_level_(0),
@@ -56,11 +57,13 @@ SatSolver::~SatSolver() {
   IF_STATS_ENABLED(LOG(INFO) << stats_.StatString());
   if (parameters_.unsat_proof()) {
     // We need to free the memory used by the ResolutionNode of the clauses
-    for (SatClause* clause : learned_clauses_) {
-      unsat_proof_.UnlockNode(clause->ResolutionNodePointer());
+    for (ClauseOffset offset : learned_clauses_) {
+      unsat_proof_.UnlockNode(
+          clause_arena_.Clause(offset)->ResolutionNodePointer());
     }
-    for (SatClause* clause : problem_clauses_) {
-      unsat_proof_.UnlockNode(clause->ResolutionNodePointer());
+    for (ClauseOffset offset : problem_clauses_) {
+      unsat_proof_.UnlockNode(
+          clause_arena_.Clause(offset)->ResolutionNodePointer());
     }
     // We also have to free the ResolutionNode of the variable assigned at
     // level 0.
@@ -76,8 +79,6 @@ SatSolver::~SatSolver() {
       unsat_proof_.UnlockNode(node);
     }
   }
-  STLDeleteElements(&problem_clauses_);
-  STLDeleteElements(&learned_clauses_);
 }
 
 void SatSolver::SetNumVariables(int num_variables) {
@@ -187,18 +188,18 @@ bool SatSolver::AddProblemClauseInternal(const std::vector<Literal>& literals,
     trail_.EnqueueWithUnitReason(literals[0], node);  // Not assigned.
     return true;
   }
-  // Create a new clause.
-  std::unique_ptr<SatClause> clause(
-      SatClause::Create(literals, SatClause::PROBLEM_CLAUSE, node));
-
-  if (parameters_.treat_binary_clauses_separately() && clause->Size() == 2) {
-    binary_implication_graph_.AddBinaryClause(clause->FirstLiteral(),
-                                              clause->SecondLiteral());
+  if (parameters_.treat_binary_clauses_separately() && literals.size() == 2) {
+    binary_implication_graph_.AddBinaryClause(literals[0], literals[1]);
   } else {
-    if (!watched_clauses_.AttachAndPropagate(clause.get(), &trail_)) {
+    // Create a new clause.
+    const ClauseOffset clause =
+        clause_arena_.Create(literals, SatClause::PROBLEM_CLAUSE,
+                             parameters_.unsat_proof(), node);
+    if (!watched_clauses_.AttachAndPropagate(clause, &trail_)) {
+      clause_arena_.Delete(clause);
       return ModelUnsat();
     }
-    problem_clauses_.push_back(clause.release());
+    problem_clauses_.push_back(clause);
   }
   return true;
 }
@@ -305,16 +306,21 @@ void SatSolver::AddLearnedClauseAndEnqueueUnitPropagation(
       binary_implication_graph_.AddBinaryConflict(literals[0], literals[1],
                                                   &trail_);
     } else {
-      SatClause* clause =
-          SatClause::Create(literals, SatClause::LEARNED_CLAUSE, node);
+      // Note that the clause must be created after the cleanup as it may move
+      // the clauses in memory.
       CompressLearnedClausesIfNeeded();
+      const ClauseOffset clause =
+          clause_arena_.Create(literals, SatClause::LEARNED_CLAUSE,
+                               parameters_.unsat_proof(), node);
       --num_learned_clause_before_cleanup_;
-      learned_clauses_.emplace_back(clause);
+      learned_clauses_.push_back(clause);
       BumpClauseActivity(clause);
 
       // Important: Even though the only literal at the last decision level has
       // been unassigned, its level was not modified, so ComputeLbd() works.
-      clause->SetLbd(parameters_.use_lbd() ? ComputeLbd(*clause) : 0);
+      SatClause* const learned_clause = clause_arena_.Clause(clause);
+      learned_clause->SetLbd(
+          parameters_.use_lbd() ? ComputeLbd(*learned_clause) : 0);
       CHECK(watched_clauses_.AttachAndPropagate(clause, &trail_));
     }
   }
@@ -368,7 +374,7 @@ int SatSolver::EnqueueDecisionAndBackjumpOnConflict(Literal true_literal) {
     // Bump the clause activities.
     // Note that the activity of the learned clause will be bumped too
     // by AddLearnedClauseAndEnqueueUnitPropagation().
-    if (trail_.FailingSatClause() != nullptr) {
+    if (trail_.FailingSatClause() != kNoClauseOffset) {
       BumpClauseActivity(trail_.FailingSatClause());
     }
     BumpReasonActivities(reason_used_to_infer_the_conflict_);
@@ -664,8 +670,8 @@ void SatSolver::BumpVariableActivities(const std::vector<Literal>& literals,
     if (level == 0) continue;
     if (level == CurrentDecisionLevel() &&
         trail_.Info(var).type == AssignmentInfo::CLAUSE_PROPAGATION &&
-        trail_.Info(var).sat_clause->IsLearned() &&
-        trail_.Info(var).sat_clause->Lbd() < bump_again_lbd_limit) {
+        ReasonClause(var)->IsLearned() &&
+        ReasonClause(var)->Lbd() < bump_again_lbd_limit) {
       activities_[var] += variable_activity_increment_;
     }
     activities_[var] += variable_activity_increment_;
@@ -681,12 +687,13 @@ void SatSolver::BumpReasonActivities(const std::vector<Literal>& literals) {
     const VariableIndex var = literal.Variable();
     if (DecisionLevel(var) > 0 &&
         trail_.Info(var).type == AssignmentInfo::CLAUSE_PROPAGATION) {
-      BumpClauseActivity(trail_.Info(var).sat_clause);
+      BumpClauseActivity(ClauseOffset(trail_.Info(var).sat_clause));
     }
   }
 }
 
-void SatSolver::BumpClauseActivity(SatClause* clause) {
+void SatSolver::BumpClauseActivity(ClauseOffset offset) {
+  SatClause* const clause = clause_arena_.Clause(offset);
   if (!clause->IsLearned()) return;
   clause->IncreaseActivity(clause_activity_increment_);
   if (clause->Activity() > parameters_.max_clause_activity_value()) {
@@ -722,8 +729,8 @@ void SatSolver::RescaleVariableActivities(double scaling_factor) {
 void SatSolver::RescaleClauseActivities(double scaling_factor) {
   SCOPED_TIME_STAT(&stats_);
   clause_activity_increment_ *= scaling_factor;
-  for (SatClause* clause : learned_clauses_) {
-    clause->MultiplyActivity(scaling_factor);
+  for (ClauseOffset offset : learned_clauses_) {
+    clause_arena_.Clause(offset)->MultiplyActivity(scaling_factor);
   }
 }
 
@@ -820,8 +827,11 @@ std::string SatSolver::StatusString(Status status) const {
                       "  (literals removed: %" GG_LL_FORMAT "d)\n",
                       binary_implication_graph_.num_minimization(),
                       binary_implication_graph_.num_literals_removed()) +
-         StringPrintf("  num inspected clauses: %" GG_LL_FORMAT "d\n",
-                      watched_clauses_.num_inspected_clauses()) +
+         StringPrintf("  num inspected clauses: %" GG_LL_FORMAT
+                      "d"
+                      "  (blocked: %" GG_LL_FORMAT "d)\n",
+                      watched_clauses_.num_inspected_clauses(),
+                      watched_clauses_.num_blocked_clauses()) +
          StringPrintf(
              "  num learned literals: %lld  (avg: %.1f /clause)\n",
              counters_.num_literals_learned,
@@ -874,7 +884,8 @@ void SatSolver::ProcessNewlyFixedVariableResolutionNodes() {
     // at this point.
     ResolutionNode* new_node =
         CreateResolutionNode(info.type == AssignmentInfo::CLAUSE_PROPAGATION
-                                 ? info.sat_clause->ResolutionNodePointer()
+                                 ? ReasonClause(trail_[i].Variable())
+                                       ->ResolutionNodePointer()
                                  : info.pb_constraint->ResolutionNodePointer(),
                              ClauseRef(literals_scratchpad_));
     trail_.SetFixedVariableInfo(trail_[i].Variable(), new_node);
@@ -892,14 +903,15 @@ void SatSolver::ProcessNewlyFixedVariables() {
   // We remove the clauses that are always true and the fixed literals from the
   // others.
   for (int i = 0; i < 2; ++i) {
-    for (SatClause* clause : (i == 0) ? problem_clauses_ : learned_clauses_) {
+    for (ClauseOffset offset : (i == 0) ? problem_clauses_ : learned_clauses_) {
+      SatClause* const clause = clause_arena_.Clause(offset);
       if (clause->IsAttached()) {
         if (clause->RemoveFixedLiteralsAndTestIfTrue(trail_.Assignment(),
                                                      &removed_literals)) {
           // The clause is always true, detach it.
           // TODO(user): Unlock its associated resolution node right away since
           // the solver will not be able to reach it again.
-          watched_clauses_.LazyDetach(clause);
+          watched_clauses_.LazyDetach(offset);
           ++num_detached_clauses;
         } else if (!removed_literals.empty()) {
           if (clause->Size() == 2 &&
@@ -907,7 +919,7 @@ void SatSolver::ProcessNewlyFixedVariables() {
             // The clause is now a binary clause, treat it separately.
             binary_implication_graph_.AddBinaryClause(clause->FirstLiteral(),
                                                       clause->SecondLiteral());
-            watched_clauses_.LazyDetach(clause);
+            watched_clauses_.LazyDetach(offset);
             ++num_binary;
           } else if (parameters_.unsat_proof()) {
             // The "new" clause is derived from the old one plus the level 0
@@ -929,18 +941,20 @@ void SatSolver::ProcessNewlyFixedVariables() {
 
     // Free-up learned clause memory. Note that this also postpone a bit the
     // next clause cleaning phase since we removed some clauses.
-    std::vector<SatClause*>::iterator iter = std::partition(
+    std::vector<ClauseOffset>::iterator iter = std::partition(
         learned_clauses_.begin(), learned_clauses_.end(),
         std::bind1st(std::mem_fun(&SatSolver::IsClauseAttachedOrUsedAsReason),
                      this));
-    if (parameters_.unsat_proof()) {
-      for (std::vector<SatClause*>::iterator it = iter; it != learned_clauses_.end();
-           ++it) {
-        unsat_proof_.UnlockNode((*it)->ResolutionNodePointer());
+    for (std::vector<ClauseOffset>::iterator it = iter;
+         it != learned_clauses_.end(); ++it) {
+      if (parameters_.unsat_proof()) {
+        unsat_proof_.UnlockNode(
+            clause_arena_.Clause(*it)->ResolutionNodePointer());
       }
+      clause_arena_.Delete(*it);
     }
-    STLDeleteContainerPointers(iter, learned_clauses_.end());
     learned_clauses_.erase(iter, learned_clauses_.end());
+    CompactClauseArenaIfNeeded();
   }
 
   // We also clean the binary implication graph.
@@ -1018,7 +1032,7 @@ ClauseRef SatSolver::Reason(VariableIndex var) {
     case AssignmentInfo::UNIT_REASON:
       return ClauseRef();
     case AssignmentInfo::CLAUSE_PROPAGATION:
-      return info.sat_clause->PropagationReason();
+      return ReasonClause(var)->PropagationReason();
     case AssignmentInfo::BINARY_PROPAGATION: {
       const Literal* literal = &info.literal;
       return ClauseRef(literal, literal + 1);
@@ -1185,8 +1199,8 @@ ResolutionNode* SatSolver::ResolutionNodeForAssignment(
   const AssignmentInfo& info = trail_.Info(var);
   switch (trail_.InitialAssignmentType(var)) {
     case AssignmentInfo::CLAUSE_PROPAGATION:
-      CHECK(info.sat_clause != nullptr);
-      node = info.sat_clause->ResolutionNodePointer();
+      CHECK(ClauseOffset(info.sat_clause) != kNoClauseOffset);
+      node = ReasonClause(var)->ResolutionNodePointer();
       break;
     case AssignmentInfo::UNIT_REASON:
       node = info.resolution_node;
@@ -1712,10 +1726,19 @@ namespace {
 
 // Order the clause by increasing LBD (Literal Blocks Distance) first. For the
 // same LBD they are ordered by decreasing activity.
-bool ClauseOrdering(SatClause* a, SatClause* b) {
-  if (a->Lbd() == b->Lbd()) return a->Activity() > b->Activity();
-  return a->Lbd() < b->Lbd();
-}
+class ClauseOrdering {
+ public:
+  explicit ClauseOrdering(const ClauseArena& arena) : arena_(arena) {}
+  bool operator()(ClauseOffset a_offset, ClauseOffset b_offset) const {
+    const SatClause* const a = arena_.Clause(a_offset);
+    const SatClause* const b = arena_.Clause(b_offset);
+    if (a->Lbd() == b->Lbd()) return a->Activity() > b->Activity();
+    return a->Lbd() < b->Lbd();
+  }
+
+ private:
+  const ClauseArena& arena_;
+};
 
 }  // namespace
 
@@ -1743,10 +1766,11 @@ void SatSolver::CompressLearnedClausesIfNeeded() {
 
   // Move the clause that should be kept at the beginning and sort the other
   // using the ClauseOrdering order.
-  std::vector<SatClause*>::iterator clause_to_keep_end = std::partition(
+  std::vector<ClauseOffset>::iterator clause_to_keep_end = std::partition(
       learned_clauses_.begin(), learned_clauses_.end(),
       std::bind1st(std::mem_fun(&SatSolver::ClauseShouldBeKept), this));
-  std::sort(clause_to_keep_end, learned_clauses_.end(), ClauseOrdering);
+  std::sort(clause_to_keep_end, learned_clauses_.end(),
+            ClauseOrdering(clause_arena_));
 
   // Compute the index of the first clause to delete.
   const int num_learned_clauses = learned_clauses_.size();
@@ -1756,21 +1780,50 @@ void SatSolver::CompressLearnedClausesIfNeeded() {
 
   // Delete all the learned clause after 'first_clause_to_delete'.
   for (int i = first_clause_to_delete; i < num_learned_clauses; ++i) {
-    SatClause* clause = learned_clauses_[i];
-    watched_clauses_.LazyDetach(clause);
+    const SatClause* const clause = clause_arena_.Clause(learned_clauses_[i]);
+    watched_clauses_.LazyDetach(learned_clauses_[i]);
     if (clause->ResolutionNodePointer() != nullptr) {
       unsat_proof_.UnlockNode(clause->ResolutionNodePointer());
     }
   }
   watched_clauses_.CleanUpWatchers();
   for (int i = first_clause_to_delete; i < num_learned_clauses; ++i) {
-    counters_.num_literals_forgotten += learned_clauses_[i]->Size();
-    delete learned_clauses_[i];
+    counters_.num_literals_forgotten +=
+        clause_arena_.Clause(learned_clauses_[i])->Size();
+    clause_arena_.Delete(learned_clauses_[i]);
   }
   learned_clauses_.resize(first_clause_to_delete);
+  CompactClauseArenaIfNeeded();
   InitLearnedClauseLimit();
 }
 
+void SatSolver::CompactClauseArenaIfNeeded() {
+  if (!clause_arena_.NeedsCompaction()) return;
+  SCOPED_TIME_STAT(&stats_);
+
+  // The clauses are moved in the order of the clause lists, so that the
+  // problem clauses stay contiguous.
+  clause_arena_.StartCompaction();
+  for (ClauseOffset& offset : problem_clauses_) {
+    offset = clause_arena_.Relocate(offset);
+  }
+  for (ClauseOffset& offset : learned_clauses_) {
+    offset = clause_arena_.Relocate(offset);
+  }
+  watched_clauses_.RelocateWatchers();
+
+  // Note that this includes the past assignments, see IsClauseUsedAsReason().
+  for (VariableIndex var(0); var < num_variables_; ++var) {
+    const AssignmentInfo& info = trail_.Info(var);
+    if (info.type == AssignmentInfo::CLAUSE_PROPAGATION) {
+      trail_.ChangeSatClauseReason(
+          var, clause_arena_.Relocate(ClauseOffset(info.sat_clause)));
+    }
+  }
+  trail_.SetFailingClause(ClauseRef());
+  clause_arena_.FinishCompaction();
+}
+
 bool SatSolver::ShouldRestart() {
   SCOPED_TIME_STAT(&stats_);
   if (conflicts_until_next_restart_ != 0) return false;
@@ -253,21 +253,29 @@ class SatSolver {
   // like a good idea to keep clauses that were used as a reason even if the
   // variable is currently not assigned. This way, even if the clause cleaning
   // happen just after a restart, the logic will not change.
-  bool IsClauseUsedAsReason(SatClause* clause) const {
-    const VariableIndex var = clause->PropagatedLiteral().Variable();
+  bool IsClauseUsedAsReason(ClauseOffset offset) const {
+    const VariableIndex var =
+        clause_arena_.Clause(offset)->PropagatedLiteral().Variable();
     return trail_.Info(var).type == AssignmentInfo::CLAUSE_PROPAGATION &&
-           trail_.Info(var).sat_clause == clause;
+           ClauseOffset(trail_.Info(var).sat_clause) == offset;
+  }
+
+  // Returns the clause of an assignment of type CLAUSE_PROPAGATION.
+  const SatClause* ReasonClause(VariableIndex var) const {
+    return clause_arena_.Clause(ClauseOffset(trail_.Info(var).sat_clause));
   }
 
   // Predicate used by ProcessNewlyFixedVariables().
-  bool IsClauseAttachedOrUsedAsReason(SatClause* clause) const {
-    return clause->IsAttached() || IsClauseUsedAsReason(clause);
+  bool IsClauseAttachedOrUsedAsReason(ClauseOffset offset) const {
+    return clause_arena_.Clause(offset)->IsAttached() ||
+           IsClauseUsedAsReason(offset);
   }
 
   // Predicate used by CompressLearnedClausesIfNeeded().
-  bool ClauseShouldBeKept(SatClause* clause) const {
+  bool ClauseShouldBeKept(ClauseOffset offset) const {
+    const SatClause* const clause = clause_arena_.Clause(offset);
     return clause->Lbd() <= 2 || clause->Size() <= 2 ||
-           IsClauseUsedAsReason(clause);
+           IsClauseUsedAsReason(offset);
   }
 
   // Add a problem clause. Not that the clause is assumed to be "cleaned", that
@@ -392,6 +400,10 @@ class SatSolver {
   void CompressLearnedClausesIfNeeded();
   void InitLearnedClauseLimit();
 
+  // Reclaims the memory of the deleted clauses if it is worth it. This moves
+  // the clauses in memory, see ClauseArena.
+  void CompactClauseArenaIfNeeded();
+
   // Returns the initial weight of a variable. Higher is better. This depends on
   // the variable_ordering parameter.
   double ComputeInitialVariableWeight(VariableIndex var) const;
@@ -417,7 +429,7 @@ class SatSolver {
   // Activity managment for clauses. This work the same way at the ones for
   // variables, but with different parameters.
   void BumpReasonActivities(const std::vector<Literal>& literals);
-  void BumpClauseActivity(SatClause* clause);
+  void BumpClauseActivity(ClauseOffset offset);
   void RescaleClauseActivities(double scaling_factor);
   void UpdateClauseActivityIncrement();
 
@@ -438,12 +450,12 @@ class SatSolver {
   // The number of constraints of the initial problem that where added.
   int num_constraints_;
 
-  // Original clauses of the problem and clauses learned during search.
-  // These vector have the ownership of the pointers. We currently do not use
-  // std::unique_ptr<SatClause> because it can't be used with STL algorithm
-  // like std::partition.
-  std::vector<SatClause*> problem_clauses_;
-  std::vector<SatClause*> learned_clauses_;
+  // Storage of all the clauses, original clauses of the problem and clauses
+  // learned during search. Note that clause_arena_ must be declared before
+  // watched_clauses_.
+  ClauseArena clause_arena_;
+  std::vector<ClauseOffset> problem_clauses_;
+  std::vector<ClauseOffset> learned_clauses_;
 
   // Observers of literals.
   LiteralWatchers watched_clauses_;
@@ -0,0 +1,542 @@
+// Copyright 2010-2013 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sat/simplification.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/timer.h"
+#include "sat/boolean_problem.h"
+#include "sat/sat_solver.h"
+
+namespace operations_research {
+namespace sat {
+
+namespace {
+// Returns true if the given constraint is a clause, i.e. a sum of literals
+// greater or equal to one.
+bool IsClause(const LinearBooleanConstraint& constraint) {
+  if (constraint.literals_size() == 0) return false;
+  if (!constraint.has_lower_bound() || constraint.lower_bound() != 1) {
+    return false;
+  }
+  if (constraint.has_upper_bound() &&
+      constraint.upper_bound() < constraint.literals_size()) {
+    return false;
+  }
+  for (const int64 coefficient : constraint.coefficients()) {
+    if (coefficient != 1) return false;
+  }
+  return true;
+}
+
+void AddClauseToProblem(const std::vector<Literal>& clause,
+                        LinearBooleanProblem* problem) {
+  LinearBooleanConstraint* constraint = problem->add_constraints();
+  constraint->set_lower_bound(1);
+  for (const Literal literal : clause) {
+    constraint->add_literals(literal.SignedValue());
+    constraint->add_coefficients(1);
+  }
+}
+
+uint64 ComputeSignature(const std::vector<Literal>& clause) {
+  uint64 signature = 0;
+  for (const Literal literal : clause) {
+    signature |= (GG_ULONGLONG(1) << (literal.Variable().value() & 63));
+  }
+  return signature;
+}
+
+// Returns true if the sorted clause a is included in the sorted clause b up to
+// at most one literal of a that appears negated in b. In this case, the
+// literal of b is returned in opposite_literal, otherwise opposite_literal is
+// set to kNoLiteralIndex and a subsumes b.
+bool SimplifyClause(const std::vector<Literal>& a, const std::vector<Literal>& b,
+                    LiteralIndex* opposite_literal) {
+  if (b.size() < a.size()) return false;
+  *opposite_literal = kNoLiteralIndex;
+  int size_diff = b.size() - a.size();
+  std::vector<Literal>::const_iterator ia = a.begin();
+  std::vector<Literal>::const_iterator ib = b.begin();
+
+  // Because we abort as soon as size_diff becomes negative, ib can't reach the
+  // end of b before ia reaches the end of a.
+  while (ia != a.end()) {
+    if (*ia == *ib) {
+      ++ia;
+      ++ib;
+    } else if (*ia == ib->Negated()) {
+      if (*opposite_literal != kNoLiteralIndex) return false;
+      *opposite_literal = ib->Index();
+      ++ia;
+      ++ib;
+    } else if (*ia < *ib) {
+      return false;
+    } else {
+      ++ib;
+      if (--size_diff < 0) return false;
+    }
+  }
+  return true;
+}
+
+// Computes the resolvent of the sorted clauses a and b on the given variable.
+// Returns false if the resolvent is a tautology.
+bool ComputeResolvent(VariableIndex var, const std::vector<Literal>& a,
+                      const std::vector<Literal>& b,
+                      std::vector<Literal>* resolvent) {
+  resolvent->clear();
+  std::vector<Literal>::const_iterator ia = a.begin();
+  std::vector<Literal>::const_iterator ib = b.begin();
+  while (ia != a.end() && ib != b.end()) {
+    if (*ia == *ib) {
+      resolvent->push_back(*ia);
+      ++ia;
+      ++ib;
+    } else if (*ia == ib->Negated()) {
+      if (ia->Variable() != var) return false;
+      ++ia;
+      ++ib;
+    } else if (*ia < *ib) {
+      if (ia->Variable() != var) resolvent->push_back(*ia);
+      ++ia;
+    } else {
+      if (ib->Variable() != var) resolvent->push_back(*ib);
+      ++ib;
+    }
+  }
+  for (; ia != a.end(); ++ia) {
+    if (ia->Variable() != var) resolvent->push_back(*ia);
+  }
+  for (; ib != b.end(); ++ib) {
+    if (ib->Variable() != var) resolvent->push_back(*ib);
+  }
+  return true;
+}
+
+// Orders the clause indices by decreasing size.
+class DecreasingClauseSize {
+ public:
+  explicit DecreasingClauseSize(const std::vector<std::vector<Literal> >& clauses)
+      : clauses_(clauses) {}
+  bool operator()(int a, int b) const {
+    return clauses_[a].size() > clauses_[b].size();
+  }
+
+ private:
+  const std::vector<std::vector<Literal> >& clauses_;
+};
+}  // namespace
+
+// ----- SatPostsolver -----
+
+SatPostsolver::SatPostsolver(int num_variables)
+    : num_variables_(num_variables) {
+  clauses_start_.push_back(0);
+}
+
+void SatPostsolver::Add(Literal x, const std::vector<Literal>& clause) {
+  DCHECK(std::find(clause.begin(), clause.end(), x) != clause.end());
+  associated_literal_.push_back(x);
+  clauses_literals_.insert(clauses_literals_.end(), clause.begin(),
+                           clause.end());
+  clauses_start_.push_back(clauses_literals_.size());
+}
+
+void SatPostsolver::PostsolveSolution(
+    const VariablesAssignment& presolved_assignment,
+    VariablesAssignment* assignment) const {
+  assignment->Resize(num_variables_);
+  for (VariableIndex var(0); var < num_variables_; ++var) {
+    if (presolved_assignment.IsVariableAssigned(var)) {
+      assignment->AssignFromTrueLiteral(
+          presolved_assignment.GetTrueLiteralForAssignedVariable(var));
+    } else {
+      assignment->AssignFromTrueLiteral(Literal(var, false));
+    }
+  }
+
+  // The clauses are processed in the reverse order of their elimination. When
+  // a clause is not satisfied, the literal of the variable that was eliminated
+  // with it is set to true. This never falsifies a clause processed before
+  // since their resolvent was part of the problem.
+  for (int i = associated_literal_.size() - 1; i >= 0; --i) {
+    bool is_satisfied = false;
+    for (int j = clauses_start_[i]; j < clauses_start_[i + 1]; ++j) {
+      if (assignment->IsLiteralTrue(clauses_literals_[j])) {
+        is_satisfied = true;
+        break;
+      }
+    }
+    if (!is_satisfied) {
+      const Literal x = associated_literal_[i];
+      assignment->UnassignLiteral(x.Negated());
+      assignment->AssignFromTrueLiteral(x);
+    }
+  }
+}
+
+// ----- SatPresolver -----
+
+SatPresolver::SatPresolver(SatPostsolver* postsolver)
+    : postsolver_(postsolver),
+      num_subsumed_clauses_(0),
+      num_removed_literals_(0),
+      num_eliminated_variables_(0),
+      num_failed_literals_(0) {}
+
+void SatPresolver::Load(const LinearBooleanProblem& problem) {
+  const int num_variables = problem.num_variables();
+  problem_without_clauses_.CopyFrom(problem);
+  problem_without_clauses_.clear_constraints();
+  literal_to_clauses_.resize(num_variables << 1);
+  literal_to_clause_sizes_.resize(num_variables << 1, 0);
+  is_frozen_.resize(num_variables, false);
+  is_eliminated_.resize(num_variables, false);
+  assignment_.Resize(num_variables);
+
+  // The objective variables can't be eliminated.
+  for (const int signed_literal : problem.objective().literals()) {
+    is_frozen_[Literal(signed_literal).Variable()] = true;
+  }
+
+  std::vector<Literal> clause;
+  for (const LinearBooleanConstraint& constraint : problem.constraints()) {
+    if (!IsClause(constraint)) {
+      problem_without_clauses_.add_constraints()->CopyFrom(constraint);
+      for (const int signed_literal : constraint.literals()) {
+        is_frozen_[Literal(signed_literal).Variable()] = true;
+      }
+      continue;
+    }
+    clause.clear();
+    for (const int signed_literal : constraint.literals()) {
+      clause.push_back(Literal(signed_literal));
+    }
+    std::sort(clause.begin(), clause.end());
+    clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+
+    // Skip the tautologies. Note that x and not(x) are consecutive once the
+    // literals are sorted by index.
+    bool is_tautology = false;
+    for (int i = 1; i < clause.size(); ++i) {
+      if (clause[i] == clause[i - 1].Negated()) {
+        is_tautology = true;
+        break;
+      }
+    }
+    if (!is_tautology) CHECK(AddClauseInternal(&clause));
+  }
+}
+
+bool SatPresolver::AddClauseInternal(std::vector<Literal>* clause) {
+  if (clause->empty()) return false;
+  if (clause->size() == 1) units_to_fix_.push_back((*clause)[0]);
+  const int clause_index = clauses_.size();
+  clauses_.push_back(std::vector<Literal>());
+  clauses_.back().swap(*clause);
+  signatures_.push_back(ComputeSignature(clauses_.back()));
+  for (const Literal literal : clauses_.back()) {
+    literal_to_clauses_[literal.Index()].push_back(clause_index);
+    ++literal_to_clause_sizes_[literal.Index()];
+  }
+  clause_queue_.push_back(clause_index);
+  in_clause_queue_.push_back(true);
+  return true;
+}
+
+void SatPresolver::RemoveClause(int clause_index) {
+  for (const Literal literal : clauses_[clause_index]) {
+    --literal_to_clause_sizes_[literal.Index()];
+  }
+  std::vector<Literal>().swap(clauses_[clause_index]);
+}
+
+bool SatPresolver::RemoveLiteralFromClause(LiteralIndex literal,
+                                           int clause_index) {
+  std::vector<Literal>& clause = clauses_[clause_index];
+  clause.erase(std::find(clause.begin(), clause.end(), Literal(literal)));
+  --literal_to_clause_sizes_[literal];
+  ++num_removed_literals_;
+  if (clause.empty()) return false;
+  if (clause.size() == 1) units_to_fix_.push_back(clause[0]);
+  signatures_[clause_index] = ComputeSignature(clause);
+  if (!in_clause_queue_[clause_index]) {
+    clause_queue_.push_back(clause_index);
+    in_clause_queue_[clause_index] = true;
+  }
+  return true;
+}
+
+bool SatPresolver::PropagateUnits() {
+  while (!units_to_fix_.empty()) {
+    const Literal true_literal = units_to_fix_.back();
+    units_to_fix_.pop_back();
+    if (assignment_.IsLiteralTrue(true_literal)) continue;
+    if (assignment_.IsLiteralFalse(true_literal)) return false;
+    assignment_.AssignFromTrueLiteral(true_literal);
+    fixed_literals_.push_back(true_literal);
+
+    // Note that the occurrence lists may contain clauses that do not contain
+    // the literal anymore, so we test it.
+    for (const int clause_index : literal_to_clauses_[true_literal.Index()]) {
+      const std::vector<Literal>& clause = clauses_[clause_index];
+      if (std::binary_search(clause.begin(), clause.end(), true_literal)) {
+        RemoveClause(clause_index);
+      }
+    }
+    std::vector<int>().swap(literal_to_clauses_[true_literal.Index()]);
+    const Literal false_literal = true_literal.Negated();
+    for (const int clause_index : literal_to_clauses_[false_literal.Index()]) {
+      const std::vector<Literal>& clause = clauses_[clause_index];
+      if (std::binary_search(clause.begin(), clause.end(), false_literal)) {
+        if (!RemoveLiteralFromClause(false_literal.Index(), clause_index)) {
+          return false;
+        }
+      }
+    }
+    std::vector<int>().swap(literal_to_clauses_[false_literal.Index()]);
+  }
+  return true;
+}
+
+bool SatPresolver::ProcessClauseToSimplifyOthers(int clause_index) {
+  const std::vector<Literal>& clause = clauses_[clause_index];
+  if (clause.empty()) return true;
+
+  // All the clauses that can be simplified by this one contain one of its
+  // literals or its negation. We choose the one with the fewest occurrences.
+  LiteralIndex best = clause[0].Index();
+  int best_size = kint32max;
+  for (const Literal literal : clause) {
+    const int size = literal_to_clause_sizes_[literal.Index()] +
+                     literal_to_clause_sizes_[literal.NegatedIndex()];
+    if (size < best_size) {
+      best = literal.Index();
+      best_size = size;
+    }
+  }
+
+  const uint64 signature = signatures_[clause_index];
+  const LiteralIndex to_scan[2] = {best, Literal(best).NegatedIndex()};
+  for (const LiteralIndex scanned : to_scan) {
+    std::vector<int>& occurrences = literal_to_clauses_[scanned];
+    int new_size = 0;
+    for (int i = 0; i < occurrences.size(); ++i) {
+      const int other = occurrences[i];
+      if (clauses_[other].empty()) continue;
+      if (other != clause_index && (signature & ~signatures_[other]) == 0) {
+        LiteralIndex opposite_literal;
+        if (SimplifyClause(clause, clauses_[other], &opposite_literal)) {
+          if (opposite_literal == kNoLiteralIndex) {
+            ++num_subsumed_clauses_;
+            RemoveClause(other);
+            continue;
+          }
+          if (!RemoveLiteralFromClause(opposite_literal, other)) return false;
+          if (opposite_literal == scanned) continue;
+        }
+      }
+      occurrences[new_size++] = other;
+    }
+    occurrences.resize(new_size);
+  }
+  return true;
+}
+
+bool SatPresolver::ProcessClauseQueue() {
+  while (true) {
+    if (!PropagateUnits()) return false;
+    if (clause_queue_.empty()) break;
+    const int clause_index = clause_queue_.back();
+    clause_queue_.pop_back();
+    in_clause_queue_[clause_index] = false;
+    if (!ProcessClauseToSimplifyOthers(clause_index)) return false;
+  }
+  return true;
+}
+
+bool SatPresolver::ProbeLiterals() {
+  SatSolver solver;
+  LinearBooleanProblem problem;
+  ExtractPresolvedProblem(&problem);
+  if (!LoadBooleanProblem(problem, &solver)) return false;
+  const int64 propagation_limit =
+      solver.num_propagations() +
+      parameters_.presolve_probing_max_propagations();
+  for (VariableIndex var(0); var < problem.num_variables(); ++var) {
+    if (solver.num_propagations() > propagation_limit) break;
+    for (int i = 0; i < 2; ++i) {
+      if (solver.Assignment().IsVariableAssigned(var)) break;
+      if (solver.EnqueueDecisionAndBackjumpOnConflict(Literal(var, i == 0)) ==
+          kUnsatTrailIndex) {
+        return false;
+      }
+      solver.Backtrack(0);
+    }
+  }
+
+  // All the literals at level zero are implied by the problem.
+  const Trail& trail = solver.LiteralTrail();
+  for (int i = 0; i < trail.Index(); ++i) {
+    if (!assignment_.IsLiteralTrue(trail[i])) {
+      ++num_failed_literals_;
+      units_to_fix_.push_back(trail[i]);
+    }
+  }
+  return ProcessClauseQueue();
+}
+
+void SatPresolver::CleanUpOccurrences(LiteralIndex literal) {
+  std::vector<int>& occurrences = literal_to_clauses_[literal];
+  int new_size = 0;
+  for (const int clause_index : occurrences) {
+    const std::vector<Literal>& clause = clauses_[clause_index];
+    if (std::binary_search(clause.begin(), clause.end(), Literal(literal))) {
+      occurrences[new_size++] = clause_index;
+    }
+  }
+  occurrences.resize(new_size);
+}
+
+bool SatPresolver::CrossProduct(VariableIndex var, bool* eliminated) {
+  *eliminated = false;
+  const Literal literal(var, true);
+  CleanUpOccurrences(literal.Index());
+  CleanUpOccurrences(literal.NegatedIndex());
+  const std::vector<int>& positive = literal_to_clauses_[literal.Index()];
+  const std::vector<int>& negative = literal_to_clauses_[literal.NegatedIndex()];
+  if (positive.empty() && negative.empty()) return true;
+  if (static_cast<int64>(positive.size()) * negative.size() >
+      parameters_.presolve_bve_threshold()) {
+    return true;
+  }
+
+  // The variable is only eliminated if this doesn't increase the number of
+  // clauses.
+  const int max_num_resolvents = positive.size() + negative.size();
+  int num_resolvents = 0;
+  std::vector<Literal> resolvent;
+  for (const int a : positive) {
+    for (const int b : negative) {
+      if (ComputeResolvent(var, clauses_[a], clauses_[b], &resolvent)) {
+        if (++num_resolvents > max_num_resolvents) return true;
+      }
+    }
+  }
+
+  // Note that the resolvents do not contain var, so adding them doesn't modify
+  // the positive and negative occurrence lists.
+  for (const int a : positive) {
+    for (const int b : negative) {
+      if (ComputeResolvent(var, clauses_[a], clauses_[b], &resolvent)) {
+        if (!AddClauseInternal(&resolvent)) return false;
+      }
+    }
+  }
+  for (const int a : positive) {
+    postsolver_->Add(literal, clauses_[a]);
+    RemoveClause(a);
+  }
+  for (const int b : negative) {
+    postsolver_->Add(literal.Negated(), clauses_[b]);
+    RemoveClause(b);
+  }
+  std::vector<int>().swap(literal_to_clauses_[literal.Index()]);
+  std::vector<int>().swap(literal_to_clauses_[literal.NegatedIndex()]);
+  is_eliminated_[var] = true;
+  ++num_eliminated_variables_;
+  *eliminated = true;
+  return true;
+}
+
+bool SatPresolver::Presolve() {
+  WallTimer timer;
+  timer.Start();
+  const int num_variables = problem_without_clauses_.num_variables();
+  int num_initial_clauses = 0;
+  for (const std::vector<Literal>& clause : clauses_) {
+    if (!clause.empty()) ++num_initial_clauses;
+  }
+
+  // Subsumption and self-subsuming resolution. The smallest clauses are
+  // processed first since they are the most likely to simplify the others.
+  std::sort(clause_queue_.begin(), clause_queue_.end(),
+            DecreasingClauseSize(clauses_));
+  if (!ProcessClauseQueue()) return false;
+  if (!ProbeLiterals()) return false;
+
+  // Bounded variable elimination. The variables with the fewest occurrences are
+  // tried first, and we loop until no more variables can be eliminated.
+  std::vector<std::pair<int64, VariableIndex> > candidates;
+  bool has_eliminated = true;
+  while (has_eliminated) {
+    has_eliminated = false;
+    candidates.clear();
+    for (VariableIndex var(0); var < num_variables; ++var) {
+      if (is_frozen_[var] || is_eliminated_[var] ||
+          assignment_.IsVariableAssigned(var)) {
+        continue;
+      }
+      const Literal literal(var, true);
+      candidates.push_back(std::make_pair(
+          static_cast<int64>(literal_to_clause_sizes_[literal.Index()]) *
+              literal_to_clause_sizes_[literal.NegatedIndex()],
+          var));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const std::pair<int64, VariableIndex>& candidate : candidates) {
+      // The variable may have been fixed by a previous elimination.
+      if (assignment_.IsVariableAssigned(candidate.second)) continue;
+      bool eliminated = false;
+      if (!CrossProduct(candidate.second, &eliminated)) return false;
+      if (eliminated) {
+        has_eliminated = true;
+        if (!ProcessClauseQueue()) return false;
+      }
+    }
+  }
+
+  if (parameters_.log_search_progress()) {
+    int num_clauses = 0;
+    int64 num_literals = 0;
+    for (const std::vector<Literal>& clause : clauses_) {
+      if (clause.empty()) continue;
+      ++num_clauses;
+      num_literals += clause.size();
+    }
+    LOG(INFO) << "Presolve: " << num_initial_clauses << " -> " << num_clauses
+              << " clauses (" << num_literals << " literals), "
+              << num_subsumed_clauses_ << " subsumed clauses, "
+              << num_removed_literals_ << " removed literals, "
+              << num_eliminated_variables_ << " eliminated variables, "
+              << fixed_literals_.size() << " fixed variables ("
+              << num_failed_literals_ << " by probing), time: " << timer.Get()
+              << "s";
+  }
+  return true;
+}
+
+void SatPresolver::ExtractPresolvedProblem(LinearBooleanProblem* problem) const {
+  problem->CopyFrom(problem_without_clauses_);
+  for (const Literal literal : fixed_literals_) {
+    AddClauseToProblem(std::vector<Literal>(1, literal), problem);
+  }
+  for (const std::vector<Literal>& clause : clauses_) {
+    if (!clause.empty()) AddClauseToProblem(clause, problem);
+  }
+}
+
+}  // namespace sat
+}  // namespace operations_research
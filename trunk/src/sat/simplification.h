@@ -0,0 +1,179 @@
+// Copyright 2010-2013 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Implementation of a pure SAT presolver. This roughly follows the paper:
+//
+// "Effective Preprocessing in SAT through Variable and Clause Elimination",
+// Niklas Een and Armin Biere, published in the SAT 2005 proceedings.
+
+#ifndef OR_TOOLS_SAT_SIMPLIFICATION_H_
+#define OR_TOOLS_SAT_SIMPLIFICATION_H_
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/int_type_indexed_vector.h"
+#include "sat/boolean_problem.pb.h"
+#include "sat/sat_base.h"
+#include "sat/sat_parameters.pb.h"
+
+namespace operations_research {
+namespace sat {
+
+// Stores the clauses removed by the bounded variable elimination of the
+// SatPresolver so that a solution of the presolved problem can be extended to
+// a solution of the original one.
+class SatPostsolver {
+ public:
+  explicit SatPostsolver(int num_variables);
+
+  // Records a clause removed by the elimination of the variable of x. The given
+  // clause must contain x.
+  void Add(Literal x, const std::vector<Literal>& clause);
+
+  // Fills the given assignment (which is resized to the number of variables of
+  // the original problem) from a complete assignment of the presolved problem.
+  // The value of the eliminated variables are recomputed so that all the
+  // clauses passed to Add() are satisfied.
+  void PostsolveSolution(const VariablesAssignment& presolved_assignment,
+                         VariablesAssignment* assignment) const;
+
+ private:
+  const int num_variables_;
+
+  // The stack of removed clauses, in the order they were given to Add(). The
+  // literals of the clause i are in [clauses_start_[i], clauses_start_[i + 1])
+  // of clauses_literals_.
+  std::vector<Literal> associated_literal_;
+  std::vector<int> clauses_start_;
+  std::vector<Literal> clauses_literals_;
+
+  DISALLOW_COPY_AND_ASSIGN(SatPostsolver);
+};
+
+// This class simplifies the clauses of a LinearBooleanProblem with the
+// following techniques:
+// - Unit propagation and removal of the satisfied clauses.
+// - Subsumption: the clauses that contain another clause are removed.
+// - Self-subsuming resolution: if a clause c contains all the literals of
+//   another clause except one literal x that appears negated in c, then not(x)
+//   is removed from c.
+// - Bounded variable elimination: a variable is removed by replacing all the
+//   clauses containing it by all their non-trivial resolvents if this doesn't
+//   increase the number of clauses.
+// - Failed literal probing: the literals whose propagation leads to a conflict
+//   are fixed to false.
+//
+// The constraints that are not clauses and the objective are kept as is, and
+// their variables are never eliminated. The presolved problem has the same
+// variables as the original one, so the objective value of a solution is not
+// changed by the postsolve.
+class SatPresolver {
+ public:
+  // Does not take ownership of the postsolver, it must outlive this class.
+  explicit SatPresolver(SatPostsolver* postsolver);
+
+  void SetParameters(const SatParameters& parameters) {
+    parameters_ = parameters;
+  }
+
+  // Loads the problem to presolve.
+  void Load(const LinearBooleanProblem& problem);
+
+  // Presolves the loaded problem. Returns false if the problem was proven to be
+  // UNSAT, in which case the presolved problem must not be used.
+  bool Presolve();
+
+  // Returns the presolved problem. The fixed variables are encoded as unit
+  // clauses.
+  void ExtractPresolvedProblem(LinearBooleanProblem* problem) const;
+
+ private:
+  // Adds a new clause to clauses_ and to the clause queue. The literals must be
+  // sorted and without duplicates. Returns false if the clause is empty.
+  bool AddClauseInternal(std::vector<Literal>* clause);
+
+  // Removes the given clause and updates the occurrence counts.
+  void RemoveClause(int clause_index);
+
+  // Removes the given literal from the given clause. Returns false if this
+  // creates an empty clause.
+  bool RemoveLiteralFromClause(LiteralIndex literal, int clause_index);
+
+  // Fixes the literals of units_to_fix_ and propagates them to the clauses.
+  // Returns false on conflict.
+  bool PropagateUnits();
+
+  // Uses the given clause to remove the clauses it subsumes and to strengthen
+  // the ones on which a self-subsuming resolution step applies. Returns false
+  // on conflict.
+  bool ProcessClauseToSimplifyOthers(int clause_index);
+
+  // Processes all the clauses of the queue with
+  // ProcessClauseToSimplifyOthers(). Returns false on conflict.
+  bool ProcessClauseQueue();
+
+  // Probes all the unassigned variables with a SatSolver and fixes the failed
+  // literals. Returns false on conflict.
+  bool ProbeLiterals();
+
+  // Tries to eliminate the given variable. Returns false on conflict.
+  bool CrossProduct(VariableIndex var, bool* eliminated);
+
+  // Removes from literal_to_clauses_[literal] the removed clauses and the ones
+  // that no longer contain the literal.
+  void CleanUpOccurrences(LiteralIndex literal);
+
+  SatParameters parameters_;
+  SatPostsolver* postsolver_;
+  LinearBooleanProblem problem_without_clauses_;
+
+  // The clauses, sorted by literal index. A removed clause is empty.
+  std::vector<std::vector<Literal> > clauses_;
+
+  // A bitmask of the variables of each clause, used to quickly detect that a
+  // clause is not included in another.
+  std::vector<uint64> signatures_;
+
+  // Occurrence lists. They may contain removed clauses, or clauses that do not
+  // contain the literal anymore, but literal_to_clause_sizes_ is exact.
+  ITIVector<LiteralIndex, std::vector<int> > literal_to_clauses_;
+  ITIVector<LiteralIndex, int> literal_to_clause_sizes_;
+
+  // The clauses that still need to be processed by
+  // ProcessClauseToSimplifyOthers().
+  std::vector<int> clause_queue_;
+  std::vector<bool> in_clause_queue_;
+
+  // The variables that can't be eliminated because they appear in a
+  // constraint which is not a clause or in the objective.
+  ITIVector<VariableIndex, bool> is_frozen_;
+  ITIVector<VariableIndex, bool> is_eliminated_;
+  VariablesAssignment assignment_;
+  std::vector<Literal> fixed_literals_;
+  std::vector<Literal> units_to_fix_;
+
+  // Statistics.
+  int num_subsumed_clauses_;
+  int num_removed_literals_;
+  int num_eliminated_variables_;
+  int num_failed_literals_;
+
+  DISALLOW_COPY_AND_ASSIGN(SatPresolver);
+};
+
+}  // namespace sat
+}  // namespace operations_research
+
+#endif  // OR_TOOLS_SAT_SIMPLIFICATION_H_
@@ -38,7 +38,12 @@ inline uint64 OneBit64(int pos) { return GG_ULONGLONG(1) << pos; }
 inline uint32 OneBit32(int pos) { return 1U << pos; }
 
 // Returns the number of bits set in n.
+// The builtin is only used when it compiles to the popcnt instruction, the
+// generic version is faster than the library call gcc uses otherwise.
 inline uint64 BitCount64(uint64 n) {
+#if defined(__GNUC__) && defined(__POPCNT__)
+  return __builtin_popcountll(n);
+#else
   const uint64 m1 = GG_ULONGLONG(0x5555555555555555);
   const uint64 m2 = GG_ULONGLONG(0x3333333333333333);
   const uint64 m4 = GG_ULONGLONG(0x0F0F0F0F0F0F0F0F);
@@ -48,6 +53,7 @@ inline uint64 BitCount64(uint64 n) {
   n = (n + (n >> 4)) & m4;
   n = (n * h01) >> 56;
   return n;
+#endif
 }
 inline uint32 BitCount32(uint32 n) {
   n -= (n >> 1) & 0x55555555UL;
@@ -68,6 +74,8 @@ inline uint32 LeastSignificantBitWord32(uint32 n) { return n & ~(n - 1); }
 // win on PIII. On k8, bsf is much slower than the C-equivalent!
 // Using inline assembly code yields a 10% performance gain.
 // Use de Bruijn hashing instead of bsf is always a win, on both P3 and K8.
+// On recent processors, the tzcnt/bsf and lzcnt/bsr instructions that gcc
+// emits for its builtins are faster than both, and are used when available.
 #define USE_DEBRUIJN true  // if true, use de Bruijn bit forward scanner
 #if defined(ARCH_K8) || defined(ARCH_PIII)
 #define USE_ASM_LEAST_SIGNIFICANT_BIT true  // if true, use assembly lsb
@@ -89,6 +97,8 @@ inline int LeastSignificantBitPosition64(uint64 n) {
   }
   return pos;
 #endif
+#elif defined(__GNUC__)
+  return __builtin_ctzll(n);
 #elif defined(USE_DEBRUIJN)
   // de Bruijn sequence
   static const uint64 kSeq = GG_ULONGLONG(0x0218a392dd5fb34f);
@@ -141,6 +151,8 @@ inline int LeastSignificantBitPosition32(uint32 n) {
   int pos;
   __asm__("bsfl %1, %0\n" : "=r"(pos) : "r"(n));
   return pos;
+#elif defined(__GNUC__)
+  return __builtin_ctz(n);
 #elif defined(USE_DEBRUIJN)
   static const uint32 kSeq = 0x077CB531U;  // de Bruijn sequence
   static const int kTab[32] = {
@@ -198,6 +210,9 @@ inline int MostSignificantBitPosition64(uint64 n) {
   __asm__("bsrq  %1, %0\n" : "=r"(pos) : "ro"(n) : "cc");
   return pos;
 #endif
+#elif defined(__GNUC__)
+  // The generic version returns 0 for 0, and some callers rely on it.
+  return 63 ^ __builtin_clzll(n | 1);
 #else
   int b = 0;
   if (0 != (n & (kAllBits64 << (1 << 5)))) {
@@ -232,6 +247,8 @@ inline int MostSignificantBitPosition32(uint32 n) {
   int pos;
   __asm__("bsrl %1, %0\n" : "=r"(pos) : "ro"(n) : "cc");
   return pos;
+#elif defined(__GNUC__)
+  return 31 ^ __builtin_clz(n | 1);
 #else
   int b = 0;
   if (0 != (n & (kAllBits32 << (1 << 4)))) {
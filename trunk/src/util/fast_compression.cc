@@ -0,0 +1,174 @@
+// Copyright 2010-2013 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/fast_compression.h"
+
+#include <string.h>
+
+#include "base/integral_types.h"
+
+namespace operations_research {
+namespace {
+const int kMinMatch = 4;
+const int kHashLog = 12;
+const size_t kMaxOffset = 65535;
+// No match starts in the last kMatchSafetyMargin bytes of the input, and the
+// last kLastLiterals bytes are always literals.
+const size_t kMatchSafetyMargin = 12;
+const size_t kLastLiterals = 5;
+
+inline uint32 Load32(const uint8* ptr) {
+  uint32 value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+inline int Hash(uint32 sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashLog);
+}
+
+// Writes the continuation bytes of a length that does not fit in a nibble.
+inline uint8* WriteLength(size_t length, uint8* op) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<uint8>(length);
+  return op;
+}
+
+// Writes a block with the given literals. If 'match_length' is zero, the block
+// is the last one and has no match.
+uint8* WriteBlock(const uint8* literals, size_t num_literals, size_t offset,
+                  size_t match_length, uint8* op) {
+  uint8* const token = op++;
+  if (num_literals >= 15) {
+    *token = 15 << 4;
+    op = WriteLength(num_literals - 15, op);
+  } else {
+    *token = num_literals << 4;
+  }
+  memcpy(op, literals, num_literals);
+  op += num_literals;
+  if (match_length == 0) return op;
+  *op++ = offset & 0xFF;
+  *op++ = offset >> 8;
+  const size_t length = match_length - kMinMatch;
+  if (length >= 15) {
+    *token |= 15;
+    op = WriteLength(length - 15, op);
+  } else {
+    *token |= length;
+  }
+  return op;
+}
+
+// Reads the continuation bytes of a length. Returns false if the input ends.
+inline bool ReadLength(const uint8** ip, const uint8* const end,
+                       size_t* length) {
+  uint8 byte;
+  do {
+    if (*ip >= end) return false;
+    byte = *(*ip)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+}  // namespace
+
+size_t FastCompressBound(size_t input_size) {
+  return input_size + input_size / 255 + 16;
+}
+
+size_t FastCompress(const char* input, size_t input_size, char* output) {
+  const uint8* const in = reinterpret_cast<const uint8*>(input);
+  uint8* op = reinterpret_cast<uint8*>(output);
+  size_t anchor = 0;
+  if (input_size > kMatchSafetyMargin) {
+    // Positions + 1 of the last sequences seen with each hash, 0 means none.
+    uint32 table[1 << kHashLog];
+    memset(table, 0, sizeof(table));
+    const size_t match_limit = input_size - kMatchSafetyMargin;
+    const size_t extend_limit = input_size - kLastLiterals;
+    size_t pos = 0;
+    while (pos < match_limit) {
+      const uint32 sequence = Load32(in + pos);
+      const int hash = Hash(sequence);
+      const size_t candidate = table[hash];
+      table[hash] = pos + 1;
+      if (candidate == 0 || pos - (candidate - 1) > kMaxOffset ||
+          Load32(in + candidate - 1) != sequence) {
+        // Skips faster in incompressible data.
+        pos += 1 + ((pos - anchor) >> 6);
+        continue;
+      }
+      const size_t match = candidate - 1;
+      size_t length = kMinMatch;
+      while (pos + length < extend_limit &&
+             in[match + length] == in[pos + length]) {
+        ++length;
+      }
+      op = WriteBlock(in + anchor, pos - anchor, pos - match, length, op);
+      pos += length;
+      anchor = pos;
+    }
+  }
+  op = WriteBlock(in + anchor, input_size - anchor, 0, 0, op);
+  return op - reinterpret_cast<uint8*>(output);
+}
+
+bool FastUncompress(const char* input, size_t input_size, char* output,
+                    size_t output_size) {
+  const uint8* ip = reinterpret_cast<const uint8*>(input);
+  const uint8* const in_end = ip + input_size;
+  uint8* const out = reinterpret_cast<uint8*>(output);
+  uint8* op = out;
+  uint8* const out_end = out + output_size;
+  for (;;) {
+    if (ip >= in_end) return false;
+    const uint8 token = *ip++;
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !ReadLength(&ip, in_end, &num_literals)) {
+      return false;
+    }
+    if (num_literals > static_cast<size_t>(in_end - ip) ||
+        num_literals > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+    memcpy(op, ip, num_literals);
+    op += num_literals;
+    ip += num_literals;
+    if (ip == in_end) break;
+    if (in_end - ip < 2) return false;
+    const size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - out)) return false;
+    size_t length = token & 15;
+    if (length == 15 && !ReadLength(&ip, in_end, &length)) return false;
+    length += kMinMatch;
+    if (length > static_cast<size_t>(out_end - op)) return false;
+    const uint8* match = op - offset;
+    if (offset >= length) {
+      memcpy(op, match, length);
+      op += length;
+    } else {
+      // Overlapping copy, the match repeats the last 'offset' bytes.
+      for (size_t i = 0; i < length; ++i) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return op == out_end;
+}
+
+}  // namespace operations_research
@@ -0,0 +1,49 @@
+// Copyright 2010-2013 Google
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A fast byte-oriented LZ77 codec, in the spirit of LZ4. It trades
+// compression ratio for speed: both compression and decompression are single
+// pass, without entropy coding, and use a small hash table to find matches.
+//
+// The compressed stream is a sequence of blocks. Each block starts with a
+// token byte whose high nibble is the number of literals and whose low nibble
+// is the match length minus kMinMatch (15 means that the length continues
+// with bytes that are added to it, until a byte different from 255 is read).
+// The literals follow, then the 2-byte little-endian offset of the match and
+// the continuation bytes of the match length. The last block only contains
+// literals.
+
+#ifndef OR_TOOLS_UTIL_FAST_COMPRESSION_H_
+#define OR_TOOLS_UTIL_FAST_COMPRESSION_H_
+
+#include <stddef.h>
+
+namespace operations_research {
+
+// Returns the maximum size of the output of FastCompress() for an input of
+// the given size.
+size_t FastCompressBound(size_t input_size);
+
+// Compresses 'input_size' bytes from 'input' into 'output', which must have
+// at least FastCompressBound(input_size) bytes. Returns the size of the
+// compressed data.
+size_t FastCompress(const char* input, size_t input_size, char* output);
+
+// Decompresses 'input_size' bytes from 'input' into 'output', which must
+// receive exactly 'output_size' bytes. Returns false if the input is
+// corrupted, in which case the content of 'output' is unspecified.
+bool FastUncompress(const char* input, size_t input_size, char* output,
+                    size_t output_size);
+
+}  // namespace operations_research
+#endif  // OR_TOOLS_UTIL_FAST_COMPRESSION_H_